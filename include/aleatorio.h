@@ -1,2 +1,27 @@
+#ifndef HEADER_ALEATORIO
+#define HEADER_ALEATORIO
+
+#include <stdint.h>
+
+/*!
+ * @typedef aleatorio_estado
+ * @brief Estado de um gerador xoshiro256**
+ *
+ * Dois estados semeados com o mesmo valor geram a mesma sequência.
+*/
+
+typedef struct aleatorio_estado {
+	uint64_t s[4]; /**< Estado interno, nunca todo nulo */
+} aleatorio_estado;
+
+void semearAleatorio_r(aleatorio_estado *, uint64_t);
+uint64_t proximoAleatorio_r(aleatorio_estado *);
+unsigned int numeroAleatorio_r(aleatorio_estado *, unsigned int);
+double realAleatorio_r(aleatorio_estado *);
+char *stringAleatoria_r(aleatorio_estado *, unsigned int);
+
+void semearAleatorio(uint64_t);
 char *stringAleatoria(unsigned int);
 unsigned int numeroAleatorio(unsigned int);
+
+#endif
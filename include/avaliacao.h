@@ -6,16 +6,101 @@
 #ifndef HEADER_AVALIACAO
 #define HEADER_AVALIACAO
 
+#include <stdint.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include "usuarios.h"
+
 /*!
  * @brief Estrutura do banco de dados
  *
- * ID AVALIADOR | ID AVALIADO | NOTA | COMENTÁRIO
+ * ID AVALIADOR | ID AVALIADO | NOTA | COMENTÁRIO | TEMPO
+ *
+ * TEMPO são os segundos desde 1970 em que a avaliação foi feita, depois
+ * do comentário completado com espaços até AVALIACAO_LIMITE_COMENTARIO
+ * bytes. Linhas gravadas sem ele (AVALIACAO_DB_ESTRUTURA) continuam
+ * válidas e têm tempo desconhecido.
 */
 
 #define AVALIACAO_DB "../../db/avaliacao.txt"
 #define AVALIACAO_DB_ESTRUTURA "%-4u\t%-4u\t%-4u\t%-200s\n"
+#define AVALIACAO_DB_ESTRUTURA_TEMPO "%-4u\t%-4u\t%-4u\t%-200s\t%u\n"
 #define AVALIACAO_LIMITE_INT 4
 #define AVALIACAO_LIMITE_COMENTARIO 200
+#define AVALIACAO_LINHA_NUMEROS 40 /**< Bytes que bastam para os três números de uma linha e seus '\t' */
+#define AVALIACAO_LINHA_TEMPO 11 /**< Bytes do '\t' e do tempo no fim de uma linha */
+#define AVALIACAO_LINHA_LIMITE (AVALIACAO_LINHA_NUMEROS + AVALIACAO_LIMITE_COMENTARIO + AVALIACAO_LINHA_TEMPO + 2) /**< Bytes de uma linha completa, com '\n' e '\0' */
+
+/*!
+ * @brief Registro binário de avaliações
+ *
+ * Formato compacto alternativo ao texto de AVALIACAO_DB, em dois
+ * arquivos: um de registros de 16 bytes (avaliacao_registro), depois de
+ * um cabeçalho também de 16 bytes, e uma pilha de comentários em que
+ * cada comentário é precedido pelo seu tamanho em um byte. O registro
+ * guarda a posição do comentário na pilha e é gravado depois dele, assim
+ * um registro no arquivo sempre tem o seu comentário.
+*/
+
+#define AVALIACAO_BINARIO_REGISTROS_SUFIXO ".reg"
+#define AVALIACAO_BINARIO_COMENTARIOS_SUFIXO ".com"
+#define AVALIACAO_BINARIO_ASSINATURA 0x4C415641 /**< "AVAL", primeiros bytes do arquivo de registros */
+#define AVALIACAO_BINARIO_VERSAO 1
+#define AVALIACAO_BINARIO_BITS_NOTA 3 /**< Bits baixos de avaliacao_registro.comentario com a nota */
+#define AVALIACAO_BINARIO_LIMITE_PILHA (1u << (32 - AVALIACAO_BINARIO_BITS_NOTA)) /**< Bytes endereçáveis da pilha de comentários */
+
+/*!
+ * @brief Gravação das avaliações em lote
+ *
+ * As linhas de avaliacao_fazerAvaliacao ficam em memória e vão para o
+ * arquivo em uma só escrita, seguida de fsync, junto com o contador do
+ * cabeçalho: quando chegam a AVALIACAO_LOTE ou a cada
+ * AVALIACAO_LOTE_INTERVALO_MS milissegundos. As consultas do módulo e
+ * avaliacao_sincronizar gravam as pendentes antes.
+*/
+
+#define AVALIACAO_LOTE 64
+#define AVALIACAO_LOTE_INTERVALO_MS 50
+
+#define AVALIACAO_HISTOGRAMAS_SUFIXO ".hist" /**< Acrescentado ao arquivo de avaliações para o arquivo de histogramas */
+#define AVALIACAO_HISTOGRAMAS_ASSINATURA 0x54534948 /**< "HIST", primeiros bytes do arquivo de histogramas */
+#define AVALIACAO_NOTAS 6 /**< Notas possíveis, de 0 a 5 */
+#define AVALIACAO_NOTA_POSITIVA 4 /**< Menor nota contada como positiva */
+
+/*!
+ * @brief Busca por palavras nos comentários
+ *
+ * Os termos são as sequências de letras e dígitos do comentário, em
+ * minúsculas e sem acentos (UTF-8): "Ótimo" e "otimo" são o mesmo termo.
+*/
+
+#define AVALIACAO_BUSCA_LIMITE_TERMO 32 /**< Bytes de um termo com o '\0', o que passar disso é ignorado */
+#define AVALIACAO_BUSCA_LIMITE_CONSULTA 16 /**< Termos de uma consulta */
+
+/*!
+ * @brief Pontuações alternativas à média simples, calculadas em segundo plano
+ *
+ * A média bayesiana soma a cada usuário AVALIACAO_PONTUACAO_PRIORI
+ * avaliações fictícias com a média de todas as avaliações, assim poucas
+ * notas pesam pouco. Na média com decaimento o peso de uma avaliação cai
+ * à metade a cada AVALIACAO_PONTUACAO_MEIA_VIDA segundos de idade.
+*/
+
+#define AVALIACAO_PONTUACAO_PRIORI 5.0
+#define AVALIACAO_PONTUACAO_MEIA_VIDA (90*24*3600.0)
+#define AVALIACAO_PONTUACAO_INTERVALO_MS 100 /**< Intervalo entre duas leituras do arquivo de avaliações pela thread das pontuações */
+#define AVALIACAO_PONTUACAO_BLOCO 1024 /**< Linhas lidas pela thread das pontuações entre duas aquisições da trava */
+
+/*!
+ * @brief Campos de uma avaliação copiados por avaliacao_cursorLer
+*/
+
+#define AVALIACAO_CAMPO_AVALIADOR 1
+#define AVALIACAO_CAMPO_AVALIADO 2
+#define AVALIACAO_CAMPO_NOTA 4
+#define AVALIACAO_CAMPO_COMENTARIO 8
+#define AVALIACAO_CAMPO_TEMPO 16
+#define AVALIACAO_CAMPOS_TODOS 31
 
 /*!
  * @enum avaliacao_condRet
@@ -46,6 +131,15 @@ typedef enum {
   AVALIADO /**< Busca por avaliações em que o usuário é o avaliado */
 } avaliacao_tipo;
 
+/*!
+ * @enum avaliacao_operador
+ * Como os termos de uma busca nos comentários são combinados
+*/
+typedef enum {
+  AVALIACAO_BUSCA_E, /**< Avaliações com todos os termos */
+  AVALIACAO_BUSCA_OU /**< Avaliações com algum dos termos */
+} avaliacao_operador;
+
 /*!
  * @typedef avaliacao
  * @brief Estrutura de dados de uma avaliação
@@ -57,6 +151,7 @@ typedef struct avaliacao {
   unsigned int avaliado; /**< Id do avaliado no grafo de usuários */
   unsigned int nota; /**< Nota atribuída pelo avaliador ao avaliado */
   char comentario[AVALIACAO_LIMITE_COMENTARIO];  /**< Comentário feito pelo avaliador ao avaliado */
+  unsigned int tempo; /**< Segundos desde 1970 em que a avaliação foi feita, 0 se desconhecido */
 } avaliacao;
 
 /*!
@@ -76,6 +171,371 @@ typedef struct avaliacao_vetor {
   avaliacao **array;
 } avaliacao_vetor;
 
+/*!
+ * @typedef avaliacao_posicoes
+ * @brief Posições no arquivo das avaliações de um usuário em um papel, em ordem de arquivo, de uso único do módulo
+*/
+
+typedef struct avaliacao_posicoes {
+  off_t *posicoes; /**< Início de cada linha no arquivo de avaliações */
+  unsigned int n; /**< Avaliações do usuário */
+  unsigned int capacidade; /**< Posições alocadas */
+} avaliacao_posicoes;
+
+/*!
+ * @typedef avaliacao_indice
+ * @brief Índice das avaliações por usuário, de uso único do módulo
+ *
+ * usuarios[AVALIADOR][id] tem as posições das avaliações feitas por id e
+ * usuarios[AVALIADO][id] as das recebidas, assim a n-ésima avaliação é
+ * uma leitura só (pread). O índice cobre o arquivo até tamanho; linhas
+ * acrescentadas por fora são indexadas na consulta seguinte.
+*/
+
+typedef struct avaliacao_indice {
+  int construido; /**< Não nulo se o índice reflete o arquivo até tamanho */
+  avaliacao_posicoes *usuarios[2]; /**< Posições por papel (avaliacao_tipo) e id */
+  unsigned int capacidade; /**< Ids com posição em cada vetor de usuarios */
+  off_t tamanho; /**< Bytes do arquivo já indexados */
+  ino_t arquivo; /**< Inode indexado, para notar que o arquivo foi trocado */
+  int descritor; /**< Descritor aberto para leitura, -1 se fechado */
+} avaliacao_indice;
+
+/*!
+ * @typedef avaliacao_estatisticas
+ * @brief Distribuição das notas recebidas por um usuário
+*/
+
+typedef struct avaliacao_estatisticas {
+  unsigned int contagem[AVALIACAO_NOTAS]; /**< Avaliações recebidas com cada nota */
+  unsigned int total; /**< Avaliações recebidas */
+  double media; /**< Nota média, 0 sem avaliações */
+  double mediana; /**< Nota mediana, média das duas centrais se total for par, 0 sem avaliações */
+  double positivas; /**< Percentual de avaliações com nota de pelo menos AVALIACAO_NOTA_POSITIVA */
+} avaliacao_estatisticas;
+
+/*!
+ * @typedef avaliacao_pontuacao
+ * @brief Pontuações de um usuário pelas notas recebidas
+*/
+
+typedef struct avaliacao_pontuacao {
+  unsigned int n; /**< Avaliações recebidas */
+  double media; /**< Média simples das notas, a de tpUsuario.avaliacao, 0 sem avaliações */
+  double bayesiana; /**< Média com AVALIACAO_PONTUACAO_PRIORI avaliações com a média global, a média global sem avaliações */
+  double decaida; /**< Média com decaimento pela idade das avaliações, 0 sem avaliações */
+  unsigned int avaliacoes; /**< Linhas do arquivo de avaliações contadas no cálculo */
+} avaliacao_pontuacao;
+
+/*!
+ * @typedef avaliacao_somas_pontuacao
+ * @brief Somas das notas recebidas por um usuário, de uso único do módulo
+*/
+
+typedef struct avaliacao_somas_pontuacao {
+  uint32_t n; /**< Avaliações recebidas */
+  uint64_t soma; /**< Soma das notas */
+  double soma_pesada; /**< Soma das notas vezes os pesos */
+  double pesos; /**< Soma dos pesos, 2 elevado à idade relativa a base em meias-vidas */
+} avaliacao_somas_pontuacao;
+
+/*!
+ * @typedef avaliacao_pontuacoes
+ * @brief Pontuações de todos os usuários, mantidas por uma thread, de uso único do módulo
+ *
+ * A thread lê as linhas acrescentadas ao arquivo de avaliações desde a
+ * leitura anterior e atualiza as somas; as consultas só leem as somas.
+ * Os pesos são relativos a base, o tempo da primeira avaliação com tempo,
+ * e são reescalados quando ficam grandes demais. Uma avaliação sem tempo
+ * conta como feita no tempo da anterior com tempo ou, se não houver, em
+ * base.
+*/
+
+typedef struct avaliacao_pontuacoes {
+  avaliacao_somas_pontuacao *usuarios; /**< Somas por id de avaliado */
+  unsigned int capacidade; /**< Ids com somas alocadas */
+  uint64_t soma; /**< Soma de todas as notas, para a média global */
+  unsigned int n; /**< Avaliações com nota válida */
+  unsigned int avaliacoes; /**< Linhas já lidas */
+  double base; /**< Tempo de peso 1, 0 antes da primeira avaliação com tempo */
+  unsigned int ultimo; /**< Tempo da última avaliação lida com tempo */
+  off_t tamanho; /**< Bytes do arquivo de avaliações já lidos */
+  ino_t arquivo; /**< Inode do arquivo de avaliações lido */
+  int ativo; /**< Não nulo enquanto a thread estiver rodando */
+  pthread_t trabalhador; /**< Thread que lê o arquivo e atualiza as somas */
+  pthread_mutex_t trava; /**< Protege as somas e ativo */
+  pthread_cond_t sinal; /**< Acorda a thread, depois de um lote gravado ou para terminar */
+} avaliacao_pontuacoes;
+
+/*!
+ * @typedef avaliacao_histogramas_cabecalho
+ * @brief Início do arquivo de histogramas, de uso único do módulo
+ *
+ * Depois do cabeçalho vêm AVALIACAO_NOTAS contadores de 32 bits por id,
+ * do id 0 em diante, assim o contador de uma nota de um usuário está
+ * sempre na mesma posição do arquivo.
+*/
+
+typedef struct avaliacao_histogramas_cabecalho {
+  uint32_t assinatura; /**< AVALIACAO_HISTOGRAMAS_ASSINATURA */
+  uint32_t notas; /**< AVALIACAO_NOTAS */
+  uint64_t arquivo; /**< Inode do arquivo de avaliações contado */
+  int64_t tamanho; /**< Bytes do arquivo de avaliações já contados */
+} avaliacao_histogramas_cabecalho;
+
+/*!
+ * @typedef avaliacao_histogramas
+ * @brief Contagem das notas recebidas por usuário, de uso único do módulo
+ *
+ * Espelho na memória do arquivo de histogramas. Cada avaliação gravada
+ * soma um a um contador e grava só ele, e o tamanho contado é gravado
+ * uma vez por consulta; se o arquivo faltar ou não corresponder ao de
+ * avaliações, é refeito.
+*/
+
+typedef struct avaliacao_histogramas {
+  int construido; /**< Não nulo se as contagens refletem o arquivo de avaliações até tamanho */
+  uint32_t (*contagens)[AVALIACAO_NOTAS]; /**< Contadores por id e nota */
+  unsigned int capacidade; /**< Ids com contadores alocados */
+  off_t tamanho; /**< Bytes do arquivo de avaliações já contados */
+  ino_t arquivo; /**< Inode do arquivo de avaliações contado */
+  int descritor; /**< Arquivo de histogramas aberto para leitura e escrita, -1 se fechado */
+} avaliacao_histogramas;
+
+/*!
+ * @typedef avaliacao_pares
+ * @brief Conjunto dos pares (avaliador, avaliado) já avaliados, de uso único do módulo
+ *
+ * Tabela hash de endereçamento aberto com a chave avaliador<<32|avaliado,
+ * assim saber se um usuário já avaliou outro é uma consulta só. Avaliações
+ * feitas pelo contexto entram na hora; as acrescentadas por fora, na
+ * consulta seguinte.
+*/
+
+typedef struct avaliacao_pares {
+  int construido; /**< Não nulo se o conjunto reflete o arquivo de avaliações até tamanho */
+  uint64_t *tabela; /**< Chaves dos pares, 0 em posição vazia */
+  unsigned int capacidade; /**< Posições da tabela, potência de 2 */
+  unsigned int n; /**< Pares na tabela */
+  off_t tamanho; /**< Bytes do arquivo de avaliações já lidos */
+  ino_t arquivo; /**< Inode do arquivo de avaliações lido */
+} avaliacao_pares;
+
+/*!
+ * @brief Maior número de threads usadas por avaliacao_recalcular para ler o arquivo de avaliações
+*/
+
+#define AVALIACAO_RECALCULO_THREADS_MAX 64
+
+/*!
+ * @typedef avaliacao_parte_recalculo
+ * @brief Trecho do arquivo de avaliações somado por uma thread de avaliacao_recalcular, de uso único do módulo
+ *
+ * O trecho começa no início de uma linha e termina depois do '\n' de
+ * outra. Cada thread soma só na sua parte; as partes são juntadas depois.
+*/
+
+typedef struct avaliacao_parte_recalculo {
+  const char *inicio; /**< Primeiro byte do trecho */
+  const char *fim; /**< Byte seguinte ao último do trecho */
+  unsigned int usuarios; /**< Ids com soma, de 0 ao maior id do contexto de usuários */
+  uint64_t *somas; /**< Soma das notas recebidas por id */
+  uint32_t *contagens; /**< Avaliações recebidas por id */
+} avaliacao_parte_recalculo;
+
+/*!
+ * @typedef avaliacao_grafo_notas
+ * @brief Grafo das avaliações com nota alta, de uso único do módulo
+ *
+ * Listas de adjacência compactas: as arestas de v são
+ * destinos[inicio[v]] até destinos[inicio[v+1]-1], uma por avaliado.
+*/
+
+typedef struct avaliacao_grafo_notas {
+  unsigned int usuarios; /**< Vértices, do id 0 ao maior id avaliador ou avaliado */
+  unsigned int *inicio; /**< Primeira aresta de cada vértice, com usuarios+1 posições */
+  unsigned int *destinos; /**< Avaliados de cada avaliador, em ordem crescente e sem repetição */
+  unsigned int *pesos; /**< Avaliações de nota alta de cada aresta */
+} avaliacao_grafo_notas;
+
+/*!
+ * @typedef avaliacao_grupo
+ * @brief Grupo de usuários que se avaliam bem entre si, candidato a conluio
+ *
+ * Componente fortemente conexo do grafo das avaliações com nota alta:
+ * cada membro alcança todos os outros seguindo avaliações do grupo.
+*/
+
+typedef struct avaliacao_grupo {
+  unsigned int *membros; /**< Ids dos membros em ordem crescente, dentro de avaliacao_conluio.membros */
+  unsigned int n; /**< Membros */
+  unsigned int arestas; /**< Pares ordenados (avaliador, avaliado) do grupo com avaliação de nota alta */
+  unsigned int reciprocas; /**< Pares de membros que se avaliaram com nota alta nos dois sentidos */
+  unsigned int avaliacoes; /**< Avaliações de nota alta dentro do grupo, peso total das arestas */
+  double densidade; /**< arestas dividido por n*(n-1), 1 se todos avaliaram todos */
+} avaliacao_grupo;
+
+/*!
+ * @typedef avaliacao_conluio
+ * @brief Resultado de avaliacao_detectarConluio, liberado com avaliacao_conluioLimpar
+*/
+
+typedef struct avaliacao_conluio {
+  avaliacao_grupo *grupos; /**< Grupos suspeitos, do mais denso para o menos e, empatados, do maior para o menor */
+  unsigned int n; /**< Grupos suspeitos */
+  unsigned int *membros; /**< Membros de todos os grupos, um grupo após o outro */
+  unsigned int *grupo; /**< Posição em grupos do grupo de cada id, UINT_MAX se o id não é suspeito */
+  unsigned int usuarios; /**< Ids com posição em grupo, do 0 ao maior id avaliador ou avaliado */
+} avaliacao_conluio;
+
+/*!
+ * @typedef avaliacao_termo
+ * @brief Termo dos comentários e a lista das avaliações em que aparece, de uso único do módulo
+ *
+ * A lista guarda os ids em ordem crescente, cada um como a diferença
+ * para o anterior em base 128 (7 bits por byte, o bit alto marca que o
+ * número continua): ids próximos ocupam um byte.
+*/
+
+typedef struct avaliacao_termo {
+  char termo[AVALIACAO_BUSCA_LIMITE_TERMO]; /**< Termo terminado em '\0', vazio em posição livre da tabela */
+  unsigned char *lista; /**< Ids das avaliações com o termo, comprimidos */
+  unsigned int tamanho; /**< Bytes usados da lista */
+  unsigned int capacidade; /**< Bytes alocados da lista */
+  unsigned int ultima; /**< Id da última avaliação da lista */
+  unsigned int n; /**< Avaliações com o termo */
+} avaliacao_termo;
+
+/*!
+ * @typedef avaliacao_busca
+ * @brief Índice invertido dos comentários, de uso único do módulo
+ *
+ * Tabela hash de endereçamento aberto dos termos. O id de uma avaliação
+ * é a sua linha no arquivo, a primeira depois do contador é a 1. Como
+ * nos pares, linhas acrescentadas ao arquivo são indexadas na busca
+ * seguinte, sem reler as anteriores.
+*/
+
+typedef struct avaliacao_busca {
+  int construido; /**< Não nulo se o índice reflete o arquivo de avaliações até tamanho */
+  avaliacao_termo *termos; /**< Tabela dos termos */
+  unsigned int capacidade; /**< Posições da tabela, potência de 2 */
+  unsigned int n; /**< Termos na tabela */
+  off_t *posicoes; /**< Início da linha de cada avaliação, a de id i em posicoes[i-1] */
+  unsigned int avaliacoes; /**< Avaliações indexadas, também o maior id */
+  unsigned int capacidade_posicoes; /**< Posições alocadas */
+  off_t tamanho; /**< Bytes do arquivo de avaliações já lidos */
+  ino_t arquivo; /**< Inode do arquivo de avaliações lido */
+} avaliacao_busca;
+
+/*!
+ * @typedef avaliacao_leitor_lista
+ * @brief Percurso por uma lista comprimida de avaliacao_termo, de uso único do módulo
+*/
+
+typedef struct avaliacao_leitor_lista {
+  const unsigned char *p; /**< Próximo byte da lista */
+  const unsigned char *fim; /**< Byte seguinte ao último da lista */
+  unsigned int atual; /**< Último id lido, 0 antes do primeiro */
+} avaliacao_leitor_lista;
+
+/*!
+ * @typedef avaliacao_registro
+ * @brief Avaliação no arquivo de registros binário, 16 bytes
+*/
+
+typedef struct avaliacao_registro {
+  uint32_t avaliador; /**< Id do avaliador */
+  uint32_t avaliado; /**< Id do avaliado */
+  uint32_t tempo; /**< Segundos desde 1970 em que a avaliação foi feita, 0 se desconhecido */
+  uint32_t comentario; /**< Posição do comentário na pilha, deslocada de AVALIACAO_BINARIO_BITS_NOTA bits, com a nota nos bits baixos */
+} avaliacao_registro;
+
+/*!
+ * @typedef avaliacao_binario_cabecalho
+ * @brief Início do arquivo de registros, do mesmo tamanho de um registro
+*/
+
+typedef struct avaliacao_binario_cabecalho {
+  uint32_t assinatura; /**< AVALIACAO_BINARIO_ASSINATURA */
+  uint32_t versao; /**< AVALIACAO_BINARIO_VERSAO */
+  uint64_t reservado; /**< Zero */
+} avaliacao_binario_cabecalho;
+
+/*!
+ * @typedef avaliacao_binario
+ * @brief Registro binário aberto para leitura por avaliacao_binarioAbrir
+ *
+ * Os dois arquivos ficam mapeados na memória (mmap) até
+ * avaliacao_binarioFechar; avaliações acrescentadas depois da abertura
+ * só são vistas ao abrir de novo.
+*/
+
+typedef struct avaliacao_binario {
+  const avaliacao_registro *registros; /**< Registros mapeados, sem o cabeçalho */
+  unsigned int n; /**< Registros completos e com comentário na pilha */
+  const unsigned char *pilha; /**< Pilha de comentários mapeada */
+  size_t tamanho_pilha; /**< Bytes mapeados da pilha */
+  void *mapa; /**< Início do mapeamento do arquivo de registros */
+  size_t tamanho_mapa; /**< Bytes mapeados do arquivo de registros */
+} avaliacao_binario;
+
+/*!
+ * @typedef avaliacao_escritor
+ * @brief Avaliações aguardando a gravação em lote, de uso único do módulo
+*/
+
+typedef struct avaliacao_escritor {
+  char buffer[AVALIACAO_LOTE*AVALIACAO_LINHA_LIMITE]; /**< Linhas no formato AVALIACAO_DB_ESTRUTURA aguardando gravação */
+  size_t tamanho; /**< Bytes usados do buffer */
+  unsigned int pendentes; /**< Avaliações no buffer */
+  int ativo; /**< Não nulo enquanto a thread de gravação estiver rodando */
+  pthread_t trabalhador; /**< Thread que grava o lote pelo gatilho de tempo */
+  pthread_mutex_t trava; /**< Protege o buffer, o contador e as escritas no arquivo */
+  pthread_cond_t sinal; /**< Acorda a thread de gravação */
+} avaliacao_escritor;
+
+/*!
+ * @typedef avaliacao_contexto
+ * @brief Estado de uma instância do módulo de avaliações
+ *
+ * As funções com sufixo _r recebem o contexto como primeiro argumento,
+ * as sem sufixo usam o contexto padrão, ligado ao contexto padrão de
+ * usuários e a AVALIACAO_DB.
+*/
+
+typedef struct avaliacao_contexto {
+  usuarios_contexto *usuarios; /**< Contexto de usuários dos avaliadores e avaliados */
+  unsigned int contador; /**< Identificador máximo já atribuído a uma avaliação */
+  avaliacao_indice indice; /**< Posições das avaliações por usuário, construído na primeira consulta */
+  avaliacao_histogramas histogramas; /**< Notas recebidas por usuário, carregadas na primeira consulta */
+  avaliacao_pares pares; /**< Pares já avaliados, construído na primeira consulta */
+  avaliacao_busca busca; /**< Índice invertido dos comentários, construído na primeira busca */
+  avaliacao_escritor escritor; /**< Avaliações feitas ainda não gravadas no arquivo */
+  avaliacao_pontuacoes pontuacoes; /**< Pontuações alternativas, com a thread iniciada na primeira consulta */
+  char db[USUARIOS_LIMITE_CAMINHO]; /**< Arquivo de avaliações */
+  char db_histogramas[USUARIOS_LIMITE_CAMINHO + sizeof(AVALIACAO_HISTOGRAMAS_SUFIXO)]; /**< Arquivo de histogramas, db seguido de AVALIACAO_HISTOGRAMAS_SUFIXO */
+} avaliacao_contexto;
+
+/*!
+ * @typedef avaliacao_cursor
+ * @brief Percurso pelas avaliações feitas ou recebidas por um usuário
+ *
+ * Aberto por avaliacao_cursorAbrir e lido por páginas com
+ * avaliacao_cursorLer, em ordem de arquivo e sem voltar ao início.
+ * Avaliações feitas depois da abertura também são percorridas.
+*/
+
+typedef struct avaliacao_cursor {
+  avaliacao_contexto *contexto; /**< Contexto das avaliações percorridas */
+  unsigned int identificador; /**< Usuário cujas avaliações são percorridas */
+  avaliacao_tipo tipo; /**< Papel do usuário nas avaliações */
+  unsigned int proxima; /**< Posição no índice da próxima avaliação a ler */
+  unsigned int notaMinima; /**< Menor nota aceita */
+  unsigned int notaMaxima; /**< Maior nota aceita */
+  unsigned int campos; /**< Máscara AVALIACAO_CAMPO_* dos campos copiados */
+} avaliacao_cursor;
+
 /*!
  * @brief Protótipos das funções
 */
@@ -88,6 +548,39 @@ avaliacao_condRet avaliacao_listar(unsigned int);
 avaliacao_condRet avaliacao_pegarContador();
 avaliacao_condRet avaliacao_obterAvaliacao(unsigned int, unsigned int, avaliacao_tipo, avaliacao *);
 avaliacao_condRet avaliacao_avaliar(unsigned int, unsigned int, unsigned int, char *);
+avaliacao_condRet avaliacao_avaliarSessao(usuarios_token, unsigned int, unsigned int, char *);
+avaliacao_condRet avaliacao_cursorAbrir(avaliacao_cursor *, unsigned int, avaliacao_tipo, unsigned int, unsigned int, unsigned int);
+avaliacao_condRet avaliacao_cursorLer(avaliacao_cursor *, avaliacao *, unsigned int, unsigned int *);
+avaliacao_condRet avaliacao_obterEstatisticas(unsigned int, avaliacao_estatisticas *);
+avaliacao_condRet avaliacao_sincronizar();
+avaliacao_condRet avaliacao_jaAvaliou(unsigned int, unsigned int);
+avaliacao_condRet avaliacao_recalcular(unsigned int, unsigned int *);
+avaliacao_condRet avaliacao_detectarConluio(unsigned int, unsigned int, double, avaliacao_conluio *);
+avaliacao_condRet avaliacao_conluioLimpar(avaliacao_conluio *);
+avaliacao_condRet avaliacao_obterPontuacao(unsigned int, avaliacao_pontuacao *);
+avaliacao_condRet avaliacao_buscar(const char *, avaliacao_operador, unsigned int, avaliacao *, unsigned int, unsigned int *);
+avaliacao_condRet avaliacao_binarioAbrir(avaliacao_binario *, const char *, const char *);
+avaliacao_condRet avaliacao_binarioLer(const avaliacao_binario *, unsigned int, avaliacao *, uint32_t *);
+avaliacao_condRet avaliacao_binarioFechar(avaliacao_binario *);
+avaliacao_condRet avaliacao_binarioAcrescentar(const char *, const char *, avaliacao *, uint32_t);
+avaliacao_condRet avaliacao_binarioConverter(const char *, const char *, const char *, unsigned int *);
+
+avaliacao_contexto *avaliacao_contextoCriar(usuarios_contexto *, const char *);
+avaliacao_condRet avaliacao_contextoDestruir(avaliacao_contexto **);
+avaliacao_condRet avaliacao_fazerAvaliacao_r(avaliacao_contexto *, avaliacao *);
+avaliacao *avaliacao_iniciar_r(avaliacao_contexto *);
+avaliacao_condRet avaliacao_pegarContador_r(avaliacao_contexto *);
+avaliacao_condRet avaliacao_obterAvaliacao_r(avaliacao_contexto *, unsigned int, unsigned int, avaliacao_tipo, avaliacao *);
+avaliacao_condRet avaliacao_avaliar_r(avaliacao_contexto *, unsigned int, unsigned int, unsigned int, char *);
+avaliacao_condRet avaliacao_avaliarSessao_r(avaliacao_contexto *, usuarios_token, unsigned int, unsigned int, char *);
+avaliacao_condRet avaliacao_cursorAbrir_r(avaliacao_contexto *, avaliacao_cursor *, unsigned int, avaliacao_tipo, unsigned int, unsigned int, unsigned int);
+avaliacao_condRet avaliacao_obterEstatisticas_r(avaliacao_contexto *, unsigned int, avaliacao_estatisticas *);
+avaliacao_condRet avaliacao_sincronizar_r(avaliacao_contexto *);
+avaliacao_condRet avaliacao_jaAvaliou_r(avaliacao_contexto *, unsigned int, unsigned int);
+avaliacao_condRet avaliacao_recalcular_r(avaliacao_contexto *, unsigned int, unsigned int *);
+avaliacao_condRet avaliacao_detectarConluio_r(avaliacao_contexto *, unsigned int, unsigned int, double, avaliacao_conluio *);
+avaliacao_condRet avaliacao_obterPontuacao_r(avaliacao_contexto *, unsigned int, avaliacao_pontuacao *);
+avaliacao_condRet avaliacao_buscar_r(avaliacao_contexto *, const char *, avaliacao_operador, unsigned int, avaliacao *, unsigned int, unsigned int *);
 
 #endif
 
@@ -99,6 +99,8 @@ grafo_lista_no *vizinhos(grafo *, int);
 grafo_cte adiciona_vertice(grafo *, int);
 grafo_cte remove_vertice(grafo *, int);
 grafo_cte adiciona_aresta(grafo *, int, int);
+grafo_no *grafo_anexa_vertice(grafo *, int);
+grafo_cte grafo_anexa_aresta(grafo_no *, grafo_no *, int);
 grafo_cte remove_aresta(grafo *, int, int);
 void *retorna_valor_vertice(grafo *, int);
 grafo_cte muda_valor_vertice(grafo *, int, void *);
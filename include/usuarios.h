@@ -9,6 +9,9 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdarg.h>
+#include <stdint.h>
+#include <float.h>
+#include <pthread.h>
 #include "aleatorio.h"
 #include "grafo.h"
 
@@ -31,6 +34,7 @@
 #define USUARIOS_LIMITE_EMAIL 30
 #define USUARIOS_LIMITE_DOUBLE 9
 #define USUARIOS_LIMITE_INT 4
+#define USUARIOS_LIMITE_CAMINHO 256
 
 /*!
  * @brief Arquivos do banco de dados a respeito dos usuários
@@ -42,6 +46,41 @@
 #define USUARIOS_DB_AMIGOS "../../db/amigos.txt"
 #define USUARIOS_DB_AMIGOS_REGISTRO_TAMANHO 15 
 
+/*!
+ * @brief Tamanho em bytes de um registro em USUARIOS_DB, contando os separadores
+*/
+
+#define USUARIOS_DB_REGISTRO_TAMANHO ( \
+  USUARIOS_LIMITE_INT + 1 + \
+  USUARIOS_LIMITE_USUARIO + 1 + \
+  USUARIOS_LIMITE_NOME + 1 + \
+  USUARIOS_LIMITE_EMAIL + 1 + \
+  USUARIOS_LIMITE_SENHA + 1 + \
+  USUARIOS_LIMITE_ENDERECO + 1 + \
+  USUARIOS_LIMITE_INT + 1 + \
+  USUARIOS_LIMITE_INT + 1 + \
+  USUARIOS_LIMITE_INT + 1 + \
+  USUARIOS_LIMITE_DOUBLE + 1 + \
+  USUARIOS_LIMITE_INT + 1 + \
+  USUARIOS_LIMITE_INT + 1 \
+)
+
+/*!
+ * @brief Log de escrita antecipada (WAL) das alterações de usuários
+ *
+ * Cada entrada é um registro completo no formato USUARIOS_DB_ESTRUTURA,
+ * aplicado em USUARIOS_DB pelo checkpoint. Entradas são agrupadas em
+ * memória e gravadas em lote (group commit) quando chegam a
+ * USUARIOS_WAL_LOTE ou a cada USUARIOS_WAL_INTERVALO_MS milissegundos.
+ * O checkpoint ocorre em segundo plano quando o log acumula
+ * USUARIOS_WAL_CHECKPOINT entradas.
+*/
+
+#define USUARIOS_DB_WAL "../../db/usuarios.wal"
+#define USUARIOS_WAL_LOTE 64
+#define USUARIOS_WAL_INTERVALO_MS 50
+#define USUARIOS_WAL_CHECKPOINT 1024
+
 /*!
  * @enum usuarios_forma_de_pagamento
  * @brief Estrutura de numeração para as formas de pagamento
@@ -89,11 +128,11 @@ typedef enum {
 
 typedef struct tpUsuario {
 	unsigned int identificador; /**< Identificador único do usuário no grafo e no arquivo de dados */
-	char nome[USUARIOS_LIMITE_NOME]; /**< Nome do cliente, não deve ultrapassar o limite de USUARIOS_LIMITE_NOME-1 caracteres */
+	uint32_t nome; /**< Nome do cliente no conjunto de textos internados do contexto (ver usuarios_internos), não deve ultrapassar o limite de USUARIOS_LIMITE_NOME-1 caracteres */
 	char usuario[USUARIOS_LIMITE_USUARIO]; /**< Usuário do cliente, único, não deve ultrapassar o limite de USUARIOS_LIMITE_USUARIO-1 caracteres */
 	char email[USUARIOS_LIMITE_EMAIL]; /**< E-mail do cliente, não deve ultrapassar o limite de USUARIOS_LIMITE_EMAIL-1 caracteres */
 	char senha[USUARIOS_LIMITE_SENHA]; /**< Senha do cliente, não deve ultrapassar o limite de USUARIOS_LIMITE_SENHA-1 caracteres */
-	char endereco[USUARIOS_LIMITE_ENDERECO]; /**< Endereço do cliente, não deve ultrapassar o limite de USUARIOS_LIMITE_ENDERECO-1 caracteres */
+	uint32_t endereco; /**< Endereço do cliente no conjunto de textos internados do contexto, não deve ultrapassar o limite de USUARIOS_LIMITE_ENDERECO-1 caracteres */
 	usuarios_forma_de_pagamento formaPagamento; /**< Forma de pagamento padrão */
 	usuarios_tipo_usuario tipo; /**< Tipo do usuário, se é OFERTANTE, CONSUMIDOR ou ADMINISTRADOR */
 	usuarios_estado_de_usuario estado; /**< Estado do usuário, ATIVO ou INATIVO por alguma razão */
@@ -137,7 +176,11 @@ typedef enum {
   USUARIOS_FALHA_ACESSORESTRITO,
   USUARIOS_FALHA_LISTARAMIGOS,
   USUARIOS_FALHA_REMOVER_AMIZADE,
-  USUARIOS_FALHA_ALOCAR
+  USUARIOS_FALHA_ALOCAR,
+  USUARIOS_FALHA_WAL,
+  USUARIOS_FALHA_TOKEN,
+  USUARIOS_FALHA_SEMCAMINHO,
+  USUARIOS_FALHA_COMPACTAR
 } usuarios_condRet;
 
 /*!
@@ -153,15 +196,225 @@ typedef enum {
 } usuarios_relacao;
 
 /*!
- * @typedef usuarios_cadastro_argumentos
- * @brief Estrutura para os argumentos da função usuarios_cadastro, de uso único do módulo. Serve para facilitar na leitura de argumentos
+ * @enum usuarios_campo
+ * @brief Campos de tpUsuario, chave das funções de acesso tipado
+ *
+ * A ordem é a mesma da tabela de descritores do módulo, por isso
+ * USUARIOS_CAMPO_INVALIDO deve permanecer o último.
+*/
+
+typedef enum {
+  USUARIOS_CAMPO_IDENTIFICADOR, /**< unsigned int identificador */
+  USUARIOS_CAMPO_USUARIO, /**< char usuario[USUARIOS_LIMITE_USUARIO] */
+  USUARIOS_CAMPO_NOME, /**< char nome[USUARIOS_LIMITE_NOME] */
+  USUARIOS_CAMPO_EMAIL, /**< char email[USUARIOS_LIMITE_EMAIL] */
+  USUARIOS_CAMPO_SENHA, /**< char senha[USUARIOS_LIMITE_SENHA] */
+  USUARIOS_CAMPO_ENDERECO, /**< char endereco[USUARIOS_LIMITE_ENDERECO] */
+  USUARIOS_CAMPO_FORMAPAGAMENTO, /**< usuarios_forma_de_pagamento formaPagamento */
+  USUARIOS_CAMPO_TIPO, /**< usuarios_tipo_usuario tipo */
+  USUARIOS_CAMPO_ESTADO, /**< usuarios_estado_de_usuario estado */
+  USUARIOS_CAMPO_AVALIACAO, /**< double avaliacao */
+  USUARIOS_CAMPO_N_AVALIACAO, /**< unsigned int n_avaliacao */
+  USUARIOS_CAMPO_N_RECLAMACOES, /**< unsigned int n_reclamacoes */
+  USUARIOS_CAMPO_INVALIDO /**< Nenhum campo, também é o número de campos */
+} usuarios_campo;
+
+/*!
+ * @enum usuarios_tipo_campo
+ * @brief Tipo de dado armazenado em um campo de tpUsuario
+*/
+
+typedef enum {
+  USUARIOS_TIPO_INTEIRO, /**< unsigned int ou enumeração */
+  USUARIOS_TIPO_REAL, /**< double */
+  USUARIOS_TIPO_TEXTO /**< String finalizada com '\0' */
+} usuarios_tipo_campo;
+
+/*!
+ * @brief Valor de campo de usuarios_filtro que aceita qualquer valor
+*/
+
+#define USUARIOS_QUALQUER -1
+
+/*!
+ * @typedef usuarios_filtro
+ * @brief Condições de usuarios_consultar; um usuário precisa atender a todas
+ *
+ * @code
+ * usuarios_filtro filtro = USUARIOS_FILTRO_TODOS;
+ * filtro.tipo = OFERTANTE;
+ * filtro.estado = ATIVO;
+ * filtro.avaliacaoMinima = 4;
+ * @endcode
+*/
+
+typedef struct usuarios_filtro {
+  int tipo; /**< usuarios_tipo_usuario ou USUARIOS_QUALQUER */
+  int estado; /**< usuarios_estado_de_usuario ou USUARIOS_QUALQUER */
+  int formaPagamento; /**< usuarios_forma_de_pagamento ou USUARIOS_QUALQUER */
+  double avaliacaoMinima; /**< Menor avaliação aceita, inclusive */
+  double avaliacaoMaxima; /**< Maior avaliação aceita, inclusive */
+} usuarios_filtro;
+
+/*!
+ * @brief Filtro que aceita todos os usuários, ponto de partida para consultas
+*/
+
+#define USUARIOS_FILTRO_TODOS {USUARIOS_QUALQUER, USUARIOS_QUALQUER, USUARIOS_QUALQUER, -DBL_MAX, DBL_MAX}
+
+/*!
+ * @typedef usuarios_quente
+ * @brief Campos de tpUsuario que não são texto, guardados em um vetor denso por identificador, de uso único do módulo
+ *
+ * É uma cópia dos campos de tpUsuario, que continua sendo o registro
+ * completo: é o que a sessão devolve e o que vai para o arquivo, o log e
+ * as páginas. A cópia existe por dois motivos. Filtros por estado, tipo
+ * ou avaliação percorrem este vetor (32 bytes por usuário) sem trazer
+ * para a cache as strings de tpUsuario. No modo preguiçoso de
+ * usuarios_carregarIndice os registros saem da memória, e o vetor
+ * continua lá, então esses filtros não leem o arquivo.
+ *
+ * Toda alteração de um campo passa por tpUsuario e é copiada para cá em
+ * seguida (carga, cadastro, usuarios_atualizarDados_r e
+ * usuarios_atualizarAvaliacao_r).
+*/
+
+typedef struct usuarios_quente {
+  unsigned int identificador; /**< 0 se não houver usuário com o índice */
+  usuarios_forma_de_pagamento formaPagamento;
+  usuarios_tipo_usuario tipo;
+  usuarios_estado_de_usuario estado;
+  unsigned int n_avaliacao;
+  unsigned int n_reclamacoes;
+  double avaliacao;
+} usuarios_quente;
+
+/*!
+ * @brief Posições dos mapas de bits em usuarios_indices: um por valor de tipo, estado e forma de pagamento, e um com todos os usuários
+*/
+
+#define USUARIOS_BITMAP_TIPO 0
+#define USUARIOS_BITMAP_ESTADO 3
+#define USUARIOS_BITMAP_PAGAMENTO 7
+#define USUARIOS_BITMAP_TODOS 11
+#define USUARIOS_BITMAPS 12
+
+/*!
+ * @typedef usuarios_indices
+ * @brief Índices secundários sobre os campos quentes, de uso único do módulo
+ *
+ * Cada mapa de bits tem o bit i ligado se o usuário i tem o valor
+ * correspondente; por_avaliacao tem os ids em ordem de avaliação e id,
+ * para consultas por faixa com busca binária.
+*/
+
+typedef struct usuarios_indices {
+  int construido; /**< Não nulo se os índices refletem o grafo */
+  uint64_t *bitmaps[USUARIOS_BITMAPS]; /**< Mapas de bits por identificador */
+  unsigned int palavras; /**< Palavras de 64 bits alocadas em cada mapa */
+  unsigned int *por_avaliacao; /**< Ids em ordem crescente de avaliação e, nos empates, de id */
+  unsigned int n; /**< Ids em por_avaliacao */
+  unsigned int capacidade; /**< Posições alocadas em por_avaliacao */
+} usuarios_indices;
+
+/*!
+ * @typedef usuarios_estatisticas_disponibilidade
+ * @brief Contadores do filtro de disponibilidade de usuario e email (ver usuarios_estatisticasDisponibilidade)
+ *
+ * A taxa de falsos positivos é falsos_positivos/(rejeitadas+falsos_positivos),
+ * a fração dos dados livres que ainda precisou da verificação exata.
+*/
+
+typedef struct usuarios_estatisticas_disponibilidade {
+  unsigned long consultas; /**< Verificações de repetição de usuario ou email */
+  unsigned long rejeitadas; /**< Respondidas como livres só pelo filtro */
+  unsigned long confirmadas; /**< Positivos do filtro confirmados pela verificação exata */
+  unsigned long falsos_positivos; /**< Positivos do filtro que a verificação exata achou livres */
+} usuarios_estatisticas_disponibilidade;
+
+/*!
+ * @brief Posições por texto e contadores por texto do filtro de disponibilidade
+*/
+
+#define USUARIOS_DISPONIBILIDADE_FUNCOES 7
+#define USUARIOS_DISPONIBILIDADE_CONTADORES 16
+
+/*!
+ * @typedef usuarios_disponibilidade
+ * @brief Filtro de Bloom com contadores sobre os usuario e email em uso, de uso único do módulo
+ *
+ * Cada texto incrementa USUARIOS_DISPONIBILIDADE_FUNCOES contadores de 4 bits;
+ * se algum dos contadores de um texto é nulo, ele não está em uso. Os
+ * contadores permitem retirar o valor antigo quando usuario ou email
+ * mudam; um contador que satura em 15 não é mais decrementado.
+*/
+
+typedef struct usuarios_disponibilidade {
+  int construido; /**< Não nulo se o filtro reflete o grafo */
+  uint8_t *contadores; /**< Dois contadores de 4 bits por byte */
+  unsigned int capacidade; /**< Número de contadores, potência de 2 */
+  unsigned int n; /**< Textos inseridos */
+  usuarios_estatisticas_disponibilidade estatisticas; /**< Mantidas quando o filtro é reconstruído */
+} usuarios_disponibilidade;
+
+/*!
+ * @typedef usuarios_descritor_campo
+ * @brief Descreve onde e como um campo é armazenado em tpUsuario, de uso único do módulo
 */
 
-typedef struct usuarios_cadastro_argumentos {
-	const char *validos; /**< Um argumento válido */
-	int tamanho; /**< Tamanho em bytes que ocupa o dado do argumento */
-	char *destino; /**< Onde será armazenado o dado do argumento */
-} usuarios_cadastro_argumentos;
+typedef struct usuarios_descritor_campo {
+  const char *nome; /**< Nome do campo aceito por usuarios_retornaDados e usuarios_atualizarDados */
+  usuarios_tipo_campo tipo; /**< Tipo do dado no campo */
+  size_t deslocamento; /**< Posição do campo em tpUsuario (offsetof) */
+  size_t deslocamento_quente; /**< Posição do campo em usuarios_quente, se não for texto */
+  int tamanho; /**< Tamanho em bytes do campo; nos campos internados, do texto */
+  int internado; /**< Não nulo se o campo guarda um handle de usuarios_internos em vez do texto */
+} usuarios_descritor_campo;
+
+/*!
+ * @typedef usuarios_linha
+ * @brief Registro de USUARIOS_DB com todos os textos, usado para ler e escrever os arquivos, de uso único do módulo
+ *
+ * Os campos internados de dados ficam sem uso; os textos estão em nome
+ * e endereco até o registro ser internado com usuarios_linhaInternar.
+*/
+
+typedef struct usuarios_linha {
+  tpUsuario dados; /**< Demais campos */
+  char nome[USUARIOS_LIMITE_NOME]; /**< Texto do nome */
+  char endereco[USUARIOS_LIMITE_ENDERECO]; /**< Texto do endereço */
+} usuarios_linha;
+
+/*!
+ * @typedef usuarios_interno
+ * @brief Texto internado e quantos registros o usam, de uso único do módulo
+*/
+
+typedef struct usuarios_interno {
+  char *texto; /**< Texto, NULL se a entrada está livre */
+  unsigned int referencias; /**< Registros que usam o texto */
+  unsigned int dispersao; /**< Valor de dispersão do texto */
+} usuarios_interno;
+
+/*!
+ * @typedef usuarios_internos
+ * @brief Conjunto de textos internados dos campos de baixa cardinalidade (nome e endereco), de uso único do módulo
+ *
+ * Cada texto distinto é guardado uma vez; os registros guardam um handle
+ * de 32 bits, o índice da entrada mais 1. O handle 0 é o texto vazio.
+ * Uma entrada é liberada quando o último registro deixa de usá-la.
+*/
+
+typedef struct usuarios_internos {
+  usuarios_interno *entradas; /**< Textos por handle-1 */
+  unsigned int n; /**< Entradas usadas ou livres */
+  unsigned int capacidade; /**< Entradas alocadas */
+  uint32_t *livres; /**< Handles de entradas livres, reaproveitados primeiro; alocado com capacidade posições */
+  unsigned int n_livres; /**< Handles em livres */
+  uint32_t *tabela; /**< Tabela de dispersão de handles, endereçamento aberto; 0 vazio, UINT32_MAX removido */
+  unsigned int capacidade_tabela; /**< Posições da tabela, potência de 2 */
+  unsigned int ocupadas; /**< Posições da tabela não vazias, incluindo removidas */
+} usuarios_internos;
 
 /*!
  * @typedef usuarios_uintarray
@@ -173,23 +426,370 @@ typedef struct usuarios_uintarray {
   unsigned int *array; /**< Ponteiro para os inteiros não negativos do array */
 } usuarios_uintarray;
 
+/*!
+ * @typedef usuarios_wal
+ * @brief Estado do log de escrita antecipada de alterações de usuários, de uso único do módulo
+*/
+
+typedef struct usuarios_wal {
+  FILE *log; /**< Arquivo USUARIOS_DB_WAL aberto para acréscimo, NULL se fechado */
+  char buffer[USUARIOS_WAL_LOTE*USUARIOS_DB_REGISTRO_TAMANHO]; /**< Entradas aguardando o group commit */
+  unsigned int pendentes; /**< Número de entradas no buffer */
+  unsigned int registradas; /**< Número de entradas gravadas no log ainda não aplicadas em USUARIOS_DB */
+  int ativo; /**< Não nulo enquanto a thread de checkpoint estiver rodando */
+  pthread_t trabalhador; /**< Thread de group commit e checkpoint em segundo plano */
+  pthread_mutex_t trava; /**< Protege o buffer, o log e as escritas em USUARIOS_DB */
+  pthread_cond_t sinal; /**< Acorda a thread de segundo plano */
+} usuarios_wal;
+
+/*!
+ * @typedef usuarios_token
+ * @brief Identificador opaco de uma sessão da tabela de sessões
+ *
+ * Os 32 bits baixos são a posição da sessão na tabela e os 32 altos um
+ * segredo aleatório sorteado no login. A busca é O(1) e um token de uma
+ * sessão encerrada não é aceito quando a posição é reutilizada. O valor
+ * 0 nunca é um token válido.
+*/
+
+typedef unsigned long long usuarios_token;
+
+/*!
+ * @brief Número de posições alocadas na primeira sessão aberta da tabela, dobra quando enche
+*/
+
+#define USUARIOS_SESSOES_INICIAL 64
+
+/*!
+ * @brief Menor número de registros completos mantidos na memória pelo modo preguiçoso de usuarios_carregarIndice
+*/
+
+#define USUARIOS_PAGINAS_MINIMO 4
+
+/*!
+ * @typedef usuarios_sessao_entrada
+ * @brief Posição da tabela de sessões
+*/
+
+typedef struct usuarios_sessao_entrada {
+  unsigned int identificador; /**< Usuário da sessão, 0 se a posição estiver livre */
+  unsigned int segredo; /**< Parte aleatória do token, 0 se a posição estiver livre */
+  unsigned int proxima_livre; /**< Próxima posição livre, válida se esta também estiver livre */
+} usuarios_sessao_entrada;
+
+/*!
+ * @typedef usuarios_sessoes
+ * @brief Tabela de sessões abertas ao mesmo tempo, de uso único do módulo
+*/
+
+typedef struct usuarios_sessoes {
+  usuarios_sessao_entrada *entradas; /**< Vetor de posições da tabela */
+  unsigned int capacidade; /**< Número de posições alocadas */
+  unsigned int livre; /**< Primeira posição livre, igual a capacidade se não houver */
+  unsigned int abertas; /**< Número de sessões abertas */
+  unsigned long long semente; /**< Estado do gerador de segredos, 0 antes de ser semeado */
+  pthread_mutex_t trava; /**< Protege a tabela */
+} usuarios_sessoes;
+
+/*!
+ * @typedef usuarios_recomendacao
+ * @brief Um candidato de "pessoas que você talvez conheça"
+*/
+
+typedef struct usuarios_recomendacao {
+  unsigned int identificador; /**< Id do usuário recomendado */
+  unsigned int mutuos; /**< Número de amigos confirmados em comum */
+  double pontuacao; /**< mutuos*(1 + avaliacao/5), critério da ordenação */
+} usuarios_recomendacao;
+
+/*!
+ * @typedef usuarios_cache_recomendacao
+ * @brief Recomendações já calculadas para um usuário, de uso único do módulo
+*/
+
+typedef struct usuarios_cache_recomendacao {
+  int valido; /**< Nulo se precisa ser recalculado */
+  unsigned int k; /**< Limite pedido no cálculo, a lista é completa se n < k */
+  unsigned int n; /**< Número de itens calculados */
+  usuarios_recomendacao *itens; /**< Itens em ordem decrescente de pontuação */
+} usuarios_cache_recomendacao;
+
+/*!
+ * @typedef usuarios_visitas
+ * @brief Vetores reutilizáveis da busca em largura bidirecional, de uso único do módulo
+ *
+ * Cada vetor tem duas metades de capacidade posições, uma para a busca a
+ * partir da origem e outra a partir do destino, indexadas por id. Uma
+ * posição só vale se marca for igual a geracao, assim nada precisa ser
+ * zerado entre consultas.
+*/
+
+typedef struct usuarios_visitas {
+  unsigned int *marca; /**< Geração da consulta que visitou o id */
+  unsigned int *pai; /**< Id pelo qual o id foi alcançado */
+  unsigned int *distancia; /**< Distância do id ao ponto de partida do lado */
+  unsigned int *fila; /**< Fila de cada lado */
+  unsigned int capacidade; /**< Posições de cada metade */
+  unsigned int geracao; /**< Geração da consulta corrente */
+} usuarios_visitas;
+
+/*!
+ * @typedef usuarios_chave_pesquisa
+ * @brief Entrada do vetor ordenado de prefixos, de uso único do módulo
+*/
+
+typedef struct usuarios_chave_pesquisa {
+  char *texto; /**< usuario ou nome em minúsculas */
+  unsigned int identificador; /**< Dono do texto */
+} usuarios_chave_pesquisa;
+
+/*!
+ * @typedef usuarios_trigrama
+ * @brief Lista de ocorrência de um trigrama, de uso único do módulo
+*/
+
+typedef struct usuarios_trigrama {
+  unsigned int codigo; /**< Os três bytes do trigrama em minúsculas, 0 se a posição da tabela estiver livre */
+  unsigned int n; /**< Número de ids na lista */
+  unsigned int capacidade; /**< Posições alocadas em ids */
+  unsigned int *ids; /**< Ids com o trigrama em usuario ou nome, em ordem crescente */
+} usuarios_trigrama;
+
+/*!
+ * @typedef usuarios_pesquisa
+ * @brief Índice de pesquisa por usuario e nome, de uso único do módulo
+ *
+ * Prefixos são achados por busca binária em chaves, ordenado por texto, e
+ * trechos com três ou mais caracteres pela interseção das listas de seus
+ * trigramas na tabela de dispersão trigramas.
+*/
+
+typedef struct usuarios_pesquisa {
+  int construido; /**< Não nulo se o índice reflete o grafo */
+  usuarios_chave_pesquisa *chaves; /**< Chaves em ordem de texto e identificador */
+  unsigned int n_chaves; /**< Número de chaves */
+  unsigned int capacidade_chaves; /**< Posições alocadas em chaves */
+  usuarios_trigrama *trigramas; /**< Tabela de dispersão de trigramas, endereçamento aberto */
+  unsigned int n_trigramas; /**< Posições ocupadas em trigramas */
+  unsigned int capacidade_trigramas; /**< Posições de trigramas, potência de 2 */
+} usuarios_pesquisa;
+
+/*!
+ * @typedef usuarios_resultado_pesquisa
+ * @brief Usuário encontrado e a avaliação usada para ordená-lo, de uso único do módulo
+*/
+
+typedef struct usuarios_resultado_pesquisa {
+  unsigned int identificador; /**< Id do usuário */
+  double avaliacao; /**< Avaliação do usuário no momento da pesquisa */
+} usuarios_resultado_pesquisa;
+
+/*!
+ * @typedef usuarios_arco_origem
+ * @brief Arco do grafo e o usuário de onde ele sai, de uso único do módulo
+*/
+
+typedef struct usuarios_arco_origem {
+  grafo_arco *arco; /**< Arco, cujo valor é o id da aresta */
+  unsigned int origem; /**< Id do usuário de origem */
+} usuarios_arco_origem;
+
+/*!
+ * @typedef usuarios_pagina
+ * @brief Registro completo de um usuário na memória do modo preguiçoso, de uso único do módulo
+*/
+
+typedef struct usuarios_pagina {
+  tpUsuario dados; /**< Registro lido de USUARIOS_DB, deve ser o primeiro membro */
+  unsigned int anterior; /**< Página usada mais recentemente que esta, UINT_MAX se for a cabeça */
+  unsigned int proxima; /**< Página usada menos recentemente que esta, UINT_MAX se for a cauda */
+  int sujo; /**< Não nulo se o registro foi alterado depois de lido de USUARIOS_DB */
+} usuarios_pagina;
+
+/*!
+ * @typedef usuarios_paginacao
+ * @brief Estado do modo preguiçoso de carregamento, de uso único do módulo
+ *
+ * Com limite nulo todos os registros ficam na memória, como em
+ * usuarios_carregarArquivo. Caso contrário os nós do grafo começam sem
+ * dados e só os nomes de usuário ficam na memória, em nomes; o registro
+ * completo é lido na primeira vez que for pedido e fica em uma das limite
+ * páginas, que são reaproveitadas da menos usada recentemente para a mais.
+*/
+
+typedef struct usuarios_paginacao {
+  unsigned int limite; /**< Número máximo de páginas, 0 se o modo preguiçoso estiver desligado */
+  usuarios_pagina *paginas; /**< Páginas alocadas na primeira falta */
+  unsigned int n; /**< Páginas em uso */
+  unsigned int cabeca; /**< Página usada mais recentemente, UINT_MAX se não houver */
+  unsigned int cauda; /**< Página usada menos recentemente, UINT_MAX se não houver */
+  char *nomes; /**< Nomes de usuário terminados em '\0', um atrás do outro */
+  size_t nomes_tamanho; /**< Bytes usados em nomes */
+  size_t nomes_capacidade; /**< Bytes alocados em nomes */
+  size_t *deslocamentos; /**< Posição em nomes do nome de usuário de cada id */
+  unsigned int deslocamentos_capacidade; /**< Posições alocadas em deslocamentos */
+  FILE *leitura; /**< USUARIOS_DB aberto para leitura das faltas */
+} usuarios_paginacao;
+
+/*!
+ * @brief Maior número de threads usadas por usuarios_carregarArquivo para ler os arquivos
+*/
+
+#define USUARIOS_CARGA_THREADS_MAX 64
+
+/*!
+ * @typedef usuarios_parte_carga
+ * @brief Trecho de um arquivo do banco lido por uma thread da carga, de uso único do módulo
+ *
+ * O trecho começa no início de um registro e termina depois do '\n' de
+ * outro. Cada thread escreve só na sua parte; o grafo é montado depois,
+ * percorrendo as partes em ordem.
+*/
+
+typedef struct usuarios_parte_carga {
+  const char *inicio; /**< Primeiro byte do trecho */
+  const char *fim; /**< Byte seguinte ao último do trecho */
+  int preguicoso; /**< Não nulo se só os nomes de usuário devem ser guardados */
+  tpUsuario **registros; /**< Registros lidos de USUARIOS_DB, fora do modo preguiçoso; nome e endereco guardam posições em textos */
+  char *textos; /**< Nomes e endereços dos registros, ainda não internados, separados por '\0' */
+  size_t textos_tamanho; /**< Bytes usados em textos */
+  size_t textos_capacidade; /**< Bytes alocados em textos */
+  char (*nomes)[USUARIOS_LIMITE_USUARIO]; /**< Nomes de usuário lidos de USUARIOS_DB, no modo preguiçoso */
+  usuarios_quente *quentes; /**< Campos quentes lidos de USUARIOS_DB, no modo preguiçoso */
+  int (*arestas)[3]; /**< Id, origem e destino lidos de USUARIOS_DB_AMIGOS */
+  unsigned int n; /**< Itens lidos */
+  unsigned int capacidade; /**< Itens alocados */
+  int terminado; /**< Não nulo se o trecho tem o registro que encerra o arquivo (id 0 ou ilegível) */
+  int falha; /**< Não nulo se faltou memória */
+} usuarios_parte_carga;
+
+/*!
+ * @typedef usuarios_contexto
+ * @brief Estado de uma instância do módulo de usuários
+ *
+ * Agrupa o que antes eram variáveis globais do módulo. As funções com
+ * sufixo _r (reentrantes, como strtok_r) recebem o contexto como
+ * primeiro argumento, as sem sufixo usam o contexto padrão. Contextos
+ * distintos não compartilham estado e podem ser usados em paralelo.
+*/
+
+typedef struct usuarios_contexto {
+  grafo *grafo_usuarios; /**< Grafo de usuários, NULL se não carregado */
+  unsigned int contador; /**< Número de usuários no grafo */
+  int contador_amizades; /**< Número de relações entre os nodos, também o valor da última aresta */
+  tpUsuario *sessao; /**< Sessão aberta por usuarios_login_r, NULL se não houver */
+  grafo_no **nos; /**< Nós do grafo indexados pelo identificador do usuário */
+  unsigned int nos_capacidade; /**< Número de posições alocadas em nos */
+  usuarios_quente *quentes; /**< Cópia dos campos quentes dos registros, indexada pelo identificador, com nos_capacidade posições */
+  usuarios_wal log; /**< Log de escrita antecipada das alterações */
+  usuarios_sessoes sessoes; /**< Sessões identificadas por token */
+  pthread_rwlock_t trava; /**< Trava do grafo para as funções de sessão por token */
+  unsigned int *contagem; /**< Contador denso de amigos em comum por id, zerado entre consultas */
+  unsigned int *tocados; /**< Ids com contagem não nula na consulta corrente */
+  unsigned int contagem_capacidade; /**< Número de posições de contagem e tocados */
+  usuarios_cache_recomendacao *recomendacoes; /**< Cache de recomendações indexado por id */
+  unsigned int recomendacoes_capacidade; /**< Número de posições de recomendacoes */
+  usuarios_visitas visitas; /**< Vetores da busca de grau de separação */
+  usuarios_pesquisa pesquisa; /**< Índice de pesquisa por usuario e nome, construído na primeira pesquisa */
+  usuarios_indices indices; /**< Índices secundários de usuarios_consultar, construídos na primeira consulta */
+  usuarios_internos internos; /**< Textos de nome e endereco dos registros na memória */
+  usuarios_disponibilidade disponibilidade; /**< Filtro de usuario e email em uso, construído na primeira verificação */
+  usuarios_paginacao paginacao; /**< Registros carregados sob demanda por usuarios_carregarIndice */
+  unsigned int threads_carga; /**< Threads da carga dos arquivos, 0 para uma por processador */
+  char db[USUARIOS_LIMITE_CAMINHO]; /**< Arquivo de dados de usuários */
+  char db_amigos[USUARIOS_LIMITE_CAMINHO]; /**< Arquivo de amizades */
+  char db_wal[USUARIOS_LIMITE_CAMINHO]; /**< Arquivo do log de escrita antecipada */
+} usuarios_contexto;
+
 usuarios_condRet usuarios_cadastro(int, ...);
 usuarios_condRet usuarios_carregarArquivo();
 usuarios_condRet usuarios_login(char *, char *);
 usuarios_condRet usuarios_logout();
 usuarios_condRet usuarios_retornaDados(unsigned int, const char *, void *);
+usuarios_campo usuarios_campoPorNome(const char *);
+usuarios_condRet usuarios_retornaCampo(unsigned int, usuarios_campo, void *);
+const char *usuarios_campoTexto(unsigned int, usuarios_campo, char *, size_t);
+usuarios_condRet usuarios_campoInteiro(unsigned int, usuarios_campo, unsigned int *);
+usuarios_condRet usuarios_campoReal(unsigned int, usuarios_campo, double *);
 usuarios_condRet usuarios_limpar();
 usuarios_condRet usuarios_criarAmizade(unsigned int);
 usuarios_relacao usuarios_verificarAmizade(unsigned int);
 usuarios_condRet usuarios_atualizarDados(unsigned int, const char *, ...);
+usuarios_condRet usuarios_atualizarAvaliacao(unsigned int, double, unsigned int);
 usuarios_condRet usuarios_listarAmigos(unsigned int, usuarios_uintarray *);
 usuarios_condRet usuarios_listarAmigosdeAmigos(unsigned int, usuarios_uintarray *);
 usuarios_condRet usuarios_listarAmigosPendentes(unsigned int, usuarios_uintarray *);
 usuarios_condRet usuarios_freeUint(usuarios_uintarray *);
 usuarios_condRet usuarios_removerAmizade(unsigned int, unsigned int);
+usuarios_condRet usuarios_sincronizar();
+usuarios_condRet usuarios_loginSessao(const char *, const char *, usuarios_token *);
+usuarios_condRet usuarios_logoutSessao(usuarios_token);
+usuarios_condRet usuarios_sessaoIdentificador(usuarios_token, unsigned int *);
+usuarios_condRet usuarios_retornaDadosSessao(usuarios_token, const char *, void *);
+usuarios_condRet usuarios_criarAmizadeSessao(usuarios_token, unsigned int);
+usuarios_relacao usuarios_verificarAmizadeSessao(usuarios_token, unsigned int);
+unsigned int usuarios_sessoesAbertas();
+void usuarios_travarLeitura();
+void usuarios_travarEscrita();
+void usuarios_destravar();
 int usuarios_sessaoAberta();
 int usuarios_max();
 
+usuarios_contexto *usuarios_contextoCriar(const char *, const char *, const char *);
+usuarios_condRet usuarios_contextoDestruir(usuarios_contexto **);
+usuarios_contexto *usuarios_contextoPadrao();
+usuarios_condRet usuarios_cadastro_r(usuarios_contexto *, int, ...);
+usuarios_condRet usuarios_carregarArquivo_r(usuarios_contexto *);
+usuarios_condRet usuarios_login_r(usuarios_contexto *, char *, char *);
+usuarios_condRet usuarios_logout_r(usuarios_contexto *);
+usuarios_condRet usuarios_retornaDados_r(usuarios_contexto *, unsigned int, const char *, void *);
+usuarios_condRet usuarios_retornaCampo_r(usuarios_contexto *, unsigned int, usuarios_campo, void *);
+const char *usuarios_campoTexto_r(usuarios_contexto *, unsigned int, usuarios_campo, char *, size_t);
+usuarios_condRet usuarios_campoInteiro_r(usuarios_contexto *, unsigned int, usuarios_campo, unsigned int *);
+usuarios_condRet usuarios_campoReal_r(usuarios_contexto *, unsigned int, usuarios_campo, double *);
+usuarios_condRet usuarios_limpar_r(usuarios_contexto *);
+usuarios_condRet usuarios_criarAmizade_r(usuarios_contexto *, unsigned int);
+usuarios_relacao usuarios_verificarAmizade_r(usuarios_contexto *, unsigned int);
+usuarios_condRet usuarios_atualizarDados_r(usuarios_contexto *, unsigned int, const char *, ...);
+usuarios_condRet usuarios_atualizarAvaliacao_r(usuarios_contexto *, unsigned int, double, unsigned int);
+usuarios_condRet usuarios_listarAmigos_r(usuarios_contexto *, unsigned int, usuarios_uintarray *);
+usuarios_condRet usuarios_listarAmigosdeAmigos_r(usuarios_contexto *, unsigned int, usuarios_uintarray *);
+usuarios_condRet usuarios_listarAmigosPendentes_r(usuarios_contexto *, unsigned int, usuarios_uintarray *);
+usuarios_condRet usuarios_removerAmizade_r(usuarios_contexto *, unsigned int, unsigned int);
+usuarios_condRet usuarios_sincronizar_r(usuarios_contexto *);
+usuarios_condRet usuarios_loginSessao_r(usuarios_contexto *, const char *, const char *, usuarios_token *);
+usuarios_condRet usuarios_logoutSessao_r(usuarios_contexto *, usuarios_token);
+usuarios_condRet usuarios_sessaoIdentificador_r(usuarios_contexto *, usuarios_token, unsigned int *);
+usuarios_condRet usuarios_retornaDadosSessao_r(usuarios_contexto *, usuarios_token, const char *, void *);
+usuarios_condRet usuarios_criarAmizadeSessao_r(usuarios_contexto *, usuarios_token, unsigned int);
+usuarios_relacao usuarios_verificarAmizadeSessao_r(usuarios_contexto *, usuarios_token, unsigned int);
+unsigned int usuarios_sessoesAbertas_r(usuarios_contexto *);
+void usuarios_travarLeitura_r(usuarios_contexto *);
+void usuarios_travarEscrita_r(usuarios_contexto *);
+void usuarios_destravar_r(usuarios_contexto *);
+int usuarios_sessaoAberta_r(usuarios_contexto *);
+int usuarios_max_r(usuarios_contexto *);
+usuarios_condRet usuarios_recomendarAmigos_r(usuarios_contexto *, unsigned int, unsigned int, usuarios_recomendacao *, unsigned int *);
+usuarios_condRet usuarios_recomendarAmigos(unsigned int, unsigned int, usuarios_recomendacao *, unsigned int *);
+usuarios_condRet usuarios_grauSeparacao_r(usuarios_contexto *, unsigned int, unsigned int, unsigned int, unsigned int *, usuarios_uintarray *);
+usuarios_condRet usuarios_grauSeparacao(unsigned int, unsigned int, unsigned int, unsigned int *, usuarios_uintarray *);
+usuarios_condRet usuarios_pesquisar_r(usuarios_contexto *, const char *, unsigned int, unsigned int, usuarios_uintarray *, unsigned int *);
+usuarios_condRet usuarios_pesquisar(const char *, unsigned int, unsigned int, usuarios_uintarray *, unsigned int *);
+usuarios_condRet usuarios_compactarAmizades_r(usuarios_contexto *, unsigned int *);
+usuarios_condRet usuarios_compactarAmizades(unsigned int *);
+usuarios_condRet usuarios_carregarIndice_r(usuarios_contexto *, unsigned int);
+usuarios_condRet usuarios_carregarIndice(unsigned int);
+unsigned int usuarios_registrosResidentes_r(usuarios_contexto *);
+unsigned int usuarios_registrosResidentes();
+unsigned int usuarios_textosInternados_r(usuarios_contexto *);
+unsigned int usuarios_textosInternados();
+void usuarios_estatisticasDisponibilidade_r(usuarios_contexto *, usuarios_estatisticas_disponibilidade *);
+void usuarios_estatisticasDisponibilidade(usuarios_estatisticas_disponibilidade *);
+void usuarios_threadsCarga_r(usuarios_contexto *, unsigned int);
+void usuarios_threadsCarga(unsigned int);
+usuarios_condRet usuarios_consultar_r(usuarios_contexto *, const usuarios_filtro *, usuarios_uintarray *);
+usuarios_condRet usuarios_consultar(const usuarios_filtro *, usuarios_uintarray *);
+
 #endif
 
 
@@ -8,295 +8,2508 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdarg.h>
+#include <math.h>
+#include <limits.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include "usuarios.h"
 #include "avaliacao.h"
 
 /*!
- * @brief Identificador máximo já atribuido a uma avaliação
+ * @brief Contexto usado pelas funções sem o sufixo _r, sobre o contexto padrão de usuários e AVALIACAO_DB
 */
-static unsigned int avaliacao_contador = 0;
+static avaliacao_contexto avaliacao_padrao = {
+  .usuarios = usuarios_contextoPadrao(),
+  .contador = 0,
+  .indice = {
+    .construido = 0,
+    .usuarios = {NULL, NULL},
+    .capacidade = 0,
+    .tamanho = 0,
+    .arquivo = 0,
+    .descritor = -1
+  },
+  .histogramas = {
+    .construido = 0,
+    .contagens = NULL,
+    .capacidade = 0,
+    .tamanho = 0,
+    .arquivo = 0,
+    .descritor = -1
+  },
+  .pares = {},
+  .busca = {},
+  .escritor = {
+    .buffer = {0},
+    .tamanho = 0,
+    .pendentes = 0,
+    .ativo = 0,
+    .trabalhador = 0,
+    .trava = PTHREAD_MUTEX_INITIALIZER,
+    .sinal = PTHREAD_COND_INITIALIZER
+  },
+  .pontuacoes = {
+    .usuarios = NULL,
+    .capacidade = 0,
+    .soma = 0,
+    .n = 0,
+    .avaliacoes = 0,
+    .base = 0,
+    .ultimo = 0,
+    .tamanho = 0,
+    .arquivo = 0,
+    .ativo = 0,
+    .trabalhador = 0,
+    .trava = PTHREAD_MUTEX_INITIALIZER,
+    .sinal = PTHREAD_COND_INITIALIZER
+  },
+  .db = AVALIACAO_DB,
+  .db_histogramas = AVALIACAO_DB AVALIACAO_HISTOGRAMAS_SUFIXO
+};
 
 /*!
- * @brief Função DEPRECATED, o carregamento do contador ocorre automaticamente na realização de avaliações
-*/
-avaliacao_condRet avaliacao_pegarContador(){
-  return AVALIACAO_SUCESSO;
-}
-
-/*!
- * @fn avaliacao_condRet avaliacao_atualizarContador()
- * @brief Função que atualiza o contador de avaliações e cria o banco de dados caso não exista
- * @return Retorna uma instância avaliacao_condRet que assume:
- *  - AVALIACAO_FALHA_CRIARDB se não conseguir criar um banco de dados;
- *  - AVALIACAO_SUCESSO se conseguir criar ou atualizar o contador no arquivo e na variável global estática avaliacao_contador
+ * @fn static avaliacao_condRet avaliacao_escritorGravar(avaliacao_contexto *contexto)
+ * @brief Grava no arquivo de avaliações as linhas pendentes e o contador do cabeçalho
+ * @return Instância avaliacao_condRet que assume:
+ *  - AVALIACAO_FALHA_CRIARDB se não conseguir criar, abrir ou gravar o arquivo de avaliações;
+ *  - AVALIACAO_SUCESSO se o lote estiver no disco ou se não houver avaliações pendentes.
+ *
+ * O arquivo é aberto uma vez por lote: o contador é reescrito no início,
+ * as linhas vão ao fim em um único fwrite e o fsync é a barreira de
+ * durabilidade do lote. O arquivo é criado se não existir.
  *
  * Assertivas de entrada:
- *  - Há permissões para escrever e atualizar no arquivo de avaliações definido em avaliacoes.h
+ *  - escritor.trava do contexto está adquirida pela thread chamadora
  *
  * Assertivas de saída:
- *  - Haverá um arquivo de avaliações
- *  - O início do arquivo conterá o contador de avaliações atualizado
- *  - O contador global do módulo será atualizado
- *
- * Assertivas estruturais:
- *  - Nenhuma
- *
- * Assertivas de contrato:
- *  - O valor do contador global será acrescido de 1
+ *  - escritor.pendentes do contexto é 0 se retornar AVALIACAO_SUCESSO
+ *  - Em caso de falha as linhas continuam no buffer
  *
  * Requisitos:
- *  - stdio.h
+ *  - stdio.h, unistd.h
  *
  * Hipóteses:
  *  - Nenhuma
  */
 
-static avaliacao_condRet avaliacao_atualizarContador() {
+static avaliacao_condRet avaliacao_escritorGravar(avaliacao_contexto *contexto){
+  avaliacao_escritor *escritor = &contexto->escritor;
   FILE *db_avaliacao;
-  db_avaliacao = fopen(AVALIACAO_DB, "r+");
+  int falha;
+  
+  if(escritor->pendentes == 0) return AVALIACAO_SUCESSO;
+  
+  db_avaliacao = fopen(contexto->db, "r+");
   if(db_avaliacao == NULL) {
-    db_avaliacao = fopen(AVALIACAO_DB, "w");
+    db_avaliacao = fopen(contexto->db, "w");
     if(db_avaliacao == NULL) return AVALIACAO_FALHA_CRIARDB;
   }
-  fprintf(db_avaliacao, "%-4u\n", ++avaliacao_contador);
-  fclose(db_avaliacao);
+  
+  fprintf(db_avaliacao, "%-4u\n", contexto->contador);
+  fseeko(db_avaliacao, 0, SEEK_END);
+  falha = fwrite(escritor->buffer, 1, escritor->tamanho, db_avaliacao) != escritor->tamanho || fflush(db_avaliacao) != 0;
+  if(!falha) falha = fsync(fileno(db_avaliacao)) != 0;
+  if(fclose(db_avaliacao) != 0) falha = 1;
+  if(falha) return AVALIACAO_FALHA_CRIARDB;
+  
+  escritor->pendentes = 0;
+  escritor->tamanho = 0;
+  
+  /* As pontuações leem o lote sem esperar o intervalo */
+  pthread_mutex_lock(&contexto->pontuacoes.trava);
+  pthread_cond_signal(&contexto->pontuacoes.sinal);
+  pthread_mutex_unlock(&contexto->pontuacoes.trava);
   return AVALIACAO_SUCESSO;
 }
 
 /*!
- * @fn avaliacao *avaliacao_iniciar()
- * @brief Função que inicia uma avaliação
- * @return Retorna o endereço de uma avaliação alocada dinamicamente
- *
- * Inicialmente todos os valores da transação são 0
+ * @fn static void *avaliacao_escritorTrabalhador(void *argumento)
+ * @brief Thread de gravação das avaliações
+ * @param argumento Contexto (avaliacao_contexto *) dono do buffer
+ * @return Sempre NULL
  *
- * @code
- * avaliacao *a = avaliacao_iniciar();
- * @code
+ * A cada AVALIACAO_LOTE_INTERVALO_MS milissegundos grava as avaliações
+ * pendentes (gatilho de tempo do lote). Termina quando escritor.ativo
+ * for nulo.
  *
- * Assertivas de entrada:
- *  - Há memória suficiente
+ * Requisitos:
+ *  - pthread.h, time.h
+ */
+
+static void *avaliacao_escritorTrabalhador(void *argumento){
+  avaliacao_contexto *contexto = (avaliacao_contexto *)argumento;
+  struct timespec limite;
+  
+  pthread_mutex_lock(&contexto->escritor.trava);
+  while(contexto->escritor.ativo) {
+    clock_gettime(CLOCK_REALTIME, &limite);
+    limite.tv_nsec += (long)AVALIACAO_LOTE_INTERVALO_MS*1000000;
+    limite.tv_sec += limite.tv_nsec/1000000000;
+    limite.tv_nsec %= 1000000000;
+    pthread_cond_timedwait(&contexto->escritor.sinal, &contexto->escritor.trava, &limite);
+    
+    avaliacao_escritorGravar(contexto);
+  }
+  pthread_mutex_unlock(&contexto->escritor.trava);
+  return NULL;
+}
+
+/*!
+ * @fn static void avaliacao_escritorParar(avaliacao_contexto *contexto)
+ * @brief Encerra a thread de gravação, se estiver rodando
  *
  * Assertivas de saída:
- *  - Alocará memória para uma avaliação e retornará o ponteiro por valor
+ *  - escritor.ativo do contexto é nulo e a thread terminou
+ */
+
+static void avaliacao_escritorParar(avaliacao_contexto *contexto){
+  pthread_mutex_lock(&contexto->escritor.trava);
+  if(!contexto->escritor.ativo) {
+    pthread_mutex_unlock(&contexto->escritor.trava);
+    return;
+  }
+  contexto->escritor.ativo = 0;
+  pthread_cond_signal(&contexto->escritor.sinal);
+  pthread_mutex_unlock(&contexto->escritor.trava);
+  pthread_join(contexto->escritor.trabalhador, NULL);
+}
+
+/*!
+ * @fn static void avaliacao_escritorEncerrar()
+ * @brief Registrada com atexit, garante que as avaliações do contexto padrão são gravadas ao fim do programa
  *
- * Assertivas estruturais:
- *  - Nenhuma
+ * Contextos criados com avaliacao_contextoCriar são gravados por avaliacao_contextoDestruir.
+*/
+
+static void avaliacao_escritorEncerrar(){
+  avaliacao_escritorParar(&avaliacao_padrao);
+  avaliacao_sincronizar_r(&avaliacao_padrao);
+}
+
+/*!
+ * @fn static void avaliacao_escritorIniciar(avaliacao_contexto *contexto)
+ * @brief Inicia a thread de gravação, se ainda não estiver rodando
  *
- * Assertivas de contrato:
- *  - Nenhuma
+ * Na primeira chamada com o contexto padrão registra avaliacao_escritorEncerrar com atexit.
  *
  * Requisitos:
- *  - stdlib.h
+ *  - pthread.h, stdlib.h
+ */
+
+static void avaliacao_escritorIniciar(avaliacao_contexto *contexto){
+  static int registrado = 0;
+  
+  if(!registrado && contexto == &avaliacao_padrao) {
+    atexit(avaliacao_escritorEncerrar);
+    registrado = 1;
+  }
+  
+  pthread_mutex_lock(&contexto->escritor.trava);
+  if(!contexto->escritor.ativo) {
+    contexto->escritor.ativo = 1;
+    if(pthread_create(&contexto->escritor.trabalhador, NULL, avaliacao_escritorTrabalhador, contexto) != 0)
+      contexto->escritor.ativo = 0; /* Sem thread, o gatilho de tamanho e avaliacao_sincronizar ainda gravam */
+  }
+  pthread_mutex_unlock(&contexto->escritor.trava);
+}
+
+/*!
+ * @fn static avaliacao_condRet avaliacao_escritorRegistrar(avaliacao_contexto *contexto, avaliacao *dados)
+ * @brief Acrescenta a linha de uma avaliação ao buffer e avança o contador
+ * @return Instância avaliacao_condRet que assume:
+ *  - AVALIACAO_VALORINVALIDO se a linha não couber em AVALIACAO_LINHA_LIMITE;
+ *  - AVALIACAO_FALHA_CRIARDB se o buffer está cheio e não foi possível gravá-lo, a linha não é acrescentada;
+ *  - AVALIACAO_SUCESSO caso contrário.
  *
- * Hipóteses:
- *  - Nenhuma.
+ * A linha fica no buffer até o próximo lote: quando o buffer chegar a
+ * AVALIACAO_LOTE avaliações (nesta chamada), na próxima execução da
+ * thread de gravação ou na próxima consulta. Se a gravação do lote
+ * falhar as linhas continuam no buffer e são gravadas no lote seguinte;
+ * só quando não houver espaço para a nova linha a chamada falha.
  *
+ * Requisitos:
+ *  - stdio.h, string.h, pthread.h
  */
 
-avaliacao *avaliacao_iniciar(){
-  avaliacao *novo = (avaliacao *)calloc(1, sizeof(avaliacao));
-  novo->identificador = avaliacao_contador;
-  return novo;
+static avaliacao_condRet avaliacao_escritorRegistrar(avaliacao_contexto *contexto, avaliacao *dados){
+  avaliacao_escritor *escritor = &contexto->escritor;
+  char linha[AVALIACAO_LINHA_LIMITE];
+  int tamanho;
+  
+  tamanho = snprintf(linha, sizeof(linha), AVALIACAO_DB_ESTRUTURA_TEMPO, dados->avaliador, dados->avaliado, dados->nota, dados->comentario, dados->tempo);
+  if(tamanho < 0 || tamanho >= (int)sizeof(linha)) return AVALIACAO_VALORINVALIDO;
+  
+  avaliacao_escritorIniciar(contexto);
+  
+  pthread_mutex_lock(&escritor->trava);
+  
+  /* Sem espaço, como depois de um lote que não pôde ser gravado, gravamos antes de acrescentar */
+  if(escritor->tamanho + tamanho > sizeof(escritor->buffer) && avaliacao_escritorGravar(contexto) != AVALIACAO_SUCESSO) {
+    pthread_mutex_unlock(&escritor->trava);
+    return AVALIACAO_FALHA_CRIARDB;
+  }
+  
+  memcpy(escritor->buffer + escritor->tamanho, linha, tamanho);
+  escritor->tamanho += tamanho;
+  contexto->contador++;
+  
+  /* A linha já está no buffer; se o lote falhar ela é gravada no próximo */
+  if(++escritor->pendentes >= AVALIACAO_LOTE) avaliacao_escritorGravar(contexto);
+  pthread_mutex_unlock(&escritor->trava);
+  
+  return AVALIACAO_SUCESSO;
 }
 
 /*!
- * @fn avaliacao_condRet avaliacao_limpar(avaliacao **dado)
- * @brief Função que limpa uma avaliação
- * @param dado Ponteiro para o ponteiro da avaliação
- * @return Instância avaliacao_condRet que retornará AVALIACAO_SUCESSO
+ * @fn avaliacao_condRet avaliacao_sincronizar_r(avaliacao_contexto *contexto)
+ * @brief Grava no arquivo de avaliações as avaliações ainda em memória
+ * @return Instância avaliacao_condRet que assume:
+ *  - AVALIACAO_FALHA_CRIARDB se não conseguir gravar o arquivo de avaliações;
+ *  - AVALIACAO_SUCESSO se o arquivo contiver todas as avaliações feitas.
  *
- * É usado para desalocar memória de uma avaliação:
- * @code
- * avaliacao *a = avaliacao_iniciar();
- * //...
- * avaliacao_limpar(&a);
- * @endcode
+ * Deve ser chamada antes de encerrar o programa ou de ler ou escrever o
+ * arquivo de avaliações por fora do módulo. O contexto padrão é gravado
+ * ao fim do programa e os demais por avaliacao_contextoDestruir.
  *
  * Assertivas de entrada:
- *  - dado é diferente de NULL
- *
- * Assertivas de saída:
- *  - o conteúdo de dado será NULL
- *  - Memória ocupado pelo conteúdo de dado será desalocada
- *
- * Assertivas estruturais:
  *  - Nenhuma
  *
- * Assertivas de contrato:
- *  - o conteúdo de dado será NULL e a memória apontada por esse conteúdo será desalocada.
+ * Assertivas de saída:
+ *  - Não há avaliações pendentes e o arquivo passou por fsync
  *
  * Requisitos:
- *  - stdlib.h
+ *  - pthread.h
  *
  * Hipóteses:
- *  - dado é diferente de NULL
- *
+ *  - Nenhuma
  */
 
-avaliacao_condRet avaliacao_limpar(avaliacao **dado){
-  free(*dado);
-  *dado = NULL;
-  return AVALIACAO_SUCESSO; 
+avaliacao_condRet avaliacao_sincronizar_r(avaliacao_contexto *contexto){
+  avaliacao_condRet retorno;
+  pthread_mutex_lock(&contexto->escritor.trava);
+  retorno = avaliacao_escritorGravar(contexto);
+  pthread_mutex_unlock(&contexto->escritor.trava);
+  return retorno;
 }
 
 /*!
- * @fn avaliacao_condRet avaliacao_definir(avaliacao *retorno, const char *nome, ...)
- * @brief Função que atribui dados a avaliação
- * @param retorno Endereço da avaliação a definir um valor
- * @param nome Argumento válido que identificará o que definir: "avaliador", "avaliado", "nota", "comentario"
- * @param (...) Um argumento dos tipos unsigned int ou char * É o valor a se definir na avaliação
- * @return Retorna uma instância avaliacao_condRet que assume AVALIACAO_SUCESSO.
- *
- * Exemplo de uso:
- * @code
- * avaliacao *a = avaliacao_iniciar();
- * avaliacao_definir(a, "avaliador", 5);
- * avaliacao_definir(a, "avaliado", 6);
- * avaliacao_definir(a, "nota", 2);
- * avaliacao_definir(a, "comentario", (char *)"Muito bom!");
- * avaliacao_limpar(&a);
- * @endcode
- *
- * Assertivas de entrada:
- *  - É passado exatamente um argumento na elípse do tipo unsigned int ou char *
- *  - O nome passado é algum desses: "avaliador", "avaliado", "nota", "comentario"
- *  - retorno não é NULL
- * 
- * Assertivas de saída:
- *  - O argumento na elipse de dado passado passa a definir um valor na avaliação
+ * @fn static void avaliacao_indiceLimpar(avaliacao_contexto *contexto)
+ * @brief Libera o índice de avaliações e fecha o seu descritor; será reconstruído na próxima consulta
+*/
+
+static void avaliacao_indiceLimpar(avaliacao_contexto *contexto){
+  avaliacao_indice *indice = &contexto->indice;
+  unsigned int i;
+  int tipo;
+  
+  for(tipo=AVALIADOR;tipo<=AVALIADO;tipo++) {
+    for(i=0;i<indice->capacidade;i++) free(indice->usuarios[tipo][i].posicoes);
+    free(indice->usuarios[tipo]);
+  }
+  if(indice->descritor >= 0) close(indice->descritor);
+  memset(indice, 0, sizeof(avaliacao_indice));
+  indice->descritor = -1;
+}
+
+/*!
+ * @fn static int avaliacao_indiceAnexar(avaliacao_indice *indice, avaliacao_tipo tipo, unsigned int identificador, off_t posicao)
+ * @brief Acrescenta posicao às avaliações de identificador no papel tipo
+ * @return Nulo se faltar memória
+*/
+
+static int avaliacao_indiceAnexar(avaliacao_indice *indice, avaliacao_tipo tipo, unsigned int identificador, off_t posicao){
+  avaliacao_posicoes *usuarios, *lista;
+  unsigned int capacidade;
+  off_t *posicoes;
+  int papel;
+  
+  if(identificador >= indice->capacidade) {
+    capacidade = indice->capacidade ? indice->capacidade : 64;
+    while(capacidade <= identificador) capacidade *= 2;
+    for(papel=AVALIADOR;papel<=AVALIADO;papel++) {
+      usuarios = (avaliacao_posicoes *)realloc(indice->usuarios[papel], capacidade*sizeof(avaliacao_posicoes));
+      if(usuarios == NULL) return 0;
+      memset(usuarios + indice->capacidade, 0, (capacidade - indice->capacidade)*sizeof(avaliacao_posicoes));
+      indice->usuarios[papel] = usuarios;
+    }
+    indice->capacidade = capacidade;
+  }
+  
+  lista = &indice->usuarios[tipo][identificador];
+  if(lista->n == lista->capacidade) {
+    capacidade = lista->capacidade ? 2*lista->capacidade : 4;
+    posicoes = (off_t *)realloc(lista->posicoes, capacidade*sizeof(off_t));
+    if(posicoes == NULL) return 0;
+    lista->posicoes = posicoes;
+    lista->capacidade = capacidade;
+  }
+  lista->posicoes[lista->n++] = posicao;
+  return 1;
+}
+
+/*!
+ * @fn static avaliacao_condRet avaliacao_indiceAtualizar(avaliacao_contexto *contexto)
+ * @brief Garante que o índice cobre todo o arquivo de avaliações
+ * @return Instância avaliacao_condRet que assume:
+ *  - AVALIACAO_FALHA_ABRIRDB se não conseguir abrir o arquivo ou faltar memória para o índice;
+ *  - AVALIACAO_SUCESSO caso contrário.
  *
- * Assertivas estruturais:
- *  - As strings passadas na elipse terminam com '\0'
+ * Na primeira chamada, ou se o arquivo foi trocado ou diminuiu, o índice
+ * é refeito lendo o arquivo uma vez; se só cresceu, apenas as linhas
+ * novas são lidas. A primeira linha do arquivo é o contador.
+*/
+
+static avaliacao_condRet avaliacao_indiceAtualizar(avaliacao_contexto *contexto){
+  avaliacao_indice *indice = &contexto->indice;
+  char linha[AVALIACAO_LIMITE_COMENTARIO + 64];
+  unsigned int avaliador, avaliado;
+  FILE *db_avaliacao;
+  struct stat estado;
+  off_t posicao;
+  
+  if(avaliacao_sincronizar_r(contexto) != AVALIACAO_SUCESSO) return AVALIACAO_FALHA_ABRIRDB;
+  if(stat(contexto->db, &estado) != 0) return AVALIACAO_FALHA_ABRIRDB;
+  if(indice->construido && estado.st_ino == indice->arquivo && estado.st_size == indice->tamanho) return AVALIACAO_SUCESSO;
+  
+  if(!indice->construido || estado.st_ino != indice->arquivo || estado.st_size < indice->tamanho) {
+    avaliacao_indiceLimpar(contexto);
+    indice->descritor = open(contexto->db, O_RDONLY);
+    if(indice->descritor < 0) return AVALIACAO_FALHA_ABRIRDB;
+    indice->arquivo = estado.st_ino;
+    indice->construido = 1;
+  }
+  
+  db_avaliacao = fopen(contexto->db, "r");
+  if(db_avaliacao == NULL) return AVALIACAO_FALHA_ABRIRDB;
+  fseeko(db_avaliacao, indice->tamanho, SEEK_SET);
+  /* Pulamos o contador */
+  if(indice->tamanho == 0 && fgets(linha, sizeof(linha), db_avaliacao) != NULL) indice->tamanho = ftello(db_avaliacao);
+  
+  for(posicao = indice->tamanho; fgets(linha, sizeof(linha), db_avaliacao) != NULL; posicao = ftello(db_avaliacao)) {
+    /* Uma linha sem '\n' ainda está sendo escrita, fica para a próxima consulta */
+    if(strchr(linha, '\n') == NULL) break;
+    if(sscanf(linha, "%u\t%u", &avaliador, &avaliado) == 2) {
+      if(!avaliacao_indiceAnexar(indice, AVALIADOR, avaliador, posicao) || !avaliacao_indiceAnexar(indice, AVALIADO, avaliado, posicao)) {
+        fclose(db_avaliacao);
+        avaliacao_indiceLimpar(contexto);
+        return AVALIACAO_FALHA_ABRIRDB;
+      }
+    }
+    indice->tamanho = ftello(db_avaliacao);
+  }
+  
+  fclose(db_avaliacao);
+  return AVALIACAO_SUCESSO;
+}
+
+/*!
+ * @fn static void avaliacao_histogramasLimpar(avaliacao_contexto *contexto)
+ * @brief Libera as contagens e fecha o arquivo de histogramas, que continua no disco; serão carregadas na próxima consulta
+*/
+
+static void avaliacao_histogramasLimpar(avaliacao_contexto *contexto){
+  avaliacao_histogramas *histogramas = &contexto->histogramas;
+  
+  free(histogramas->contagens);
+  if(histogramas->descritor >= 0) close(histogramas->descritor);
+  memset(histogramas, 0, sizeof(avaliacao_histogramas));
+  histogramas->descritor = -1;
+}
+
+/*!
+ * @fn static void avaliacao_histogramasDescartar(avaliacao_contexto *contexto)
+ * @brief Esvazia o arquivo de histogramas depois de uma escrita falha, para que seja refeito, e limpa as contagens
+*/
+
+static void avaliacao_histogramasDescartar(avaliacao_contexto *contexto){
+  if(contexto->histogramas.descritor >= 0 && ftruncate(contexto->histogramas.descritor, 0) != 0) unlink(contexto->db_histogramas);
+  avaliacao_histogramasLimpar(contexto);
+}
+
+/*!
+ * @fn static int avaliacao_histogramasCapacidade(avaliacao_histogramas *histogramas, unsigned int identificador)
+ * @brief Garante contadores para identificador, os novos começam zerados
+ * @return Nulo se faltar memória
+*/
+
+static int avaliacao_histogramasCapacidade(avaliacao_histogramas *histogramas, unsigned int identificador){
+  uint32_t (*contagens)[AVALIACAO_NOTAS];
+  unsigned int capacidade;
+  
+  if(identificador < histogramas->capacidade) return 1;
+  capacidade = histogramas->capacidade ? histogramas->capacidade : 64;
+  while(capacidade <= identificador) capacidade *= 2;
+  
+  contagens = (uint32_t (*)[AVALIACAO_NOTAS])realloc(histogramas->contagens, capacidade*sizeof(*contagens));
+  if(contagens == NULL) return 0;
+  memset(contagens + histogramas->capacidade, 0, (capacidade - histogramas->capacidade)*sizeof(*contagens));
+  histogramas->contagens = contagens;
+  histogramas->capacidade = capacidade;
+  return 1;
+}
+
+/*!
+ * @fn static int avaliacao_histogramasGravar(avaliacao_histogramas *histogramas, unsigned int identificador, unsigned int nota)
+ * @brief Grava um contador no arquivo de histogramas, ou só o cabeçalho se identificador for UINT_MAX
+ * @return Nulo se a escrita falhar
+*/
+
+static int avaliacao_histogramasGravar(avaliacao_histogramas *histogramas, unsigned int identificador, unsigned int nota){
+  avaliacao_histogramas_cabecalho cabecalho;
+  off_t posicao;
+  
+  if(identificador != UINT_MAX) {
+    posicao = sizeof(avaliacao_histogramas_cabecalho) + ((off_t)identificador*AVALIACAO_NOTAS + nota)*sizeof(uint32_t);
+    return pwrite(histogramas->descritor, &histogramas->contagens[identificador][nota], sizeof(uint32_t), posicao) == sizeof(uint32_t);
+  }
+  
+  cabecalho.assinatura = AVALIACAO_HISTOGRAMAS_ASSINATURA;
+  cabecalho.notas = AVALIACAO_NOTAS;
+  cabecalho.arquivo = (uint64_t)histogramas->arquivo;
+  cabecalho.tamanho = (int64_t)histogramas->tamanho;
+  return pwrite(histogramas->descritor, &cabecalho, sizeof(cabecalho), 0) == sizeof(cabecalho);
+}
+
+/*!
+ * @fn static int avaliacao_histogramasSalvar(avaliacao_histogramas *histogramas)
+ * @brief Reescreve o arquivo de histogramas inteiro
+ * @return Nulo se a escrita falhar
  *
- * Assertivas de contrato:
- *  - Nenhuma
+ * O arquivo é esvaziado antes e o cabeçalho é o último a ser escrito,
+ * assim uma interrupção no meio deixa um arquivo que será refeito.
+*/
+
+static int avaliacao_histogramasSalvar(avaliacao_histogramas *histogramas){
+  size_t tamanho = (size_t)histogramas->capacidade*sizeof(*histogramas->contagens);
+  
+  if(ftruncate(histogramas->descritor, 0) != 0) return 0;
+  if(tamanho && pwrite(histogramas->descritor, histogramas->contagens, tamanho, sizeof(avaliacao_histogramas_cabecalho)) != (ssize_t)tamanho) return 0;
+  return avaliacao_histogramasGravar(histogramas, UINT_MAX, 0);
+}
+
+/*!
+ * @fn static avaliacao_condRet avaliacao_histogramasAtualizar(avaliacao_contexto *contexto)
+ * @brief Garante que as contagens cobrem todo o arquivo de avaliações
+ * @return Instância avaliacao_condRet que assume:
+ *  - AVALIACAO_FALHA_ABRIRDB se não conseguir abrir algum dos arquivos ou faltar memória;
+ *  - AVALIACAO_FALHA_CRIARDB se não conseguir gravar o arquivo de histogramas refeito;
+ *  - AVALIACAO_SUCESSO caso contrário.
  *
- * Resquisitos:
- *  - string.h, stdarg.h
+ * Na primeira chamada as contagens vêm do arquivo de histogramas. Se ele
+ * faltar, for de outro arquivo de avaliações ou este tiver diminuído, as
+ * contagens são refeitas lendo as avaliações uma vez e gravadas de uma
+ * vez; se as avaliações só cresceram, apenas as linhas novas são contadas.
  *
  * Hipóteses:
- *  - retorno não é NULL
- *  - Há exatamente 1 argumento em (...) do tipo especificado
- * 
- */
+ *  - O processo não é interrompido entre a gravação de um contador e a do cabeçalho
+*/
 
-avaliacao_condRet avaliacao_definir(avaliacao *retorno, const char *nome, ...) {
-  /* Lista de argumentos */
-  va_list arg;
-  va_start(arg, nome);
+static avaliacao_condRet avaliacao_histogramasAtualizar(avaliacao_contexto *contexto){
+  avaliacao_histogramas *histogramas = &contexto->histogramas;
+  avaliacao_histogramas_cabecalho cabecalho;
+  char linha[AVALIACAO_LIMITE_COMENTARIO + 64];
+  unsigned int avaliador, avaliado, nota, n = 0;
+  FILE *db_avaliacao;
+  struct stat estado, arquivo;
+  int reescrever = 0;
   
-  /* Comparamos o nome com os valores possíveis */
-  if(!strcmp("avaliador", nome)) retorno->avaliador = va_arg(arg, unsigned int);
-  else if(!strcmp("avaliado", nome)) retorno->avaliado = va_arg(arg, unsigned int);
-  else if(!strcmp("nota", nome)) retorno->nota = va_arg(arg, unsigned int);
-  else if(!strcmp("comentario", nome)) strncpy(retorno->comentario, va_arg(arg, char *), AVALIACAO_LIMITE_COMENTARIO);
+  if(avaliacao_sincronizar_r(contexto) != AVALIACAO_SUCESSO) return AVALIACAO_FALHA_ABRIRDB;
+  if(stat(contexto->db, &estado) != 0) return AVALIACAO_FALHA_ABRIRDB;
+  if(histogramas->construido && estado.st_ino == histogramas->arquivo && estado.st_size == histogramas->tamanho) return AVALIACAO_SUCESSO;
   
-  va_end(arg);
+  if(!histogramas->construido) {
+    histogramas->descritor = open(contexto->db_histogramas, O_RDWR | O_CREAT, 0644);
+    if(histogramas->descritor < 0) return AVALIACAO_FALHA_ABRIRDB;
+    
+    /* O arquivo de histogramas só vale se contou este arquivo de avaliações */
+    if(pread(histogramas->descritor, &cabecalho, sizeof(cabecalho), 0) == sizeof(cabecalho) && fstat(histogramas->descritor, &arquivo) == 0 &&
+       cabecalho.assinatura == AVALIACAO_HISTOGRAMAS_ASSINATURA && cabecalho.notas == AVALIACAO_NOTAS &&
+       cabecalho.arquivo == (uint64_t)estado.st_ino && cabecalho.tamanho <= (int64_t)estado.st_size)
+      n = (arquivo.st_size - sizeof(cabecalho))/sizeof(*histogramas->contagens);
+    else reescrever = 1;
+    
+    if(n) {
+      if(!avaliacao_histogramasCapacidade(histogramas, n-1)) {
+        avaliacao_histogramasLimpar(contexto);
+        return AVALIACAO_FALHA_ABRIRDB;
+      }
+      if(pread(histogramas->descritor, histogramas->contagens, n*sizeof(*histogramas->contagens), sizeof(cabecalho)) != (ssize_t)(n*sizeof(*histogramas->contagens))) reescrever = 1;
+    }
+    
+    if(!reescrever) histogramas->tamanho = (off_t)cabecalho.tamanho;
+    else if(n) memset(histogramas->contagens, 0, histogramas->capacidade*sizeof(*histogramas->contagens));
+    histogramas->arquivo = estado.st_ino;
+    histogramas->construido = 1;
+  }
+  else if(estado.st_ino != histogramas->arquivo || estado.st_size < histogramas->tamanho) {
+    if(histogramas->capacidade) memset(histogramas->contagens, 0, histogramas->capacidade*sizeof(*histogramas->contagens));
+    histogramas->tamanho = 0;
+    histogramas->arquivo = estado.st_ino;
+    reescrever = 1;
+  }
+  
+  db_avaliacao = fopen(contexto->db, "r");
+  if(db_avaliacao == NULL) return AVALIACAO_FALHA_ABRIRDB;
+  fseeko(db_avaliacao, histogramas->tamanho, SEEK_SET);
+  /* Pulamos o contador */
+  if(histogramas->tamanho == 0 && fgets(linha, sizeof(linha), db_avaliacao) != NULL) histogramas->tamanho = ftello(db_avaliacao);
+  
+  while(fgets(linha, sizeof(linha), db_avaliacao) != NULL) {
+    /* Uma linha sem '\n' ainda está sendo escrita, fica para a próxima consulta */
+    if(strchr(linha, '\n') == NULL) break;
+    if(sscanf(linha, "%u\t%u\t%u", &avaliador, &avaliado, &nota) == 3 && nota < AVALIACAO_NOTAS) {
+      if(!avaliacao_histogramasCapacidade(histogramas, avaliado)) {
+        fclose(db_avaliacao);
+        avaliacao_histogramasLimpar(contexto);
+        return AVALIACAO_FALHA_ABRIRDB;
+      }
+      histogramas->contagens[avaliado][nota]++;
+      if(!reescrever && !avaliacao_histogramasGravar(histogramas, avaliado, nota)) reescrever = 1;
+    }
+    histogramas->tamanho = ftello(db_avaliacao);
+  }
+  fclose(db_avaliacao);
   
+  /* Contagens refeitas são gravadas de uma vez, as completadas já tiveram seus contadores gravados */
+  if(reescrever ? !avaliacao_histogramasSalvar(histogramas) : !avaliacao_histogramasGravar(histogramas, UINT_MAX, 0)) {
+    avaliacao_histogramasDescartar(contexto);
+    return AVALIACAO_FALHA_CRIARDB;
+  }
   return AVALIACAO_SUCESSO;
 }
 
 /*!
- * @fn avaliacao_condRet avaliacao_obterAvaliacao(unsigned int identificador, unsigned int n, avaliacao_tipo tipo, avaliacao *retorno)
- * @brief Função que busca a n-ésima avaliação de um usuário
- * @param identificador Id de um usuário, se for 0 usa a sessão (Se usar a sessão o módulo de usuários deve ter sido carregado!)
- * @param n n-ésima avaliação do usuário a ler
- * @param tipo O tipo da avaliação podendo ser AVALIADOR ou AVALIADO, se for AVALIADOR busca as avaliações em que o identificador é o avaliador se for AVALIADO busca as avaliações em que identificador é avaliado.
- * @param retorno Retorno da avaliação pretendida por referência, já deve estar alocado anteriormente a execução da função
- * @return Instância avaliacao_condRet que assume: 
- *  - AVALIACAO_VALORINVALIDO se n=0;
- *  - AVALIACAO_FALHA_SEMSESSAO se não houver sessão aberta;
- *  - AVALIACAO_FALHA_USUARIOS se não conseguir obter o id do usuário na sessão;
- *  - AVALIACAO_FALHA_ABRIRDB se não consegue abrir para leitura "r" o arquivo de avaliações;
- *  - AVALIACAO_NAO_ENCONTRADO se não encontrou uma avaliação com esse valor de n;
- *  - AVALIACAO_SUCESSO se encontrou uma avaliação e a copiou para retorno com sucesso
- * 
- * Recebe o id do usuário, se receber 0 trabalha com a sessão
+ * @fn static void avaliacao_paresLimpar(avaliacao_contexto *contexto)
+ * @brief Libera o conjunto de pares avaliados; será reconstruído na próxima consulta
+*/
+
+static void avaliacao_paresLimpar(avaliacao_contexto *contexto){
+  free(contexto->pares.tabela);
+  memset(&contexto->pares, 0, sizeof(avaliacao_pares));
+}
+
+/*!
+ * @fn static unsigned int avaliacao_paresPosicao(const avaliacao_pares *pares, uint64_t chave)
+ * @brief Posição da tabela com chave ou, se ela não estiver no conjunto, a posição vazia onde entraria
  *
- * Recebe a posição da avaliação a ser lida
- * 
- * Recebe AVALIADOR ou AVALIADO para listar as avaliações em que o usuário avaliou ou as que ele foi avaliado
- * 
- * Retorna por referência uma avaliação
+ * Hipóteses:
+ *  - A tabela tem ao menos uma posição vazia
+*/
+
+static unsigned int avaliacao_paresPosicao(const avaliacao_pares *pares, uint64_t chave){
+  /* Hash multiplicativo: os bits altos do produto espalham ids sequenciais pela tabela */
+  unsigned int i = (unsigned int)((chave*0x9E3779B97F4A7C15ULL) >> 32) & (pares->capacidade - 1);
+  
+  while(pares->tabela[i] != 0 && pares->tabela[i] != chave) i = (i + 1) & (pares->capacidade - 1);
+  return i;
+}
+
+/*!
+ * @fn static int avaliacao_paresInserir(avaliacao_pares *pares, unsigned int avaliador, unsigned int avaliado)
+ * @brief Acrescenta o par ao conjunto, se ainda não estiver nele
+ * @return Nulo se faltar memória
+ *
+ * A tabela dobra ao passar de metade cheia.
+*/
+
+static int avaliacao_paresInserir(avaliacao_pares *pares, unsigned int avaliador, unsigned int avaliado){
+  uint64_t chave = ((uint64_t)avaliador << 32) | avaliado;
+  uint64_t *antiga = pares->tabela;
+  unsigned int capacidade = pares->capacidade, i;
+  
+  /* O par (0, 0) não é de usuários do grafo e teria a chave de posição vazia */
+  if(chave == 0) return 1;
+  
+  if(2*(pares->n + 1) > pares->capacidade) {
+    pares->capacidade = capacidade ? 2*capacidade : 1024;
+    pares->tabela = (uint64_t *)calloc(pares->capacidade, sizeof(uint64_t));
+    if(pares->tabela == NULL) {
+      pares->tabela = antiga;
+      pares->capacidade = capacidade;
+      return 0;
+    }
+    for(i=0;i<capacidade;i++)
+      if(antiga[i] != 0) pares->tabela[avaliacao_paresPosicao(pares, antiga[i])] = antiga[i];
+    free(antiga);
+  }
+  
+  i = avaliacao_paresPosicao(pares, chave);
+  if(pares->tabela[i] == 0) {
+    pares->tabela[i] = chave;
+    pares->n++;
+  }
+  return 1;
+}
+
+/*!
+ * @fn static avaliacao_condRet avaliacao_paresAtualizar(avaliacao_contexto *contexto)
+ * @brief Garante que o conjunto de pares cobre todo o arquivo de avaliações
+ * @return Instância avaliacao_condRet que assume:
+ *  - AVALIACAO_FALHA_ABRIRDB se não conseguir abrir o arquivo ou faltar memória para o conjunto;
+ *  - AVALIACAO_SUCESSO caso contrário, com o conjunto vazio se o arquivo ainda não existir.
+ *
+ * Como em avaliacao_indiceAtualizar, o conjunto é refeito se o arquivo
+ * foi trocado ou diminuiu e, se só cresceu, apenas as linhas novas são
+ * lidas. Pares já inseridos por avaliacao_fazerAvaliacao_r são lidos de
+ * novo sem efeito.
+*/
+
+static avaliacao_condRet avaliacao_paresAtualizar(avaliacao_contexto *contexto){
+  avaliacao_pares *pares = &contexto->pares;
+  char linha[AVALIACAO_LIMITE_COMENTARIO + 64];
+  unsigned int avaliador, avaliado;
+  FILE *db_avaliacao;
+  struct stat estado;
+  
+  if(avaliacao_sincronizar_r(contexto) != AVALIACAO_SUCESSO) return AVALIACAO_FALHA_ABRIRDB;
+  if(stat(contexto->db, &estado) != 0) {
+    if(errno != ENOENT) return AVALIACAO_FALHA_ABRIRDB;
+    /* Sem arquivo não há avaliações; o inode 0 faz o conjunto ser refeito quando ele for criado */
+    avaliacao_paresLimpar(contexto);
+    pares->construido = 1;
+    return AVALIACAO_SUCESSO;
+  }
+  if(pares->construido && estado.st_ino == pares->arquivo && estado.st_size == pares->tamanho) return AVALIACAO_SUCESSO;
+  
+  if(!pares->construido || estado.st_ino != pares->arquivo || estado.st_size < pares->tamanho) {
+    avaliacao_paresLimpar(contexto);
+    pares->arquivo = estado.st_ino;
+    pares->construido = 1;
+  }
+  
+  db_avaliacao = fopen(contexto->db, "r");
+  if(db_avaliacao == NULL) return AVALIACAO_FALHA_ABRIRDB;
+  fseeko(db_avaliacao, pares->tamanho, SEEK_SET);
+  /* Pulamos o contador */
+  if(pares->tamanho == 0 && fgets(linha, sizeof(linha), db_avaliacao) != NULL) pares->tamanho = ftello(db_avaliacao);
+  
+  while(fgets(linha, sizeof(linha), db_avaliacao) != NULL) {
+    /* Uma linha sem '\n' ainda está sendo escrita, fica para a próxima consulta */
+    if(strchr(linha, '\n') == NULL) break;
+    if(sscanf(linha, "%u\t%u", &avaliador, &avaliado) == 2 && !avaliacao_paresInserir(pares, avaliador, avaliado)) {
+      fclose(db_avaliacao);
+      avaliacao_paresLimpar(contexto);
+      return AVALIACAO_FALHA_ABRIRDB;
+    }
+    pares->tamanho = ftello(db_avaliacao);
+  }
+  
+  fclose(db_avaliacao);
+  return AVALIACAO_SUCESSO;
+}
+
+/*!
+ * @fn static void avaliacao_buscaLimpar(avaliacao_contexto *contexto)
+ * @brief Libera o índice invertido dos comentários; será reconstruído na próxima busca
+*/
+
+static void avaliacao_buscaLimpar(avaliacao_contexto *contexto){
+  avaliacao_busca *busca = &contexto->busca;
+  unsigned int i;
+  
+  for(i=0;i<busca->capacidade;i++) free(busca->termos[i].lista);
+  free(busca->termos);
+  free(busca->posicoes);
+  memset(busca, 0, sizeof(avaliacao_busca));
+}
+
+/*!
+ * @fn static size_t avaliacao_buscaTermo(const char **p, const char *fim, char *termo)
+ * @brief Lê o próximo termo de um texto, em minúsculas e sem acentos
+ * @param termo Recebe o termo terminado em '\0', com até AVALIACAO_BUSCA_LIMITE_TERMO-1 bytes
+ * @return Tamanho do termo, 0 se o texto acabou
+ *
+ * Letras acentuadas em UTF-8 (0xC3 e mais um byte) viram a letra sem
+ * acento; os demais bytes que não são letras nem dígitos separam termos.
+ * Deixa *p depois do termo.
+*/
+
+static size_t avaliacao_buscaTermo(const char **p, const char *fim, char *termo){
+  /* Letra sem acento para o segundo byte de À a ÿ sem o bit de caixa; ' ' separa termos */
+  static const char latinas[] = "aaaaaa ceeeeiiii nooooo ouuuuy  ";
+  const unsigned char *q = (const unsigned char *)*p, *final = (const unsigned char *)fim;
+  size_t n = 0;
+  char letra;
+  
+  while(q < final) {
+    if(*q >= 'A' && *q <= 'Z') letra = (char)(*q++ - 'A' + 'a');
+    else if((*q >= 'a' && *q <= 'z') || (*q >= '0' && *q <= '9')) letra = (char)*q++;
+    else if(*q == 0xC3 && q+1 < final && q[1] >= 0x80 && q[1] <= 0xBF) {
+      letra = latinas[q[1] & 0x1F];
+      q += 2;
+    }
+    else {
+      letra = ' ';
+      q++;
+    }
+    
+    if(letra == ' ') {
+      if(n) break;
+      continue;
+    }
+    if(n < AVALIACAO_BUSCA_LIMITE_TERMO-1) termo[n++] = letra;
+  }
+  
+  termo[n] = '\0';
+  *p = (const char *)q;
+  return n;
+}
+
+/*!
+ * @fn static unsigned int avaliacao_buscaPosicao(const avaliacao_busca *busca, const char *termo)
+ * @brief Posição da tabela com o termo ou, se ele não estiver nela, a posição vazia onde entraria
+ *
+ * Hipóteses:
+ *  - A tabela tem ao menos uma posição vazia
+*/
+
+static unsigned int avaliacao_buscaPosicao(const avaliacao_busca *busca, const char *termo){
+  uint32_t hash = 2166136261u;
+  unsigned int i;
+  const char *c;
+  
+  /* FNV-1a */
+  for(c=termo;*c;c++) hash = (hash ^ (unsigned char)*c)*16777619u;
+  for(i = hash & (busca->capacidade - 1); busca->termos[i].termo[0] != '\0' && strcmp(busca->termos[i].termo, termo) != 0; i = (i + 1) & (busca->capacidade - 1));
+  return i;
+}
+
+/*!
+ * @fn static int avaliacao_buscaAnexar(avaliacao_busca *busca, const char *termo, unsigned int identificador)
+ * @brief Acrescenta a avaliação identificador à lista do termo, criando o termo se preciso
+ * @return Nulo se faltar memória
+ *
+ * Os ids chegam em ordem crescente, assim a lista só cresce no fim. A
+ * tabela dobra ao passar de metade cheia.
+*/
+
+static int avaliacao_buscaAnexar(avaliacao_busca *busca, const char *termo, unsigned int identificador){
+  avaliacao_termo *antiga = busca->termos, *entrada;
+  unsigned int capacidade = busca->capacidade, i, diferenca;
+  unsigned char *lista;
+  
+  if(2*(busca->n + 1) > busca->capacidade) {
+    busca->capacidade = capacidade ? 2*capacidade : 1024;
+    busca->termos = (avaliacao_termo *)calloc(busca->capacidade, sizeof(avaliacao_termo));
+    if(busca->termos == NULL) {
+      busca->termos = antiga;
+      busca->capacidade = capacidade;
+      return 0;
+    }
+    for(i=0;i<capacidade;i++)
+      if(antiga[i].termo[0] != '\0') busca->termos[avaliacao_buscaPosicao(busca, antiga[i].termo)] = antiga[i];
+    free(antiga);
+  }
+  
+  entrada = &busca->termos[avaliacao_buscaPosicao(busca, termo)];
+  if(entrada->termo[0] == '\0') {
+    strcpy(entrada->termo, termo);
+    busca->n++;
+  }
+  /* Um termo repetido no mesmo comentário entra uma vez */
+  if(entrada->n && entrada->ultima == identificador) return 1;
+  
+  /* Uma diferença de 32 bits ocupa até 5 bytes */
+  if(entrada->tamanho + 5 > entrada->capacidade) {
+    capacidade = entrada->capacidade ? 2*entrada->capacidade : 8;
+    lista = (unsigned char *)realloc(entrada->lista, capacidade);
+    if(lista == NULL) return 0;
+    entrada->lista = lista;
+    entrada->capacidade = capacidade;
+  }
+  for(diferenca = identificador - entrada->ultima; diferenca >= 0x80; diferenca >>= 7)
+    entrada->lista[entrada->tamanho++] = (unsigned char)(diferenca | 0x80);
+  entrada->lista[entrada->tamanho++] = (unsigned char)diferenca;
+  entrada->ultima = identificador;
+  entrada->n++;
+  return 1;
+}
+
+/*!
+ * @fn static avaliacao_condRet avaliacao_buscaAtualizar(avaliacao_contexto *contexto)
+ * @brief Garante que o índice invertido cobre todo o arquivo de avaliações
+ * @return Instância avaliacao_condRet que assume:
+ *  - AVALIACAO_FALHA_ABRIRDB se não conseguir abrir o arquivo ou faltar memória para o índice;
+ *  - AVALIACAO_SUCESSO caso contrário, com o índice vazio se o arquivo ainda não existir.
+ *
+ * Como em avaliacao_paresAtualizar, o índice é refeito se o arquivo foi
+ * trocado ou diminuiu e, se só cresceu, apenas as linhas novas são lidas
+ * e recebem os ids seguintes.
+*/
+
+static avaliacao_condRet avaliacao_buscaAtualizar(avaliacao_contexto *contexto){
+  avaliacao_busca *busca = &contexto->busca;
+  char linha[AVALIACAO_LIMITE_COMENTARIO + 64], termo[AVALIACAO_BUSCA_LIMITE_TERMO];
+  const char *p, *fim;
+  unsigned int capacidade, campo;
+  off_t *posicoes, posicao;
+  FILE *db_avaliacao;
+  struct stat estado;
+  int falha = 0;
+  
+  if(avaliacao_sincronizar_r(contexto) != AVALIACAO_SUCESSO) return AVALIACAO_FALHA_ABRIRDB;
+  if(stat(contexto->db, &estado) != 0) {
+    if(errno != ENOENT) return AVALIACAO_FALHA_ABRIRDB;
+    avaliacao_buscaLimpar(contexto);
+    busca->construido = 1;
+    return AVALIACAO_SUCESSO;
+  }
+  if(busca->construido && estado.st_ino == busca->arquivo && estado.st_size == busca->tamanho) return AVALIACAO_SUCESSO;
+  
+  if(!busca->construido || estado.st_ino != busca->arquivo || estado.st_size < busca->tamanho) {
+    avaliacao_buscaLimpar(contexto);
+    busca->arquivo = estado.st_ino;
+    busca->construido = 1;
+  }
+  
+  db_avaliacao = fopen(contexto->db, "r");
+  if(db_avaliacao == NULL) return AVALIACAO_FALHA_ABRIRDB;
+  fseeko(db_avaliacao, busca->tamanho, SEEK_SET);
+  /* Pulamos o contador */
+  if(busca->tamanho == 0 && fgets(linha, sizeof(linha), db_avaliacao) != NULL) busca->tamanho = ftello(db_avaliacao);
+  
+  for(posicao = busca->tamanho; !falha && fgets(linha, sizeof(linha), db_avaliacao) != NULL; posicao = ftello(db_avaliacao)) {
+    /* Uma linha sem '\n' ainda está sendo escrita, fica para a próxima busca */
+    fim = strchr(linha, '\n');
+    if(fim == NULL) break;
+    
+    /* Toda linha recebe um id, mesmo sem comentário, para que o id seja a posição da linha */
+    if(busca->avaliacoes == busca->capacidade_posicoes) {
+      capacidade = busca->capacidade_posicoes ? 2*busca->capacidade_posicoes : 1024;
+      posicoes = (off_t *)realloc(busca->posicoes, capacidade*sizeof(off_t));
+      if(posicoes == NULL) {
+        falha = 1;
+        break;
+      }
+      busca->posicoes = posicoes;
+      busca->capacidade_posicoes = capacidade;
+    }
+    busca->posicoes[busca->avaliacoes++] = posicao;
+    
+    /* O comentário vem depois do terceiro '\t' e o tempo, se houver, AVALIACAO_LIMITE_COMENTARIO bytes depois */
+    for(p = linha, campo = 0; campo < 3 && p != NULL; campo++) {
+      p = strchr(p, '\t');
+      if(p != NULL) p++;
+    }
+    if(p != NULL && fim - p > AVALIACAO_LIMITE_COMENTARIO) fim = p + AVALIACAO_LIMITE_COMENTARIO;
+    if(p != NULL)
+      while(!falha && avaliacao_buscaTermo(&p, fim, termo))
+        falha = !avaliacao_buscaAnexar(busca, termo, busca->avaliacoes);
+    if(!falha) busca->tamanho = ftello(db_avaliacao);
+  }
+  
+  fclose(db_avaliacao);
+  if(falha) {
+    avaliacao_buscaLimpar(contexto);
+    return AVALIACAO_FALHA_ABRIRDB;
+  }
+  return AVALIACAO_SUCESSO;
+}
+
+/*!
+ * @fn static void avaliacao_interpretarLinha(char *linha, unsigned int campos, avaliacao *retorno)
+ * @brief Preenche retorno a partir de uma linha no formato AVALIACAO_DB_ESTRUTURA_TEMPO ou AVALIACAO_DB_ESTRUTURA, sem o '\n'
+ * @param campos Máscara AVALIACAO_CAMPO_*; o comentário e o tempo só são copiados se pedidos
+ *
+ * Avaliador, avaliado e nota são sempre preenchidos. O tempo é 0 em
+ * linhas sem ele.
+*/
+
+static void avaliacao_interpretarLinha(char *linha, unsigned int campos, avaliacao *retorno){
+  char *campo;
+  size_t tamanho;
+  
+  /* Três números alinhados à esquerda e o comentário, separados por '\t' */
+  retorno->avaliador = (unsigned int)strtoul(linha, &campo, 10);
+  retorno->avaliado = (unsigned int)strtoul(campo, &campo, 10);
+  retorno->nota = (unsigned int)strtoul(campo, &campo, 10);
+  if(!(campos & (AVALIACAO_CAMPO_COMENTARIO | AVALIACAO_CAMPO_TEMPO))) return;
+  while(*campo == ' ') campo++;
+  if(*campo == '\t') campo++;
+  
+  /* O tempo vem depois do comentário completado até AVALIACAO_LIMITE_COMENTARIO bytes, que nunca tem tantos */
+  tamanho = strlen(campo);
+  if(campos & AVALIACAO_CAMPO_TEMPO)
+    retorno->tempo = (tamanho > AVALIACAO_LIMITE_COMENTARIO && campo[AVALIACAO_LIMITE_COMENTARIO] == '\t') ? (unsigned int)strtoul(campo + AVALIACAO_LIMITE_COMENTARIO + 1, NULL, 10) : 0;
+  if(!(campos & AVALIACAO_CAMPO_COMENTARIO)) return;
+  
+  /* Devemos retirar os espaços finais do comentário */
+  if(tamanho > AVALIACAO_LIMITE_COMENTARIO-1) tamanho = AVALIACAO_LIMITE_COMENTARIO-1;
+  while(tamanho && campo[tamanho-1] == ' ') tamanho--;
+  memcpy(retorno->comentario, campo, tamanho);
+  retorno->comentario[tamanho] = '\0';
+}
+
+/*!
+ * @fn static void avaliacao_pontuacoesLimpar(avaliacao_contexto *contexto)
+ * @brief Libera as somas das pontuações; serão refeitas desde o início do arquivo de avaliações
+ *
+ * Assertivas de entrada:
+ *  - pontuacoes.trava do contexto está adquirida ou a thread das pontuações não está rodando
+*/
+
+static void avaliacao_pontuacoesLimpar(avaliacao_contexto *contexto){
+  avaliacao_pontuacoes *pontuacoes = &contexto->pontuacoes;
+  
+  free(pontuacoes->usuarios);
+  pontuacoes->usuarios = NULL;
+  pontuacoes->capacidade = 0;
+  pontuacoes->soma = 0;
+  pontuacoes->n = 0;
+  pontuacoes->avaliacoes = 0;
+  pontuacoes->base = 0;
+  pontuacoes->ultimo = 0;
+  pontuacoes->tamanho = 0;
+  pontuacoes->arquivo = 0;
+}
+
+/*!
+ * @fn static int avaliacao_pontuacoesSomar(avaliacao_pontuacoes *pontuacoes, unsigned int avaliado, unsigned int nota, unsigned int tempo)
+ * @brief Soma uma avaliação às pontuações do avaliado
+ * @param tempo Momento da avaliação, 0 se desconhecido
+ * @return Nulo se faltar memória
+ *
+ * O peso da avaliação é 2 elevado ao número de meias-vidas entre base e
+ * o seu tempo. Como só a razão entre as somas importa, quando o peso
+ * passa de 2^512 base avança até o tempo atual e todas as somas são
+ * multiplicadas pelo mesmo fator.
+ *
+ * Assertivas de entrada:
+ *  - pontuacoes.trava está adquirida
+*/
+
+static int avaliacao_pontuacoesSomar(avaliacao_pontuacoes *pontuacoes, unsigned int avaliado, unsigned int nota, unsigned int tempo){
+  avaliacao_somas_pontuacao *usuarios;
+  unsigned int capacidade, i;
+  double expoente, fator, peso;
+  
+  if(avaliado >= pontuacoes->capacidade) {
+    capacidade = pontuacoes->capacidade ? pontuacoes->capacidade : 64;
+    while(capacidade <= avaliado) capacidade *= 2;
+    usuarios = (avaliacao_somas_pontuacao *)realloc(pontuacoes->usuarios, capacidade*sizeof(avaliacao_somas_pontuacao));
+    if(usuarios == NULL) return 0;
+    memset(usuarios + pontuacoes->capacidade, 0, (capacidade - pontuacoes->capacidade)*sizeof(avaliacao_somas_pontuacao));
+    pontuacoes->usuarios = usuarios;
+    pontuacoes->capacidade = capacidade;
+  }
+  
+  /* Sem tempo, vale o da anterior com tempo; base é o primeiro tempo visto */
+  if(tempo) pontuacoes->ultimo = tempo;
+  if(pontuacoes->base == 0) pontuacoes->base = pontuacoes->ultimo;
+  expoente = ((double)pontuacoes->ultimo - pontuacoes->base)/AVALIACAO_PONTUACAO_MEIA_VIDA;
+  if(expoente > 512) {
+    fator = exp2(-expoente);
+    for(i=0;i<pontuacoes->capacidade;i++) {
+      pontuacoes->usuarios[i].soma_pesada *= fator;
+      pontuacoes->usuarios[i].pesos *= fator;
+    }
+    pontuacoes->base = pontuacoes->ultimo;
+    expoente = 0;
+  }
+  peso = exp2(expoente);
+  
+  pontuacoes->usuarios[avaliado].n++;
+  pontuacoes->usuarios[avaliado].soma += nota;
+  pontuacoes->usuarios[avaliado].soma_pesada += peso*nota;
+  pontuacoes->usuarios[avaliado].pesos += peso;
+  pontuacoes->soma += nota;
+  pontuacoes->n++;
+  return 1;
+}
+
+/*!
+ * @fn static void avaliacao_pontuacoesAtualizar(avaliacao_contexto *contexto)
+ * @brief Soma às pontuações as linhas acrescentadas ao arquivo de avaliações desde a chamada anterior
+ *
+ * Como nos índices do módulo, as somas são refeitas se o arquivo foi
+ * trocado ou diminuiu. As linhas são lidas sem a trava e somadas em
+ * blocos de AVALIACAO_PONTUACAO_BLOCO, assim uma consulta espera no
+ * máximo a soma de um bloco. Se faltar memória as somas são descartadas
+ * e refeitas na chamada seguinte. Linhas ilegíveis ou com nota acima de 5
+ * não são somadas.
+ *
+ * Assertivas de entrada:
+ *  - Só a thread das pontuações do contexto chama a função
+*/
+
+static void avaliacao_pontuacoesAtualizar(avaliacao_contexto *contexto){
+  avaliacao_pontuacoes *pontuacoes = &contexto->pontuacoes;
+  unsigned int avaliados[AVALIACAO_PONTUACAO_BLOCO], notas[AVALIACAO_PONTUACAO_BLOCO], tempos[AVALIACAO_PONTUACAO_BLOCO];
+  char linha[AVALIACAO_LIMITE_COMENTARIO + 64];
+  unsigned int linhas, n, i;
+  FILE *db_avaliacao;
+  struct stat estado;
+  avaliacao lida;
+  off_t tamanho;
+  int falha = 0, fim = 0;
+  
+  if(stat(contexto->db, &estado) != 0) {
+    /* Sem arquivo não há avaliações */
+    if(errno == ENOENT && pontuacoes->arquivo != 0) {
+      pthread_mutex_lock(&pontuacoes->trava);
+      avaliacao_pontuacoesLimpar(contexto);
+      pthread_mutex_unlock(&pontuacoes->trava);
+    }
+    return;
+  }
+  if(estado.st_ino == pontuacoes->arquivo && estado.st_size == pontuacoes->tamanho) return;
+  if(estado.st_ino != pontuacoes->arquivo || estado.st_size < pontuacoes->tamanho) {
+    pthread_mutex_lock(&pontuacoes->trava);
+    avaliacao_pontuacoesLimpar(contexto);
+    pontuacoes->arquivo = estado.st_ino;
+    pthread_mutex_unlock(&pontuacoes->trava);
+  }
+  
+  db_avaliacao = fopen(contexto->db, "r");
+  if(db_avaliacao == NULL) return;
+  tamanho = pontuacoes->tamanho;
+  fseeko(db_avaliacao, tamanho, SEEK_SET);
+  /* Pulamos o contador */
+  if(tamanho == 0 && fgets(linha, sizeof(linha), db_avaliacao) != NULL) tamanho = ftello(db_avaliacao);
+  
+  while(!fim && !falha) {
+    for(linhas=0, n=0;linhas<AVALIACAO_PONTUACAO_BLOCO;linhas++) {
+      /* Uma linha sem '\n' ainda está sendo escrita, fica para a próxima leitura */
+      if(fgets(linha, sizeof(linha), db_avaliacao) == NULL || strchr(linha, '\n') == NULL) {
+        fim = 1;
+        break;
+      }
+      tamanho = ftello(db_avaliacao);
+      if(sscanf(linha, "%u\t%u\t%u", &lida.avaliador, &lida.avaliado, &lida.nota) != 3 || lida.nota > 5) continue;
+      avaliacao_interpretarLinha(linha, AVALIACAO_CAMPO_TEMPO, &lida);
+      avaliados[n] = lida.avaliado;
+      notas[n] = lida.nota;
+      tempos[n++] = lida.tempo;
+    }
+    
+    pthread_mutex_lock(&pontuacoes->trava);
+    for(i=0;i<n && !falha;i++) falha = !avaliacao_pontuacoesSomar(pontuacoes, avaliados[i], notas[i], tempos[i]);
+    if(falha) avaliacao_pontuacoesLimpar(contexto);
+    else {
+      pontuacoes->avaliacoes += linhas;
+      pontuacoes->tamanho = tamanho;
+    }
+    pthread_mutex_unlock(&pontuacoes->trava);
+  }
+  
+  fclose(db_avaliacao);
+}
+
+/*!
+ * @fn static void *avaliacao_pontuacoesTrabalhador(void *argumento)
+ * @brief Thread das pontuações
+ * @param argumento Contexto (avaliacao_contexto *) das pontuações
+ * @return Sempre NULL
+ *
+ * Lê as avaliações novas logo depois de cada lote gravado pelo contexto
+ * e, para as acrescentadas por fora, a cada
+ * AVALIACAO_PONTUACAO_INTERVALO_MS milissegundos. Termina quando
+ * pontuacoes.ativo for nulo.
+ *
+ * Requisitos:
+ *  - pthread.h, time.h
+ */
+
+static void *avaliacao_pontuacoesTrabalhador(void *argumento){
+  avaliacao_contexto *contexto = (avaliacao_contexto *)argumento;
+  avaliacao_pontuacoes *pontuacoes = &contexto->pontuacoes;
+  struct timespec limite;
+  
+  pthread_mutex_lock(&pontuacoes->trava);
+  while(pontuacoes->ativo) {
+    pthread_mutex_unlock(&pontuacoes->trava);
+    avaliacao_pontuacoesAtualizar(contexto);
+    pthread_mutex_lock(&pontuacoes->trava);
+    if(!pontuacoes->ativo) break;
+    
+    clock_gettime(CLOCK_REALTIME, &limite);
+    limite.tv_nsec += (long)AVALIACAO_PONTUACAO_INTERVALO_MS*1000000;
+    limite.tv_sec += limite.tv_nsec/1000000000;
+    limite.tv_nsec %= 1000000000;
+    pthread_cond_timedwait(&pontuacoes->sinal, &pontuacoes->trava, &limite);
+  }
+  pthread_mutex_unlock(&pontuacoes->trava);
+  return NULL;
+}
+
+/*!
+ * @fn static void avaliacao_pontuacoesParar(avaliacao_contexto *contexto)
+ * @brief Encerra a thread das pontuações, se estiver rodando; as somas são mantidas
+ *
+ * Assertivas de saída:
+ *  - pontuacoes.ativo do contexto é nulo e a thread terminou
+ */
+
+static void avaliacao_pontuacoesParar(avaliacao_contexto *contexto){
+  pthread_mutex_lock(&contexto->pontuacoes.trava);
+  if(!contexto->pontuacoes.ativo) {
+    pthread_mutex_unlock(&contexto->pontuacoes.trava);
+    return;
+  }
+  contexto->pontuacoes.ativo = 0;
+  pthread_cond_signal(&contexto->pontuacoes.sinal);
+  pthread_mutex_unlock(&contexto->pontuacoes.trava);
+  pthread_join(contexto->pontuacoes.trabalhador, NULL);
+}
+
+/*!
+ * @fn static void avaliacao_pontuacoesEncerrar()
+ * @brief Registrada com atexit, encerra a thread das pontuações do contexto padrão ao fim do programa
+*/
+
+static void avaliacao_pontuacoesEncerrar(){
+  avaliacao_pontuacoesParar(&avaliacao_padrao);
+}
+
+/*!
+ * @fn static void avaliacao_pontuacoesIniciar(avaliacao_contexto *contexto)
+ * @brief Inicia a thread das pontuações, se ainda não estiver rodando
+ *
+ * Na primeira chamada com o contexto padrão registra
+ * avaliacao_pontuacoesEncerrar com atexit. Se a thread não puder ser
+ * criada, a próxima chamada tenta de novo.
+ *
+ * Requisitos:
+ *  - pthread.h, stdlib.h
+ */
+
+static void avaliacao_pontuacoesIniciar(avaliacao_contexto *contexto){
+  static int registrado = 0;
+  
+  if(!registrado && contexto == &avaliacao_padrao) {
+    atexit(avaliacao_pontuacoesEncerrar);
+    registrado = 1;
+  }
+  
+  pthread_mutex_lock(&contexto->pontuacoes.trava);
+  if(!contexto->pontuacoes.ativo) {
+    contexto->pontuacoes.ativo = 1;
+    if(pthread_create(&contexto->pontuacoes.trabalhador, NULL, avaliacao_pontuacoesTrabalhador, contexto) != 0)
+      contexto->pontuacoes.ativo = 0;
+  }
+  pthread_mutex_unlock(&contexto->pontuacoes.trava);
+}
+
+/*!
+ * @fn avaliacao_contexto *avaliacao_contextoCriar(usuarios_contexto *usuarios, const char *db)
+ * @brief Cria um contexto de avaliações independente
+ * @param usuarios Contexto de usuários dos avaliadores e avaliados
+ * @param db Caminho do arquivo de avaliações, no formato de AVALIACAO_DB
+ * @return O contexto criado ou NULL se não houver memória ou o caminho tiver USUARIOS_LIMITE_CAMINHO caracteres ou mais
+ *
+ * As funções com sufixo _r recebem o contexto como primeiro argumento,
+ * as demais usam o contexto padrão.
+ *
+ * Requisitos:
+ *  - stdlib.h, string.h, usuarios.h
+ */
+
+avaliacao_contexto *avaliacao_contextoCriar(usuarios_contexto *usuarios, const char *db){
+  avaliacao_contexto *contexto;
+  
+  if(usuarios == NULL || strlen(db) >= USUARIOS_LIMITE_CAMINHO) return NULL;
+  
+  contexto = (avaliacao_contexto *)calloc(1, sizeof(avaliacao_contexto));
+  if(contexto == NULL) return NULL;
+  
+  contexto->usuarios = usuarios;
+  contexto->indice.descritor = -1;
+  contexto->histogramas.descritor = -1;
+  pthread_mutex_init(&contexto->escritor.trava, NULL);
+  pthread_cond_init(&contexto->escritor.sinal, NULL);
+  pthread_mutex_init(&contexto->pontuacoes.trava, NULL);
+  pthread_cond_init(&contexto->pontuacoes.sinal, NULL);
+  strcpy(contexto->db, db);
+  sprintf(contexto->db_histogramas, "%s" AVALIACAO_HISTOGRAMAS_SUFIXO, db);
+  return contexto;
+}
+
+/*!
+ * @fn avaliacao_condRet avaliacao_contextoDestruir(avaliacao_contexto **contexto)
+ * @brief Grava as avaliações pendentes e libera um contexto criado por avaliacao_contextoCriar, o contexto de usuários não é afetado
+ * @return Instância avaliacao_condRet que assume:
+ *  - AVALIACAO_VALORINVALIDO se for o contexto padrão;
+ *  - AVALIACAO_FALHA_CRIARDB se não conseguir gravar as avaliações pendentes, o contexto não é liberado;
+ *  - AVALIACAO_SUCESSO caso contrário.
+*/
+
+avaliacao_condRet avaliacao_contextoDestruir(avaliacao_contexto **contexto){
+  avaliacao_condRet retorno;
+  
+  if(*contexto == &avaliacao_padrao) return AVALIACAO_VALORINVALIDO;
+  avaliacao_escritorParar(*contexto);
+  retorno = avaliacao_sincronizar_r(*contexto);
+  if(retorno != AVALIACAO_SUCESSO) return retorno;
+  avaliacao_pontuacoesParar(*contexto);
+  
+  avaliacao_indiceLimpar(*contexto);
+  avaliacao_histogramasLimpar(*contexto);
+  avaliacao_paresLimpar(*contexto);
+  avaliacao_buscaLimpar(*contexto);
+  avaliacao_pontuacoesLimpar(*contexto);
+  pthread_mutex_destroy(&(*contexto)->escritor.trava);
+  pthread_cond_destroy(&(*contexto)->escritor.sinal);
+  pthread_mutex_destroy(&(*contexto)->pontuacoes.trava);
+  pthread_cond_destroy(&(*contexto)->pontuacoes.sinal);
+  free(*contexto);
+  *contexto = NULL;
+  return AVALIACAO_SUCESSO;
+}
+
+/*!
+ * @fn avaliacao_condRet avaliacao_pegarContador_r(avaliacao_contexto *contexto)
+ * @brief Função DEPRECATED, o carregamento do contador ocorre automaticamente na realização de avaliações
+ * @param contexto Não é usado, mantido para a assinatura seguir as demais funções _r
+ * @return Sempre AVALIACAO_SUCESSO
+*/
+
+avaliacao_condRet avaliacao_pegarContador_r(avaliacao_contexto *contexto){
+  (void)contexto;
+  return AVALIACAO_SUCESSO;
+}
+
+/*!
+ * @fn avaliacao *avaliacao_iniciar_r(avaliacao_contexto *contexto)
+ * @brief Função que inicia uma avaliação
+ * @return Retorna o endereço de uma avaliação alocada dinamicamente
+ *
+ * Inicialmente todos os valores da transação são 0
+ *
+ * @code
+ * avaliacao *a = avaliacao_iniciar();
+ * @code
+ *
+ * Assertivas de entrada:
+ *  - Há memória suficiente
+ *
+ * Assertivas de saída:
+ *  - Alocará memória para uma avaliação e retornará o ponteiro por valor
+ *
+ * Assertivas estruturais:
+ *  - Nenhuma
+ *
+ * Assertivas de contrato:
+ *  - Nenhuma
+ *
+ * Requisitos:
+ *  - stdlib.h
+ *
+ * Hipóteses:
+ *  - Nenhuma.
+ *
+ */
+
+avaliacao *avaliacao_iniciar_r(avaliacao_contexto *contexto){
+  avaliacao *novo = (avaliacao *)calloc(1, sizeof(avaliacao));
+  novo->identificador = contexto->contador;
+  return novo;
+}
+
+/*!
+ * @fn avaliacao_condRet avaliacao_limpar(avaliacao **dado)
+ * @brief Função que limpa uma avaliação
+ * @param dado Ponteiro para o ponteiro da avaliação
+ * @return Instância avaliacao_condRet que retornará AVALIACAO_SUCESSO
+ *
+ * É usado para desalocar memória de uma avaliação:
+ * @code
+ * avaliacao *a = avaliacao_iniciar();
+ * //...
+ * avaliacao_limpar(&a);
+ * @endcode
+ *
+ * Assertivas de entrada:
+ *  - dado é diferente de NULL
+ *
+ * Assertivas de saída:
+ *  - o conteúdo de dado será NULL
+ *  - Memória ocupado pelo conteúdo de dado será desalocada
+ *
+ * Assertivas estruturais:
+ *  - Nenhuma
+ *
+ * Assertivas de contrato:
+ *  - o conteúdo de dado será NULL e a memória apontada por esse conteúdo será desalocada.
+ *
+ * Requisitos:
+ *  - stdlib.h
+ *
+ * Hipóteses:
+ *  - dado é diferente de NULL
+ *
+ */
+
+avaliacao_condRet avaliacao_limpar(avaliacao **dado){
+  free(*dado);
+  *dado = NULL;
+  return AVALIACAO_SUCESSO; 
+}
+
+/*!
+ * @fn avaliacao_condRet avaliacao_definir(avaliacao *retorno, const char *nome, ...)
+ * @brief Função que atribui dados a avaliação
+ * @param retorno Endereço da avaliação a definir um valor
+ * @param nome Argumento válido que identificará o que definir: "avaliador", "avaliado", "nota", "comentario", "tempo"
+ * @param (...) Um argumento dos tipos unsigned int ou char * É o valor a se definir na avaliação
+ * @return Retorna uma instância avaliacao_condRet que assume AVALIACAO_SUCESSO.
+ *
+ * Exemplo de uso:
+ * @code
+ * avaliacao *a = avaliacao_iniciar();
+ * avaliacao_definir(a, "avaliador", 5);
+ * avaliacao_definir(a, "avaliado", 6);
+ * avaliacao_definir(a, "nota", 2);
+ * avaliacao_definir(a, "comentario", (char *)"Muito bom!");
+ * avaliacao_limpar(&a);
+ * @endcode
+ *
+ * Assertivas de entrada:
+ *  - É passado exatamente um argumento na elípse do tipo unsigned int ou char *
+ *  - O nome passado é algum desses: "avaliador", "avaliado", "nota", "comentario", "tempo"
+ *  - retorno não é NULL
+ * 
+ * Assertivas de saída:
+ *  - O argumento na elipse de dado passado passa a definir um valor na avaliação
+ *
+ * Assertivas estruturais:
+ *  - As strings passadas na elipse terminam com '\0'
+ *
+ * Assertivas de contrato:
+ *  - Nenhuma
+ *
+ * Resquisitos:
+ *  - string.h, stdarg.h
+ *
+ * Hipóteses:
+ *  - retorno não é NULL
+ *  - Há exatamente 1 argumento em (...) do tipo especificado
+ * 
+ */
+
+avaliacao_condRet avaliacao_definir(avaliacao *retorno, const char *nome, ...) {
+  /* Lista de argumentos */
+  va_list arg;
+  va_start(arg, nome);
+  
+  /* Comparamos o nome com os valores possíveis */
+  if(!strcmp("avaliador", nome)) retorno->avaliador = va_arg(arg, unsigned int);
+  else if(!strcmp("avaliado", nome)) retorno->avaliado = va_arg(arg, unsigned int);
+  else if(!strcmp("nota", nome)) retorno->nota = va_arg(arg, unsigned int);
+  else if(!strcmp("comentario", nome)) strncpy(retorno->comentario, va_arg(arg, char *), AVALIACAO_LIMITE_COMENTARIO);
+  else if(!strcmp("tempo", nome)) retorno->tempo = va_arg(arg, unsigned int);
+  
+  va_end(arg);
+  
+  return AVALIACAO_SUCESSO;
+}
+
+/*!
+ * @fn static avaliacao_condRet avaliacao_lerPosicao(int descritor, off_t posicao, unsigned int campos, avaliacao *retorno)
+ * @brief Lê a linha do arquivo de avaliações que começa em posicao
+ * @param campos Máscara AVALIACAO_CAMPO_*; o comentário e o tempo só são lidos e copiados se pedidos
+ * @return AVALIACAO_FALHA_ABRIRDB se a leitura falhar, AVALIACAO_SUCESSO caso contrário
+ *
+ * Sem o comentário e o tempo a leitura para nos três números, que cabem
+ * em AVALIACAO_LINHA_NUMEROS bytes.
+*/
+
+static avaliacao_condRet avaliacao_lerPosicao(int descritor, off_t posicao, unsigned int campos, avaliacao *retorno){
+  char linha[AVALIACAO_LIMITE_COMENTARIO + 64], *fim;
+  ssize_t lidos;
+  
+  lidos = pread(descritor, linha, (campos & (AVALIACAO_CAMPO_COMENTARIO | AVALIACAO_CAMPO_TEMPO)) ? sizeof(linha)-1 : AVALIACAO_LINHA_NUMEROS, posicao);
+  if(lidos <= 0) return AVALIACAO_FALHA_ABRIRDB;
+  linha[lidos] = '\0';
+  fim = strchr(linha, '\n');
+  if(fim != NULL) *fim = '\0';
+  
+  avaliacao_interpretarLinha(linha, campos, retorno);
+  return AVALIACAO_SUCESSO;
+}
+
+/*!
+ * @fn avaliacao_condRet avaliacao_obterAvaliacao_r(avaliacao_contexto *contexto, unsigned int identificador, unsigned int n, avaliacao_tipo tipo, avaliacao *retorno)
+ * @brief Função que busca a n-ésima avaliação de um usuário
+ * @param identificador Id de um usuário, se for 0 usa a sessão (Se usar a sessão o módulo de usuários deve ter sido carregado!)
+ * @param n n-ésima avaliação do usuário a ler
+ * @param tipo O tipo da avaliação podendo ser AVALIADOR ou AVALIADO, se for AVALIADOR busca as avaliações em que o identificador é o avaliador se for AVALIADO busca as avaliações em que identificador é avaliado.
+ * @param retorno Retorno da avaliação pretendida por referência, já deve estar alocado anteriormente a execução da função
+ * @return Instância avaliacao_condRet que assume: 
+ *  - AVALIACAO_VALORINVALIDO se n=0;
+ *  - AVALIACAO_FALHA_SEMSESSAO se não houver sessão aberta;
+ *  - AVALIACAO_FALHA_USUARIOS se não conseguir obter o id do usuário na sessão;
+ *  - AVALIACAO_FALHA_ABRIRDB se não consegue abrir para leitura "r" o arquivo de avaliações ou faltar memória para o índice;
+ *  - AVALIACAO_NAO_ENCONTRADO se não encontrou uma avaliação com esse valor de n;
+ *  - AVALIACAO_SUCESSO se encontrou uma avaliação e a copiou para retorno com sucesso
+ * 
+ * Recebe o id do usuário, se receber 0 trabalha com a sessão
+ *
+ * Recebe a posição da avaliação a ser lida
+ * 
+ * Recebe AVALIADOR ou AVALIADO para listar as avaliações em que o usuário avaliou ou as que ele foi avaliado
+ * 
+ * Retorna por referência uma avaliação
+ *
+ * As posições das avaliações de cada usuário ficam em um índice na
+ * memória (avaliacao_indice), construído na primeira consulta e
+ * completado com as linhas gravadas desde a anterior; a consulta é uma leitura do
+ * arquivo na posição da n-ésima avaliação, sem percorrê-lo.
+ *
+ * Assertivas de entrada:
+ *  - n é diferente de 0 e há pelo menos n avaliações referentes ao usuário identificado com o tipo passado
+ *  - retorno já está alocado
+ *
+ * Assertivas de saída
+ *  - retorno conterá n-ésima a avaliação
+ *  - O arquivo de dados não é alterado
+ *
+ * Assertivas estruturais:
+ *  - Nenhuma
+ *
+ * Assertivas de contrato:
+ *  - Se as condições forem satisfeitas o retorno terá a n-ésima avaliação
+ *
+ * Requisitos:
+ *  - stdio.h, unistd.h, usuarios.h
+ *
+ * Hipóteses:
+ *  - Há memória alocada para o retorno
+ */
+ 
+avaliacao_condRet avaliacao_obterAvaliacao_r(avaliacao_contexto *contexto, unsigned int identificador, unsigned int n, avaliacao_tipo tipo, avaliacao *retorno) {
+  avaliacao_indice *indice = &contexto->indice;
+  avaliacao_posicoes *lista;
+  
+  /* Verificamos se o valor passado é correto */
+  if(n == 0) return AVALIACAO_VALORINVALIDO;
+  
+  /* Se avaliador for 0 pegamos a sessão */
+  if(identificador == 0){
+    if(!usuarios_sessaoAberta_r(contexto->usuarios)) return AVALIACAO_FALHA_SEMSESSAO;
+    if(usuarios_retornaDados_r(contexto->usuarios, 0, "identificador", &identificador) != USUARIOS_SUCESSO) return AVALIACAO_FALHA_USUARIOS;
+  }
+  
+  /* O índice dá a posição da n-ésima avaliação, lida de uma vez */
+  if(avaliacao_indiceAtualizar(contexto) != AVALIACAO_SUCESSO) return AVALIACAO_FALHA_ABRIRDB;
+  if(identificador >= indice->capacidade) return AVALIACAO_NAO_ENCONTRADO;
+  lista = &indice->usuarios[tipo == AVALIADO ? AVALIADO : AVALIADOR][identificador];
+  if(n > lista->n) return AVALIACAO_NAO_ENCONTRADO;
+  
+  return avaliacao_lerPosicao(indice->descritor, lista->posicoes[n-1], AVALIACAO_CAMPOS_TODOS, retorno);
+}
+
+/*!
+ * @fn avaliacao_condRet avaliacao_cursorAbrir_r(avaliacao_contexto *contexto, avaliacao_cursor *cursor, unsigned int identificador, avaliacao_tipo tipo, unsigned int notaMinima, unsigned int notaMaxima, unsigned int campos)
+ * @brief Abre um cursor pelas avaliações feitas (AVALIADOR) ou recebidas (AVALIADO) por um usuário
+ * @param cursor Cursor já alocado, preenchido pela função
+ * @param identificador id do usuário, 0 para o usuário da sessão
+ * @param notaMinima Menor nota das avaliações percorridas
+ * @param notaMaxima Maior nota das avaliações percorridas
+ * @param campos Máscara AVALIACAO_CAMPO_* dos campos que avaliacao_cursorLer copia
+ * @return Instância do tipo avaliacao_condRet que assume:
+ *  - AVALIACAO_VALORINVALIDO se notaMinima for maior que notaMaxima ou campos for 0
+ *  - AVALIACAO_FALHA_SEMSESSAO se identificador for 0 e não houver sessão
+ *  - AVALIACAO_FALHA_USUARIOS se não conseguir obter o id da sessão
+ *  - AVALIACAO_SUCESSO caso contrário
+ *
+ * Percorrer todas as avaliações com o cursor custa uma leitura por
+ * avaliação, enquanto n chamadas a avaliacao_obterAvaliacao refazem a
+ * verificação do índice a cada uma:
+ * @code
+ * avaliacao_cursor c;
+ * avaliacao pagina[16];
+ * unsigned int lidas, i;
+ * avaliacao_cursorAbrir(&c, id, AVALIADO, 0, 2, AVALIACAO_CAMPO_AVALIADOR | AVALIACAO_CAMPO_NOTA);
+ * while(avaliacao_cursorLer(&c, pagina, 16, &lidas) == AVALIACAO_SUCESSO)
+ *   for(i=0;i<lidas;i++) printf("%u %u\n", pagina[i].avaliador, pagina[i].nota);
+ * @endcode
+ *
+ * Assertivas de entrada:
+ *  - cursor é diferente de NULL
+ *
+ * Assertivas de saída:
+ *  - O cursor está antes da primeira avaliação do usuário
+ *  - O arquivo de dados não é alterado
+ *
+ * Requisitos:
+ *  - usuarios.h
+ *
+ * Hipóteses:
+ *  - O contexto não é destruído enquanto o cursor é usado
+ */
+
+avaliacao_condRet avaliacao_cursorAbrir_r(avaliacao_contexto *contexto, avaliacao_cursor *cursor, unsigned int identificador, avaliacao_tipo tipo, unsigned int notaMinima, unsigned int notaMaxima, unsigned int campos) {
+  if(notaMinima > notaMaxima || !(campos & AVALIACAO_CAMPOS_TODOS)) return AVALIACAO_VALORINVALIDO;
+  
+  /* Se identificador for 0 pegamos a sessão */
+  if(identificador == 0){
+    if(!usuarios_sessaoAberta_r(contexto->usuarios)) return AVALIACAO_FALHA_SEMSESSAO;
+    if(usuarios_retornaDados_r(contexto->usuarios, 0, "identificador", &identificador) != USUARIOS_SUCESSO) return AVALIACAO_FALHA_USUARIOS;
+  }
+  
+  cursor->contexto = contexto;
+  cursor->identificador = identificador;
+  cursor->tipo = tipo == AVALIADO ? AVALIADO : AVALIADOR;
+  cursor->proxima = 0;
+  cursor->notaMinima = notaMinima;
+  cursor->notaMaxima = notaMaxima;
+  cursor->campos = campos & AVALIACAO_CAMPOS_TODOS;
+  return AVALIACAO_SUCESSO;
+}
+
+/*!
+ * @fn avaliacao_condRet avaliacao_cursorLer(avaliacao_cursor *cursor, avaliacao *pagina, unsigned int tamanho, unsigned int *lidas)
+ * @brief Copia para pagina as próximas avaliações do cursor com nota entre notaMinima e notaMaxima
+ * @param pagina Vetor de pelo menos tamanho avaliações, alocado por quem chama
+ * @param tamanho Máximo de avaliações copiadas nesta chamada
+ * @param lidas Retorna quantas avaliações foram copiadas
+ * @return Instância do tipo avaliacao_condRet que assume:
+ *  - AVALIACAO_VALORINVALIDO se tamanho for 0
+ *  - AVALIACAO_FALHA_ABRIRDB se não conseguir ler o arquivo de avaliações
+ *  - AVALIACAO_NAO_ENCONTRADO se o cursor chegou ao fim sem copiar nenhuma avaliação
+ *  - AVALIACAO_SUCESSO se copiou ao menos uma avaliação
+ *
+ * Só os campos pedidos na abertura são escritos em pagina; os demais
+ * ficam como estavam. Sem AVALIACAO_CAMPO_COMENTARIO o comentário não
+ * chega a ser lido do arquivo.
+ *
+ * Assertivas de entrada:
+ *  - cursor foi aberto por avaliacao_cursorAbrir
+ *
+ * Assertivas de saída:
+ *  - O cursor avança até depois da última avaliação examinada
+ *  - O arquivo de dados não é alterado
+ *
+ * Requisitos:
+ *  - unistd.h
+ *
+ * Hipóteses:
+ *  - Nenhuma
+ */
+
+avaliacao_condRet avaliacao_cursorLer(avaliacao_cursor *cursor, avaliacao *pagina, unsigned int tamanho, unsigned int *lidas) {
+  avaliacao_indice *indice = &cursor->contexto->indice;
+  avaliacao_posicoes *lista;
+  avaliacao lida, *destino;
+  
+  *lidas = 0;
+  if(tamanho == 0) return AVALIACAO_VALORINVALIDO;
+  
+  /* O índice é completado antes da página, então o cursor vê as avaliações novas */
+  if(avaliacao_indiceAtualizar(cursor->contexto) != AVALIACAO_SUCESSO) return AVALIACAO_FALHA_ABRIRDB;
+  if(cursor->identificador >= indice->capacidade) return AVALIACAO_NAO_ENCONTRADO;
+  lista = &indice->usuarios[cursor->tipo][cursor->identificador];
+  
+  while(*lidas < tamanho && cursor->proxima < lista->n){
+    if(avaliacao_lerPosicao(indice->descritor, lista->posicoes[cursor->proxima], cursor->campos, &lida) != AVALIACAO_SUCESSO) return AVALIACAO_FALHA_ABRIRDB;
+    cursor->proxima++;
+    if(lida.nota < cursor->notaMinima || lida.nota > cursor->notaMaxima) continue;
+    
+    destino = &pagina[(*lidas)++];
+    if(cursor->campos & AVALIACAO_CAMPO_AVALIADOR) destino->avaliador = lida.avaliador;
+    if(cursor->campos & AVALIACAO_CAMPO_AVALIADO) destino->avaliado = lida.avaliado;
+    if(cursor->campos & AVALIACAO_CAMPO_NOTA) destino->nota = lida.nota;
+    if(cursor->campos & AVALIACAO_CAMPO_COMENTARIO) strcpy(destino->comentario, lida.comentario);
+    if(cursor->campos & AVALIACAO_CAMPO_TEMPO) destino->tempo = lida.tempo;
+  }
+  
+  return *lidas ? AVALIACAO_SUCESSO : AVALIACAO_NAO_ENCONTRADO;
+}
+
+/*!
+ * @fn avaliacao_condRet avaliacao_obterPontuacao_r(avaliacao_contexto *contexto, unsigned int identificador, avaliacao_pontuacao *retorno)
+ * @brief Retorna por referência a média simples, a bayesiana e a com decaimento das notas recebidas por um usuário
+ * @param identificador id do usuário avaliado, 0 para o usuário da sessão
+ * @param retorno Pontuação já alocada, preenchida pela função
+ * @return Instância do tipo avaliacao_condRet que assume:
+ *  - AVALIACAO_FALHA_SEMSESSAO se identificador for 0 e não houver sessão
+ *  - AVALIACAO_FALHA_USUARIOS se não conseguir obter o id da sessão
+ *  - AVALIACAO_SUCESSO caso contrário
+ *
+ * As pontuações são calculadas por uma thread do contexto, iniciada na
+ * primeira consulta, que lê só as avaliações novas do arquivo logo depois
+ * de cada lote gravado e a cada AVALIACAO_PONTUACAO_INTERVALO_MS
+ * milissegundos. A consulta não lê o arquivo: copia as somas da última
+ * leitura da thread, e retorno->avaliacoes diz quantas linhas do arquivo
+ * elas cobrem (0 logo depois da primeira consulta).
+ *
+ * Um vendedor novo com um só 5 tem media 5, mas bayesiana perto da média
+ * global; com o tempo as avaliações recentes pesam mais em decaida.
+ *
+ * Assertivas de entrada:
+ *  - retorno já está alocado
+ *
+ * Assertivas de saída:
+ *  - O arquivo de avaliações não é alterado
+ *
+ * Requisitos:
+ *  - pthread.h, usuarios.h
+ *
+ * Hipóteses:
+ *  - As avaliações são feitas por este módulo ou acrescentadas ao fim do arquivo
+ */
+
+avaliacao_condRet avaliacao_obterPontuacao_r(avaliacao_contexto *contexto, unsigned int identificador, avaliacao_pontuacao *retorno) {
+  avaliacao_pontuacoes *pontuacoes = &contexto->pontuacoes;
+  avaliacao_somas_pontuacao somas = {0, 0, 0, 0};
+  double global;
+  
+  /* Se identificador for 0 pegamos a sessão */
+  if(identificador == 0){
+    if(!usuarios_sessaoAberta_r(contexto->usuarios)) return AVALIACAO_FALHA_SEMSESSAO;
+    if(usuarios_retornaDados_r(contexto->usuarios, 0, "identificador", &identificador) != USUARIOS_SUCESSO) return AVALIACAO_FALHA_USUARIOS;
+  }
+  
+  avaliacao_pontuacoesIniciar(contexto);
+  
+  pthread_mutex_lock(&pontuacoes->trava);
+  if(identificador < pontuacoes->capacidade) somas = pontuacoes->usuarios[identificador];
+  global = pontuacoes->n ? (double)pontuacoes->soma/pontuacoes->n : 0;
+  retorno->avaliacoes = pontuacoes->avaliacoes;
+  pthread_mutex_unlock(&pontuacoes->trava);
+  
+  retorno->n = somas.n;
+  retorno->media = somas.n ? (double)somas.soma/somas.n : 0;
+  retorno->bayesiana = (AVALIACAO_PONTUACAO_PRIORI*global + somas.soma)/(AVALIACAO_PONTUACAO_PRIORI + somas.n);
+  retorno->decaida = (somas.pesos > 0) ? somas.soma_pesada/somas.pesos : retorno->media;
+  return AVALIACAO_SUCESSO;
+}
+
+/*!
+ * @fn avaliacao_condRet avaliacao_obterEstatisticas_r(avaliacao_contexto *contexto, unsigned int identificador, avaliacao_estatisticas *retorno)
+ * @brief Retorna por referência a distribuição das notas recebidas por um usuário
+ * @param identificador id do usuário avaliado, 0 para o usuário da sessão
+ * @param retorno Estatísticas já alocadas, preenchidas pela função
+ * @return Instância do tipo avaliacao_condRet que assume:
+ *  - AVALIACAO_FALHA_SEMSESSAO se identificador for 0 e não houver sessão
+ *  - AVALIACAO_FALHA_USUARIOS se não conseguir obter o id da sessão
+ *  - AVALIACAO_FALHA_ABRIRDB se não conseguir ler as avaliações ou os histogramas
+ *  - AVALIACAO_FALHA_CRIARDB se não conseguir gravar os histogramas refeitos
+ *  - AVALIACAO_SUCESSO caso contrário, com tudo zerado se o usuário não recebeu avaliações
+ *
+ * As notas recebidas por usuário ficam em um histograma de
+ * AVALIACAO_NOTAS contadores, gravado em db_histogramas e somado a cada
+ * avaliação gravada; média, mediana e percentual de positivas
+ * saem dos seis contadores, sem ler as avaliações. Só a primeira
+ * consulta lê o arquivo de histogramas, ou refaz os histogramas a partir
+ * das avaliações se ele faltar.
+ *
+ * Assertivas de entrada:
+ *  - retorno já está alocado
+ *
+ * Assertivas de saída:
+ *  - retorno terá as contagens, o total, a média, a mediana e o percentual de positivas
+ *  - O arquivo de avaliações não é alterado
+ *
+ * Requisitos:
+ *  - unistd.h, usuarios.h
+ *
+ * Hipóteses:
+ *  - As avaliações são feitas por este módulo ou acrescentadas ao fim do arquivo
+ */
+
+avaliacao_condRet avaliacao_obterEstatisticas_r(avaliacao_contexto *contexto, unsigned int identificador, avaliacao_estatisticas *retorno) {
+  avaliacao_histogramas *histogramas = &contexto->histogramas;
+  avaliacao_condRet resultado;
+  unsigned int nota, soma = 0, positivas = 0, acumulado = 0, centrais[2], i;
+  
+  /* Se identificador for 0 pegamos a sessão */
+  if(identificador == 0){
+    if(!usuarios_sessaoAberta_r(contexto->usuarios)) return AVALIACAO_FALHA_SEMSESSAO;
+    if(usuarios_retornaDados_r(contexto->usuarios, 0, "identificador", &identificador) != USUARIOS_SUCESSO) return AVALIACAO_FALHA_USUARIOS;
+  }
+  
+  resultado = avaliacao_histogramasAtualizar(contexto);
+  if(resultado != AVALIACAO_SUCESSO) return resultado;
+  
+  memset(retorno, 0, sizeof(avaliacao_estatisticas));
+  if(identificador >= histogramas->capacidade) return AVALIACAO_SUCESSO;
+  
+  for(nota=0;nota<AVALIACAO_NOTAS;nota++) {
+    retorno->contagem[nota] = histogramas->contagens[identificador][nota];
+    retorno->total += retorno->contagem[nota];
+    soma += nota*retorno->contagem[nota];
+    if(nota >= AVALIACAO_NOTA_POSITIVA) positivas += retorno->contagem[nota];
+  }
+  if(retorno->total == 0) return AVALIACAO_SUCESSO;
+  
+  retorno->media = (double)soma/retorno->total;
+  retorno->positivas = 100.0*positivas/retorno->total;
+  
+  /* A mediana é a média das notas nas posições centrais, contadas a partir de 0 */
+  centrais[0] = (retorno->total-1)/2;
+  centrais[1] = retorno->total/2;
+  for(nota=0, i=0;nota<AVALIACAO_NOTAS && i<2;nota++) {
+    acumulado += retorno->contagem[nota];
+    for(;i<2 && centrais[i] < acumulado;i++) retorno->mediana += nota/2.0;
+  }
+  
+  return AVALIACAO_SUCESSO;
+}
+
+/*!
+ * @fn avaliacao_condRet avaliacao_jaAvaliou_r(avaliacao_contexto *contexto, unsigned int avaliador, unsigned int avaliado)
+ * @brief Verifica se avaliador já avaliou avaliado
+ * @param avaliador id do avaliador, 0 para o usuário da sessão
+ * @param avaliado id do avaliado
+ * @return Instância do tipo avaliacao_condRet que assume:
+ *  - AVALIACAO_FALHA_SEMSESSAO se avaliador for 0 e não houver sessão
+ *  - AVALIACAO_FALHA_USUARIOS se não conseguir obter o id da sessão
+ *  - AVALIACAO_FALHA_ABRIRDB se não conseguir ler as avaliações
+ *  - AVALIACAO_NAO_ENCONTRADO se avaliador ainda não avaliou avaliado
+ *  - AVALIACAO_SUCESSO se já avaliou
+ *
+ * Os pares (avaliador, avaliado) ficam em uma tabela hash montada na
+ * primeira consulta com uma leitura do arquivo; depois cada consulta é
+ * uma busca na tabela e as avaliações feitas pelo contexto entram nela
+ * ao serem feitas, mesmo antes de gravadas.
+ *
+ * Assertivas de entrada:
+ *  - Nenhuma
+ *
+ * Assertivas de saída:
+ *  - O arquivo de avaliações não é alterado
+ *
+ * Requisitos:
+ *  - usuarios.h
+ *
+ * Hipóteses:
+ *  - As avaliações são feitas por este módulo ou acrescentadas ao fim do arquivo
+ */
+
+avaliacao_condRet avaliacao_jaAvaliou_r(avaliacao_contexto *contexto, unsigned int avaliador, unsigned int avaliado) {
+  avaliacao_condRet resultado;
+  uint64_t chave;
+  
+  /* Se avaliador for 0 pegamos a sessão */
+  if(avaliador == 0){
+    if(!usuarios_sessaoAberta_r(contexto->usuarios)) return AVALIACAO_FALHA_SEMSESSAO;
+    if(usuarios_retornaDados_r(contexto->usuarios, 0, "identificador", &avaliador) != USUARIOS_SUCESSO) return AVALIACAO_FALHA_USUARIOS;
+  }
+  
+  resultado = avaliacao_paresAtualizar(contexto);
+  if(resultado != AVALIACAO_SUCESSO) return resultado;
+  
+  chave = ((uint64_t)avaliador << 32) | avaliado;
+  if(contexto->pares.n == 0 || chave == 0) return AVALIACAO_NAO_ENCONTRADO;
+  return contexto->pares.tabela[avaliacao_paresPosicao(&contexto->pares, chave)] == chave ? AVALIACAO_SUCESSO : AVALIACAO_NAO_ENCONTRADO;
+}
+
+/*!
+ * @fn static avaliacao_condRet avaliacao_mapear(avaliacao_contexto *contexto, char **conteudo, size_t *tamanho, const char **linhas)
+ * @brief Grava as avaliações pendentes e mapeia o arquivo de avaliações inteiro na memória para leitura
+ * @param conteudo Recebe o início do mapeamento, NULL se o arquivo não existir ou estiver vazio; liberar com munmap
+ * @param tamanho Recebe os bytes mapeados
+ * @param linhas Recebe a primeira linha depois do contador
+ * @return Instância avaliacao_condRet que assume:
+ *  - AVALIACAO_FALHA_ABRIRDB se não conseguir gravar as pendentes ou abrir e mapear o arquivo;
+ *  - AVALIACAO_SUCESSO caso contrário, também se o arquivo não existir.
+*/
+
+static avaliacao_condRet avaliacao_mapear(avaliacao_contexto *contexto, char **conteudo, size_t *tamanho, const char **linhas){
+  struct stat estado;
+  const char *corte;
+  void *mapa;
+  int descritor;
+  
+  *conteudo = NULL;
+  *tamanho = 0;
+  *linhas = NULL;
+  if(avaliacao_sincronizar_r(contexto) != AVALIACAO_SUCESSO) return AVALIACAO_FALHA_ABRIRDB;
+  
+  descritor = open(contexto->db, O_RDONLY);
+  if(descritor < 0) return (errno == ENOENT) ? AVALIACAO_SUCESSO : AVALIACAO_FALHA_ABRIRDB;
+  if(fstat(descritor, &estado) != 0) {
+    close(descritor);
+    return AVALIACAO_FALHA_ABRIRDB;
+  }
+  if(estado.st_size == 0) {
+    close(descritor);
+    return AVALIACAO_SUCESSO;
+  }
+  mapa = mmap(NULL, estado.st_size, PROT_READ, MAP_PRIVATE, descritor, 0);
+  close(descritor);
+  if(mapa == MAP_FAILED) return AVALIACAO_FALHA_ABRIRDB;
+  
+  *conteudo = (char *)mapa;
+  *tamanho = (size_t)estado.st_size;
+  /* Pulamos o contador */
+  corte = (const char *)memchr(*conteudo, '\n', *tamanho);
+  *linhas = (corte == NULL) ? *conteudo + *tamanho : corte+1;
+  return AVALIACAO_SUCESSO;
+}
+
+/*!
+ * @fn static int avaliacao_numeroMemoria(const char **p, const char *fim, unsigned int *valor)
+ * @brief Lê um número sem sinal de um trecho na memória, pulando espaços e '\t' antes dele
+ * @return Nulo se não houver número antes de fim ou se ele não couber em um unsigned int
+ *
+ * Deixa *p no primeiro byte depois do número.
+*/
+
+static int avaliacao_numeroMemoria(const char **p, const char *fim, unsigned int *valor){
+  const char *q = *p;
+  uint64_t numero = 0;
+  
+  while(q < fim && (*q == ' ' || *q == '\t')) q++;
+  if(q == fim || *q < '0' || *q > '9') return 0;
+  for(;q < fim && *q >= '0' && *q <= '9';q++)
+    if((numero = numero*10 + (*q - '0')) > UINT_MAX) return 0;
+  
+  *valor = (unsigned int)numero;
+  *p = q;
+  return 1;
+}
+
+/*!
+ * @fn static void *avaliacao_recalcularParte(void *argumento)
+ * @brief Soma as notas recebidas por usuário em um trecho do arquivo de avaliações
+ * @param argumento Parte (avaliacao_parte_recalculo *) com o trecho e os vetores zerados
+ * @return Sempre NULL
+ *
+ * Linhas ilegíveis, com nota acima de 5 ou com avaliado fora do contexto
+ * de usuários são ignoradas, assim como uma linha sem '\n' no fim.
+*/
+
+static void *avaliacao_recalcularParte(void *argumento){
+  avaliacao_parte_recalculo *parte = (avaliacao_parte_recalculo *)argumento;
+  const char *p, *fim;
+  unsigned int avaliador, avaliado, nota;
+  
+  for(p = parte->inicio; p < parte->fim; p = fim + 1) {
+    fim = (const char *)memchr(p, '\n', parte->fim - p);
+    if(fim == NULL) break;
+    if(!avaliacao_numeroMemoria(&p, fim, &avaliador) || !avaliacao_numeroMemoria(&p, fim, &avaliado) || !avaliacao_numeroMemoria(&p, fim, &nota)) continue;
+    if(nota >= AVALIACAO_NOTAS || avaliado >= parte->usuarios) continue;
+    parte->somas[avaliado] += nota;
+    parte->contagens[avaliado]++;
+  }
+  return NULL;
+}
+
+/*!
+ * @fn avaliacao_condRet avaliacao_recalcular_r(avaliacao_contexto *contexto, unsigned int threads, unsigned int *corrigidos)
+ * @brief Refaz a avaliação média e o número de avaliações de todos os usuários a partir do arquivo de avaliações
+ * @param threads Número de threads de leitura, até AVALIACAO_RECALCULO_THREADS_MAX; 0 usa uma por processador
+ * @param corrigidos Recebe o número de usuários cujos campos divergiam e foram corrigidos
+ * @return Instância do tipo avaliacao_condRet que assume:
+ *  - AVALIACAO_FALHA_ABRIRDB se não conseguir ler o arquivo de avaliações ou faltar memória
+ *  - AVALIACAO_FALHA_USUARIOS se não conseguir atualizar um usuário ou gravar o arquivo de usuários
+ *  - AVALIACAO_SUCESSO caso contrário, com todos os usuários de acordo com o arquivo de avaliações
+ *
+ * Conserta avaliacao e n_avaliacao de usuários que se afastaram do
+ * arquivo de avaliações. O arquivo é mapeado na memória e dividido em
+ * trechos alinhados a linhas, somados em paralelo, cada thread no seu
+ * vetor de somas por id; os vetores são juntados no fim. Só os usuários
+ * divergentes são regravados, cada um em uma entrada do log de usuários,
+ * e o log é aplicado no arquivo de usuários uma vez, no fim.
+ *
+ * Rápido o bastante para ser chamado a cada início do programa, como
+ * verificação de consistência.
+ *
+ * Assertivas de entrada:
+ *  - O grafo de usuários foi carregado
+ *  - corrigidos é diferente de NULL
+ *
+ * Assertivas de saída:
+ *  - Para todo usuário, n_avaliacao é o número de avaliações recebidas no arquivo e avaliacao a média das suas notas
+ *  - O arquivo de avaliações não é alterado
+ *
+ * Requisitos:
+ *  - pthread.h, sys/mman.h, usuarios.h
+ *
+ * Hipóteses:
+ *  - Nenhuma avaliação é feita no contexto durante o recálculo
+ */
+
+avaliacao_condRet avaliacao_recalcular_r(avaliacao_contexto *contexto, unsigned int threads, unsigned int *corrigidos) {
+  avaliacao_parte_recalculo partes[AVALIACAO_RECALCULO_THREADS_MAX];
+  pthread_t trabalhadores[AVALIACAO_RECALCULO_THREADS_MAX];
+  int criada[AVALIACAO_RECALCULO_THREADS_MAX];
+  avaliacao_condRet retorno = AVALIACAO_SUCESSO;
+  unsigned int usuarios, n, i, identificador, contagem;
+  const char *p, *fim, *corte;
+  char *conteudo;
+  size_t tamanho;
+  long processadores;
+  double media, registrada;
+  
+  *corrigidos = 0;
+  /* Sem arquivo ninguém recebeu avaliações */
+  if(avaliacao_mapear(contexto, &conteudo, &tamanho, &p) != AVALIACAO_SUCESSO) return AVALIACAO_FALHA_ABRIRDB;
+  fim = conteudo + tamanho;
+  
+  n = threads;
+  if(n == 0) {
+    processadores = sysconf(_SC_NPROCESSORS_ONLN);
+    n = (processadores > 0) ? (unsigned int)processadores : 1;
+  }
+  if(n > AVALIACAO_RECALCULO_THREADS_MAX) n = AVALIACAO_RECALCULO_THREADS_MAX;
+  /* Não vale criar threads para trechos pequenos */
+  if((size_t)(fim - p)/n < 64*1024) n = (unsigned int)((fim - p)/(64*1024)) + 1;
+  
+  usuarios = (unsigned int)usuarios_max_r(contexto->usuarios) + 1;
+  memset(partes, 0, sizeof(partes));
+  for(i=0;i<n;i++) {
+    partes[i].usuarios = usuarios;
+    partes[i].somas = (uint64_t *)calloc(usuarios, sizeof(uint64_t));
+    partes[i].contagens = (uint32_t *)calloc(usuarios, sizeof(uint32_t));
+    if(partes[i].somas == NULL || partes[i].contagens == NULL) retorno = AVALIACAO_FALHA_ABRIRDB;
+    
+    partes[i].inicio = p;
+    if(i == n-1) corte = fim;
+    else {
+      corte = p + (fim - p)/(n - i);
+      corte = (const char *)memchr(corte, '\n', fim - corte);
+      corte = (corte == NULL) ? fim : corte+1;
+    }
+    partes[i].fim = corte;
+    p = corte;
+  }
+  
+  if(retorno == AVALIACAO_SUCESSO) {
+    /* Uma thread que não puder ser criada tem sua parte somada pela thread chamadora */
+    for(i=1;i<n;i++) criada[i] = pthread_create(&trabalhadores[i], NULL, avaliacao_recalcularParte, &partes[i]) == 0;
+    avaliacao_recalcularParte(&partes[0]);
+    for(i=1;i<n;i++) {
+      if(criada[i]) pthread_join(trabalhadores[i], NULL);
+      else avaliacao_recalcularParte(&partes[i]);
+    }
+    
+    for(i=1;i<n;i++)
+      for(identificador=0;identificador<usuarios;identificador++) {
+        partes[0].somas[identificador] += partes[i].somas[identificador];
+        partes[0].contagens[identificador] += partes[i].contagens[identificador];
+      }
+    
+    for(identificador=1;identificador<usuarios && retorno == AVALIACAO_SUCESSO;identificador++) {
+      /* Ids sem usuário no grafo são pulados */
+      if(usuarios_campoInteiro_r(contexto->usuarios, identificador, USUARIOS_CAMPO_N_AVALIACAO, &contagem) != USUARIOS_SUCESSO) continue;
+      if(usuarios_campoReal_r(contexto->usuarios, identificador, USUARIOS_CAMPO_AVALIACAO, &registrada) != USUARIOS_SUCESSO) continue;
+      
+      media = partes[0].contagens[identificador] ? (double)partes[0].somas[identificador]/partes[0].contagens[identificador] : 0;
+      /* O arquivo de usuários guarda a média com seis casas decimais */
+      if(contagem == partes[0].contagens[identificador] && fabs(media - registrada) <= 1e-6) continue;
+      
+      if(usuarios_atualizarAvaliacao_r(contexto->usuarios, identificador, media, partes[0].contagens[identificador]) != USUARIOS_SUCESSO) retorno = AVALIACAO_FALHA_USUARIOS;
+      else (*corrigidos)++;
+    }
+    
+    if(*corrigidos && usuarios_sincronizar_r(contexto->usuarios) != USUARIOS_SUCESSO) retorno = AVALIACAO_FALHA_USUARIOS;
+  }
+  
+  for(i=0;i<n;i++) {
+    free(partes[i].somas);
+    free(partes[i].contagens);
+  }
+  if(conteudo != NULL) munmap(conteudo, tamanho);
+  return retorno;
+}
+
+/*!
+ * @fn static int avaliacao_idComparar(const void *a, const void *b)
+ * @brief Ordem crescente de ids, para qsort
+*/
+
+static int avaliacao_idComparar(const void *a, const void *b){
+  unsigned int x = *(const unsigned int *)a, y = *(const unsigned int *)b;
+  return (x > y) - (x < y);
+}
+
+/*!
+ * @fn static void avaliacao_grafoNotasLimpar(avaliacao_grafo_notas *grafo)
+ * @brief Libera as listas de adjacência do grafo das notas altas
+*/
+
+static void avaliacao_grafoNotasLimpar(avaliacao_grafo_notas *grafo){
+  free(grafo->inicio);
+  free(grafo->destinos);
+  free(grafo->pesos);
+  memset(grafo, 0, sizeof(avaliacao_grafo_notas));
+}
+
+/*!
+ * @fn static avaliacao_condRet avaliacao_grafoNotasMontar(avaliacao_contexto *contexto, unsigned int notaMinima, avaliacao_grafo_notas *grafo)
+ * @brief Monta o grafo das avaliações com nota de pelo menos notaMinima, lendo o arquivo de avaliações uma vez
+ * @return Instância avaliacao_condRet que assume:
+ *  - AVALIACAO_FALHA_ABRIRDB se não conseguir ler o arquivo ou faltar memória, o grafo fica vazio;
+ *  - AVALIACAO_SUCESSO caso contrário.
+ *
+ * As arestas são lidas para um vetor e distribuídas por avaliador com
+ * uma contagem (counting sort); cada lista é então ordenada e as
+ * repetições viram peso. Autoavaliações são ignoradas.
+*/
+
+static avaliacao_condRet avaliacao_grafoNotasMontar(avaliacao_contexto *contexto, unsigned int notaMinima, avaliacao_grafo_notas *grafo){
+  uint32_t (*arestas)[2] = NULL, (*novas)[2];
+  unsigned int avaliador, avaliado, nota, v, j, k, anterior, final;
+  size_t n = 0, capacidade = 0, i, tamanho;
+  const char *p, *fim, *linha;
+  char *conteudo;
+  
+  memset(grafo, 0, sizeof(avaliacao_grafo_notas));
+  if(avaliacao_mapear(contexto, &conteudo, &tamanho, &p) != AVALIACAO_SUCESSO) return AVALIACAO_FALHA_ABRIRDB;
+  
+  for(fim = conteudo + tamanho; p < fim; p = linha + 1) {
+    linha = (const char *)memchr(p, '\n', fim - p);
+    if(linha == NULL) break;
+    if(!avaliacao_numeroMemoria(&p, linha, &avaliador) || !avaliacao_numeroMemoria(&p, linha, &avaliado) || !avaliacao_numeroMemoria(&p, linha, &nota)) continue;
+    if(avaliador == UINT_MAX || avaliado == UINT_MAX) continue;
+    if(avaliador >= grafo->usuarios) grafo->usuarios = avaliador + 1;
+    if(avaliado >= grafo->usuarios) grafo->usuarios = avaliado + 1;
+    if(nota < notaMinima || nota >= AVALIACAO_NOTAS || avaliador == avaliado) continue;
+    
+    if(n == capacidade) {
+      capacidade = capacidade ? 2*capacidade : 1024;
+      novas = (uint32_t (*)[2])realloc(arestas, capacidade*sizeof(*arestas));
+      if(novas == NULL) {
+        free(arestas);
+        munmap(conteudo, tamanho);
+        grafo->usuarios = 0;
+        return AVALIACAO_FALHA_ABRIRDB;
+      }
+      arestas = novas;
+    }
+    arestas[n][0] = avaliador;
+    arestas[n][1] = avaliado;
+    n++;
+  }
+  if(conteudo != NULL) munmap(conteudo, tamanho);
+  
+  grafo->inicio = (unsigned int *)calloc((size_t)grafo->usuarios + 1, sizeof(unsigned int));
+  grafo->destinos = (unsigned int *)malloc((n ? n : 1)*sizeof(unsigned int));
+  grafo->pesos = (unsigned int *)malloc((n ? n : 1)*sizeof(unsigned int));
+  if(grafo->inicio == NULL || grafo->destinos == NULL || grafo->pesos == NULL) {
+    free(arestas);
+    avaliacao_grafoNotasLimpar(grafo);
+    return AVALIACAO_FALHA_ABRIRDB;
+  }
+  
+  /* Contagem por avaliador: depois de distribuir, inicio[v] é o fim de v e é deslocado uma posição */
+  for(i=0;i<n;i++) grafo->inicio[arestas[i][0] + 1]++;
+  for(v=0;v<grafo->usuarios;v++) grafo->inicio[v+1] += grafo->inicio[v];
+  for(i=0;i<n;i++) grafo->destinos[grafo->inicio[arestas[i][0]]++] = arestas[i][1];
+  for(v=grafo->usuarios;v>0;v--) grafo->inicio[v] = grafo->inicio[v-1];
+  grafo->inicio[0] = 0;
+  free(arestas);
+  
+  /* Ordenamos cada lista e juntamos as repetições, compactando no lugar */
+  for(v=0, k=0, anterior=0;v<grafo->usuarios;v++) {
+    final = grafo->inicio[v+1];
+    qsort(grafo->destinos + anterior, final - anterior, sizeof(unsigned int), avaliacao_idComparar);
+    grafo->inicio[v] = k;
+    for(j=anterior;j<final;j++) {
+      if(k > grafo->inicio[v] && grafo->destinos[k-1] == grafo->destinos[j]) grafo->pesos[k-1]++;
+      else {
+        grafo->destinos[k] = grafo->destinos[j];
+        grafo->pesos[k++] = 1;
+      }
+    }
+    anterior = final;
+  }
+  grafo->inicio[grafo->usuarios] = k;
+  return AVALIACAO_SUCESSO;
+}
+
+/*!
+ * @fn static int avaliacao_grafoNotasAresta(const avaliacao_grafo_notas *grafo, unsigned int origem, unsigned int destino)
+ * @brief Verifica por busca binária se origem avaliou destino com nota alta
+ * @return Não nulo se a aresta existir
+*/
+
+static int avaliacao_grafoNotasAresta(const avaliacao_grafo_notas *grafo, unsigned int origem, unsigned int destino){
+  return bsearch(&destino, grafo->destinos + grafo->inicio[origem], grafo->inicio[origem+1] - grafo->inicio[origem], sizeof(unsigned int), avaliacao_idComparar) != NULL;
+}
+
+/*!
+ * @fn static unsigned int avaliacao_grafoNotasComponentes(const avaliacao_grafo_notas *grafo, unsigned int *componente)
+ * @brief Separa o grafo das notas altas em componentes fortemente conexos (Tarjan), em tempo linear
+ * @param componente Recebe o componente de cada vértice, UINT_MAX para vértices sem aresta
+ * @return Número de componentes, UINT_MAX se faltar memória
+ *
+ * A recursão do algoritmo de Tarjan é feita com uma pilha explícita de
+ * chamadas, assim grafos grandes não estouram a pilha do programa. Um
+ * vértice está na pilha de Tarjan enquanto foi visitado e ainda não tem
+ * componente.
+*/
+
+static unsigned int avaliacao_grafoNotasComponentes(const avaliacao_grafo_notas *grafo, unsigned int *componente){
+  unsigned int *memoria, *indice, *baixo, *pilha, *chamadas, *proxima;
+  unsigned int topo = 0, profundidade, contador = 0, componentes = 0, raiz, v, w, u;
+  
+  memoria = (unsigned int *)malloc(5*(size_t)grafo->usuarios*sizeof(unsigned int));
+  if(memoria == NULL) return UINT_MAX;
+  indice = memoria;
+  baixo = indice + grafo->usuarios;
+  pilha = baixo + grafo->usuarios;
+  chamadas = pilha + grafo->usuarios;
+  proxima = chamadas + grafo->usuarios;
+  for(v=0;v<grafo->usuarios;v++) indice[v] = componente[v] = UINT_MAX;
+  
+  for(raiz=0;raiz<grafo->usuarios;raiz++) {
+    /* Vértices sem arestas de saída nunca estão em um ciclo */
+    if(indice[raiz] != UINT_MAX || grafo->inicio[raiz] == grafo->inicio[raiz+1]) continue;
+    
+    indice[raiz] = baixo[raiz] = contador++;
+    pilha[topo++] = raiz;
+    proxima[raiz] = grafo->inicio[raiz];
+    chamadas[0] = raiz;
+    profundidade = 1;
+    
+    while(profundidade) {
+      v = chamadas[profundidade-1];
+      if(proxima[v] < grafo->inicio[v+1]) {
+        w = grafo->destinos[proxima[v]++];
+        if(indice[w] == UINT_MAX) {
+          indice[w] = baixo[w] = contador++;
+          pilha[topo++] = w;
+          proxima[w] = grafo->inicio[w];
+          chamadas[profundidade++] = w;
+        }
+        else if(componente[w] == UINT_MAX && indice[w] < baixo[v]) baixo[v] = indice[w];
+        continue;
+      }
+      
+      /* Todas as arestas de v foram vistas: retornamos da chamada */
+      profundidade--;
+      if(baixo[v] == indice[v]) {
+        do {
+          w = pilha[--topo];
+          componente[w] = componentes;
+        } while(w != v);
+        componentes++;
+      }
+      if(profundidade) {
+        u = chamadas[profundidade-1];
+        if(baixo[v] < baixo[u]) baixo[u] = baixo[v];
+      }
+    }
+  }
+  
+  free(memoria);
+  return componentes;
+}
+
+/*!
+ * @fn static int avaliacao_grupoComparar(const void *a, const void *b)
+ * @brief Ordena os grupos do mais denso para o menos, os empatados do maior para o menor e então pelo menor membro
+*/
+
+static int avaliacao_grupoComparar(const void *a, const void *b){
+  const avaliacao_grupo *x = (const avaliacao_grupo *)a, *y = (const avaliacao_grupo *)b;
+  if(x->densidade != y->densidade) return (x->densidade < y->densidade) ? 1 : -1;
+  if(x->n != y->n) return (x->n < y->n) ? 1 : -1;
+  return avaliacao_idComparar(x->membros, y->membros);
+}
+
+/*!
+ * @fn static avaliacao_condRet avaliacao_conluioPreencher(const avaliacao_grafo_notas *grafo, const unsigned int *componente, unsigned int componentes, unsigned int tamanhoMinimo, double densidadeMinima, avaliacao_conluio *retorno)
+ * @brief Mede os componentes fortemente conexos e copia os suspeitos para retorno
+ * @return AVALIACAO_FALHA_ABRIRDB se faltar memória, AVALIACAO_SUCESSO caso contrário
+*/
+
+static avaliacao_condRet avaliacao_conluioPreencher(const avaliacao_grafo_notas *grafo, const unsigned int *componente, unsigned int componentes, unsigned int tamanhoMinimo, double densidadeMinima, avaliacao_conluio *retorno){
+  avaliacao_grupo *grupo;
+  unsigned int *memoria, *tamanhos, *arestas, *reciprocas, *avaliacoes, *posicao;
+  unsigned int c, v, w, j, g, membros = 0;
+  
+  memoria = (unsigned int *)calloc(5*(size_t)componentes + 1, sizeof(unsigned int));
+  if(memoria == NULL) return AVALIACAO_FALHA_ABRIRDB;
+  tamanhos = memoria;
+  arestas = tamanhos + componentes;
+  reciprocas = arestas + componentes;
+  avaliacoes = reciprocas + componentes;
+  posicao = avaliacoes + componentes;
+  
+  for(v=0;v<grafo->usuarios;v++) if(componente[v] != UINT_MAX) tamanhos[componente[v]]++;
+  
+  /* Arestas internas dos componentes grandes o bastante; a recíproca é contada uma vez por par */
+  for(v=0;v<grafo->usuarios;v++) {
+    c = componente[v];
+    if(c == UINT_MAX || tamanhos[c] < tamanhoMinimo) continue;
+    for(j=grafo->inicio[v];j<grafo->inicio[v+1];j++) {
+      w = grafo->destinos[j];
+      if(componente[w] != c) continue;
+      arestas[c]++;
+      avaliacoes[c] += grafo->pesos[j];
+      if(v < w && avaliacao_grafoNotasAresta(grafo, w, v)) reciprocas[c]++;
+    }
+  }
+  
+  for(c=0;c<componentes;c++) {
+    posicao[c] = UINT_MAX;
+    if(tamanhos[c] < tamanhoMinimo) continue;
+    if((double)arestas[c]/((double)tamanhos[c]*(tamanhos[c]-1)) < densidadeMinima) continue;
+    posicao[c] = retorno->n++;
+    membros += tamanhos[c];
+  }
+  
+  retorno->grupos = (avaliacao_grupo *)malloc((retorno->n ? retorno->n : 1)*sizeof(avaliacao_grupo));
+  retorno->membros = (unsigned int *)malloc((membros ? membros : 1)*sizeof(unsigned int));
+  if(retorno->grupos == NULL || retorno->membros == NULL) {
+    free(memoria);
+    return AVALIACAO_FALHA_ABRIRDB;
+  }
+  
+  for(c=0, membros=0;c<componentes;c++) {
+    if(posicao[c] == UINT_MAX) continue;
+    grupo = &retorno->grupos[posicao[c]];
+    grupo->membros = retorno->membros + membros;
+    grupo->n = 0;
+    grupo->arestas = arestas[c];
+    grupo->reciprocas = reciprocas[c];
+    grupo->avaliacoes = avaliacoes[c];
+    grupo->densidade = (double)arestas[c]/((double)tamanhos[c]*(tamanhos[c]-1));
+    membros += tamanhos[c];
+  }
+  /* Percorrer os ids em ordem deixa os membros de cada grupo ordenados */
+  for(v=0;v<grafo->usuarios;v++) {
+    if(componente[v] == UINT_MAX || posicao[componente[v]] == UINT_MAX) continue;
+    grupo = &retorno->grupos[posicao[componente[v]]];
+    grupo->membros[grupo->n++] = v;
+  }
+  free(memoria);
+  
+  qsort(retorno->grupos, retorno->n, sizeof(avaliacao_grupo), avaliacao_grupoComparar);
+  for(g=0;g<retorno->n;g++)
+    for(j=0;j<retorno->grupos[g].n;j++) retorno->grupo[retorno->grupos[g].membros[j]] = g;
+  return AVALIACAO_SUCESSO;
+}
+
+/*!
+ * @fn avaliacao_condRet avaliacao_detectarConluio_r(avaliacao_contexto *contexto, unsigned int notaMinima, unsigned int tamanhoMinimo, double densidadeMinima, avaliacao_conluio *retorno)
+ * @brief Procura grupos de usuários que inflam as notas uns dos outros
+ * @param notaMinima Menor nota considerada alta, as demais avaliações são ignoradas
+ * @param tamanhoMinimo Menor grupo suspeito; valores abaixo de 2 valem 2
+ * @param densidadeMinima Menor densidade de um grupo suspeito, entre 0 e 1
+ * @param retorno Recebe os grupos suspeitos; liberar com avaliacao_conluioLimpar
+ * @return Instância do tipo avaliacao_condRet que assume:
+ *  - AVALIACAO_FALHA_ABRIRDB se não conseguir ler o arquivo de avaliações ou faltar memória
+ *  - AVALIACAO_SUCESSO caso contrário, com retorno vazio se não houver grupo suspeito
+ *
+ * Monta o grafo dirigido das avaliações com nota alta, com peso igual ao
+ * número delas entre o mesmo par, e o separa em componentes fortemente
+ * conexos em tempo linear. Cada componente de pelo menos tamanhoMinimo
+ * usuários recebe a densidade, a fração dos pares ordenados de membros
+ * em que um avaliou o outro; os de densidade de pelo menos
+ * densidadeMinima são suspeitos e seus membros são marcados em
+ * retorno->grupo.
+ *
+ * Como FinishTransaction faz as duas partes se avaliarem, todo par que
+ * negociou com notas altas é um componente de 2 usuários: tamanhoMinimo
+ * de 3 ou mais evita apontar transações comuns.
+ *
+ * Assertivas de entrada:
+ *  - retorno é diferente de NULL
+ *
+ * Assertivas de saída:
+ *  - Todo membro de um grupo alcança os outros por avaliações de nota alta dentro do grupo
+ *  - O arquivo de avaliações não é alterado
+ *
+ * Requisitos:
+ *  - stdlib.h, sys/mman.h
+ *
+ * Hipóteses:
+ *  - Nenhuma
+ */
+
+avaliacao_condRet avaliacao_detectarConluio_r(avaliacao_contexto *contexto, unsigned int notaMinima, unsigned int tamanhoMinimo, double densidadeMinima, avaliacao_conluio *retorno) {
+  avaliacao_grafo_notas grafo;
+  avaliacao_condRet resultado = AVALIACAO_FALHA_ABRIRDB;
+  unsigned int *componente, componentes, v;
+  
+  memset(retorno, 0, sizeof(avaliacao_conluio));
+  if(tamanhoMinimo < 2) tamanhoMinimo = 2;
+  if(avaliacao_grafoNotasMontar(contexto, notaMinima, &grafo) != AVALIACAO_SUCESSO) return AVALIACAO_FALHA_ABRIRDB;
+  
+  retorno->usuarios = grafo.usuarios;
+  retorno->grupo = (unsigned int *)malloc((grafo.usuarios ? grafo.usuarios : 1)*sizeof(unsigned int));
+  componente = (unsigned int *)malloc((grafo.usuarios ? grafo.usuarios : 1)*sizeof(unsigned int));
+  if(retorno->grupo != NULL && componente != NULL) {
+    for(v=0;v<grafo.usuarios;v++) retorno->grupo[v] = UINT_MAX;
+    componentes = avaliacao_grafoNotasComponentes(&grafo, componente);
+    if(componentes != UINT_MAX)
+      resultado = avaliacao_conluioPreencher(&grafo, componente, componentes, tamanhoMinimo, densidadeMinima, retorno);
+  }
+  
+  free(componente);
+  avaliacao_grafoNotasLimpar(&grafo);
+  if(resultado != AVALIACAO_SUCESSO) avaliacao_conluioLimpar(retorno);
+  return resultado;
+}
+
+/*!
+ * @fn avaliacao_condRet avaliacao_conluioLimpar(avaliacao_conluio *conluio)
+ * @brief Libera o resultado de avaliacao_detectarConluio
+ * @return AVALIACAO_SUCESSO
+ *
+ * Assertivas de saída:
+ *  - conluio fica vazio e pode ser usado de novo
+ */
+
+avaliacao_condRet avaliacao_conluioLimpar(avaliacao_conluio *conluio) {
+  free(conluio->grupos);
+  free(conluio->membros);
+  free(conluio->grupo);
+  memset(conluio, 0, sizeof(avaliacao_conluio));
+  return AVALIACAO_SUCESSO;
+}
+
+/*!
+ * @fn static int avaliacao_leitorAvancar(avaliacao_leitor_lista *leitor, unsigned int alvo)
+ * @brief Avança pela lista comprimida até o primeiro id de pelo menos alvo
+ * @return Nulo se a lista acabou antes
+*/
+
+static int avaliacao_leitorAvancar(avaliacao_leitor_lista *leitor, unsigned int alvo){
+  unsigned int diferenca, deslocamento;
+  unsigned char byte;
+  
+  while(leitor->atual < alvo) {
+    if(leitor->p >= leitor->fim) return 0;
+    diferenca = 0;
+    deslocamento = 0;
+    do {
+      byte = *leitor->p++;
+      diferenca |= (unsigned int)(byte & 0x7F) << deslocamento;
+      deslocamento += 7;
+    } while((byte & 0x80) && leitor->p < leitor->fim);
+    leitor->atual += diferenca;
+  }
+  return 1;
+}
+
+/*!
+ * @fn avaliacao_condRet avaliacao_buscar_r(avaliacao_contexto *contexto, const char *consulta, avaliacao_operador operador, unsigned int aPartirDe, avaliacao *pagina, unsigned int tamanho, unsigned int *lidas)
+ * @brief Busca as avaliações cujo comentário tem as palavras da consulta, em páginas por id
+ * @param consulta Palavras procuradas, separadas por espaços ou pontuação; caixa e acentos não importam
+ * @param operador AVALIACAO_BUSCA_E para avaliações com todas as palavras, AVALIACAO_BUSCA_OU para as com alguma
+ * @param aPartirDe Só são retornadas avaliações de id maior; 0 para a primeira página, o id da última lida para as seguintes
+ * @param pagina Vetor já alocado com tamanho posições, recebe as avaliações com identificador preenchido
+ * @param lidas Recebe o número de avaliações copiadas para pagina
+ * @return Instância do tipo avaliacao_condRet que assume:
+ *  - AVALIACAO_VALORINVALIDO se tamanho for 0 ou a consulta não tiver palavras ou tiver mais de AVALIACAO_BUSCA_LIMITE_CONSULTA
+ *  - AVALIACAO_FALHA_ABRIRDB se não conseguir ler o arquivo de avaliações ou faltar memória para o índice
+ *  - AVALIACAO_NAO_ENCONTRADO se não houver avaliação com id maior que aPartirDe
+ *  - AVALIACAO_SUCESSO se copiou ao menos uma avaliação
  *
- * Assertivas de entrada:
- *  - n é diferente de 0 e há pelo menos n avaliações referentes ao usuário identificado com o tipo passado
- *  - retorno já está alocado
+ * O id de uma avaliação é a sua linha no arquivo, a primeira depois do
+ * contador é a 1. As palavras dos comentários ficam em um índice
+ * invertido na memória (avaliacao_busca), montado na primeira busca e
+ * completado com as linhas gravadas desde a anterior: cada palavra tem a
+ * lista comprimida dos ids em que aparece, e a busca percorre só as
+ * listas das palavras da consulta, lendo do arquivo apenas as linhas da
+ * página.
  *
- * Assertivas de saída
- *  - retorno conterá n-ésima a avaliação
- *  - O arquivo de dados não é alterado
+ * @code
+ * avaliacao pagina[16];
+ * unsigned int lidas, ultima = 0, i;
+ * while(avaliacao_buscar("entrega atrasada", AVALIACAO_BUSCA_E, ultima, pagina, 16, &lidas) == AVALIACAO_SUCESSO) {
+ *   for(i=0;i<lidas;i++) printf("%u %s\n", pagina[i].identificador, pagina[i].comentario);
+ *   ultima = pagina[lidas-1].identificador;
+ * }
+ * @endcode
  *
- * Assertivas estruturais:
- *  - Nenhuma
+ * Assertivas de entrada:
+ *  - consulta, pagina e lidas são diferentes de NULL
  *
- * Assertivas de contrato:
- *  - Se as condições forem satisfeitas o retorno terá a n-ésima avaliação
+ * Assertivas de saída:
+ *  - pagina tem as avaliações em ordem crescente de id
+ *  - O arquivo de avaliações não é alterado
  *
  * Requisitos:
- *  - stdio.h, usuarios.h
+ *  - stdio.h, unistd.h
  *
  * Hipóteses:
- *  - Há memória alocada para o retorno
+ *  - As avaliações são acrescentadas ao fim do arquivo
  */
- 
-avaliacao_condRet avaliacao_obterAvaliacao(unsigned int identificador, unsigned int n, avaliacao_tipo tipo, avaliacao *retorno) {
-  unsigned int i=0;
-  FILE *db_avaliacao;
+
+avaliacao_condRet avaliacao_buscar_r(avaliacao_contexto *contexto, const char *consulta, avaliacao_operador operador, unsigned int aPartirDe, avaliacao *pagina, unsigned int tamanho, unsigned int *lidas) {
+  avaliacao_leitor_lista leitores[AVALIACAO_BUSCA_LIMITE_CONSULTA];
+  avaliacao_busca *busca = &contexto->busca;
+  char termo[AVALIACAO_BUSCA_LIMITE_TERMO];
+  const char *p = consulta, *fim = consulta + strlen(consulta);
+  unsigned int termos = 0, n = 0, i, alvo, candidato;
+  avaliacao_termo *entrada;
+  int descritor, mudou, acabou = 0;
   
-  /* Verificamos se o valor passado é correto */
-  if(n == 0) return AVALIACAO_VALORINVALIDO;
+  *lidas = 0;
+  if(tamanho == 0) return AVALIACAO_VALORINVALIDO;
+  if(avaliacao_buscaAtualizar(contexto) != AVALIACAO_SUCESSO) return AVALIACAO_FALHA_ABRIRDB;
   
-  /* Se avaliador for 0 pegamos a sessão */
-  if(identificador == 0){
-    if(!usuarios_sessaoAberta()) return AVALIACAO_FALHA_SEMSESSAO;
-    if(usuarios_retornaDados(0, "identificador", &identificador) != USUARIOS_SUCESSO) return AVALIACAO_FALHA_USUARIOS;
+  /* Uma lista por palavra presente no índice */
+  while(avaliacao_buscaTermo(&p, fim, termo)) {
+    if(++termos > AVALIACAO_BUSCA_LIMITE_CONSULTA) return AVALIACAO_VALORINVALIDO;
+    if(busca->n == 0) continue;
+    entrada = &busca->termos[avaliacao_buscaPosicao(busca, termo)];
+    if(entrada->termo[0] == '\0') continue;
+    leitores[n].p = entrada->lista;
+    leitores[n].fim = entrada->lista + entrada->tamanho;
+    leitores[n].atual = 0;
+    n++;
   }
+  if(termos == 0) return AVALIACAO_VALORINVALIDO;
+  /* Na busca E basta uma palavra fora do índice para não haver resultado */
+  if(n == 0 || (operador == AVALIACAO_BUSCA_E && n < termos) || aPartirDe >= busca->avaliacoes) return AVALIACAO_NAO_ENCONTRADO;
   
-  db_avaliacao = fopen(AVALIACAO_DB, "r");
-  if(db_avaliacao == NULL) return AVALIACAO_FALHA_ABRIRDB;
-  fseek(db_avaliacao, 5, SEEK_SET);
-  
+  descritor = open(contexto->db, O_RDONLY);
+  if(descritor < 0) return AVALIACAO_FALHA_ABRIRDB;
   
-  /* Buscamos no arquivo */
-  avaliacao *corrente = (avaliacao *)malloc(sizeof(avaliacao));
-  while(!feof(db_avaliacao)){
-    
-    /* Lê-se uma linha de dados */
-    fscanf(db_avaliacao, "%4u\t%4u\t%4u\t%199[^\n]\n", &corrente->avaliador, &corrente->avaliado, &corrente->nota, corrente->comentario);
-    
-    
-    if(tipo == AVALIADO && corrente->avaliado == identificador) i++;
-    else if(tipo == AVALIADOR && corrente->avaliador == identificador) i++;
+  for(alvo = aPartirDe + 1; *lidas < tamanho && !acabou; alvo = candidato + 1) {
+    if(operador == AVALIACAO_BUSCA_E) {
+      /* O candidato sobe até todas as listas pararem no mesmo id */
+      candidato = alvo;
+      do {
+        mudou = 0;
+        for(i=0;i<n && !acabou;i++) {
+          if(!avaliacao_leitorAvancar(&leitores[i], candidato)) acabou = 1;
+          else if(leitores[i].atual > candidato) {
+            candidato = leitores[i].atual;
+            mudou = 1;
+          }
+        }
+      } while(mudou && !acabou);
+    }
+    else {
+      /* O candidato é o menor próximo id das listas que não acabaram */
+      candidato = UINT_MAX;
+      for(i=0;i<n;i++)
+        if(avaliacao_leitorAvancar(&leitores[i], alvo) && leitores[i].atual < candidato) candidato = leitores[i].atual;
+      acabou = (candidato == UINT_MAX);
+    }
+    if(acabou || candidato > busca->avaliacoes) break;
     
-    /* Achamos a n-esima avaliação */
-    if(i == n) {
-      /* Devemos retirar os espaços finais de corrente->comentario */
-      unsigned int j = 198;
-      while(corrente->comentario[j] == ' ' && j) corrente->comentario[j--] = '\0';
-      memcpy(retorno, corrente, sizeof(avaliacao));
-      break;
+    if(avaliacao_lerPosicao(descritor, busca->posicoes[candidato-1], AVALIACAO_CAMPOS_TODOS, &pagina[*lidas]) != AVALIACAO_SUCESSO) {
+      close(descritor);
+      return AVALIACAO_FALHA_ABRIRDB;
     }
+    pagina[(*lidas)++].identificador = candidato;
   }
   
-  free(corrente);
-  fclose(db_avaliacao);
-  
-  if(i == n) return AVALIACAO_SUCESSO;
-  else return AVALIACAO_NAO_ENCONTRADO;
+  close(descritor);
+  return *lidas ? AVALIACAO_SUCESSO : AVALIACAO_NAO_ENCONTRADO;
 }
 
 /*!
- * @fn avaliacao_condRet avaliacao_fazerAvaliacao(avaliacao *dados)
+ * @fn avaliacao_condRet avaliacao_fazerAvaliacao_r(avaliacao_contexto *contexto, avaliacao *dados)
  * @param dados Avaliação de onde sairão os dados a serem gravados em disco
  * @brief Adiciona uma avaliação ao arquivo de dados a partir de do tipo avaliacao
  * @return Instância do tipo avaliacao_condRet que assume:
  *  - AVALIACAO_FALHA_AUTOAVALIACAO se os ids de avaliador e avaliados forem os mesmos
  *  - AVALIACAO_FALHA_NOTAINVALIDA se a nota passada for maior que 5
  *  - AVALIACAO_FALHA_USUARIOS se não conseguir obter os dados no grafo de usuários do avaliado referentes ao número de avaliações e à avaliação. Também retorna esse erro se não conseguir atualizar no grafo de usuários e consequentemente no arquivo de dados dos usuários
- *  - AVALIACAO_FALHA_CRIARDB se não conseguir criar/acessar o banco de dados de avaliações com permissão "a+"
- *  - AVALIACAO_SUCESSO se tiver salvo a avaliação no arquivo de dados com sucesso e atualizado os parâmetros nas configurações do usuário avaliado.
+ *  - AVALIACAO_VALORINVALIDO se a linha da avaliação não couber em AVALIACAO_LINHA_LIMITE
+ *  - AVALIACAO_FALHA_CRIARDB se o buffer de avaliações está cheio e não foi possível gravá-lo no banco de dados de avaliações; a avaliação não é feita e o avaliado volta aos valores anteriores
+ *  - AVALIACAO_SUCESSO se tiver registrado a avaliação para gravação e atualizado os parâmetros nas configurações do usuário avaliado.
+ *
+ * A avaliação é gravada em lote com as demais (ver AVALIACAO_LOTE): fica
+ * em memória até o lote encher, até AVALIACAO_LOTE_INTERVALO_MS
+ * milissegundos depois ou até a próxima consulta ou avaliacao_sincronizar.
  *
  * Modo de uso:
  * @code
@@ -307,11 +2520,12 @@ avaliacao_condRet avaliacao_obterAvaliacao(unsigned int identificador, unsigned
  *  - dados é não nulo
  *  - avaliador e avaliado são distintos
  *  - nota pertence a {0,1,2,3,4,5}
- *  - Programa tem acesso "a+" ao arquivo de dados de avaliações
+ *  - Programa tem acesso "r+" ao arquivo de dados de avaliações ou pode criá-lo
  *  - Módulo de usuários foi carregado com a função usuarios_carregarArquivo
  *
  * Assertivas de saída:
- *  - Os dados da avaliação estarão no arquivo de avaliações
+ *  - Os dados da avaliação estarão no arquivo de avaliações depois da gravação do lote
+ *  - Se dados->tempo era 0, passa a ser o momento da chamada
  *
  * Assertivas estruturais:
  *  - O comentário termina com um '\0'
@@ -327,10 +2541,10 @@ avaliacao_condRet avaliacao_obterAvaliacao(unsigned int identificador, unsigned
  *
  */
  
-avaliacao_condRet avaliacao_fazerAvaliacao(avaliacao *dados) {
-  unsigned int n_avaliacao;
-  double avaliacao;
-  FILE *db_avaliacao;
+avaliacao_condRet avaliacao_fazerAvaliacao_r(avaliacao_contexto *contexto, avaliacao *dados) {
+  avaliacao_condRet retorno;
+  unsigned int n_avaliacao, total;
+  double avaliacao, media;
   
   /* Evitamos autoavaliação */
   if(dados->avaliador == dados->avaliado) return AVALIACAO_FALHA_AUTOAVALIACAO;
@@ -338,32 +2552,36 @@ avaliacao_condRet avaliacao_fazerAvaliacao(avaliacao *dados) {
   /* Verificamos o intervalo da nota */
   if(dados->nota > 5) return AVALIACAO_FALHA_NOTAINVALIDA;
   
-  /* Obtemos os dados iniciais */
-  if(usuarios_retornaDados(dados->avaliado, "n_avaliacao", (void *)&n_avaliacao) != USUARIOS_SUCESSO) return AVALIACAO_FALHA_USUARIOS;
-  if(usuarios_retornaDados(dados->avaliado, "avaliacao", (void *)&avaliacao) != USUARIOS_SUCESSO) return AVALIACAO_FALHA_USUARIOS;
-  
-  /* Calculamos a nova avaliação e atualizamos no grafo de usuários */
-  avaliacao = (double)(n_avaliacao*avaliacao+dados->nota)/(++n_avaliacao);
-  if(usuarios_atualizarDados(dados->avaliado, "n_avaliacao", n_avaliacao) != USUARIOS_SUCESSO) return AVALIACAO_FALHA_USUARIOS;
-  if(usuarios_atualizarDados(dados->avaliado, "avaliacao", avaliacao) != USUARIOS_SUCESSO) return AVALIACAO_FALHA_USUARIOS;
+  /* Sem tempo definido a avaliação é do momento da chamada */
+  if(dados->tempo == 0) dados->tempo = (unsigned int)time(NULL);
   
-  /* Atualizamos o contador de avaliações */
-  avaliacao_atualizarContador();
+  /* Obtemos os dados iniciais */
+  if(usuarios_campoInteiro_r(contexto->usuarios, dados->avaliado, USUARIOS_CAMPO_N_AVALIACAO, &n_avaliacao) != USUARIOS_SUCESSO) return AVALIACAO_FALHA_USUARIOS;
+  if(usuarios_campoReal_r(contexto->usuarios, dados->avaliado, USUARIOS_CAMPO_AVALIACAO, &avaliacao) != USUARIOS_SUCESSO) return AVALIACAO_FALHA_USUARIOS;
   
-  /* Salvamos no banco de dados, cria-se um caso não haja */
-  db_avaliacao = fopen(AVALIACAO_DB, "a+");
-  if(db_avaliacao == NULL) return AVALIACAO_FALHA_CRIARDB;
+  /* Calculamos a nova avaliação e atualizamos no grafo de usuários, os dois campos em um só registro do log */
+  total = n_avaliacao + 1;
+  media = (n_avaliacao*avaliacao + dados->nota)/total;
+  if(usuarios_atualizarAvaliacao_r(contexto->usuarios, dados->avaliado, media, total) != USUARIOS_SUCESSO) return AVALIACAO_FALHA_USUARIOS;
   
-  fprintf(db_avaliacao, AVALIACAO_DB_ESTRUTURA, dados->avaliador, dados->avaliado, dados->nota, dados->comentario);
+  /* A linha e o contador vão ao arquivo no próximo lote; o índice e os histogramas as leem na próxima consulta */
+  retorno = avaliacao_escritorRegistrar(contexto, dados);
   
-  fclose(db_avaliacao);
+  /* Sem a linha a avaliação não foi feita, então a média volta ao que era */
+  if(retorno != AVALIACAO_SUCESSO) {
+    usuarios_atualizarAvaliacao_r(contexto->usuarios, dados->avaliado, avaliacao, n_avaliacao);
+    return retorno;
+  }
   
-  return AVALIACAO_SUCESSO;
+  /* O par entra já, para que avaliacao_jaAvaliou_r veja também as avaliações ainda no buffer */
+  if(retorno == AVALIACAO_SUCESSO && contexto->pares.construido && !avaliacao_paresInserir(&contexto->pares, dados->avaliador, dados->avaliado))
+    avaliacao_paresLimpar(contexto);
+  return retorno;
   
 }
 
 /*!
- * @fn avaliacao_condRet avaliacao_avaliar(unsigned int avaliador, unsigned int avaliado, unsigned int nota, char *comentario)
+ * @fn avaliacao_condRet avaliacao_avaliar_r(avaliacao_contexto *contexto, unsigned int avaliador, unsigned int avaliado, unsigned int nota, char *comentario)
  * @brief Função que cria uma avaliação e já avalia
  * @param avaliador identificador do avaliador, se for 0 usa a sessão (precisa do módulo de usuários carregado)
  * @param avaliado identificador do avaliado
@@ -407,17 +2625,17 @@ avaliacao_condRet avaliacao_fazerAvaliacao(avaliacao *dados) {
  *
  */
  
-avaliacao_condRet avaliacao_avaliar(unsigned int avaliador, unsigned int avaliado, unsigned int nota, char *comentario) {
+avaliacao_condRet avaliacao_avaliar_r(avaliacao_contexto *contexto, unsigned int avaliador, unsigned int avaliado, unsigned int nota, char *comentario) {
   avaliacao *a;
   
   /* Se avaliador for 0 pegamos a sessão */
   if(avaliador == 0){
-    if(!usuarios_sessaoAberta()) return AVALIACAO_FALHA_SEMSESSAO;
-    if(usuarios_retornaDados(0, "identificador", &avaliador) != USUARIOS_SUCESSO) return AVALIACAO_FALHA_USUARIOS;
+    if(!usuarios_sessaoAberta_r(contexto->usuarios)) return AVALIACAO_FALHA_SEMSESSAO;
+    if(usuarios_retornaDados_r(contexto->usuarios, 0, "identificador", &avaliador) != USUARIOS_SUCESSO) return AVALIACAO_FALHA_USUARIOS;
   }
   
   /* Compomos a avaliação */
-  a = avaliacao_iniciar();
+  a = avaliacao_iniciar_r(contexto);
   
   if(avaliacao_definir(a, "avaliador", avaliador) != AVALIACAO_SUCESSO) return AVALIACAO_FALHA_DEFINIR;
   if(avaliacao_definir(a, "avaliado", avaliado) != AVALIACAO_SUCESSO) return AVALIACAO_FALHA_DEFINIR;
@@ -425,8 +2643,498 @@ avaliacao_condRet avaliacao_avaliar(unsigned int avaliador, unsigned int avaliad
   if(avaliacao_definir(a, "comentario", comentario) != AVALIACAO_SUCESSO) return AVALIACAO_FALHA_DEFINIR;
   
   /* Enviamos */
-  if(avaliacao_fazerAvaliacao(a) != AVALIACAO_SUCESSO) return AVALIACAO_FALHA_AVALIAR;
+  if(avaliacao_fazerAvaliacao_r(contexto, a) != AVALIACAO_SUCESSO) return AVALIACAO_FALHA_AVALIAR;
   if(avaliacao_limpar(&a) != AVALIACAO_SUCESSO) return AVALIACAO_FALHA_FREE;
   
   return AVALIACAO_SUCESSO;
 }
+
+/*!
+ * @fn avaliacao_condRet avaliacao_avaliarSessao_r(avaliacao_contexto *contexto, usuarios_token token, unsigned int avaliado, unsigned int nota, char *comentario)
+ * @brief Versão de avaliacao_avaliar em que o avaliador é o usuário de uma sessão por token
+ * @param token Token retornado por usuarios_loginSessao
+ * @param avaliado id do usuário avaliado
+ * @param nota Nota do avaliador ao avaliado, deve pertencer ao conjunto {0,1,2,3,4,5}
+ * @param comentario comentário que não exceda o limite de AVALIACAO_LIMITE_COMENTARIO-1 caracteres
+ * @retorno AVALIACAO_FALHA_SEMSESSAO se o token não for de uma sessão aberta, ou o retorno de avaliacao_avaliar
+ *
+ * A avaliação é feita com a trava de escrita do módulo de usuários, então
+ * pode ser chamada de várias threads ao mesmo tempo que as funções de
+ * sessão por token de usuarios.h.
+ *
+ * Requisitos:
+ *  - usuarios.h
+ */
+
+avaliacao_condRet avaliacao_avaliarSessao_r(avaliacao_contexto *contexto, usuarios_token token, unsigned int avaliado, unsigned int nota, char *comentario) {
+  unsigned int avaliador;
+  avaliacao_condRet resultado;
+  
+  if(usuarios_sessaoIdentificador_r(contexto->usuarios, token, &avaliador) != USUARIOS_SUCESSO) return AVALIACAO_FALHA_SEMSESSAO;
+  
+  usuarios_travarEscrita_r(contexto->usuarios);
+  resultado = avaliacao_avaliar_r(contexto, avaliador, avaliado, nota, comentario);
+  usuarios_destravar_r(contexto->usuarios);
+  
+  return resultado;
+}
+
+/*!
+ * @fn avaliacao_condRet avaliacao_binarioAbrir(avaliacao_binario *binario, const char *registros, const char *comentarios)
+ * @brief Abre para leitura um registro binário de avaliações, mapeando os dois arquivos na memória
+ * @param binario Estrutura já alocada, preenchida pela função
+ * @param registros Arquivo de registros, com o cabeçalho
+ * @param comentarios Pilha de comentários
+ * @return Instância do tipo avaliacao_condRet que assume:
+ *  - AVALIACAO_FALHA_ABRIRDB se não conseguir abrir ou mapear os arquivos, ou se o cabeçalho não for de um registro binário
+ *  - AVALIACAO_SUCESSO caso contrário
+ *
+ * Um registro incompleto no fim do arquivo, ou cujo comentário não está
+ * na pilha, é de uma gravação interrompida e não é contado em binario->n.
+ *
+ * @code
+ * avaliacao_binario b;
+ * avaliacao a;
+ * unsigned int i;
+ * if(avaliacao_binarioAbrir(&b, "avaliacao.txt.reg", "avaliacao.txt.com") == AVALIACAO_SUCESSO) {
+ *   for(i=1;i<=b.n;i++) if(avaliacao_binarioLer(&b, i, &a, NULL) == AVALIACAO_SUCESSO) printf("%u\n", a.nota);
+ *   avaliacao_binarioFechar(&b);
+ * }
+ * @endcode
+ *
+ * Assertivas de entrada:
+ *  - binario é diferente de NULL
+ *
+ * Assertivas de saída:
+ *  - Se retornar AVALIACAO_SUCESSO, binario deve ser fechado com avaliacao_binarioFechar
+ *  - Caso contrário binario está zerado
+ *
+ * Requisitos:
+ *  - fcntl.h, unistd.h, sys/mman.h, sys/stat.h
+ *
+ * Hipóteses:
+ *  - Os arquivos não diminuem enquanto estiverem mapeados
+ */
+
+avaliacao_condRet avaliacao_binarioAbrir(avaliacao_binario *binario, const char *registros, const char *comentarios) {
+  const avaliacao_binario_cabecalho *cabecalho;
+  const avaliacao_registro *ultimo;
+  struct stat estado;
+  size_t posicao;
+  void *mapa;
+  int descritor;
+  
+  memset(binario, 0, sizeof(avaliacao_binario));
+  
+  descritor = open(registros, O_RDONLY);
+  if(descritor < 0) return AVALIACAO_FALHA_ABRIRDB;
+  if(fstat(descritor, &estado) != 0 || estado.st_size < (off_t)sizeof(avaliacao_binario_cabecalho)) {
+    close(descritor);
+    return AVALIACAO_FALHA_ABRIRDB;
+  }
+  mapa = mmap(NULL, estado.st_size, PROT_READ, MAP_SHARED, descritor, 0);
+  close(descritor);
+  if(mapa == MAP_FAILED) return AVALIACAO_FALHA_ABRIRDB;
+  binario->mapa = mapa;
+  binario->tamanho_mapa = estado.st_size;
+  
+  cabecalho = (const avaliacao_binario_cabecalho *)mapa;
+  if(cabecalho->assinatura != AVALIACAO_BINARIO_ASSINATURA || cabecalho->versao != AVALIACAO_BINARIO_VERSAO) {
+    avaliacao_binarioFechar(binario);
+    return AVALIACAO_FALHA_ABRIRDB;
+  }
+  binario->registros = (const avaliacao_registro *)(cabecalho + 1);
+  binario->n = (binario->tamanho_mapa - sizeof(avaliacao_binario_cabecalho))/sizeof(avaliacao_registro);
+  
+  /* A pilha pode estar vazia, e um arquivo vazio não pode ser mapeado */
+  descritor = open(comentarios, O_RDONLY);
+  if(descritor < 0 || fstat(descritor, &estado) != 0) {
+    if(descritor >= 0) close(descritor);
+    avaliacao_binarioFechar(binario);
+    return AVALIACAO_FALHA_ABRIRDB;
+  }
+  if(estado.st_size > 0) {
+    mapa = mmap(NULL, estado.st_size, PROT_READ, MAP_SHARED, descritor, 0);
+    if(mapa == MAP_FAILED) {
+      close(descritor);
+      avaliacao_binarioFechar(binario);
+      return AVALIACAO_FALHA_ABRIRDB;
+    }
+    binario->pilha = (const unsigned char *)mapa;
+    binario->tamanho_pilha = estado.st_size;
+  }
+  close(descritor);
+  
+  /* Ignoramos os últimos registros se os seus comentários não chegaram à pilha */
+  while(binario->n) {
+    ultimo = &binario->registros[binario->n-1];
+    posicao = ultimo->comentario >> AVALIACAO_BINARIO_BITS_NOTA;
+    if(posicao < binario->tamanho_pilha && posicao + 1 + binario->pilha[posicao] <= binario->tamanho_pilha) break;
+    binario->n--;
+  }
+  
+  return AVALIACAO_SUCESSO;
+}
+
+/*!
+ * @fn avaliacao_condRet avaliacao_binarioLer(const avaliacao_binario *binario, unsigned int n, avaliacao *retorno, uint32_t *tempo)
+ * @brief Retorna por referência a n-ésima avaliação de um registro binário aberto
+ * @param tempo Recebe o momento da avaliação em segundos desde 1970, 0 se desconhecido; pode ser NULL
+ * @return Instância do tipo avaliacao_condRet que assume:
+ *  - AVALIACAO_VALORINVALIDO se n for 0
+ *  - AVALIACAO_NAO_ENCONTRADO se houver menos de n avaliações
+ *  - AVALIACAO_FALHA_ABRIRDB se o comentário do registro estiver fora da pilha
+ *  - AVALIACAO_SUCESSO caso contrário
+ *
+ * A leitura é feita direto da memória mapeada: o registro está na
+ * posição n e o comentário na posição que o registro guarda.
+ *
+ * Assertivas de entrada:
+ *  - binario foi aberto por avaliacao_binarioAbrir
+ *  - retorno já está alocado
+ *
+ * Requisitos:
+ *  - string.h
+ *
+ * Hipóteses:
+ *  - Nenhuma
+ */
+
+avaliacao_condRet avaliacao_binarioLer(const avaliacao_binario *binario, unsigned int n, avaliacao *retorno, uint32_t *tempo) {
+  const avaliacao_registro *registro;
+  size_t posicao, tamanho;
+  
+  if(n == 0) return AVALIACAO_VALORINVALIDO;
+  if(n > binario->n) return AVALIACAO_NAO_ENCONTRADO;
+  
+  registro = &binario->registros[n-1];
+  posicao = registro->comentario >> AVALIACAO_BINARIO_BITS_NOTA;
+  if(posicao >= binario->tamanho_pilha) return AVALIACAO_FALHA_ABRIRDB;
+  tamanho = binario->pilha[posicao];
+  if(posicao + 1 + tamanho > binario->tamanho_pilha || tamanho > AVALIACAO_LIMITE_COMENTARIO-1) return AVALIACAO_FALHA_ABRIRDB;
+  
+  retorno->avaliador = registro->avaliador;
+  retorno->avaliado = registro->avaliado;
+  retorno->nota = registro->comentario & ((1u << AVALIACAO_BINARIO_BITS_NOTA) - 1);
+  memcpy(retorno->comentario, binario->pilha + posicao + 1, tamanho);
+  retorno->comentario[tamanho] = '\0';
+  if(tempo != NULL) *tempo = registro->tempo;
+  
+  return AVALIACAO_SUCESSO;
+}
+
+/*!
+ * @fn avaliacao_condRet avaliacao_binarioFechar(avaliacao_binario *binario)
+ * @brief Desfaz os mapeamentos de um registro binário aberto por avaliacao_binarioAbrir
+ * @return AVALIACAO_SUCESSO
+ *
+ * Assertivas de saída:
+ *  - binario está zerado
+ */
+
+avaliacao_condRet avaliacao_binarioFechar(avaliacao_binario *binario) {
+  if(binario->mapa != NULL) munmap(binario->mapa, binario->tamanho_mapa);
+  if(binario->pilha != NULL) munmap((void *)binario->pilha, binario->tamanho_pilha);
+  memset(binario, 0, sizeof(avaliacao_binario));
+  return AVALIACAO_SUCESSO;
+}
+
+/*!
+ * @fn static size_t avaliacao_binarioCompor(avaliacao *dados, uint32_t tempo, size_t posicao, avaliacao_registro *registro, unsigned char *entrada)
+ * @brief Monta o registro e a entrada da pilha de uma avaliação cujo comentário ficará em posicao
+ * @param entrada Recebe o tamanho e o comentário, precisa de AVALIACAO_LIMITE_COMENTARIO bytes
+ * @return Bytes da entrada, 0 se a pilha passaria de AVALIACAO_BINARIO_LIMITE_PILHA
+*/
+
+static size_t avaliacao_binarioCompor(avaliacao *dados, uint32_t tempo, size_t posicao, avaliacao_registro *registro, unsigned char *entrada){
+  size_t tamanho = strnlen(dados->comentario, AVALIACAO_LIMITE_COMENTARIO-1);
+  
+  if(posicao + 1 + tamanho > AVALIACAO_BINARIO_LIMITE_PILHA) return 0;
+  
+  entrada[0] = (unsigned char)tamanho;
+  memcpy(entrada + 1, dados->comentario, tamanho);
+  registro->avaliador = dados->avaliador;
+  registro->avaliado = dados->avaliado;
+  registro->tempo = tempo;
+  registro->comentario = (uint32_t)(posicao << AVALIACAO_BINARIO_BITS_NOTA) | dados->nota;
+  return tamanho + 1;
+}
+
+/*!
+ * @fn avaliacao_condRet avaliacao_binarioAcrescentar(const char *registros, const char *comentarios, avaliacao *dados, uint32_t tempo)
+ * @brief Acrescenta uma avaliação a um registro binário, criando os arquivos se não existirem
+ * @param tempo Momento da avaliação em segundos desde 1970, 0 se desconhecido
+ * @return Instância do tipo avaliacao_condRet que assume:
+ *  - AVALIACAO_FALHA_NOTAINVALIDA se a nota for maior que 5
+ *  - AVALIACAO_FALHA_ABRIRDB se o arquivo de registros existir e não for de um registro binário
+ *  - AVALIACAO_FALHA_CRIARDB se não conseguir criar ou gravar os arquivos, ou se a pilha estiver cheia
+ *  - AVALIACAO_SUCESSO caso contrário
+ *
+ * O comentário vai ao fim da pilha e passa por fsync antes de o registro
+ * ser gravado, assim o registro é o ponto de confirmação: interrompida
+ * antes dele, a gravação deixa só bytes na pilha que nenhum registro usa.
+ * Um registro incompleto no fim do arquivo é sobrescrito.
+ *
+ * Requisitos:
+ *  - fcntl.h, unistd.h, sys/stat.h
+ *
+ * Hipóteses:
+ *  - Não há outra gravação no mesmo registro binário ao mesmo tempo
+ */
+
+avaliacao_condRet avaliacao_binarioAcrescentar(const char *registros, const char *comentarios, avaliacao *dados, uint32_t tempo) {
+  avaliacao_binario_cabecalho cabecalho;
+  unsigned char entrada[AVALIACAO_LIMITE_COMENTARIO];
+  avaliacao_condRet retorno = AVALIACAO_FALHA_CRIARDB;
+  avaliacao_registro registro;
+  struct stat estado;
+  int arquivo_registros, arquivo_pilha;
+  off_t fim;
+  size_t tamanho;
+  
+  if(dados->nota > 5) return AVALIACAO_FALHA_NOTAINVALIDA;
+  
+  arquivo_registros = open(registros, O_RDWR | O_CREAT, 0644);
+  if(arquivo_registros < 0) return AVALIACAO_FALHA_CRIARDB;
+  arquivo_pilha = open(comentarios, O_RDWR | O_CREAT, 0644);
+  if(arquivo_pilha < 0) {
+    close(arquivo_registros);
+    return AVALIACAO_FALHA_CRIARDB;
+  }
+  
+  if(fstat(arquivo_registros, &estado) == 0) {
+    if(estado.st_size < (off_t)sizeof(cabecalho)) {
+      /* Arquivo novo */
+      cabecalho.assinatura = AVALIACAO_BINARIO_ASSINATURA;
+      cabecalho.versao = AVALIACAO_BINARIO_VERSAO;
+      cabecalho.reservado = 0;
+      fim = pwrite(arquivo_registros, &cabecalho, sizeof(cabecalho), 0) == sizeof(cabecalho) ? (off_t)sizeof(cabecalho) : -1;
+    }
+    else if(pread(arquivo_registros, &cabecalho, sizeof(cabecalho), 0) != sizeof(cabecalho) || cabecalho.assinatura != AVALIACAO_BINARIO_ASSINATURA || cabecalho.versao != AVALIACAO_BINARIO_VERSAO) {
+      fim = -1;
+      retorno = AVALIACAO_FALHA_ABRIRDB;
+    }
+    else fim = sizeof(cabecalho) + (estado.st_size - sizeof(cabecalho))/sizeof(avaliacao_registro)*sizeof(avaliacao_registro);
+    
+    if(fim >= 0 && fstat(arquivo_pilha, &estado) == 0) {
+      tamanho = avaliacao_binarioCompor(dados, tempo, estado.st_size, &registro, entrada);
+      if(tamanho &&
+         pwrite(arquivo_pilha, entrada, tamanho, estado.st_size) == (ssize_t)tamanho && fsync(arquivo_pilha) == 0 &&
+         pwrite(arquivo_registros, &registro, sizeof(registro), fim) == sizeof(registro) && fsync(arquivo_registros) == 0)
+        retorno = AVALIACAO_SUCESSO;
+    }
+  }
+  
+  close(arquivo_pilha);
+  close(arquivo_registros);
+  return retorno;
+}
+
+/*!
+ * @fn avaliacao_condRet avaliacao_binarioConverter(const char *texto, const char *registros, const char *comentarios, unsigned int *convertidas)
+ * @brief Converte um arquivo de avaliações em texto (AVALIACAO_DB_ESTRUTURA) para um registro binário
+ * @param texto Arquivo de avaliações em texto, não é alterado
+ * @param registros Arquivo de registros a criar, sobrescrito se existir
+ * @param comentarios Pilha de comentários a criar, sobrescrita se existir
+ * @param convertidas Recebe o número de avaliações convertidas
+ * @return Instância do tipo avaliacao_condRet que assume:
+ *  - AVALIACAO_FALHA_ABRIRDB se não conseguir abrir o arquivo em texto
+ *  - AVALIACAO_FALHA_CRIARDB se não conseguir criar ou gravar o registro binário, ou se a pilha passar de AVALIACAO_BINARIO_LIMITE_PILHA
+ *  - AVALIACAO_SUCESSO caso contrário
+ *
+ * O texto é lido uma vez, na ordem do arquivo, e a ordem das avaliações
+ * é mantida, assim como o momento de cada avaliação; linhas sem tempo
+ * ficam com 0. Os espaços que completam o comentário até
+ * AVALIACAO_LIMITE_COMENTARIO não são copiados. Linhas sem '\n' no fim
+ * ou com nota inválida são ignoradas.
+ *
+ * Assertivas de saída:
+ *  - Os dois arquivos passaram por fsync, a pilha antes dos registros
+ *
+ * Requisitos:
+ *  - stdio.h, unistd.h
+ *
+ * Hipóteses:
+ *  - O arquivo em texto não é alterado durante a conversão; avaliacao_sincronizar já foi chamada
+ */
+
+avaliacao_condRet avaliacao_binarioConverter(const char *texto, const char *registros, const char *comentarios, unsigned int *convertidas) {
+  avaliacao_binario_cabecalho cabecalho = {AVALIACAO_BINARIO_ASSINATURA, AVALIACAO_BINARIO_VERSAO, 0};
+  char linha[AVALIACAO_LIMITE_COMENTARIO + 64], *fim;
+  unsigned char entrada[AVALIACAO_LIMITE_COMENTARIO];
+  FILE *db_avaliacao, *arquivo_registros, *arquivo_pilha;
+  avaliacao_registro registro;
+  avaliacao lida;
+  size_t posicao = 0, tamanho;
+  int falha;
+  
+  *convertidas = 0;
+  db_avaliacao = fopen(texto, "r");
+  if(db_avaliacao == NULL) return AVALIACAO_FALHA_ABRIRDB;
+  arquivo_registros = fopen(registros, "wb");
+  arquivo_pilha = fopen(comentarios, "wb");
+  if(arquivo_registros == NULL || arquivo_pilha == NULL) {
+    if(arquivo_registros != NULL) fclose(arquivo_registros);
+    if(arquivo_pilha != NULL) fclose(arquivo_pilha);
+    fclose(db_avaliacao);
+    return AVALIACAO_FALHA_CRIARDB;
+  }
+  
+  falha = fwrite(&cabecalho, sizeof(cabecalho), 1, arquivo_registros) != 1;
+  /* Pulamos o contador */
+  if(fgets(linha, sizeof(linha), db_avaliacao) == NULL) linha[0] = '\0';
+  
+  while(!falha && fgets(linha, sizeof(linha), db_avaliacao) != NULL) {
+    fim = strchr(linha, '\n');
+    if(fim == NULL) break;
+    *fim = '\0';
+    if(sscanf(linha, "%u\t%u\t%u", &lida.avaliador, &lida.avaliado, &lida.nota) != 3 || lida.nota > 5) continue;
+    avaliacao_interpretarLinha(linha, AVALIACAO_CAMPOS_TODOS, &lida);
+    
+    tamanho = avaliacao_binarioCompor(&lida, lida.tempo, posicao, &registro, entrada);
+    falha = tamanho == 0 || fwrite(entrada, 1, tamanho, arquivo_pilha) != tamanho || fwrite(&registro, sizeof(registro), 1, arquivo_registros) != 1;
+    posicao += tamanho;
+    if(!falha) (*convertidas)++;
+  }
+  
+  falha = falha || fflush(arquivo_pilha) != 0 || fsync(fileno(arquivo_pilha)) != 0;
+  falha = falha || fflush(arquivo_registros) != 0 || fsync(fileno(arquivo_registros)) != 0;
+  fclose(arquivo_pilha);
+  fclose(arquivo_registros);
+  fclose(db_avaliacao);
+  
+  return falha ? AVALIACAO_FALHA_CRIARDB : AVALIACAO_SUCESSO;
+}
+
+/*
+ * Funções no contexto padrão
+ *
+ * Cada função abaixo equivale à versão com sufixo _r chamada com o
+ * contexto padrão, cuja documentação descreve os parâmetros e retornos.
+*/
+
+/*!
+ * @fn avaliacao_condRet avaliacao_pegarContador()
+ * @brief Versão de avaliacao_pegarContador_r no contexto padrão
+*/
+
+avaliacao_condRet avaliacao_pegarContador(){
+  return avaliacao_pegarContador_r(&avaliacao_padrao);
+}
+
+/*!
+ * @fn avaliacao *avaliacao_iniciar()
+ * @brief Versão de avaliacao_iniciar_r no contexto padrão
+*/
+
+avaliacao *avaliacao_iniciar(){
+  return avaliacao_iniciar_r(&avaliacao_padrao);
+}
+
+/*!
+ * @fn avaliacao_condRet avaliacao_obterAvaliacao(unsigned int identificador, unsigned int n, avaliacao_tipo tipo, avaliacao *retorno)
+ * @brief Versão de avaliacao_obterAvaliacao_r no contexto padrão
+*/
+
+avaliacao_condRet avaliacao_obterAvaliacao(unsigned int identificador, unsigned int n, avaliacao_tipo tipo, avaliacao *retorno){
+  return avaliacao_obterAvaliacao_r(&avaliacao_padrao, identificador, n, tipo, retorno);
+}
+
+/*!
+ * @fn avaliacao_condRet avaliacao_fazerAvaliacao(avaliacao *dados)
+ * @brief Versão de avaliacao_fazerAvaliacao_r no contexto padrão
+*/
+
+avaliacao_condRet avaliacao_fazerAvaliacao(avaliacao *dados){
+  return avaliacao_fazerAvaliacao_r(&avaliacao_padrao, dados);
+}
+
+/*!
+ * @fn avaliacao_condRet avaliacao_avaliar(unsigned int avaliador, unsigned int avaliado, unsigned int nota, char *comentario)
+ * @brief Versão de avaliacao_avaliar_r no contexto padrão
+*/
+
+avaliacao_condRet avaliacao_avaliar(unsigned int avaliador, unsigned int avaliado, unsigned int nota, char *comentario){
+  return avaliacao_avaliar_r(&avaliacao_padrao, avaliador, avaliado, nota, comentario);
+}
+
+/*!
+ * @fn avaliacao_condRet avaliacao_avaliarSessao(usuarios_token token, unsigned int avaliado, unsigned int nota, char *comentario)
+ * @brief Versão de avaliacao_avaliarSessao_r no contexto padrão
+*/
+
+avaliacao_condRet avaliacao_avaliarSessao(usuarios_token token, unsigned int avaliado, unsigned int nota, char *comentario){
+  return avaliacao_avaliarSessao_r(&avaliacao_padrao, token, avaliado, nota, comentario);
+}
+
+/*!
+ * @fn avaliacao_condRet avaliacao_cursorAbrir(avaliacao_cursor *cursor, unsigned int identificador, avaliacao_tipo tipo, unsigned int notaMinima, unsigned int notaMaxima, unsigned int campos)
+ * @brief Versão de avaliacao_cursorAbrir_r no contexto padrão
+*/
+
+avaliacao_condRet avaliacao_cursorAbrir(avaliacao_cursor *cursor, unsigned int identificador, avaliacao_tipo tipo, unsigned int notaMinima, unsigned int notaMaxima, unsigned int campos){
+  return avaliacao_cursorAbrir_r(&avaliacao_padrao, cursor, identificador, tipo, notaMinima, notaMaxima, campos);
+}
+
+/*!
+ * @fn avaliacao_condRet avaliacao_obterEstatisticas(unsigned int identificador, avaliacao_estatisticas *retorno)
+ * @brief Versão de avaliacao_obterEstatisticas_r no contexto padrão
+*/
+
+avaliacao_condRet avaliacao_obterEstatisticas(unsigned int identificador, avaliacao_estatisticas *retorno){
+  return avaliacao_obterEstatisticas_r(&avaliacao_padrao, identificador, retorno);
+}
+
+/*!
+ * @fn avaliacao_condRet avaliacao_sincronizar()
+ * @brief Versão de avaliacao_sincronizar_r no contexto padrão
+*/
+
+avaliacao_condRet avaliacao_sincronizar(){
+  return avaliacao_sincronizar_r(&avaliacao_padrao);
+}
+
+/*!
+ * @fn avaliacao_condRet avaliacao_jaAvaliou(unsigned int avaliador, unsigned int avaliado)
+ * @brief Versão de avaliacao_jaAvaliou_r no contexto padrão
+*/
+
+avaliacao_condRet avaliacao_jaAvaliou(unsigned int avaliador, unsigned int avaliado){
+  return avaliacao_jaAvaliou_r(&avaliacao_padrao, avaliador, avaliado);
+}
+
+/*!
+ * @fn avaliacao_condRet avaliacao_recalcular(unsigned int threads, unsigned int *corrigidos)
+ * @brief Versão de avaliacao_recalcular_r no contexto padrão
+*/
+
+avaliacao_condRet avaliacao_recalcular(unsigned int threads, unsigned int *corrigidos){
+  return avaliacao_recalcular_r(&avaliacao_padrao, threads, corrigidos);
+}
+
+/*!
+ * @fn avaliacao_condRet avaliacao_detectarConluio(unsigned int notaMinima, unsigned int tamanhoMinimo, double densidadeMinima, avaliacao_conluio *retorno)
+ * @brief Versão de avaliacao_detectarConluio_r no contexto padrão
+*/
+
+avaliacao_condRet avaliacao_detectarConluio(unsigned int notaMinima, unsigned int tamanhoMinimo, double densidadeMinima, avaliacao_conluio *retorno){
+  return avaliacao_detectarConluio_r(&avaliacao_padrao, notaMinima, tamanhoMinimo, densidadeMinima, retorno);
+}
+
+/*!
+ * @fn avaliacao_condRet avaliacao_buscar(const char *consulta, avaliacao_operador operador, unsigned int aPartirDe, avaliacao *pagina, unsigned int tamanho, unsigned int *lidas)
+ * @brief Versão de avaliacao_buscar_r no contexto padrão
+*/
+
+avaliacao_condRet avaliacao_buscar(const char *consulta, avaliacao_operador operador, unsigned int aPartirDe, avaliacao *pagina, unsigned int tamanho, unsigned int *lidas){
+  return avaliacao_buscar_r(&avaliacao_padrao, consulta, operador, aPartirDe, pagina, tamanho, lidas);
+}
+
+/*!
+ * @fn avaliacao_condRet avaliacao_obterPontuacao(unsigned int identificador, avaliacao_pontuacao *retorno)
+ * @brief Versão de avaliacao_obterPontuacao_r no contexto padrão
+*/
+
+avaliacao_condRet avaliacao_obterPontuacao(unsigned int identificador, avaliacao_pontuacao *retorno){
+  return avaliacao_obterPontuacao_r(&avaliacao_padrao, identificador, retorno);
+}
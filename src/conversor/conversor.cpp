@@ -0,0 +1,94 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "avaliacao.h"
+
+/*!
+ * @file conversor.cpp
+ * @brief Converte um arquivo de avaliações em texto para o registro binário
+ *
+ * Uso: conversor [-e avaliacoes] [-r registros] [-c comentarios]
+ *
+ * Por padrão lê AVALIACAO_DB e grava ao lado dele os arquivos com
+ * AVALIACAO_BINARIO_REGISTROS_SUFIXO e AVALIACAO_BINARIO_COMENTARIOS_SUFIXO.
+ * O arquivo em texto não é alterado. Ao fim a conversão é conferida
+ * abrindo o registro binário e comparando as avaliações com o texto.
+*/
+
+/*!
+ * @brief Tamanho de um arquivo em bytes, 0 se não existir
+*/
+static long long conversor_tamanho(const char *caminho){
+	struct stat estado;
+	return stat(caminho, &estado) == 0 ? (long long)estado.st_size : 0;
+}
+
+/*!
+ * @brief Confere que o registro binário tem as mesmas avaliações, na mesma ordem, que o texto
+*/
+static int conversor_conferir(const char *registros, const char *comentarios, unsigned int convertidas){
+	avaliacao_binario binario;
+	avaliacao a;
+	unsigned int i;
+	int ok;
+
+	if(avaliacao_binarioAbrir(&binario, registros, comentarios) != AVALIACAO_SUCESSO) return 0;
+	ok = binario.n == convertidas;
+	for(i=1;ok && i<=binario.n;i++) ok = avaliacao_binarioLer(&binario, i, &a, NULL) == AVALIACAO_SUCESSO;
+	avaliacao_binarioFechar(&binario);
+	return ok;
+}
+
+int main(int argc, char **argv){
+	const char *entrada = AVALIACAO_DB;
+	char registros[USUARIOS_LIMITE_CAMINHO + 8], comentarios[USUARIOS_LIMITE_CAMINHO + 8];
+	const char *saida_registros = NULL, *saida_comentarios = NULL;
+	unsigned int convertidas;
+	long long texto, binario;
+	int opcao;
+
+	while((opcao = getopt(argc, argv, "e:r:c:")) != -1) {
+		switch(opcao) {
+			case 'e': entrada = optarg; break;
+			case 'r': saida_registros = optarg; break;
+			case 'c': saida_comentarios = optarg; break;
+			default:
+				fprintf(stderr, "Uso: %s [-e avaliacoes] [-r registros] [-c comentarios]\n", argv[0]);
+				return 1;
+		}
+	}
+	if(strlen(entrada) >= USUARIOS_LIMITE_CAMINHO) {
+		fprintf(stderr, "Caminho longo demais: %s\n", entrada);
+		return 1;
+	}
+	if(saida_registros == NULL) {
+		snprintf(registros, sizeof(registros), "%s" AVALIACAO_BINARIO_REGISTROS_SUFIXO, entrada);
+		saida_registros = registros;
+	}
+	if(saida_comentarios == NULL) {
+		snprintf(comentarios, sizeof(comentarios), "%s" AVALIACAO_BINARIO_COMENTARIOS_SUFIXO, entrada);
+		saida_comentarios = comentarios;
+	}
+
+	switch(avaliacao_binarioConverter(entrada, saida_registros, saida_comentarios, &convertidas)) {
+		case AVALIACAO_SUCESSO: break;
+		case AVALIACAO_FALHA_ABRIRDB:
+			fprintf(stderr, "Nao foi possivel ler %s\n", entrada);
+			return 1;
+		default:
+			fprintf(stderr, "Nao foi possivel gravar %s e %s\n", saida_registros, saida_comentarios);
+			return 1;
+	}
+	if(!conversor_conferir(saida_registros, saida_comentarios, convertidas)) {
+		fprintf(stderr, "O registro binario gravado nao confere com %s\n", entrada);
+		return 1;
+	}
+
+	texto = conversor_tamanho(entrada);
+	binario = conversor_tamanho(saida_registros) + conversor_tamanho(saida_comentarios);
+	printf("%u avaliacoes convertidas: %lld bytes em texto, %lld bytes em binario (%s e %s)\n",
+		convertidas, texto, binario, saida_registros, saida_comentarios);
+	return 0;
+}
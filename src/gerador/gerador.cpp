@@ -0,0 +1,384 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+#include "usuarios.h"
+#include "avaliacao.h"
+#include "product.h"
+#include "transaction.h"
+#include "aleatorio.h"
+
+/*!
+ * @file gerador.cpp
+ * @brief Gera um banco sintético (usuários, amizades, avaliações, produtos e transações)
+ *
+ * Uso: gerador [-s semente] [-u usuarios] [-g grau médio] [-a avaliacoes]
+ * [-p produtos] [-t transacoes] [-d diretorio]
+ *
+ * Os arquivos são escritos nos formatos lidos pelos módulos. A mesma
+ * semente e os mesmos parâmetros geram sempre os mesmos arquivos; cada
+ * arquivo tem seu próprio gerador, então mudar a quantidade de um não
+ * muda o conteúdo dos outros.
+ *
+ * Os graus do grafo de amizades seguem uma lei de potência (modelo de
+ * Chung-Lu com pesos de Pareto), como em redes sociais reais.
+ *
+ * Os campos numéricos dos formatos têm largura 4; acima de 9999
+ * identificadores eles crescem, e os arquivos servem para as cargas que
+ * leem por linha (usuarios_carregarArquivo), não para os acessos que
+ * calculam posições a partir do identificador.
+*/
+
+/*!
+ * @brief Expoente da lei de potência dos graus; redes sociais ficam entre 2 e 3
+*/
+#define GERADOR_EXPOENTE 2.5
+
+/*!
+ * @brief Fração das amizades que ficam só pedidas, sem confirmação
+*/
+#define GERADOR_PENDENTES 0.15
+
+/*!
+ * @brief Tamanho do buffer de escrita de cada arquivo
+*/
+#define GERADOR_BUFFER (1 << 20)
+
+/*!
+ * @typedef gerador_parametros
+ * @brief Parâmetros da linha de comando
+*/
+
+typedef struct gerador_parametros {
+	uint64_t semente; /**< Semente de todos os geradores */
+	unsigned int usuarios; /**< Usuários a gerar */
+	unsigned int grau; /**< Grau médio desejado do grafo de amizades */
+	unsigned int avaliacoes; /**< Avaliações a gerar */
+	unsigned int produtos; /**< Produtos a gerar */
+	unsigned int transacoes; /**< Transações a gerar */
+	const char *diretorio; /**< Diretório de saída */
+} gerador_parametros;
+
+/*!
+ * @typedef gerador_nota
+ * @brief Uma avaliação gerada, guardada até os usuários serem escritos
+*/
+
+typedef struct gerador_nota {
+	unsigned int avaliador;
+	unsigned int avaliado;
+	unsigned int nota;
+} gerador_nota;
+
+static const char *gerador_nomes[] = {
+	"Ana", "Bruno", "Carla", "Diego", "Eduarda", "Felipe", "Gabriela", "Heitor",
+	"Isabela", "Joao", "Karina", "Lucas", "Mariana", "Nicolas", "Olivia", "Pedro",
+	"Rafaela", "Samuel", "Tatiana", "Vitor"
+};
+
+static const char *gerador_sobrenomes[] = {
+	"Silva", "Santos", "Oliveira", "Souza", "Lima", "Pereira", "Ferreira", "Costa",
+	"Rodrigues", "Almeida", "Nascimento", "Carvalho", "Araujo", "Ribeiro"
+};
+
+static const char *gerador_itens[] = {
+	"Arroz", "Feijao", "Camisa", "Carro", "Bicicleta", "Celular", "Notebook", "Mesa",
+	"Cadeira", "Livro", "Aula", "Faxina", "Conserto", "Apartamento", "Ferramenta", "Tenis"
+};
+
+static const char *gerador_qualificadores[] = {
+	"azul", "usado", "novo", "grande", "pequeno", "premium", "simples", "importado"
+};
+
+static const char *gerador_comentarios[] = {
+	"Otimo", "Bom", "Regular", "Ruim", "Pessimo", "Entrega rapida", "Recomendo",
+	"Nao recomendo", "Produto conforme anunciado", "Atendimento excelente"
+};
+
+#define GERADOR_TAMANHO(v) (sizeof(v)/sizeof((v)[0]))
+
+/*!
+ * @brief Abre diretorio/nome para escrita, com buffer grande
+*/
+static FILE *gerador_abrir(const gerador_parametros *parametros, const char *nome){
+	char caminho[4096];
+	FILE *arquivo;
+
+	snprintf(caminho, sizeof(caminho), "%s/%s", parametros->diretorio, nome);
+	arquivo = fopen(caminho, "w");
+	if(arquivo == NULL) {
+		perror(caminho);
+		return NULL;
+	}
+	setvbuf(arquivo, NULL, _IOFBF, GERADOR_BUFFER);
+	return arquivo;
+}
+
+/*!
+ * @brief Pesos de Pareto dos usuários, acumulados para sorteio por busca binária
+ * @return Vetor com usuarios+1 posições, acumulado[0] = 0, ou NULL se faltar memória
+ *
+ * O usuário i é sorteado com probabilidade proporcional a
+ * acumulado[i] - acumulado[i-1], então o grau esperado de cada um é
+ * proporcional ao seu peso.
+*/
+static double *gerador_pesos(aleatorio_estado *estado, unsigned int usuarios){
+	double *acumulado = (double *)malloc((usuarios+1)*sizeof(double));
+	double peso, maximo = sqrt((double)usuarios);
+	unsigned int i;
+
+	if(acumulado == NULL) return NULL;
+	acumulado[0] = 0;
+	for(i=1;i<=usuarios;i++) {
+		peso = pow(1.0 - realAleatorio_r(estado), -1.0/(GERADOR_EXPOENTE-1.0));
+		/* Limitamos os pesos para que o grafo continue simples */
+		if(peso > maximo) peso = maximo;
+		acumulado[i] = acumulado[i-1] + peso;
+	}
+	return acumulado;
+}
+
+/*!
+ * @brief Sorteia um usuário com probabilidade proporcional ao peso
+*/
+static unsigned int gerador_sortear(aleatorio_estado *estado, const double *acumulado, unsigned int usuarios){
+	double alvo = realAleatorio_r(estado) * acumulado[usuarios];
+	unsigned int inicio = 1, fim = usuarios, meio;
+
+	while(inicio < fim) {
+		meio = inicio + (fim - inicio)/2;
+		if(acumulado[meio] <= alvo) inicio = meio+1;
+		else fim = meio;
+	}
+	return inicio;
+}
+
+static int gerador_compararPares(const void *a, const void *b){
+	uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+	return (x > y) - (x < y);
+}
+
+/*!
+ * @brief Escreve amigos.txt: pares sem repetição, confirmados nos dois sentidos ou só pedidos
+*/
+static int gerador_amizades(const gerador_parametros *parametros, const double *acumulado){
+	aleatorio_estado estado;
+	uint64_t *pares;
+	size_t m = (size_t)parametros->usuarios*parametros->grau/2, n = 0, i, unicos;
+	unsigned int a, b, identificador = 1;
+	FILE *arquivo;
+
+	if(parametros->usuarios < 2 || m == 0) m = 0;
+	pares = (uint64_t *)malloc((m ? m : 1)*sizeof(uint64_t));
+	if(pares == NULL) return 0;
+	semearAleatorio_r(&estado, parametros->semente + 2);
+
+	for(i=0;i<m;i++) {
+		a = gerador_sortear(&estado, acumulado, parametros->usuarios);
+		b = gerador_sortear(&estado, acumulado, parametros->usuarios);
+		if(a == b) continue;
+		if(a > b) { unsigned int t = a; a = b; b = t; }
+		pares[n++] = ((uint64_t)a << 32) | b;
+	}
+	qsort(pares, n, sizeof(uint64_t), gerador_compararPares);
+	for(i=0, unicos=0;i<n;i++)
+		if(unicos == 0 || pares[unicos-1] != pares[i]) pares[unicos++] = pares[i];
+
+	arquivo = gerador_abrir(parametros, "amigos.txt");
+	if(arquivo == NULL) {
+		free(pares);
+		return 0;
+	}
+	for(i=0;i<unicos;i++) {
+		a = (unsigned int)(pares[i] >> 32);
+		b = (unsigned int)pares[i];
+		if(realAleatorio_r(&estado) < GERADOR_PENDENTES) {
+			/* Só um dos lados pediu */
+			if(numeroAleatorio_r(&estado, 2)) { unsigned int t = a; a = b; b = t; }
+			fprintf(arquivo, "%-4d\t%-4u\t%-4u\n", identificador++, a, b);
+		}
+		else {
+			fprintf(arquivo, "%-4d\t%-4u\t%-4u\n", identificador++, a, b);
+			fprintf(arquivo, "%-4d\t%-4u\t%-4u\n", identificador++, b, a);
+		}
+	}
+	fclose(arquivo);
+	free(pares);
+	printf("amigos.txt: %u registros\n", identificador-1);
+	return 1;
+}
+
+/*!
+ * @brief Sorteia as avaliações e escreve avaliacao.txt
+ *
+ * Usuários de peso maior também recebem mais avaliações. As notas ficam
+ * em notas para que usuarios.txt traga médias coerentes.
+*/
+static int gerador_avaliacoes(const gerador_parametros *parametros, const double *acumulado, gerador_nota *notas){
+	aleatorio_estado estado;
+	unsigned int i;
+	FILE *arquivo;
+
+	semearAleatorio_r(&estado, parametros->semente + 3);
+	arquivo = gerador_abrir(parametros, "avaliacao.txt");
+	if(arquivo == NULL) return 0;
+
+	fprintf(arquivo, "%-4u\n", parametros->avaliacoes);
+	for(i=0;i<parametros->avaliacoes;i++) {
+		notas[i].avaliador = 1 + numeroAleatorio_r(&estado, parametros->usuarios);
+		do notas[i].avaliado = gerador_sortear(&estado, acumulado, parametros->usuarios);
+		while(notas[i].avaliado == notas[i].avaliador && parametros->usuarios > 1);
+		/* Notas altas são mais comuns */
+		notas[i].nota = 5 - (unsigned int)(5*realAleatorio_r(&estado)*realAleatorio_r(&estado));
+		fprintf(arquivo, AVALIACAO_DB_ESTRUTURA, notas[i].avaliador, notas[i].avaliado, notas[i].nota,
+			gerador_comentarios[numeroAleatorio_r(&estado, GERADOR_TAMANHO(gerador_comentarios))]);
+	}
+	fclose(arquivo);
+	printf("avaliacao.txt: %u registros\n", parametros->avaliacoes);
+	return 1;
+}
+
+/*!
+ * @brief Escreve usuarios.txt, com média, número de avaliações e reclamações vindos de notas
+*/
+static int gerador_usuarios(const gerador_parametros *parametros, const gerador_nota *notas){
+	aleatorio_estado estado;
+	unsigned int i, *contagem, *reclamacoes, *soma;
+	char usuario[32], nome[64], email[64], senha[USUARIOS_LIMITE_SENHA], endereco[64];
+	usuarios_tipo_usuario tipo;
+	usuarios_estado_de_usuario situacao;
+	FILE *arquivo;
+
+	contagem = (unsigned int *)calloc(parametros->usuarios+1, sizeof(unsigned int));
+	reclamacoes = (unsigned int *)calloc(parametros->usuarios+1, sizeof(unsigned int));
+	soma = (unsigned int *)calloc(parametros->usuarios+1, sizeof(unsigned int));
+	arquivo = (contagem && reclamacoes && soma) ? gerador_abrir(parametros, "usuarios.txt") : NULL;
+	if(arquivo == NULL) {
+		free(contagem); free(reclamacoes); free(soma);
+		return 0;
+	}
+	for(i=0;i<parametros->avaliacoes;i++) {
+		contagem[notas[i].avaliado]++;
+		soma[notas[i].avaliado] += notas[i].nota;
+		if(notas[i].nota <= 1) reclamacoes[notas[i].avaliado]++;
+	}
+
+	semearAleatorio_r(&estado, parametros->semente + 1);
+	for(i=1;i<=parametros->usuarios;i++) {
+		unsigned int tamanho = 6 + numeroAleatorio_r(&estado, 7), j;
+		for(j=0;j<tamanho;j++) senha[j] = 'a' + numeroAleatorio_r(&estado, 26);
+		senha[tamanho] = '\0';
+		snprintf(usuario, sizeof(usuario), "usuario%u", i);
+		snprintf(email, sizeof(email), "usuario%u@exemplo.com", i);
+		snprintf(nome, sizeof(nome), "%s %s",
+			gerador_nomes[numeroAleatorio_r(&estado, GERADOR_TAMANHO(gerador_nomes))],
+			gerador_sobrenomes[numeroAleatorio_r(&estado, GERADOR_TAMANHO(gerador_sobrenomes))]);
+		snprintf(endereco, sizeof(endereco), "Rua %s %u",
+			gerador_sobrenomes[numeroAleatorio_r(&estado, GERADOR_TAMANHO(gerador_sobrenomes))], 1 + numeroAleatorio_r(&estado, 2000));
+		j = numeroAleatorio_r(&estado, 100);
+		tipo = (j < 70) ? CONSUMIDOR : (j < 99) ? OFERTANTE : ADMINISTRADOR;
+		j = numeroAleatorio_r(&estado, 100);
+		situacao = (j < 95) ? ATIVO : (j < 98) ? INATIVO_EMAIL : INATIVO_TERMOSDEUSO;
+
+		fprintf(arquivo, USUARIOS_DB_ESTRUTURA, i, usuario, nome, email, senha, endereco,
+			(int)numeroAleatorio_r(&estado, 4), (int)tipo, (int)situacao,
+			contagem[i] ? (double)soma[i]/contagem[i] : 0.0, contagem[i], reclamacoes[i]);
+	}
+	fclose(arquivo);
+	free(contagem); free(reclamacoes); free(soma);
+	printf("usuarios.txt: %u registros\n", parametros->usuarios);
+	return 1;
+}
+
+/*!
+ * @brief Sorteia um produto: nome, tipo, preço e popularidade válidos para product.cpp
+*/
+static void gerador_produto(aleatorio_estado *estado, char *nome, size_t limite, int *tipo, double *preco, int *popularidade){
+	snprintf(nome, limite, "%s %s",
+		gerador_itens[numeroAleatorio_r(estado, GERADOR_TAMANHO(gerador_itens))],
+		gerador_qualificadores[numeroAleatorio_r(estado, GERADOR_TAMANHO(gerador_qualificadores))]);
+	*tipo = (int)numeroAleatorio_r(estado, 3);
+	/* Preços log-uniformes entre 1 e 100000 */
+	*preco = floor(pow(10.0, 5*realAleatorio_r(estado))*100)/100;
+	if(*preco < 1) *preco = 1;
+	*popularidade = (int)numeroAleatorio_r(estado, 101);
+}
+
+/*!
+ * @brief Escreve products.txt e transactions.txt
+*/
+static int gerador_produtos(const gerador_parametros *parametros, const double *acumulado){
+	aleatorio_estado estado;
+	char nome[75];
+	int tipo, popularidade;
+	double preco;
+	unsigned int i;
+	FILE *arquivo;
+
+	semearAleatorio_r(&estado, parametros->semente + 4);
+	arquivo = gerador_abrir(parametros, "products.txt");
+	if(arquivo == NULL) return 0;
+	for(i=0;i<parametros->produtos;i++) {
+		gerador_produto(&estado, nome, sizeof(nome), &tipo, &preco, &popularidade);
+		fprintf(arquivo, "%s|%d|%lf|%d\n", nome, tipo, preco, popularidade);
+	}
+	fclose(arquivo);
+	printf("products.txt: %u registros\n", parametros->produtos);
+
+	semearAleatorio_r(&estado, parametros->semente + 5);
+	arquivo = gerador_abrir(parametros, "transactions.txt");
+	if(arquivo == NULL) return 0;
+	for(i=0;i<parametros->transacoes;i++) {
+		gerador_produto(&estado, nome, sizeof(nome), &tipo, &preco, &popularidade);
+		fprintf(arquivo, "%u|%u|%s|%d|%lf|%d|%d\n",
+			gerador_sortear(&estado, acumulado, parametros->usuarios),
+			1 + numeroAleatorio_r(&estado, parametros->usuarios),
+			nome, tipo, preco, popularidade, (int)numeroAleatorio_r(&estado, Error));
+	}
+	fclose(arquivo);
+	printf("transactions.txt: %u registros\n", parametros->transacoes);
+	return 1;
+}
+
+int main(int argc, char **argv){
+	gerador_parametros parametros = {1, 1000000, 10, 1000000, 100000, 1000000, "."};
+	aleatorio_estado estado;
+	gerador_nota *notas;
+	double *acumulado;
+	int opcao, ok;
+
+	while((opcao = getopt(argc, argv, "s:u:g:a:p:t:d:")) != -1) {
+		switch(opcao) {
+			case 's': parametros.semente = strtoull(optarg, NULL, 10); break;
+			case 'u': parametros.usuarios = (unsigned int)strtoul(optarg, NULL, 10); break;
+			case 'g': parametros.grau = (unsigned int)strtoul(optarg, NULL, 10); break;
+			case 'a': parametros.avaliacoes = (unsigned int)strtoul(optarg, NULL, 10); break;
+			case 'p': parametros.produtos = (unsigned int)strtoul(optarg, NULL, 10); break;
+			case 't': parametros.transacoes = (unsigned int)strtoul(optarg, NULL, 10); break;
+			case 'd': parametros.diretorio = optarg; break;
+			default:
+				fprintf(stderr, "Uso: %s [-s semente] [-u usuarios] [-g grau medio] [-a avaliacoes] [-p produtos] [-t transacoes] [-d diretorio]\n", argv[0]);
+				return 1;
+		}
+	}
+	if(parametros.usuarios == 0) {
+		fprintf(stderr, "E preciso gerar ao menos um usuario\n");
+		return 1;
+	}
+
+	semearAleatorio_r(&estado, parametros.semente);
+	acumulado = gerador_pesos(&estado, parametros.usuarios);
+	notas = (gerador_nota *)malloc((parametros.avaliacoes ? parametros.avaliacoes : 1)*sizeof(gerador_nota));
+	ok = acumulado != NULL && notas != NULL;
+	if(!ok) fprintf(stderr, "Memoria insuficiente\n");
+
+	ok = ok && gerador_amizades(&parametros, acumulado);
+	ok = ok && gerador_avaliacoes(&parametros, acumulado, notas);
+	ok = ok && gerador_usuarios(&parametros, notas);
+	ok = ok && gerador_produtos(&parametros, acumulado);
+
+	free(acumulado);
+	free(notas);
+	return ok ? 0 : 1;
+}
@@ -433,6 +433,49 @@ int retorna_valor_aresta(grafo *G, int x, int y)
 	return A->valor;
 }
 
+/*!
+ * @brief Anexa um vértice de valor x ao fim do grafo G sem procurar um vértice igual
+ *
+ * Para cargas em lote, quando o chamador garante que x é único: custa O(1),
+ * enquanto adiciona_vertice percorre o grafo. Retorna o nó criado ou NULL.
+*/
+grafo_no *grafo_anexa_vertice(grafo *G, int x)
+{
+	if(G == NULL) return NULL;
+	if(G->raiz != NULL && G->ultimo == NULL) return NULL;
+	grafo_no *novo = (grafo_no *)calloc(1, sizeof(grafo_no));
+	if(novo == NULL) return NULL;
+	novo->valor = x;
+	
+	if(G->raiz == NULL) G->raiz = (void *)novo;
+	else ((grafo_no *)G->ultimo)->prox_no = (void *)novo;
+	G->ultimo = (void *)novo;
+	return novo;
+}
+
+/*!
+ * @brief Anexa ao nó X um arco de valor v até o nó Y, sem procurar os nós no grafo
+ *
+ * Para cargas em lote, quando o chamador já tem os nós: custa O(1),
+ * enquanto adiciona_aresta e muda_valor_aresta percorrem o grafo.
+*/
+grafo_cte grafo_anexa_aresta(grafo_no *X, grafo_no *Y, int v)
+{
+	if(X == NULL || Y == NULL) return FALHA_VERTICE_NULO;
+	if(X == Y) return FALHA_VERTICES_IGUAIS;
+	if(X->acesso_arco != NULL && X->acesso_ultimo_arco == NULL) return CORROMPIDO;
+	
+	grafo_arco *novo = (grafo_arco *)calloc(1, sizeof(grafo_arco));
+	if(novo == NULL) return FALHA_ALOCAR;
+	novo->valor = v;
+	novo->acesso_adjacente = (void *)Y;
+	
+	if(X->acesso_arco == NULL) X->acesso_arco = novo;
+	else ((grafo_arco *)X->acesso_ultimo_arco)->prox_arco = (void *)novo;
+	X->acesso_ultimo_arco = novo;
+	return SUCESSO;
+}
+
 /*!
  * @brief Muda o valor da aresta que vai de x a y com o valor v
 */
@@ -0,0 +1,72 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include "usuarios.h"
+#include "avaliacao.h"
+
+/*!
+ * @file recalculador.cpp
+ * @brief Refaz a avaliação média e o número de avaliações dos usuários a partir do arquivo de avaliações
+ *
+ * Uso: recalculador [-u usuarios] [-a amigos] [-w log] [-e avaliacoes] [-t threads]
+ *
+ * Por padrão usa USUARIOS_DB, USUARIOS_DB_AMIGOS, USUARIOS_DB_WAL e
+ * AVALIACAO_DB. Só os usuários cujos campos divergem do arquivo de
+ * avaliações são regravados; o arquivo de avaliações não é alterado.
+*/
+
+int main(int argc, char **argv){
+	const char *db = USUARIOS_DB, *db_amigos = USUARIOS_DB_AMIGOS, *db_wal = USUARIOS_DB_WAL, *db_avaliacao = AVALIACAO_DB;
+	usuarios_contexto *usuarios;
+	avaliacao_contexto *avaliacoes;
+	avaliacao_condRet retorno;
+	unsigned int threads = 0, corrigidos;
+	struct timespec inicio, fim;
+	int opcao;
+
+	while((opcao = getopt(argc, argv, "u:a:w:e:t:")) != -1) {
+		switch(opcao) {
+			case 'u': db = optarg; break;
+			case 'a': db_amigos = optarg; break;
+			case 'w': db_wal = optarg; break;
+			case 'e': db_avaliacao = optarg; break;
+			case 't': threads = (unsigned int)strtoul(optarg, NULL, 10); break;
+			default:
+				fprintf(stderr, "Uso: %s [-u usuarios] [-a amigos] [-w log] [-e avaliacoes] [-t threads]\n", argv[0]);
+				return 1;
+		}
+	}
+
+	usuarios = usuarios_contextoCriar(db, db_amigos, db_wal);
+	if(usuarios == NULL || usuarios_carregarArquivo_r(usuarios) != USUARIOS_SUCESSO) {
+		fprintf(stderr, "Nao foi possivel carregar %s\n", db);
+		return 1;
+	}
+	avaliacoes = avaliacao_contextoCriar(usuarios, db_avaliacao);
+	if(avaliacoes == NULL) {
+		fprintf(stderr, "Caminho longo demais: %s\n", db_avaliacao);
+		return 1;
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &inicio);
+	retorno = avaliacao_recalcular_r(avaliacoes, threads, &corrigidos);
+	clock_gettime(CLOCK_MONOTONIC, &fim);
+
+	avaliacao_contextoDestruir(&avaliacoes);
+	if(usuarios_contextoDestruir(&usuarios) != USUARIOS_SUCESSO && retorno == AVALIACAO_SUCESSO) retorno = AVALIACAO_FALHA_USUARIOS;
+	switch(retorno) {
+		case AVALIACAO_SUCESSO: break;
+		case AVALIACAO_FALHA_ABRIRDB:
+			fprintf(stderr, "Nao foi possivel ler %s\n", db_avaliacao);
+			return 1;
+		default:
+			fprintf(stderr, "Nao foi possivel gravar %s\n", db);
+			return 1;
+	}
+
+	printf("%u usuarios corrigidos em %.1f ms\n", corrigidos,
+		(fim.tv_sec - inicio.tv_sec)*1e3 + (fim.tv_nsec - inicio.tv_nsec)/1e6);
+	return 0;
+}
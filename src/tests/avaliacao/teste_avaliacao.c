@@ -1,6 +1,10 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <limits.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
 #include <gtest/gtest.h>
 #include "usuarios.h"
 #include "aleatorio.h"
@@ -21,7 +25,6 @@ TEST(Avaliacao, AvaliarLogin) {
   EXPECT_EQ(avaliacao_avaliar(0, 4, 5, (char *)"Ótimo"), AVALIACAO_SUCESSO);
   
   EXPECT_EQ(usuarios_logout(), USUARIOS_SUCESSO);
-
 }
 
 TEST(Avaliacao, MostrarSessao){
@@ -36,6 +39,508 @@ TEST(Avaliacao, MostrarSessao){
   EXPECT_EQ(usuarios_logout(), USUARIOS_SUCESSO);
 }
 
+TEST(Avaliacao, AvaliarSessao){
+  usuarios_token token;
+  EXPECT_EQ(usuarios_loginSessao("jose123", "987654", &token), USUARIOS_SUCESSO);
+  EXPECT_EQ(avaliacao_avaliarSessao(token, 5, 4, (char *)"Bom"), AVALIACAO_SUCESSO);
+  EXPECT_EQ(usuarios_logoutSessao(token), USUARIOS_SUCESSO);
+  EXPECT_EQ(avaliacao_avaliarSessao(token, 5, 4, (char *)"Bom"), AVALIACAO_FALHA_SEMSESSAO);
+}
+
+TEST(Avaliacao, Contexto){
+  avaliacao_contexto *contexto;
+  avaliacao *a = avaliacao_iniciar();
+  
+  remove("../../db/contexto_avaliacao.txt");
+  contexto = avaliacao_contextoCriar(usuarios_contextoPadrao(), "../../db/contexto_avaliacao.txt");
+  ASSERT_TRUE(contexto != NULL);
+  EXPECT_EQ(avaliacao_avaliar_r(contexto, 6, 7, 3, (char *)"Contexto"), AVALIACAO_SUCESSO);
+  EXPECT_EQ(avaliacao_obterAvaliacao_r(contexto, 6, 1, AVALIADOR, a), AVALIACAO_SUCESSO);
+  EXPECT_EQ(a->avaliado, 7);
+  EXPECT_EQ(!strcmp(a->comentario, "Contexto"), 1);
+  
+  /* O arquivo padrão não recebe a avaliação */
+  EXPECT_EQ(avaliacao_obterAvaliacao(6, 1, AVALIADOR, a), AVALIACAO_NAO_ENCONTRADO);
+  
+  avaliacao_limpar(&a);
+  EXPECT_EQ(avaliacao_contextoDestruir(&contexto), AVALIACAO_SUCESSO);
+  remove("../../db/contexto_avaliacao.txt");
+}
+
+/*
+ * Testes com usuários e avaliações em arquivos próprios, com nomes
+ * começados pelo prefixo do teste, para não mexer nos arquivos padrão.
+ * TearDown destrói os contextos e apaga os arquivos também quando uma
+ * asserção encerra o teste antes do fim.
+ */
+
+class AvaliacaoArquivos : public ::testing::Test {
+protected:
+  usuarios_contexto *usuarios;
+  avaliacao_contexto *contexto;
+  char db_usuarios[USUARIOS_LIMITE_CAMINHO], db_amigos[USUARIOS_LIMITE_CAMINHO], db_wal[USUARIOS_LIMITE_CAMINHO];
+  char db_avaliacao[USUARIOS_LIMITE_CAMINHO], db_histogramas[USUARIOS_LIMITE_CAMINHO + sizeof(AVALIACAO_HISTOGRAMAS_SUFIXO)];
+  
+  void SetUp(){
+    usuarios = NULL;
+    contexto = NULL;
+    db_avaliacao[0] = '\0';
+  }
+  
+  void TearDown(){
+    if(contexto != NULL) {
+      EXPECT_EQ(avaliacao_contextoDestruir(&contexto), AVALIACAO_SUCESSO);
+    }
+    if(usuarios != NULL) {
+      EXPECT_EQ(usuarios_contextoDestruir(&usuarios), USUARIOS_SUCESSO);
+    }
+    if(db_avaliacao[0] == '\0') return;
+    remove(db_avaliacao); remove(db_histogramas);
+    remove(db_usuarios); remove(db_amigos); remove(db_wal);
+  }
+  
+  /* Apaga os arquivos do prefixo e cadastra os usuários 1 a n, com usuario e email formados pelo prefixo */
+  void Preparar(const char *prefixo, unsigned int n){
+    char usuario[USUARIOS_LIMITE_USUARIO], email[USUARIOS_LIMITE_EMAIL];
+    unsigned int i;
+    
+    snprintf(db_usuarios, sizeof(db_usuarios), "../../db/%s_usuarios.txt", prefixo);
+    snprintf(db_amigos, sizeof(db_amigos), "../../db/%s_amigos.txt", prefixo);
+    snprintf(db_wal, sizeof(db_wal), "../../db/%s_usuarios.wal", prefixo);
+    snprintf(db_avaliacao, sizeof(db_avaliacao), "../../db/%s_avaliacao.txt", prefixo);
+    snprintf(db_histogramas, sizeof(db_histogramas), "%s" AVALIACAO_HISTOGRAMAS_SUFIXO, db_avaliacao);
+    remove(db_avaliacao); remove(db_histogramas);
+    remove(db_usuarios); remove(db_amigos); remove(db_wal);
+    
+    ASSERT_NO_FATAL_FAILURE(CarregarUsuarios());
+    for(i=1;i<=n;i++) {
+      snprintf(usuario, sizeof(usuario), "%s%u", prefixo, i);
+      snprintf(email, sizeof(email), "%s%u@t.com", prefixo, i);
+      EXPECT_EQ(usuarios_cadastro_r(usuarios, 8, "usuario", usuario, "nome", "Teste", "email", email, "endereco", "Rua", "senha", "1", "senha_confirmacao", "1", "formaPagamento", BOLETO, "tipo", CONSUMIDOR), USUARIOS_SUCESSO);
+    }
+  }
+  
+  /* Cria o contexto de usuários sobre os arquivos do prefixo e os carrega */
+  void CarregarUsuarios(){
+    usuarios = usuarios_contextoCriar(db_usuarios, db_amigos, db_wal);
+    ASSERT_TRUE(usuarios != NULL);
+    EXPECT_EQ(usuarios_carregarArquivo_r(usuarios), USUARIOS_SUCESSO);
+  }
+  
+  /* Cria o contexto de avaliações sobre o arquivo do prefixo, que não é apagado */
+  void Abrir(){
+    contexto = avaliacao_contextoCriar(usuarios, db_avaliacao);
+    ASSERT_TRUE(contexto != NULL);
+  }
+};
+
+TEST_F(AvaliacaoArquivos, Indice){
+  avaliacao *a = avaliacao_iniciar();
+  char comentario[32];
+  unsigned int i, j;
+  FILE *db;
+  
+  ASSERT_NO_FATAL_FAILURE(Preparar("indice", 30));
+  ASSERT_NO_FATAL_FAILURE(Abrir());
+  for(i=1;i<=5;i++) {
+    for(j=10;j<=14;j++) {
+      sprintf(comentario, "%u para %u", i, j);
+      EXPECT_EQ(avaliacao_avaliar_r(contexto, i, j, (i+j)%6, comentario), AVALIACAO_SUCESSO);
+    }
+  }
+  
+  /* A n-ésima de cada papel, na ordem do arquivo */
+  EXPECT_EQ(avaliacao_obterAvaliacao_r(contexto, 3, 4, AVALIADOR, a), AVALIACAO_SUCESSO);
+  EXPECT_EQ(a->avaliado, 13);
+  EXPECT_EQ(a->nota, 16%6);
+  EXPECT_STREQ(a->comentario, "3 para 13");
+  EXPECT_EQ(avaliacao_obterAvaliacao_r(contexto, 12, 5, AVALIADO, a), AVALIACAO_SUCESSO);
+  EXPECT_EQ(a->avaliador, 5);
+  EXPECT_STREQ(a->comentario, "5 para 12");
+  EXPECT_EQ(avaliacao_obterAvaliacao_r(contexto, 3, 6, AVALIADOR, a), AVALIACAO_NAO_ENCONTRADO);
+  EXPECT_EQ(avaliacao_obterAvaliacao_r(contexto, 900, 1, AVALIADO, a), AVALIACAO_NAO_ENCONTRADO);
+  
+  /* Avaliações feitas depois da construção e linhas escritas por fora entram no índice */
+  EXPECT_EQ(avaliacao_avaliar_r(contexto, 3, 20, 1, (char *)"Depois"), AVALIACAO_SUCESSO);
+  EXPECT_EQ(avaliacao_sincronizar_r(contexto), AVALIACAO_SUCESSO);
+  db = fopen(db_avaliacao, "a");
+  ASSERT_TRUE(db != NULL);
+  fprintf(db, AVALIACAO_DB_ESTRUTURA, 3, 21, 2, "Por fora");
+  fclose(db);
+  EXPECT_EQ(avaliacao_obterAvaliacao_r(contexto, 3, 6, AVALIADOR, a), AVALIACAO_SUCESSO);
+  EXPECT_STREQ(a->comentario, "Depois");
+  EXPECT_EQ(avaliacao_obterAvaliacao_r(contexto, 3, 7, AVALIADOR, a), AVALIACAO_SUCESSO);
+  EXPECT_EQ(a->avaliado, 21);
+  EXPECT_STREQ(a->comentario, "Por fora");
+  
+  /* Um arquivo novo refaz o índice */
+  remove(db_avaliacao);
+  EXPECT_EQ(avaliacao_avaliar_r(contexto, 2, 30, 4, (char *)"Novo"), AVALIACAO_SUCESSO);
+  EXPECT_EQ(avaliacao_obterAvaliacao_r(contexto, 3, 1, AVALIADOR, a), AVALIACAO_NAO_ENCONTRADO);
+  EXPECT_EQ(avaliacao_obterAvaliacao_r(contexto, 30, 1, AVALIADO, a), AVALIACAO_SUCESSO);
+  EXPECT_STREQ(a->comentario, "Novo");
+  
+  avaliacao_limpar(&a);
+}
+
+TEST_F(AvaliacaoArquivos, Cursor){
+  avaliacao_cursor cursor;
+  avaliacao pagina[4];
+  char comentario[32];
+  unsigned int i, lidas, total;
+  
+  ASSERT_NO_FATAL_FAILURE(Preparar("cursor", 12));
+  
+  /* O usuário 1 recebe uma avaliação de cada um dos outros, com nota (i-2)%6 */
+  ASSERT_NO_FATAL_FAILURE(Abrir());
+  for(i=2;i<=12;i++) {
+    sprintf(comentario, "de %u", i);
+    EXPECT_EQ(avaliacao_avaliar_r(contexto, i, 1, (i-2)%6, comentario), AVALIACAO_SUCESSO);
+  }
+  
+  /* Todas, em páginas de 4 e na ordem do arquivo */
+  EXPECT_EQ(avaliacao_cursorAbrir_r(contexto, &cursor, 1, AVALIADO, 0, 5, AVALIACAO_CAMPOS_TODOS), AVALIACAO_SUCESSO);
+  total = 0;
+  while(avaliacao_cursorLer(&cursor, pagina, 4, &lidas) == AVALIACAO_SUCESSO) {
+    EXPECT_LE(lidas, 4);
+    for(i=0;i<lidas;i++) {
+      EXPECT_EQ(pagina[i].avaliador, total+2);
+      EXPECT_EQ(pagina[i].avaliado, 1);
+      sprintf(comentario, "de %u", total+2);
+      EXPECT_STREQ(pagina[i].comentario, comentario);
+      total++;
+    }
+  }
+  EXPECT_EQ(total, 11);
+  EXPECT_EQ(lidas, 0);
+  
+  /* Só notas 4 e 5, copiando só o avaliador; os outros campos não são tocados */
+  memset(pagina, 0, sizeof(pagina));
+  strcpy(pagina[0].comentario, "intacto");
+  EXPECT_EQ(avaliacao_cursorAbrir_r(contexto, &cursor, 1, AVALIADO, 4, 5, AVALIACAO_CAMPO_AVALIADOR), AVALIACAO_SUCESSO);
+  EXPECT_EQ(avaliacao_cursorLer(&cursor, pagina, 4, &lidas), AVALIACAO_SUCESSO);
+  EXPECT_EQ(lidas, 3);
+  EXPECT_EQ(pagina[0].avaliador, 6);
+  EXPECT_EQ(pagina[1].avaliador, 7);
+  EXPECT_EQ(pagina[2].avaliador, 12);
+  EXPECT_EQ(pagina[3].avaliador, 0);
+  EXPECT_EQ(pagina[0].nota, 0);
+  EXPECT_STREQ(pagina[0].comentario, "intacto");
+  
+  /* Avaliações feitas depois da abertura aparecem nas páginas seguintes */
+  EXPECT_EQ(avaliacao_cursorLer(&cursor, pagina, 4, &lidas), AVALIACAO_NAO_ENCONTRADO);
+  EXPECT_EQ(avaliacao_avaliar_r(contexto, 2, 1, 5, (char *)"Outra"), AVALIACAO_SUCESSO);
+  EXPECT_EQ(avaliacao_cursorLer(&cursor, pagina, 4, &lidas), AVALIACAO_SUCESSO);
+  EXPECT_EQ(lidas, 1);
+  EXPECT_EQ(pagina[0].avaliador, 2);
+  
+  /* Papel sem avaliações e valores inválidos */
+  EXPECT_EQ(avaliacao_cursorAbrir_r(contexto, &cursor, 1, AVALIADOR, 0, 5, AVALIACAO_CAMPOS_TODOS), AVALIACAO_SUCESSO);
+  EXPECT_EQ(avaliacao_cursorLer(&cursor, pagina, 4, &lidas), AVALIACAO_NAO_ENCONTRADO);
+  EXPECT_EQ(avaliacao_cursorLer(&cursor, pagina, 0, &lidas), AVALIACAO_VALORINVALIDO);
+  EXPECT_EQ(avaliacao_cursorAbrir_r(contexto, &cursor, 1, AVALIADO, 3, 2, AVALIACAO_CAMPOS_TODOS), AVALIACAO_VALORINVALIDO);
+  EXPECT_EQ(avaliacao_cursorAbrir_r(contexto, &cursor, 1, AVALIADO, 0, 5, 0), AVALIACAO_VALORINVALIDO);
+}
+
+TEST_F(AvaliacaoArquivos, Histogramas){
+  avaliacao_estatisticas e;
+  unsigned int i, notas[] = {5, 4, 4, 1, 0};
+  uint32_t contador;
+  FILE *db;
+  
+  ASSERT_NO_FATAL_FAILURE(Preparar("histograma", 8));
+  
+  /* Sem arquivo de histogramas, a primeira consulta os refaz a partir das avaliações */
+  ASSERT_NO_FATAL_FAILURE(Abrir());
+  for(i=0;i<5;i++) EXPECT_EQ(avaliacao_avaliar_r(contexto, i+2, 1, notas[i], (char *)"H"), AVALIACAO_SUCESSO);
+  EXPECT_EQ(avaliacao_obterEstatisticas_r(contexto, 1, &e), AVALIACAO_SUCESSO);
+  EXPECT_EQ(e.total, 5);
+  EXPECT_EQ(e.contagem[0], 1);
+  EXPECT_EQ(e.contagem[1], 1);
+  EXPECT_EQ(e.contagem[2], 0);
+  EXPECT_EQ(e.contagem[4], 2);
+  EXPECT_EQ(e.contagem[5], 1);
+  EXPECT_DOUBLE_EQ(e.media, 2.8);
+  EXPECT_DOUBLE_EQ(e.mediana, 4);
+  EXPECT_DOUBLE_EQ(e.positivas, 60);
+  
+  /* Depois de carregados, cada avaliação soma um contador; com total par a mediana é a média das centrais */
+  EXPECT_EQ(avaliacao_avaliar_r(contexto, 7, 1, 2, (char *)"H"), AVALIACAO_SUCESSO);
+  EXPECT_EQ(avaliacao_obterEstatisticas_r(contexto, 1, &e), AVALIACAO_SUCESSO);
+  EXPECT_EQ(e.total, 6);
+  EXPECT_DOUBLE_EQ(e.mediana, 3);
+  EXPECT_DOUBLE_EQ(e.positivas, 50);
+  EXPECT_EQ(avaliacao_obterEstatisticas_r(contexto, 2, &e), AVALIACAO_SUCESSO);
+  EXPECT_EQ(e.total, 0);
+  EXPECT_DOUBLE_EQ(e.media, 0);
+  EXPECT_EQ(avaliacao_obterEstatisticas_r(contexto, 900, &e), AVALIACAO_SUCESSO);
+  EXPECT_EQ(e.total, 0);
+  EXPECT_EQ(avaliacao_contextoDestruir(&contexto), AVALIACAO_SUCESSO);
+  
+  /* O contador de cada nota fica em posição fixa do arquivo de histogramas */
+  db = fopen(db_histogramas, "rb");
+  ASSERT_TRUE(db != NULL);
+  fseek(db, sizeof(avaliacao_histogramas_cabecalho) + (1*AVALIACAO_NOTAS + 4)*sizeof(uint32_t), SEEK_SET);
+  EXPECT_EQ(fread(&contador, sizeof(contador), 1, db), 1);
+  EXPECT_EQ(contador, 2);
+  fclose(db);
+  
+  /* Um contexto novo carrega o arquivo e conta só as linhas acrescentadas por fora */
+  db = fopen(db_avaliacao, "a");
+  ASSERT_TRUE(db != NULL);
+  fprintf(db, AVALIACAO_DB_ESTRUTURA, 8, 1, 5, "Por fora");
+  fclose(db);
+  ASSERT_NO_FATAL_FAILURE(Abrir());
+  EXPECT_EQ(avaliacao_obterEstatisticas_r(contexto, 1, &e), AVALIACAO_SUCESSO);
+  EXPECT_EQ(e.total, 7);
+  EXPECT_EQ(e.contagem[5], 2);
+  EXPECT_DOUBLE_EQ(e.mediana, 4);
+  EXPECT_EQ(avaliacao_contextoDestruir(&contexto), AVALIACAO_SUCESSO);
+  
+  /* Sem o arquivo de histogramas, ou com um arquivo de avaliações novo, tudo é refeito */
+  remove(db_histogramas);
+  ASSERT_NO_FATAL_FAILURE(Abrir());
+  EXPECT_EQ(avaliacao_obterEstatisticas_r(contexto, 1, &e), AVALIACAO_SUCESSO);
+  EXPECT_EQ(e.total, 7);
+  remove(db_avaliacao);
+  EXPECT_EQ(avaliacao_avaliar_r(contexto, 3, 1, 3, (char *)"Novo"), AVALIACAO_SUCESSO);
+  EXPECT_EQ(avaliacao_obterEstatisticas_r(contexto, 1, &e), AVALIACAO_SUCESSO);
+  EXPECT_EQ(e.total, 1);
+  EXPECT_EQ(e.contagem[3], 1);
+  EXPECT_DOUBLE_EQ(e.mediana, 3);
+}
+
+TEST_F(AvaliacaoArquivos, Lote){
+  avaliacao a;
+  char linha[AVALIACAO_LINHA_LIMITE];
+  unsigned int i, cabecalho, linhas;
+  FILE *db;
+  
+  ASSERT_NO_FATAL_FAILURE(Preparar("lote", 2));
+  ASSERT_NO_FATAL_FAILURE(Abrir());
+  
+  /* As consultas veem as avaliações ainda em memória */
+  EXPECT_EQ(avaliacao_avaliar_r(contexto, 1, 2, 3, (char *)"Primeira"), AVALIACAO_SUCESSO);
+  EXPECT_EQ(avaliacao_obterAvaliacao_r(contexto, 2, 1, AVALIADO, &a), AVALIACAO_SUCESSO);
+  EXPECT_STREQ(a.comentario, "Primeira");
+  
+  /* Mais de um lote; ao destruir o contexto tudo está no arquivo, com o contador no cabeçalho */
+  for(i=0;i<AVALIACAO_LOTE+5;i++) EXPECT_EQ(avaliacao_avaliar_r(contexto, 2, 1, i%6, (char *)"Lote"), AVALIACAO_SUCESSO);
+  EXPECT_EQ(avaliacao_contextoDestruir(&contexto), AVALIACAO_SUCESSO);
+  
+  db = fopen(db_avaliacao, "r");
+  ASSERT_TRUE(db != NULL);
+  ASSERT_TRUE(fgets(linha, sizeof(linha), db) != NULL);
+  EXPECT_EQ(sscanf(linha, "%u", &cabecalho), 1);
+  for(linhas=0;fgets(linha, sizeof(linha), db) != NULL;linhas++);
+  fclose(db);
+  EXPECT_EQ(cabecalho, AVALIACAO_LOTE+6);
+  EXPECT_EQ(linhas, AVALIACAO_LOTE+6);
+}
+
+TEST_F(AvaliacaoArquivos, LoteCheio){
+  char linha[AVALIACAO_LINHA_LIMITE];
+  unsigned int i, aceitas = 0, n, linhas;
+  avaliacao_condRet retorno = AVALIACAO_SUCESSO;
+  FILE *db;
+  
+  ASSERT_NO_FATAL_FAILURE(Preparar("cheio", 2));
+  
+  /* O diretório do arquivo não existe, então nenhum lote é gravado */
+  rmdir("../../db/cheio");
+  contexto = avaliacao_contextoCriar(usuarios, "../../db/cheio/avaliacao.txt");
+  ASSERT_TRUE(contexto != NULL);
+  for(i=0;i<2*AVALIACAO_LOTE && retorno == AVALIACAO_SUCESSO;i++) {
+    retorno = avaliacao_avaliar_r(contexto, 1, 2, 4, (char *)"Cheio");
+    if(retorno == AVALIACAO_SUCESSO) aceitas++;
+  }
+  
+  /* Com o buffer cheio a avaliação é recusada e não conta para o avaliado */
+  EXPECT_EQ(retorno, AVALIACAO_FALHA_AVALIAR);
+  EXPECT_GE(aceitas, AVALIACAO_LOTE);
+  EXPECT_EQ(usuarios_campoInteiro_r(usuarios, 2, USUARIOS_CAMPO_N_AVALIACAO, &n), USUARIOS_SUCESSO);
+  EXPECT_EQ(n, aceitas);
+  
+  /* Quando o arquivo pode ser criado as avaliações aceitas são gravadas */
+  EXPECT_EQ(mkdir("../../db/cheio", 0755), 0);
+  EXPECT_EQ(avaliacao_contextoDestruir(&contexto), AVALIACAO_SUCESSO);
+  db = fopen("../../db/cheio/avaliacao.txt", "r");
+  if(db != NULL) {
+    for(linhas=0;fgets(linha, sizeof(linha), db) != NULL;linhas++);
+    fclose(db);
+    EXPECT_EQ(linhas, aceitas+1);
+  }
+  else ADD_FAILURE();
+  remove("../../db/cheio/avaliacao.txt"); remove("../../db/cheio/avaliacao.txt" AVALIACAO_HISTOGRAMAS_SUFIXO);
+  rmdir("../../db/cheio");
+}
+
+TEST_F(AvaliacaoArquivos, Pares){
+  avaliacao_contexto *outro;
+  unsigned int i;
+  FILE *db;
+
+  ASSERT_NO_FATAL_FAILURE(Preparar("pares", 3));
+  ASSERT_NO_FATAL_FAILURE(Abrir());
+
+  /* Sem arquivo de avaliações ninguém avaliou ninguém */
+  EXPECT_EQ(avaliacao_jaAvaliou_r(contexto, 1, 2), AVALIACAO_NAO_ENCONTRADO);
+
+  /* O par conta a partir da avaliação e só na sua direção */
+  EXPECT_EQ(avaliacao_avaliar_r(contexto, 1, 2, 4, (char *)"Par"), AVALIACAO_SUCESSO);
+  EXPECT_EQ(avaliacao_jaAvaliou_r(contexto, 1, 2), AVALIACAO_SUCESSO);
+  EXPECT_EQ(avaliacao_jaAvaliou_r(contexto, 2, 1), AVALIACAO_NAO_ENCONTRADO);
+  EXPECT_EQ(avaliacao_jaAvaliou_r(contexto, 1, 3), AVALIACAO_NAO_ENCONTRADO);
+  EXPECT_EQ(avaliacao_avaliar_r(contexto, 3, 1, 2, (char *)"Outro"), AVALIACAO_SUCESSO);
+  EXPECT_EQ(avaliacao_jaAvaliou_r(contexto, 3, 1), AVALIACAO_SUCESSO);
+
+  /* Linhas acrescentadas por fora entram na consulta seguinte, com a tabela crescendo */
+  EXPECT_EQ(avaliacao_sincronizar_r(contexto), AVALIACAO_SUCESSO);
+  db = fopen(db_avaliacao, "a");
+  ASSERT_TRUE(db != NULL);
+  for(i=100;i<1100;i++) fprintf(db, AVALIACAO_DB_ESTRUTURA, i, i+1, 3, "Fora");
+  fclose(db);
+  for(i=100;i<1100;i++) EXPECT_EQ(avaliacao_jaAvaliou_r(contexto, i, i+1), AVALIACAO_SUCESSO);
+  EXPECT_EQ(avaliacao_jaAvaliou_r(contexto, 101, 100), AVALIACAO_NAO_ENCONTRADO);
+  EXPECT_EQ(avaliacao_jaAvaliou_r(contexto, 1100, 1101), AVALIACAO_NAO_ENCONTRADO);
+
+  /* Um contexto novo monta o conjunto a partir do arquivo */
+  outro = avaliacao_contextoCriar(usuarios, db_avaliacao);
+  ASSERT_TRUE(outro != NULL);
+  EXPECT_EQ(avaliacao_jaAvaliou_r(outro, 1, 2), AVALIACAO_SUCESSO);
+  EXPECT_EQ(avaliacao_jaAvaliou_r(outro, 2, 1), AVALIACAO_NAO_ENCONTRADO);
+  EXPECT_EQ(avaliacao_jaAvaliou_r(outro, 550, 551), AVALIACAO_SUCESSO);
+  EXPECT_EQ(avaliacao_contextoDestruir(&outro), AVALIACAO_SUCESSO);
+}
+
+TEST_F(AvaliacaoArquivos, Recalcular){
+  unsigned int i, n, corrigidos, soma = 0;
+  double media;
+  FILE *db;
+
+  ASSERT_NO_FATAL_FAILURE(Preparar("recalculo", 3));
+  ASSERT_NO_FATAL_FAILURE(Abrir());
+
+  /* Sem arquivo de avaliações não há o que corrigir */
+  EXPECT_EQ(avaliacao_recalcular_r(contexto, 0, &corrigidos), AVALIACAO_SUCESSO);
+  EXPECT_EQ(corrigidos, 0);
+
+  EXPECT_EQ(avaliacao_avaliar_r(contexto, 1, 2, 4, (char *)"A"), AVALIACAO_SUCESSO);
+  EXPECT_EQ(avaliacao_avaliar_r(contexto, 3, 2, 1, (char *)"B"), AVALIACAO_SUCESSO);
+  EXPECT_EQ(avaliacao_avaliar_r(contexto, 2, 3, 5, (char *)"C"), AVALIACAO_SUCESSO);
+  EXPECT_EQ(avaliacao_recalcular_r(contexto, 0, &corrigidos), AVALIACAO_SUCESSO);
+  EXPECT_EQ(corrigidos, 0);
+
+  /* Campos que se afastaram do arquivo são refeitos, os demais não são tocados */
+  EXPECT_EQ(usuarios_atualizarDados_r(usuarios, 2, "n_avaliacao", 7), USUARIOS_SUCESSO);
+  EXPECT_EQ(usuarios_atualizarDados_r(usuarios, 3, "avaliacao", 0.5), USUARIOS_SUCESSO);
+  EXPECT_EQ(avaliacao_recalcular_r(contexto, 4, &corrigidos), AVALIACAO_SUCESSO);
+  EXPECT_EQ(corrigidos, 2);
+  EXPECT_EQ(usuarios_campoInteiro_r(usuarios, 2, USUARIOS_CAMPO_N_AVALIACAO, &n), USUARIOS_SUCESSO);
+  EXPECT_EQ(n, 2);
+  EXPECT_EQ(usuarios_campoReal_r(usuarios, 2, USUARIOS_CAMPO_AVALIACAO, &media), USUARIOS_SUCESSO);
+  EXPECT_DOUBLE_EQ(media, 2.5);
+  EXPECT_EQ(usuarios_campoReal_r(usuarios, 3, USUARIOS_CAMPO_AVALIACAO, &media), USUARIOS_SUCESSO);
+  EXPECT_DOUBLE_EQ(media, 5);
+
+  /* Linhas acrescentadas por fora, em trechos para várias threads; avaliado fora do grafo é ignorado */
+  db = fopen(db_avaliacao, "a");
+  ASSERT_TRUE(db != NULL);
+  for(i=0;i<2000;i++) {
+    fprintf(db, AVALIACAO_DB_ESTRUTURA, 2 + i%2, 1, i%6, "Fora");
+    fprintf(db, AVALIACAO_DB_ESTRUTURA, 1, 99, 5, "Sem usuario");
+    soma += i%6;
+  }
+  fclose(db);
+  EXPECT_EQ(avaliacao_recalcular_r(contexto, 4, &corrigidos), AVALIACAO_SUCESSO);
+  EXPECT_EQ(corrigidos, 1);
+  EXPECT_EQ(avaliacao_recalcular_r(contexto, 1, &corrigidos), AVALIACAO_SUCESSO);
+  EXPECT_EQ(corrigidos, 0);
+  EXPECT_EQ(avaliacao_contextoDestruir(&contexto), AVALIACAO_SUCESSO);
+  EXPECT_EQ(usuarios_contextoDestruir(&usuarios), USUARIOS_SUCESSO);
+
+  /* A correção chegou ao arquivo de usuários */
+  ASSERT_NO_FATAL_FAILURE(CarregarUsuarios());
+  EXPECT_EQ(usuarios_campoInteiro_r(usuarios, 1, USUARIOS_CAMPO_N_AVALIACAO, &n), USUARIOS_SUCESSO);
+  EXPECT_EQ(n, 2000);
+  EXPECT_EQ(usuarios_campoReal_r(usuarios, 1, USUARIOS_CAMPO_AVALIACAO, &media), USUARIOS_SUCESSO);
+  EXPECT_NEAR(media, (double)soma/2000, 1e-6);
+  EXPECT_EQ(usuarios_campoInteiro_r(usuarios, 2, USUARIOS_CAMPO_N_AVALIACAO, &n), USUARIOS_SUCESSO);
+  EXPECT_EQ(n, 2);
+}
+
+/*
+ * Também apaga os arquivos da conversão para o formato binário.
+ */
+
+class AvaliacaoBinario : public AvaliacaoArquivos {
+protected:
+  void TearDown(){
+    AvaliacaoArquivos::TearDown();
+    remove("../../db/binario.reg"); remove("../../db/binario.com");
+  }
+};
+
+TEST_F(AvaliacaoBinario, Converter){
+  avaliacao_binario binario;
+  avaliacao a;
+  const char *comentarios[] = {"Ótimo", "", "Entregou no prazo e bem embalado"};
+  unsigned int i, convertidas;
+  uint32_t tempo;
+  FILE *db;
+  
+  ASSERT_NO_FATAL_FAILURE(Preparar("binario", 4));
+  ASSERT_NO_FATAL_FAILURE(Abrir());
+  for(i=0;i<3;i++) EXPECT_EQ(avaliacao_avaliar_r(contexto, i+1, 4, i+3, (char *)comentarios[i]), AVALIACAO_SUCESSO);
+  EXPECT_EQ(avaliacao_contextoDestruir(&contexto), AVALIACAO_SUCESSO);
+  
+  /* A conversão mantém a ordem e o tempo e tira os espaços do comentário */
+  EXPECT_EQ(avaliacao_binarioConverter(db_avaliacao, "../../db/binario.reg", "../../db/binario.com", &convertidas), AVALIACAO_SUCESSO);
+  EXPECT_EQ(convertidas, 3);
+  EXPECT_EQ(avaliacao_binarioAbrir(&binario, "../../db/binario.reg", "../../db/binario.com"), AVALIACAO_SUCESSO);
+  EXPECT_EQ(binario.n, 3);
+  EXPECT_EQ(binario.tamanho_pilha, 3 + strlen(comentarios[0]) + strlen(comentarios[2]));
+  for(i=0;i<3;i++) {
+    EXPECT_EQ(avaliacao_binarioLer(&binario, i+1, &a, &tempo), AVALIACAO_SUCESSO);
+    EXPECT_EQ(a.avaliador, i+1);
+    EXPECT_EQ(a.avaliado, 4);
+    EXPECT_EQ(a.nota, i+3);
+    EXPECT_STREQ(a.comentario, comentarios[i]);
+    EXPECT_GT(tempo, 0);
+    EXPECT_LE(tempo, (uint32_t)time(NULL));
+  }
+  EXPECT_EQ(avaliacao_binarioLer(&binario, 4, &a, NULL), AVALIACAO_NAO_ENCONTRADO);
+  EXPECT_EQ(avaliacao_binarioLer(&binario, 0, &a, NULL), AVALIACAO_VALORINVALIDO);
+  avaliacao_binarioFechar(&binario);
+  
+  /* Um registro incompleto no fim é ignorado e depois sobrescrito */
+  db = fopen("../../db/binario.reg", "ab");
+  ASSERT_TRUE(db != NULL);
+  fwrite("incompleto", 1, 10, db);
+  fclose(db);
+  EXPECT_EQ(avaliacao_binarioAbrir(&binario, "../../db/binario.reg", "../../db/binario.com"), AVALIACAO_SUCESSO);
+  EXPECT_EQ(binario.n, 3);
+  avaliacao_binarioFechar(&binario);
+  
+  a.avaliador = 4; a.avaliado = 1; a.nota = 5;
+  strcpy(a.comentario, "Depois");
+  EXPECT_EQ(avaliacao_binarioAcrescentar("../../db/binario.reg", "../../db/binario.com", &a, 1700000000), AVALIACAO_SUCESSO);
+  a.nota = 6;
+  EXPECT_EQ(avaliacao_binarioAcrescentar("../../db/binario.reg", "../../db/binario.com", &a, 0), AVALIACAO_FALHA_NOTAINVALIDA);
+  EXPECT_EQ(avaliacao_binarioAbrir(&binario, "../../db/binario.reg", "../../db/binario.com"), AVALIACAO_SUCESSO);
+  EXPECT_EQ(binario.n, 4);
+  EXPECT_EQ(avaliacao_binarioLer(&binario, 4, &a, &tempo), AVALIACAO_SUCESSO);
+  EXPECT_EQ(a.avaliador, 4);
+  EXPECT_EQ(a.nota, 5);
+  EXPECT_STREQ(a.comentario, "Depois");
+  EXPECT_EQ(tempo, 1700000000);
+  avaliacao_binarioFechar(&binario);
+  
+  /* Arquivos em outro formato são recusados */
+  EXPECT_EQ(avaliacao_binarioAbrir(&binario, db_avaliacao, "../../db/binario.com"), AVALIACAO_FALHA_ABRIRDB);
+  EXPECT_EQ(avaliacao_binarioAcrescentar(db_avaliacao, "../../db/binario.com", &a, 0), AVALIACAO_FALHA_ABRIRDB);
+}
+
 TEST(Avaliacao, Avaliar){
   unsigned int i,j;
   for(i=1;i<50;i++){
@@ -52,3 +557,202 @@ int main(int argc, char **argv)
         return RUN_ALL_TESTS();
 }
 
+
+TEST_F(AvaliacaoArquivos, Conluio){
+  avaliacao_conluio conluio;
+  unsigned int i, j;
+  FILE *db;
+
+  ASSERT_NO_FATAL_FAILURE(Preparar("conluio", 0));
+  ASSERT_NO_FATAL_FAILURE(Abrir());
+
+  /* Sem arquivo não há suspeitos */
+  EXPECT_EQ(avaliacao_detectarConluio_r(contexto, 5, 3, 0.4, &conluio), AVALIACAO_SUCESSO);
+  EXPECT_EQ(conluio.n, 0);
+  EXPECT_EQ(avaliacao_conluioLimpar(&conluio), AVALIACAO_SUCESSO);
+
+  db = fopen(db_avaliacao, "w");
+  ASSERT_TRUE(db != NULL);
+  fprintf(db, "%-4u\n", 0);
+  /* 10 a 13 se avaliam todos com 5, 10 avalia 11 duas vezes e a si mesmo */
+  for(i=10;i<=13;i++)
+    for(j=10;j<=13;j++)
+      if(i != j) fprintf(db, AVALIACAO_DB_ESTRUTURA, i, j, 5, "Anel");
+  fprintf(db, AVALIACAO_DB_ESTRUTURA, 10, 11, 5, "De novo");
+  fprintf(db, AVALIACAO_DB_ESTRUTURA, 10, 10, 5, "Eu");
+  /* Ciclo dirigido 20, 21, 22 */
+  fprintf(db, AVALIACAO_DB_ESTRUTURA, 20, 21, 5, "Ciclo");
+  fprintf(db, AVALIACAO_DB_ESTRUTURA, 21, 22, 5, "Ciclo");
+  fprintf(db, AVALIACAO_DB_ESTRUTURA, 22, 20, 5, "Ciclo");
+  /* Par de uma transação, corrente sem volta, anel de notas baixas */
+  fprintf(db, AVALIACAO_DB_ESTRUTURA, 30, 31, 5, "Par");
+  fprintf(db, AVALIACAO_DB_ESTRUTURA, 31, 30, 5, "Par");
+  fprintf(db, AVALIACAO_DB_ESTRUTURA, 40, 41, 5, "Corrente");
+  fprintf(db, AVALIACAO_DB_ESTRUTURA, 41, 42, 5, "Corrente");
+  for(i=50;i<=52;i++)
+    for(j=50;j<=52;j++)
+      if(i != j) fprintf(db, AVALIACAO_DB_ESTRUTURA, i, j, 2, "Baixa");
+  fclose(db);
+
+  EXPECT_EQ(avaliacao_detectarConluio_r(contexto, 5, 3, 0.4, &conluio), AVALIACAO_SUCESSO);
+  ASSERT_EQ(conluio.n, 2);
+  EXPECT_EQ(conluio.usuarios, 53);
+  EXPECT_EQ(conluio.grupos[0].n, 4);
+  EXPECT_EQ(conluio.grupos[0].membros[0], 10);
+  EXPECT_EQ(conluio.grupos[0].membros[3], 13);
+  EXPECT_EQ(conluio.grupos[0].arestas, 12);
+  EXPECT_EQ(conluio.grupos[0].reciprocas, 6);
+  EXPECT_EQ(conluio.grupos[0].avaliacoes, 13);
+  EXPECT_DOUBLE_EQ(conluio.grupos[0].densidade, 1);
+  EXPECT_EQ(conluio.grupos[1].n, 3);
+  EXPECT_EQ(conluio.grupos[1].membros[0], 20);
+  EXPECT_EQ(conluio.grupos[1].reciprocas, 0);
+  EXPECT_DOUBLE_EQ(conluio.grupos[1].densidade, 0.5);
+  EXPECT_EQ(conluio.grupo[12], 0);
+  EXPECT_EQ(conluio.grupo[22], 1);
+  EXPECT_EQ(conluio.grupo[30], UINT_MAX);
+  EXPECT_EQ(conluio.grupo[41], UINT_MAX);
+  EXPECT_EQ(conluio.grupo[51], UINT_MAX);
+  EXPECT_EQ(avaliacao_conluioLimpar(&conluio), AVALIACAO_SUCESSO);
+
+  /* Grupos menos densos e pares só aparecem pelos limites */
+  EXPECT_EQ(avaliacao_detectarConluio_r(contexto, 5, 3, 0.6, &conluio), AVALIACAO_SUCESSO);
+  EXPECT_EQ(conluio.n, 1);
+  EXPECT_EQ(avaliacao_conluioLimpar(&conluio), AVALIACAO_SUCESSO);
+  EXPECT_EQ(avaliacao_detectarConluio_r(contexto, 2, 2, 1, &conluio), AVALIACAO_SUCESSO);
+  EXPECT_EQ(conluio.n, 3);
+  EXPECT_EQ(conluio.grupos[2].n, 2);
+  EXPECT_EQ(conluio.grupo[31], 2);
+  EXPECT_EQ(avaliacao_conluioLimpar(&conluio), AVALIACAO_SUCESSO);
+}
+
+TEST_F(AvaliacaoArquivos, Busca){
+  avaliacao pagina[4];
+  unsigned int i, lidas;
+  FILE *db;
+
+  ASSERT_NO_FATAL_FAILURE(Preparar("busca", 3));
+  ASSERT_NO_FATAL_FAILURE(Abrir());
+
+  EXPECT_EQ(avaliacao_buscar_r(contexto, "otimo", AVALIACAO_BUSCA_E, 0, pagina, 4, &lidas), AVALIACAO_NAO_ENCONTRADO);
+  EXPECT_EQ(avaliacao_avaliar_r(contexto, 1, 2, 5, (char *)"Entrega rápida, ótimo vendedor"), AVALIACAO_SUCESSO);
+  EXPECT_EQ(avaliacao_avaliar_r(contexto, 2, 1, 3, (char *)"Produto ÓTIMO mas entrega atrasada"), AVALIACAO_SUCESSO);
+  EXPECT_EQ(avaliacao_avaliar_r(contexto, 3, 2, 1, (char *)"Atrasada de novo, atrasada!"), AVALIACAO_SUCESSO);
+  EXPECT_EQ(avaliacao_avaliar_r(contexto, 2, 3, 4, (char *)"Nada a declarar"), AVALIACAO_SUCESSO);
+
+  /* Caixa e acentos não importam */
+  EXPECT_EQ(avaliacao_buscar_r(contexto, "otimo", AVALIACAO_BUSCA_E, 0, pagina, 4, &lidas), AVALIACAO_SUCESSO);
+  ASSERT_EQ(lidas, 2);
+  EXPECT_EQ(pagina[0].identificador, 1);
+  EXPECT_EQ(pagina[0].avaliador, 1);
+  EXPECT_STREQ(pagina[0].comentario, "Entrega rápida, ótimo vendedor");
+  EXPECT_EQ(pagina[1].identificador, 2);
+  EXPECT_EQ(pagina[1].nota, 3);
+  EXPECT_EQ(avaliacao_buscar_r(contexto, "ENTREGA atrasada", AVALIACAO_BUSCA_E, 0, pagina, 4, &lidas), AVALIACAO_SUCESSO);
+  ASSERT_EQ(lidas, 1);
+  EXPECT_EQ(pagina[0].identificador, 2);
+
+  /* Páginas pelo id da última avaliação lida */
+  EXPECT_EQ(avaliacao_buscar_r(contexto, "atrasada rapida", AVALIACAO_BUSCA_OU, 0, pagina, 2, &lidas), AVALIACAO_SUCESSO);
+  ASSERT_EQ(lidas, 2);
+  EXPECT_EQ(pagina[0].identificador, 1);
+  EXPECT_EQ(pagina[1].identificador, 2);
+  EXPECT_EQ(avaliacao_buscar_r(contexto, "atrasada rapida", AVALIACAO_BUSCA_OU, 2, pagina, 2, &lidas), AVALIACAO_SUCESSO);
+  ASSERT_EQ(lidas, 1);
+  EXPECT_EQ(pagina[0].identificador, 3);
+  EXPECT_EQ(avaliacao_buscar_r(contexto, "atrasada rapida", AVALIACAO_BUSCA_OU, 3, pagina, 2, &lidas), AVALIACAO_NAO_ENCONTRADO);
+  EXPECT_EQ(lidas, 0);
+
+  /* Palavra fora do índice */
+  EXPECT_EQ(avaliacao_buscar_r(contexto, "inexistente otimo", AVALIACAO_BUSCA_E, 0, pagina, 4, &lidas), AVALIACAO_NAO_ENCONTRADO);
+  EXPECT_EQ(avaliacao_buscar_r(contexto, "inexistente otimo", AVALIACAO_BUSCA_OU, 0, pagina, 4, &lidas), AVALIACAO_SUCESSO);
+  EXPECT_EQ(lidas, 2);
+  EXPECT_EQ(avaliacao_buscar_r(contexto, " !? ", AVALIACAO_BUSCA_OU, 0, pagina, 4, &lidas), AVALIACAO_VALORINVALIDO);
+  EXPECT_EQ(avaliacao_buscar_r(contexto, "otimo", AVALIACAO_BUSCA_OU, 0, pagina, 0, &lidas), AVALIACAO_VALORINVALIDO);
+
+  /* Avaliações novas e linhas acrescentadas por fora entram na busca seguinte */
+  EXPECT_EQ(avaliacao_avaliar_r(contexto, 1, 3, 5, (char *)"Ótimo atendimento"), AVALIACAO_SUCESSO);
+  EXPECT_EQ(avaliacao_buscar_r(contexto, "otimo", AVALIACAO_BUSCA_E, 2, pagina, 4, &lidas), AVALIACAO_SUCESSO);
+  ASSERT_EQ(lidas, 1);
+  EXPECT_EQ(pagina[0].identificador, 5);
+  EXPECT_EQ(pagina[0].avaliado, 3);
+  EXPECT_EQ(avaliacao_sincronizar_r(contexto), AVALIACAO_SUCESSO);
+  db = fopen(db_avaliacao, "a");
+  ASSERT_TRUE(db != NULL);
+  for(i=0;i<300;i++) fprintf(db, AVALIACAO_DB_ESTRUTURA, 1, 2, 4, "Comum");
+  fprintf(db, AVALIACAO_DB_ESTRUTURA, 3, 1, 0, "Raro e otimo");
+  fclose(db);
+  EXPECT_EQ(avaliacao_buscar_r(contexto, "raro otimo", AVALIACAO_BUSCA_E, 0, pagina, 4, &lidas), AVALIACAO_SUCESSO);
+  ASSERT_EQ(lidas, 1);
+  EXPECT_EQ(pagina[0].identificador, 306);
+  EXPECT_EQ(pagina[0].avaliador, 3);
+  EXPECT_EQ(avaliacao_buscar_r(contexto, "otimo", AVALIACAO_BUSCA_OU, 0, pagina, 4, &lidas), AVALIACAO_SUCESSO);
+  EXPECT_EQ(lidas, 4);
+}
+
+TEST_F(AvaliacaoArquivos, Pontuacao){
+  unsigned int agora = (unsigned int)time(NULL), antigo = agora - 2*365*24*3600, i;
+  avaliacao_pontuacao pontuacao;
+  double global;
+  avaliacao a;
+  FILE *db;
+
+  ASSERT_NO_FATAL_FAILURE(Preparar("pontuacao", 3));
+
+  /* 3 tem notas 3 sem tempo; 2 tem notas 1 antigas e 5 recentes; 1 tem um só 5 */
+  db = fopen(db_avaliacao, "w");
+  ASSERT_TRUE(db != NULL);
+  fprintf(db, "%-4u\n", 31);
+  for(i=0;i<20;i++) fprintf(db, AVALIACAO_DB_ESTRUTURA, 2, 3, 3, "Sem tempo");
+  for(i=0;i<5;i++) fprintf(db, AVALIACAO_DB_ESTRUTURA_TEMPO, 3, 2, 1, "Antiga", antigo);
+  for(i=0;i<5;i++) fprintf(db, AVALIACAO_DB_ESTRUTURA_TEMPO, 3, 2, 5, "Recente", agora);
+  fprintf(db, AVALIACAO_DB_ESTRUTURA_TEMPO, 2, 1, 5, "Primeira", agora);
+  fclose(db);
+  ASSERT_NO_FATAL_FAILURE(Abrir());
+
+  /* O tempo é lido junto com a avaliação */
+  EXPECT_EQ(avaliacao_obterAvaliacao_r(contexto, 2, 1, AVALIADO, &a), AVALIACAO_SUCESSO);
+  EXPECT_EQ(a.tempo, antigo);
+  EXPECT_STREQ(a.comentario, "Antiga");
+  EXPECT_EQ(avaliacao_obterAvaliacao_r(contexto, 3, 1, AVALIADO, &a), AVALIACAO_SUCESSO);
+  EXPECT_EQ(a.tempo, 0);
+
+  /* A primeira consulta inicia a thread, que lê o arquivo em segundo plano */
+  EXPECT_EQ(avaliacao_obterPontuacao_r(contexto, 0, &pontuacao), AVALIACAO_FALHA_SEMSESSAO);
+  for(i=0;i<500;i++) {
+    EXPECT_EQ(avaliacao_obterPontuacao_r(contexto, 1, &pontuacao), AVALIACAO_SUCESSO);
+    if(pontuacao.avaliacoes == 31) break;
+    usleep(10000);
+  }
+  ASSERT_EQ(pontuacao.avaliacoes, 31);
+  global = (20*3 + 5*1 + 5*5 + 5)/31.0;
+  EXPECT_EQ(pontuacao.n, 1);
+  EXPECT_DOUBLE_EQ(pontuacao.media, 5);
+  EXPECT_DOUBLE_EQ(pontuacao.bayesiana, (AVALIACAO_PONTUACAO_PRIORI*global + 5)/(AVALIACAO_PONTUACAO_PRIORI + 1));
+  EXPECT_DOUBLE_EQ(pontuacao.decaida, 5);
+
+  /* As notas antigas quase não pesam na média com decaimento */
+  EXPECT_EQ(avaliacao_obterPontuacao_r(contexto, 2, &pontuacao), AVALIACAO_SUCESSO);
+  EXPECT_DOUBLE_EQ(pontuacao.media, 3);
+  EXPECT_GT(pontuacao.decaida, 4.9);
+  EXPECT_LT(pontuacao.decaida, 5);
+  EXPECT_EQ(avaliacao_obterPontuacao_r(contexto, 3, &pontuacao), AVALIACAO_SUCESSO);
+  EXPECT_EQ(pontuacao.n, 20);
+  EXPECT_DOUBLE_EQ(pontuacao.decaida, 3);
+  EXPECT_EQ(avaliacao_obterPontuacao_r(contexto, 99, &pontuacao), AVALIACAO_SUCESSO);
+  EXPECT_EQ(pontuacao.n, 0);
+  EXPECT_DOUBLE_EQ(pontuacao.bayesiana, global);
+
+  /* Avaliações novas entram depois da gravação do lote, sem nova consulta ao arquivo */
+  EXPECT_EQ(avaliacao_avaliar_r(contexto, 3, 1, 1, (char *)"Segunda"), AVALIACAO_SUCESSO);
+  for(i=0;i<500;i++) {
+    EXPECT_EQ(avaliacao_obterPontuacao_r(contexto, 1, &pontuacao), AVALIACAO_SUCESSO);
+    if(pontuacao.avaliacoes == 32) break;
+    usleep(10000);
+  }
+  EXPECT_EQ(pontuacao.avaliacoes, 32);
+  EXPECT_EQ(pontuacao.n, 2);
+  EXPECT_DOUBLE_EQ(pontuacao.media, 3);
+  EXPECT_EQ(avaliacao_obterAvaliacao_r(contexto, 1, 2, AVALIADO, &a), AVALIACAO_SUCESSO);
+  EXPECT_GE(a.tempo, agora);
+}
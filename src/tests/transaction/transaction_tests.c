@@ -38,6 +38,14 @@ TEST (Initialization, Variables) {
   strcpy(review2, "Sem reclamações.");
 
   usuarios_carregarArquivo();
+
+  /*
+    Os testes partem de um arquivo de avaliações vazio, pois cada par de
+    usuários só se avalia uma vez e os pares usados aqui poderiam já constar
+    no banco de dados.
+   */
+
+  remove(AVALIACAO_DB);
   avaliacao_pegarContador();
 
   EXPECT_EQ(1, true);
@@ -698,6 +706,32 @@ TEST (FinishTransaction, Status_Closed) {
 
 }
 
+/*
+  Teste da função FinishTransaction para um par de usuários que já se avaliou
+  em uma transação anterior, agora com os papéis trocados.
+ */
+
+TEST (FinishTransaction, Repeated_Pair) {
+
+  EXPECT_EQ(StartTransaction(12, &new_product, &new_transaction), Success);
+  EXPECT_EQ(UpdateTransaction(14, &new_transaction), Success);
+  EXPECT_EQ(avaliacao_jaAvaliou(12, 14), AVALIACAO_NAO_ENCONTRADO);
+  EXPECT_EQ(avaliacao_jaAvaliou(14, 12), AVALIACAO_NAO_ENCONTRADO);
+  EXPECT_EQ(FinishTransaction(&new_transaction, 3, 4, review1, review2),
+            Success);
+
+  EXPECT_EQ(StartTransaction(14, &new_product, &new_transaction), Success);
+  EXPECT_EQ(UpdateTransaction(12, &new_transaction), Success);
+
+  EXPECT_EQ(FinishTransaction(&new_transaction, 3, 4, review1, review2),
+            Failure);
+
+  EXPECT_EQ(new_transaction.status, InProgress);
+  EXPECT_EQ(avaliacao_jaAvaliou(14, 12), AVALIACAO_SUCESSO);
+  EXPECT_EQ(avaliacao_jaAvaliou(12, 14), AVALIACAO_SUCESSO);
+
+}
+
 /*
   Teste da função FinishTransaction para uma transação em progresso com usuários
   iguais (algo inválido).
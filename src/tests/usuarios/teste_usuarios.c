@@ -1,5 +1,7 @@
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
+#include <pthread.h>
 #include <gtest/gtest.h>
 #include "usuarios.h"
 #include "aleatorio.h"
@@ -8,6 +10,7 @@ TEST(Usuarios, CriarUsuario){
 	/* Removemos o arquivo de usuários */
 	remove(USUARIOS_DB);
 	remove(USUARIOS_DB_AMIGOS);
+	remove(USUARIOS_DB_WAL);
 	
 	/* Esperamos que a função falhe pois o grafo de usuário não foi carregado ainda */
 	EXPECT_EQ(usuarios_cadastro(8, "usuario", "jose123", "nome", "Jose Antonio", "endereco", "Rua Foo Casa Bar", "email", "joao@antonio.com", "senha", "123456", "senha_confirmacao", "123456", "formaPagamento", BOLETO, "tipo", CONSUMIDOR), USUARIOS_FALHA_GRAFONULL);
@@ -114,6 +117,36 @@ TEST(Usuarios, DadosRetorno){
 	EXPECT_EQ(teste_tipo, CONSUMIDOR);
 }
 
+TEST(Usuarios, DadosRetornoTipado){
+	unsigned int teste_tipo;
+	double teste_avaliacao;
+	char teste_nome[40];
+	
+	EXPECT_EQ(usuarios_campoPorNome("nome"), USUARIOS_CAMPO_NOME);
+	EXPECT_EQ(usuarios_campoPorNome("n_avaliacao"), USUARIOS_CAMPO_N_AVALIACAO);
+	EXPECT_EQ(usuarios_campoPorNome("inexistente"), USUARIOS_CAMPO_INVALIDO);
+	
+	EXPECT_EQ(!strcmp(usuarios_campoTexto(2, USUARIOS_CAMPO_NOME, teste_nome, sizeof(teste_nome)), "Amanda"), 1);
+	EXPECT_EQ(!strcmp(usuarios_campoTexto(1, USUARIOS_CAMPO_USUARIO, teste_nome, sizeof(teste_nome)), "jose123"), 1);
+	EXPECT_TRUE(usuarios_campoTexto(2, USUARIOS_CAMPO_TIPO, teste_nome, sizeof(teste_nome)) == NULL);
+	EXPECT_TRUE(usuarios_campoTexto(100000, USUARIOS_CAMPO_NOME, teste_nome, sizeof(teste_nome)) == NULL);
+	
+	/* O texto é cortado no tamanho do destino */
+	EXPECT_STREQ(usuarios_campoTexto(1, USUARIOS_CAMPO_USUARIO, teste_nome, 5), "jose");
+	
+	EXPECT_EQ(usuarios_campoInteiro(2, USUARIOS_CAMPO_TIPO, &teste_tipo), USUARIOS_SUCESSO);
+	EXPECT_EQ(teste_tipo, CONSUMIDOR);
+	EXPECT_EQ(usuarios_campoInteiro(2, USUARIOS_CAMPO_IDENTIFICADOR, &teste_tipo), USUARIOS_SUCESSO);
+	EXPECT_EQ(teste_tipo, 2);
+	EXPECT_EQ(usuarios_campoInteiro(2, USUARIOS_CAMPO_AVALIACAO, &teste_tipo), USUARIOS_ARGUMENTOINVALIDO);
+	EXPECT_EQ(usuarios_campoReal(2, USUARIOS_CAMPO_AVALIACAO, &teste_avaliacao), USUARIOS_SUCESSO);
+	EXPECT_EQ(teste_avaliacao, 0);
+	EXPECT_EQ(usuarios_campoReal(100000, USUARIOS_CAMPO_AVALIACAO, &teste_avaliacao), USUARIOS_GRAFO_CORROMPIDO);
+	
+	EXPECT_EQ(usuarios_retornaCampo(2, USUARIOS_CAMPO_EMAIL, (void *)teste_nome), USUARIOS_SUCESSO);
+	EXPECT_EQ(!strcmp(teste_nome, "karol@diego.com"), 1);
+}
+
 TEST(Usuarios, AlterarDadosSessao){
 	char teste_nome[40];
 	unsigned int teste_n_reclamacoes;
@@ -203,6 +236,88 @@ TEST(Usuarios, lerArquivo){
 	EXPECT_EQ(usuarios_carregarArquivo(), USUARIOS_SUCESSO);	
 }
 
+TEST(Usuarios, RecuperarLog){
+	char teste_nome[40];
+	FILE *wal;
+	
+	/* Alterações vão para o log e chegam ao arquivo no checkpoint */
+	EXPECT_EQ(usuarios_atualizarDados(2, "nome", "Amanda Log"), USUARIOS_SUCESSO);
+	EXPECT_EQ(usuarios_limpar(), USUARIOS_SUCESSO);
+	EXPECT_EQ(usuarios_carregarArquivo(), USUARIOS_SUCESSO);
+	EXPECT_EQ(usuarios_retornaDados(2, "nome", (void *)teste_nome), USUARIOS_SUCESSO);
+	EXPECT_EQ(!strcmp(teste_nome, "Amanda Log"), 1);
+	EXPECT_EQ(usuarios_limpar(), USUARIOS_SUCESSO);
+	
+	/* Simulamos uma queda com uma entrada no log ainda não aplicada */
+	wal = fopen(USUARIOS_DB_WAL, "a");
+	ASSERT_TRUE(wal != NULL);
+	fprintf(wal, USUARIOS_DB_ESTRUTURA, 2, "amandalinda", "Amanda Nunes", "karol@diego.com", "987654", "Rua Foo 2 Casa Bar", (int)PAYPAL, (int)OFERTANTE, (int)ATIVO, 0.0, 0, 0);
+	fprintf(wal, "2   \tamanda"); /* Entrada incompleta, deve ser ignorada */
+	fclose(wal);
+	
+	EXPECT_EQ(usuarios_carregarArquivo(), USUARIOS_SUCESSO);
+	EXPECT_EQ(usuarios_retornaDados(2, "nome", (void *)teste_nome), USUARIOS_SUCESSO);
+	EXPECT_EQ(!strcmp(teste_nome, "Amanda Nunes"), 1);
+}
+
+/* Cada thread lê repetidamente os dados da sua própria sessão */
+static void *teste_lerSessao(void *argumento){
+	usuarios_token token = *(usuarios_token *)argumento;
+	char usuario[USUARIOS_LIMITE_USUARIO], esperado[USUARIOS_LIMITE_USUARIO];
+	unsigned int i;
+	long erros = 0;
+	
+	if(usuarios_retornaDadosSessao(token, "usuario", (void *)esperado) != USUARIOS_SUCESSO) return (void *)1;
+	for(i=0;i<2000;i++){
+		if(usuarios_retornaDadosSessao(token, "usuario", (void *)usuario) != USUARIOS_SUCESSO || strcmp(usuario, esperado)) erros++;
+		if(usuarios_verificarAmizadeSessao(token, 3) == ERRO) erros++;
+	}
+	return (void *)erros;
+}
+
+TEST(Usuarios, MultiplasSessoes){
+	usuarios_token jose, amanda, outra;
+	unsigned int identificador;
+	char teste_usuario[USUARIOS_LIMITE_USUARIO];
+	pthread_t threads[2];
+	void *erros;
+	
+	/* Duas sessões abertas ao mesmo tempo */
+	EXPECT_EQ(usuarios_loginSessao("jose123", "987654", &jose), USUARIOS_SUCESSO);
+	EXPECT_EQ(usuarios_loginSessao("amandalinda", "987654", &amanda), USUARIOS_SUCESSO);
+	EXPECT_EQ(usuarios_loginSessao("jose123", "errada", &outra), USUARIOS_FALHA_DADOSINCORRETOS);
+	EXPECT_NE(jose, amanda);
+	EXPECT_EQ(usuarios_sessoesAbertas(), 2);
+	EXPECT_EQ(usuarios_sessaoAberta(), 0);
+	
+	EXPECT_EQ(usuarios_sessaoIdentificador(jose, &identificador), USUARIOS_SUCESSO);
+	EXPECT_EQ(identificador, 1);
+	EXPECT_EQ(usuarios_retornaDadosSessao(amanda, "usuario", (void *)teste_usuario), USUARIOS_SUCESSO);
+	EXPECT_EQ(!strcmp(teste_usuario, "amandalinda"), 1);
+	
+	/* Leituras concorrentes */
+	EXPECT_EQ(pthread_create(&threads[0], NULL, teste_lerSessao, &jose), 0);
+	EXPECT_EQ(pthread_create(&threads[1], NULL, teste_lerSessao, &amanda), 0);
+	pthread_join(threads[0], &erros);
+	EXPECT_EQ((long)erros, 0);
+	pthread_join(threads[1], &erros);
+	EXPECT_EQ((long)erros, 0);
+	
+	/* Token de sessão encerrada não é aceito, nem se a posição for reutilizada */
+	EXPECT_EQ(usuarios_logoutSessao(jose), USUARIOS_SUCESSO);
+	EXPECT_EQ(usuarios_logoutSessao(jose), USUARIOS_FALHA_TOKEN);
+	EXPECT_EQ(usuarios_loginSessao("jose123", "987654", &outra), USUARIOS_SUCESSO);
+	EXPECT_NE(outra, jose);
+	EXPECT_EQ(usuarios_sessaoIdentificador(jose, &identificador), USUARIOS_FALHA_TOKEN);
+	EXPECT_EQ(usuarios_retornaDadosSessao(jose, "usuario", (void *)teste_usuario), USUARIOS_FALHA_TOKEN);
+	EXPECT_EQ(usuarios_criarAmizadeSessao(jose, 2), USUARIOS_FALHA_TOKEN);
+	EXPECT_EQ(usuarios_verificarAmizadeSessao(0, 2), ERRO);
+	
+	EXPECT_EQ(usuarios_logoutSessao(outra), USUARIOS_SUCESSO);
+	EXPECT_EQ(usuarios_logoutSessao(amanda), USUARIOS_SUCESSO);
+	EXPECT_EQ(usuarios_sessoesAbertas(), 0);
+}
+
 TEST(Amizade, criarAmizade){
   unsigned int i;
   usuarios_uintarray a;
@@ -296,13 +411,806 @@ TEST(Amizade, amigodeamigo){
   }
 }
 
+TEST(Amizade, recomendarAmigos){
+  usuarios_recomendacao r[20];
+  unsigned int i, n, base = usuarios_max()-99; /* Id de u0 do teste anterior */
+  
+  /* Grupos consecutivos são amigos, u0 tem 25 amigos em comum com o resto do seu grupo e com o grupo 50~75 */
+  EXPECT_EQ(usuarios_recomendarAmigos(base, 10, r, &n), USUARIOS_SUCESSO);
+  EXPECT_EQ(n, 10);
+  EXPECT_EQ(r[0].identificador, base+1);
+  EXPECT_EQ(r[0].mutuos, 25);
+  EXPECT_EQ(r[9].identificador, base+10);
+  
+  /* Solicitação pendente exclui o candidato e invalida o cache */
+  EXPECT_EQ(usuarios_login((char *)"u0", (char *)"0"), USUARIOS_SUCESSO);
+  EXPECT_EQ(usuarios_criarAmizade(base+1), USUARIOS_SUCESSO);
+  EXPECT_EQ(usuarios_logout(), USUARIOS_SUCESSO);
+  EXPECT_EQ(usuarios_recomendarAmigos(base, 10, r, &n), USUARIOS_SUCESSO);
+  EXPECT_EQ(r[0].identificador, base+2);
+  EXPECT_EQ(usuarios_recomendarAmigos(base+1, 20, r, &n), USUARIOS_SUCESSO);
+  for(i=0;i<n;i++) EXPECT_NE(r[i].identificador, base);
+  
+  /* A avaliação pondera os amigos em comum */
+  EXPECT_EQ(usuarios_atualizarDados(base+60, "avaliacao", 5.0), USUARIOS_SUCESSO);
+  EXPECT_EQ(usuarios_removerAmizade(base, base+1), USUARIOS_SUCESSO);
+  EXPECT_EQ(usuarios_recomendarAmigos(base, 20, r, &n), USUARIOS_SUCESSO);
+  EXPECT_EQ(n, 20);
+  EXPECT_EQ(r[0].identificador, base+60);
+  EXPECT_DOUBLE_EQ(r[0].pontuacao, 50.0);
+  EXPECT_EQ(r[1].identificador, base+1);
+  
+  EXPECT_EQ(usuarios_recomendarAmigos(base, 0, r, &n), USUARIOS_SUCESSO);
+  EXPECT_EQ(n, 0);
+  EXPECT_EQ(usuarios_recomendarAmigos(base+1000, 5, r, &n), USUARIOS_FALHAUSUARIONAOEXISTE);
+  EXPECT_EQ(usuarios_atualizarDados(base+60, "avaliacao", 0.0), USUARIOS_SUCESSO);
+}
+
+TEST(Amizade, grauSeparacao){
+  usuarios_uintarray caminho;
+  unsigned int passos, base = usuarios_max()-99;
+  
+  EXPECT_EQ(usuarios_grauSeparacao(base, base, 6, &passos, NULL), USUARIOS_SUCESSO);
+  EXPECT_EQ(passos, 0);
+  EXPECT_EQ(usuarios_grauSeparacao(base, base+30, 6, &passos, NULL), USUARIOS_SUCESSO);
+  EXPECT_EQ(passos, 1);
+  EXPECT_EQ(usuarios_grauSeparacao(base, base+60, 6, &passos, NULL), USUARIOS_SUCESSO);
+  EXPECT_EQ(passos, 2);
+  
+  /* Grupo 75~100 está a três passos do grupo 0~25 */
+  EXPECT_EQ(usuarios_grauSeparacao(base, base+80, 6, &passos, &caminho), USUARIOS_SUCESSO);
+  EXPECT_EQ(passos, 3);
+  ASSERT_EQ(caminho.length, 4);
+  EXPECT_EQ(caminho.array[0], base);
+  EXPECT_TRUE(caminho.array[1] >= base+25 && caminho.array[1] < base+50);
+  EXPECT_TRUE(caminho.array[2] >= base+50 && caminho.array[2] < base+75);
+  EXPECT_EQ(caminho.array[3], base+80);
+  usuarios_freeUint(&caminho);
+  
+  EXPECT_EQ(usuarios_grauSeparacao(base, base+80, 2, &passos, NULL), USUARIOS_FALHA_SEMCAMINHO);
+  EXPECT_EQ(usuarios_grauSeparacao(base, 1, 6, &passos, NULL), USUARIOS_FALHA_SEMCAMINHO);
+  EXPECT_EQ(usuarios_grauSeparacao(base, base+1000, 6, &passos, NULL), USUARIOS_FALHAUSUARIONAOEXISTE);
+}
+
 TEST(Amizade, removerAmizade){
 
 	EXPECT_EQ(usuarios_login((char *)"jose123", (char *)"987654"), USUARIOS_SUCESSO);
 	EXPECT_EQ(usuarios_verificarAmizade(2), AMIGOS);
 	EXPECT_EQ(usuarios_removerAmizade(0, 2), USUARIOS_SUCESSO);
 	EXPECT_EQ(usuarios_logout(), USUARIOS_SUCESSO);
+}
+
+TEST(Amizade, compactarAmizades){
+	unsigned int removidos, i, base = usuarios_max()-99;
+	FILE *db_amigos;
+	long tamanho;
+	
+	/* Desfazemos parte das amizades entre os grupos 50~75 e 75~100 para deixar registros mortos */
+	for(i=60;i<70;i++) EXPECT_EQ(usuarios_removerAmizade(base+i, base+25+i), USUARIOS_SUCESSO);
+	
+	EXPECT_EQ(usuarios_compactarAmizades(&removidos), USUARIOS_SUCESSO);
+	EXPECT_TRUE(removidos >= 20);
+	EXPECT_EQ(usuarios_compactarAmizades(&removidos), USUARIOS_SUCESSO);
+	EXPECT_EQ(removidos, 0);
+	
+	db_amigos = fopen(USUARIOS_DB_AMIGOS, "r");
+	ASSERT_TRUE(db_amigos != NULL);
+	fseek(db_amigos, 0, SEEK_END);
+	tamanho = ftell(db_amigos);
+	fclose(db_amigos);
+	
+	/* Ids renumerados continuam apontando para o registro certo */
+	EXPECT_EQ(usuarios_login((char *)"jose123", (char *)"987654"), USUARIOS_SUCESSO);
+	EXPECT_EQ(usuarios_criarAmizade(2), USUARIOS_SUCESSO);
+	EXPECT_EQ(usuarios_removerAmizade(base+70, base+95), USUARIOS_SUCESSO);
+	EXPECT_EQ(usuarios_logout(), USUARIOS_SUCESSO);
+	
 	EXPECT_EQ(usuarios_limpar(), USUARIOS_SUCESSO);
+	EXPECT_EQ(usuarios_carregarArquivo(), USUARIOS_SUCESSO);
+	EXPECT_EQ(usuarios_login((char *)"jose123", (char *)"987654"), USUARIOS_SUCESSO);
+	EXPECT_EQ(usuarios_verificarAmizade(2), AGUARDANDOCONFIRMACAO);
+	EXPECT_EQ(usuarios_logout(), USUARIOS_SUCESSO);
+	EXPECT_EQ(usuarios_login((char *)"amandalinda", (char *)"987654"), USUARIOS_SUCESSO);
+	EXPECT_EQ(usuarios_verificarAmizade(1), ACONFIRMAR);
+	EXPECT_EQ(usuarios_logout(), USUARIOS_SUCESSO);
+	EXPECT_EQ(usuarios_login((char *)"u70", (char *)"0"), USUARIOS_SUCESSO);
+	EXPECT_EQ(usuarios_verificarAmizade(base+95), NENHUMA);
+	EXPECT_EQ(usuarios_verificarAmizade(base+96), AMIGOS);
+	EXPECT_EQ(usuarios_logout(), USUARIOS_SUCESSO);
+	EXPECT_EQ(usuarios_grauSeparacao(base+70, base+95, 10, &i, NULL), USUARIOS_SUCESSO);
+	EXPECT_EQ(i, 3);
+	EXPECT_EQ(tamanho % USUARIOS_DB_AMIGOS_REGISTRO_TAMANHO, 0);
+	EXPECT_EQ(usuarios_limpar(), USUARIOS_SUCESSO);
+}
+
+/* Cada thread usa um contexto com arquivos próprios */
+static void *teste_contexto(void *argumento){
+	long particao = (long)argumento, erros = 0;
+	char db[USUARIOS_LIMITE_CAMINHO], db_amigos[USUARIOS_LIMITE_CAMINHO], db_wal[USUARIOS_LIMITE_CAMINHO];
+	char usuario[USUARIOS_LIMITE_USUARIO], email[USUARIOS_LIMITE_EMAIL], texto[USUARIOS_LIMITE_NOME];
+	usuarios_contexto *contexto;
+	unsigned int i;
+	
+	sprintf(db, "../../db/contexto%ld_usuarios.txt", particao);
+	sprintf(db_amigos, "../../db/contexto%ld_amigos.txt", particao);
+	sprintf(db_wal, "../../db/contexto%ld_usuarios.wal", particao);
+	remove(db); remove(db_amigos); remove(db_wal);
+	
+	contexto = usuarios_contextoCriar(db, db_amigos, db_wal);
+	if(contexto == NULL) return (void *)1;
+	if(usuarios_carregarArquivo_r(contexto) != USUARIOS_SUCESSO) erros++;
+	for(i=0;i<20;i++){
+		sprintf(usuario, "p%ldu%u", particao, i);
+		sprintf(email, "p%ldu%u@t.com", particao, i);
+		if(usuarios_cadastro_r(contexto, 8, "usuario", usuario, "nome", "Particao", "email", email, "endereco", "Rua", "senha", "123456", "senha_confirmacao", "123456", "formaPagamento", BOLETO, "tipo", CONSUMIDOR) != USUARIOS_SUCESSO) erros++;
+	}
+	sprintf(usuario, "p%ldu0", particao);
+	if(usuarios_login_r(contexto, usuario, (char *)"123456") != USUARIOS_SUCESSO) erros++;
+	if(usuarios_criarAmizade_r(contexto, 2) != USUARIOS_SUCESSO) erros++;
+	if(usuarios_atualizarDados_r(contexto, 2, "nome", "Alterado") != USUARIOS_SUCESSO) erros++;
+	if(usuarios_contextoDestruir(&contexto) != USUARIOS_SUCESSO || contexto != NULL) erros++;
+	
+	/* Relemos do disco */
+	contexto = usuarios_contextoCriar(db, db_amigos, db_wal);
+	if(contexto == NULL) return (void *)(erros+1);
+	if(usuarios_carregarArquivo_r(contexto) != USUARIOS_SUCESSO) erros++;
+	if(usuarios_max_r(contexto) != 20) erros++;
+	if(strcmp(usuarios_campoTexto_r(contexto, 2, USUARIOS_CAMPO_NOME, texto, sizeof(texto)), "Alterado")) erros++;
+	if(usuarios_login_r(contexto, usuario, (char *)"123456") != USUARIOS_SUCESSO) erros++;
+	if(usuarios_verificarAmizade_r(contexto, 2) != AGUARDANDOCONFIRMACAO) erros++;
+	usuarios_contextoDestruir(&contexto);
+	
+	remove(db); remove(db_amigos); remove(db_wal);
+	return (void *)erros;
+}
+
+TEST(Contexto, ContextosIndependentes){
+	pthread_t threads[4];
+	usuarios_contexto *padrao;
+	void *erros;
+	long i;
+	
+	EXPECT_EQ(usuarios_carregarArquivo(), USUARIOS_SUCESSO);
+	int max = usuarios_max();
+	
+	for(i=0;i<4;i++) EXPECT_EQ(pthread_create(&threads[i], NULL, teste_contexto, (void *)i), 0);
+	for(i=0;i<4;i++) {
+		pthread_join(threads[i], &erros);
+		EXPECT_EQ((long)erros, 0);
+	}
+	
+	/* O contexto padrão não é afetado */
+	EXPECT_EQ(usuarios_max(), max);
+	EXPECT_EQ(usuarios_sessaoAberta(), 0);
+	padrao = usuarios_contextoPadrao();
+	EXPECT_EQ(usuarios_contextoDestruir(&padrao), USUARIOS_ARGUMENTOINVALIDO);
+	EXPECT_EQ(usuarios_limpar(), USUARIOS_SUCESSO);
+}
+
+
+/*
+ * Testes com um contexto de usuários sobre arquivos próprios, com nomes
+ * começados pelo prefixo do teste, para não mexer nos arquivos padrão.
+ * TearDown destrói o contexto e apaga os arquivos também quando uma
+ * asserção encerra o teste antes do fim.
+ */
+
+class UsuariosArquivos : public ::testing::Test {
+protected:
+	usuarios_contexto *contexto;
+	char prefixo[USUARIOS_LIMITE_USUARIO];
+	char db_usuarios[USUARIOS_LIMITE_CAMINHO];
+	char db_amigos[USUARIOS_LIMITE_CAMINHO];
+	char db_wal[USUARIOS_LIMITE_CAMINHO];
+	
+	void SetUp(){
+		contexto = NULL;
+		db_usuarios[0] = '\0';
+	}
+	
+	void TearDown(){
+		if(contexto != NULL) {
+			EXPECT_EQ(usuarios_contextoDestruir(&contexto),
+				USUARIOS_SUCESSO);
+		}
+		if(db_usuarios[0] == '\0') return;
+		remove(db_usuarios); remove(db_amigos); remove(db_wal);
+	}
+	
+	/* Define os arquivos do prefixo e os apaga */
+	void Nomear(const char *nome){
+		snprintf(prefixo, sizeof(prefixo), "%s", nome);
+		snprintf(db_usuarios, sizeof(db_usuarios),
+			"../../db/%s_usuarios.txt", prefixo);
+		snprintf(db_amigos, sizeof(db_amigos),
+			"../../db/%s_amigos.txt", prefixo);
+		snprintf(db_wal, sizeof(db_wal),
+			"../../db/%s_usuarios.wal", prefixo);
+		remove(db_usuarios); remove(db_amigos); remove(db_wal);
+	}
+	
+	/* Cria o contexto sobre os arquivos do prefixo, sem carregá-los */
+	void Abrir(){
+		contexto = usuarios_contextoCriar(db_usuarios, db_amigos,
+			db_wal);
+		ASSERT_TRUE(contexto != NULL);
+	}
+	
+	/* Apaga os arquivos do prefixo, carrega e cadastra os usuários 1 a n */
+	void Preparar(const char *nome, unsigned int n){
+		unsigned int i;
+		
+		Nomear(nome);
+		ASSERT_NO_FATAL_FAILURE(Abrir());
+		EXPECT_EQ(usuarios_carregarArquivo_r(contexto),
+			USUARIOS_SUCESSO);
+		for(i=1;i<=n;i++) {
+			EXPECT_EQ(CadastrarNumero(i), USUARIOS_SUCESSO);
+		}
+	}
+	
+	/* Cadastra um usuário com senha "123456" */
+	usuarios_condRet Cadastrar(const char *usuario, const char *email,
+		const char *nome = "Teste", const char *endereco = "Rua",
+		usuarios_tipo_usuario tipo = CONSUMIDOR,
+		usuarios_forma_de_pagamento forma = BOLETO){
+		return usuarios_cadastro_r(contexto, 8, "usuario", usuario,
+			"nome", nome, "email", email, "endereco", endereco,
+			"senha", "123456", "senha_confirmacao", "123456",
+			"formaPagamento", forma, "tipo", tipo);
+	}
+	
+	/* Cadastra o usuário i, com usuario e email formados pelo prefixo */
+	usuarios_condRet CadastrarNumero(unsigned int i,
+		const char *nome = "Teste", const char *endereco = "Rua",
+		usuarios_tipo_usuario tipo = CONSUMIDOR){
+		char usuario[USUARIOS_LIMITE_USUARIO];
+		char email[USUARIOS_LIMITE_EMAIL];
+		
+		snprintf(usuario, sizeof(usuario), "%s%u", prefixo, i);
+		snprintf(email, sizeof(email), "%s%u@t.com", prefixo, i);
+		return Cadastrar(usuario, email, nome, endereco, tipo);
+	}
+	
+	/* Não nulo se o registro do usuário no arquivo contém texto */
+	int ArquivoContem(unsigned int identificador, const char *texto){
+		char linha[USUARIOS_DB_REGISTRO_TAMANHO+1];
+		FILE *arquivo;
+		int contem;
+		
+		arquivo = fopen(db_usuarios, "r");
+		if(arquivo == NULL) return 0;
+		fseek(arquivo,
+			(long)(identificador-1)*USUARIOS_DB_REGISTRO_TAMANHO,
+			SEEK_SET);
+		contem = fgets(linha, sizeof(linha), arquivo) != NULL &&
+			strstr(linha, texto) != NULL;
+		fclose(arquivo);
+		return contem;
+	}
+};
+
+TEST_F(UsuariosArquivos, Pesquisa){
+	const char *nomes[5][2] = {
+		{"silvana", "Silvana Costa"}, {"jsilva", "Joao Silva"},
+		{"marcos", "Marcos Prado"}, {"silvio", "Silvio Santos"},
+		{"ana", "Ana Paula"}
+	};
+	double avaliacoes[5] = {2.0, 4.5, 5.0, 1.0, 3.0};
+	usuarios_uintarray pagina;
+	unsigned int total, i;
+	char email[32];
+	
+	Nomear("pesquisa");
+	ASSERT_NO_FATAL_FAILURE(Abrir());
+	EXPECT_EQ(usuarios_pesquisar_r(contexto, "sil", 0, 10, &pagina, &total),
+		USUARIOS_FALHA_GRAFONULL);
+	EXPECT_EQ(usuarios_carregarArquivo_r(contexto), USUARIOS_SUCESSO);
+	for(i=0;i<5;i++) {
+		sprintf(email, "%s@t.com", nomes[i][0]);
+		EXPECT_EQ(Cadastrar(nomes[i][0], email, nomes[i][1]),
+			USUARIOS_SUCESSO);
+		EXPECT_EQ(usuarios_atualizarDados_r(contexto, i+1, "avaliacao",
+			avaliacoes[i]), USUARIOS_SUCESSO);
+	}
+	EXPECT_EQ(usuarios_pesquisar_r(contexto, "", 0, 10, &pagina, &total),
+		USUARIOS_FALHA_ARGUMENTOSINVALIDOS);
+	
+	/*
+	 * Trecho em qualquer ponto, ordenado pela avaliação:
+	 * jsilva 4.5, silvana 2.0, silvio 1.0
+	 */
+	EXPECT_EQ(usuarios_pesquisar_r(contexto, "SILV", 0, 10, &pagina,
+		&total), USUARIOS_SUCESSO);
+	EXPECT_EQ(total, 3);
+	ASSERT_EQ(pagina.length, 3);
+	EXPECT_EQ(pagina.array[0], 2);
+	EXPECT_EQ(pagina.array[1], 1);
+	EXPECT_EQ(pagina.array[2], 4);
+	usuarios_freeUint(&pagina);
+	
+	/* Paginação */
+	EXPECT_EQ(usuarios_pesquisar_r(contexto, "silv", 1, 2, &pagina,
+		&total), USUARIOS_SUCESSO);
+	EXPECT_EQ(total, 3);
+	ASSERT_EQ(pagina.length, 1);
+	EXPECT_EQ(pagina.array[0], 4);
+	usuarios_freeUint(&pagina);
+	EXPECT_EQ(usuarios_pesquisar_r(contexto, "silv", 2, 2, &pagina,
+		&total), USUARIOS_SUCESSO);
+	EXPECT_EQ(pagina.length, 0);
+	
+	/* Prefixo curto: "ana" e "Ana Paula" são do mesmo usuário, que aparece
+	 * uma vez */
+	EXPECT_EQ(usuarios_pesquisar_r(contexto, "a", 0, 10, &pagina, &total),
+		USUARIOS_SUCESSO);
+	EXPECT_EQ(total, 1);
+	ASSERT_EQ(pagina.length, 1);
+	EXPECT_EQ(pagina.array[0], 5);
+	usuarios_freeUint(&pagina);
+	
+	/* Trigramas presentes fora de ordem não bastam */
+	EXPECT_EQ(usuarios_pesquisar_r(contexto, "anaana", 0, 10, &pagina,
+		&total), USUARIOS_SUCESSO);
+	EXPECT_EQ(total, 0);
+	
+	/* O índice acompanha cadastro e atualizarDados */
+	EXPECT_EQ(usuarios_atualizarDados_r(contexto, 3, "nome",
+		"Marcos Silveira"), USUARIOS_SUCESSO);
+	EXPECT_EQ(usuarios_atualizarDados_r(contexto, 4, "usuario", "santos"),
+		USUARIOS_SUCESSO);
+	EXPECT_EQ(usuarios_atualizarDados_r(contexto, 4, "nome",
+		"Sergio Santos"), USUARIOS_SUCESSO);
+	EXPECT_EQ(Cadastrar("silvia", "silvia@t.com", "Silvia"),
+		USUARIOS_SUCESSO);
+	EXPECT_EQ(usuarios_pesquisar_r(contexto, "silv", 0, 10, &pagina,
+		&total), USUARIOS_SUCESSO);
+	EXPECT_EQ(total, 4);
+	ASSERT_EQ(pagina.length, 4);
+	EXPECT_EQ(pagina.array[0], 3);
+	EXPECT_EQ(pagina.array[1], 2);
+	EXPECT_EQ(pagina.array[2], 1);
+	EXPECT_EQ(pagina.array[3], 6);
+	usuarios_freeUint(&pagina);
+	EXPECT_EQ(usuarios_pesquisar_r(contexto, "s", 0, 10, &pagina, &total),
+		USUARIOS_SUCESSO);
+	EXPECT_EQ(total, 3); /* silvana, santos e silvia */
+	usuarios_freeUint(&pagina);
+}
+
+
+/* Sessão de um contexto lida por uma thread, com faltas de página entre as
+ * leituras */
+typedef struct {
+	usuarios_contexto *contexto;
+	usuarios_token token;
+	unsigned int inicio;
+} teste_sessaoIndice;
+
+static void *teste_lerSessaoIndice(void *argumento){
+	teste_sessaoIndice *sessao = (teste_sessaoIndice *)argumento;
+	usuarios_contexto *contexto = sessao->contexto;
+	usuarios_token token = sessao->token;
+	char usuario[USUARIOS_LIMITE_USUARIO];
+	char esperado[USUARIOS_LIMITE_USUARIO];
+	char nome[USUARIOS_LIMITE_NOME];
+	unsigned int i;
+	long erros = 0;
+	
+	if(usuarios_retornaDadosSessao_r(contexto, token, "usuario",
+		(void *)esperado) != USUARIOS_SUCESSO) return (void *)1;
+	for(i=0;i<500;i++){
+		if(usuarios_retornaDadosSessao_r(contexto, token, "usuario",
+			(void *)usuario) != USUARIOS_SUCESSO) erros++;
+		else if(strcmp(usuario, esperado)) erros++;
+		if(usuarios_retornaDadosSessao_r(contexto, token, "nome",
+			(void *)nome) != USUARIOS_SUCESSO) erros++;
+		if(usuarios_verificarAmizadeSessao_r(contexto, token,
+			sessao->inicio + i%20) == ERRO) erros++;
+	}
+	return (void *)erros;
+}
+
+TEST_F(UsuariosArquivos, CarregarIndice){
+	usuarios_uintarray pagina;
+	char usuario[USUARIOS_LIMITE_USUARIO];
+	char nome[USUARIOS_LIMITE_NOME];
+	unsigned int i, total;
+	teste_sessaoIndice sessoes[2];
+	pthread_t threads[2];
+	void *erros;
+	
+	ASSERT_NO_FATAL_FAILURE(Preparar("indice", 50));
+	EXPECT_EQ(usuarios_login_r(contexto, (char *)"indice1",
+		(char *)"123456"), USUARIOS_SUCESSO);
+	EXPECT_EQ(usuarios_criarAmizade_r(contexto, 2), USUARIOS_SUCESSO);
+	EXPECT_EQ(usuarios_limpar_r(contexto), USUARIOS_SUCESSO);
+	
+	/* Só os nomes de usuário e o grafo são carregados */
+	EXPECT_EQ(usuarios_carregarIndice_r(contexto, 8), USUARIOS_SUCESSO);
+	EXPECT_EQ(usuarios_max_r(contexto), 50);
+	EXPECT_EQ(usuarios_registrosResidentes_r(contexto), 0);
+	
+	/* Campos quentes e listas vêm do vetor denso, sem ler registros */
+	EXPECT_EQ(usuarios_campoInteiro_r(contexto, 5, USUARIOS_CAMPO_TIPO,
+		&total), USUARIOS_SUCESSO);
+	EXPECT_EQ(total, CONSUMIDOR);
+	EXPECT_EQ(usuarios_campoInteiro_r(contexto, 5,
+		USUARIOS_CAMPO_IDENTIFICADOR, &total), USUARIOS_SUCESSO);
+	EXPECT_EQ(total, 5);
+	EXPECT_EQ(usuarios_listarAmigosPendentes_r(contexto, 2, &pagina),
+		USUARIOS_SUCESSO);
+	usuarios_freeUint(&pagina);
+	EXPECT_EQ(usuarios_registrosResidentes_r(contexto), 0);
+	
+	EXPECT_EQ(usuarios_login_r(contexto, (char *)"indice1",
+		(char *)"errada"), USUARIOS_FALHA_DADOSINCORRETOS);
+	EXPECT_EQ(usuarios_login_r(contexto, (char *)"indice1",
+		(char *)"123456"), USUARIOS_SUCESSO);
+	EXPECT_EQ(usuarios_registrosResidentes_r(contexto), 1);
+	EXPECT_EQ(usuarios_verificarAmizade_r(contexto, 2),
+		AGUARDANDOCONFIRMACAO);
+	
+	/* Alteração seguida de mais faltas que páginas: o registro sai da
+	 * memória e volta atualizado */
+	EXPECT_EQ(usuarios_atualizarDados_r(contexto, 3, "nome", "Trocado"),
+		USUARIOS_SUCESSO);
+	
+	/* Páginas só lidas saem sem checkpoint: o arquivo ainda não tem a
+	 * alteração */
+	for(i=10;i<=30;i++) {
+		EXPECT_EQ(usuarios_retornaDados_r(contexto, i, "nome", nome),
+			USUARIOS_SUCESSO);
+		EXPECT_EQ(usuarios_retornaDados_r(contexto, 3, "nome", nome),
+			USUARIOS_SUCESSO);
+	}
+	EXPECT_FALSE(ArquivoContem(3, "Trocado"));
+	
+	for(i=4;i<=50;i++) {
+		EXPECT_EQ(usuarios_retornaDados_r(contexto, i, "nome", nome),
+			USUARIOS_SUCESSO);
+		EXPECT_STREQ(nome, "Teste");
+	}
+	EXPECT_EQ(usuarios_registrosResidentes_r(contexto), 8);
+	EXPECT_STREQ(usuarios_campoTexto_r(contexto, 3, USUARIOS_CAMPO_NOME,
+		nome, sizeof(nome)), "Trocado");
+	
+	/* A página alterada saiu com checkpoint */
+	EXPECT_TRUE(ArquivoContem(3, "Trocado"));
+	
+	/* A sessão não sai da memória */
+	EXPECT_EQ(usuarios_retornaDados_r(contexto, 0, "usuario", usuario),
+		USUARIOS_SUCESSO);
+	EXPECT_STREQ(usuario, "indice1");
+	EXPECT_EQ(usuarios_logout_r(contexto), USUARIOS_SUCESSO);
+	
+	/* Cadastro verifica repetições sem os registros na memória */
+	EXPECT_EQ(Cadastrar("indice7", "novo@t.com"), USUARIOS_USUARIOEXISTE);
+	EXPECT_EQ(Cadastrar("novo", "indice40@t.com"), USUARIOS_USUARIOEXISTE);
+	EXPECT_EQ(Cadastrar("novo", "novo@t.com", "Novo"), USUARIOS_SUCESSO);
+	EXPECT_EQ(usuarios_atualizarDados_r(contexto, 51, "usuario",
+		"renomeado"), USUARIOS_SUCESSO);
+	EXPECT_EQ(usuarios_login_r(contexto, (char *)"renomeado",
+		(char *)"123456"), USUARIOS_SUCESSO);
+	EXPECT_EQ(usuarios_logout_r(contexto), USUARIOS_SUCESSO);
+	
+	EXPECT_EQ(usuarios_pesquisar_r(contexto, "troca", 0, 10, &pagina,
+		&total), USUARIOS_SUCESSO);
+	ASSERT_EQ(pagina.length, 1);
+	EXPECT_EQ(pagina.array[0], 3);
+	usuarios_freeUint(&pagina);
+	EXPECT_TRUE(usuarios_registrosResidentes_r(contexto) <= 8);
+	
+	/* Sessões por token em paralelo: cada leitura pode trazer e descartar
+	 * páginas */
+	sessoes[0].contexto = sessoes[1].contexto = contexto;
+	sessoes[0].inicio = 10;
+	sessoes[1].inicio = 30;
+	EXPECT_EQ(usuarios_loginSessao_r(contexto, "indice4", "123456",
+		&sessoes[0].token), USUARIOS_SUCESSO);
+	EXPECT_EQ(usuarios_loginSessao_r(contexto, "indice6", "123456",
+		&sessoes[1].token), USUARIOS_SUCESSO);
+	for(i=0;i<2;i++) {
+		EXPECT_EQ(pthread_create(&threads[i], NULL,
+			teste_lerSessaoIndice, &sessoes[i]), 0);
+	}
+	for(i=0;i<2;i++) {
+		pthread_join(threads[i], &erros);
+		EXPECT_EQ((long)erros, 0);
+		EXPECT_EQ(usuarios_logoutSessao_r(contexto, sessoes[i].token),
+			USUARIOS_SUCESSO);
+	}
+	EXPECT_TRUE(usuarios_registrosResidentes_r(contexto) <= 8);
+	
+	/* O carregamento completo vê as mesmas alterações */
+	EXPECT_EQ(usuarios_limpar_r(contexto), USUARIOS_SUCESSO);
+	EXPECT_EQ(usuarios_carregarArquivo_r(contexto), USUARIOS_SUCESSO);
+	EXPECT_EQ(usuarios_registrosResidentes_r(contexto), 51);
+	EXPECT_STREQ(usuarios_campoTexto_r(contexto, 3, USUARIOS_CAMPO_NOME,
+		nome, sizeof(nome)), "Trocado");
+	EXPECT_STREQ(usuarios_campoTexto_r(contexto, 51,
+		USUARIOS_CAMPO_USUARIO, nome, sizeof(nome)), "renomeado");
+}
+
+
+TEST_F(UsuariosArquivos, CargaParalela){
+	usuarios_uintarray amigos;
+	FILE *arquivo;
+	unsigned int threads[] = {1, 4, 16};
+	unsigned int i, k, soma[3], total[3];
+	char usuario[USUARIOS_LIMITE_USUARIO], email[USUARIOS_LIMITE_EMAIL];
+	
+	/* Geramos direto no formato dos arquivos, até o limite de 4 dígitos dos
+	 * identificadores */
+	Nomear("carga");
+	arquivo = fopen(db_usuarios, "w");
+	ASSERT_TRUE(arquivo != NULL);
+	for(i=1;i<=9000;i++) {
+		sprintf(usuario, "carga%u", i);
+		sprintf(email, "carga%u@t.com", i);
+		fprintf(arquivo, USUARIOS_DB_ESTRUTURA, i, usuario, "Carga",
+			email, "123456", "Rua", BOLETO, CONSUMIDOR, 0, 0.0, 0,
+			0);
+	}
+	fclose(arquivo);
+	/* Grupos de cinco registros: dois pares i <-> i+1 e um morto */
+	arquivo = fopen(db_amigos, "w");
+	ASSERT_TRUE(arquivo != NULL);
+	for(i=1, k=1;k<=9000;k+=5, i+=4) {
+		fprintf(arquivo, "%-4d\t%-4u\t%-4u\n", k, i, i+1);
+		fprintf(arquivo, "%-4d\t%-4u\t%-4u\n", k+1, i+1, i);
+		fprintf(arquivo, "%-4d\t%-4u\t%-4u\n", k+2, i+2, i+3);
+		fprintf(arquivo, "%-4d\t%-4u\t%-4u\n", k+3, i+3, i+2);
+		fprintf(arquivo, "%4d\t%4u\t%4u\n", 0, 0, 0);
+	}
+	fclose(arquivo);
+	
+	ASSERT_NO_FATAL_FAILURE(Abrir());
+	for(k=0;k<3;k++) {
+		usuarios_threadsCarga_r(contexto, threads[k]);
+		EXPECT_EQ(usuarios_carregarArquivo_r(contexto),
+			USUARIOS_SUCESSO);
+		
+		EXPECT_EQ(usuarios_max_r(contexto), 9000);
+		EXPECT_STREQ(usuarios_campoTexto_r(contexto, 8999,
+			USUARIOS_CAMPO_USUARIO, usuario, sizeof(usuario)),
+			"carga8999");
+		EXPECT_STREQ(usuarios_campoTexto_r(contexto, 4321,
+			USUARIOS_CAMPO_EMAIL, email, sizeof(email)),
+			"carga4321@t.com");
+		/* O grafo não depende do número de threads */
+		soma[k] = total[k] = 0;
+		for(i=1;i<=9000;i++) {
+			ASSERT_EQ(usuarios_listarAmigos_r(contexto, i, &amigos),
+				USUARIOS_SUCESSO);
+			total[k] += amigos.length;
+			if(amigos.length) soma[k] += i*amigos.array[0];
+			usuarios_freeUint(&amigos);
+		}
+		EXPECT_EQ(total[k], total[0]);
+		EXPECT_EQ(soma[k], soma[0]);
+		EXPECT_EQ(usuarios_limpar_r(contexto), USUARIOS_SUCESSO);
+	}
+	EXPECT_EQ(total[0], 7200);
+}
+
+
+TEST_F(UsuariosArquivos, Consultar){
+	usuarios_filtro filtro = USUARIOS_FILTRO_TODOS;
+	usuarios_uintarray ids;
+	aleatorio_estado estado;
+	unsigned int i, j, k, tipo, situacao, esperados;
+	double avaliacao;
+	
+	ASSERT_NO_FATAL_FAILURE(Preparar("consulta", 0));
+	for(i=1;i<=60;i++) {
+		EXPECT_EQ(CadastrarNumero(i, "Consulta", "Rua",
+			(i%3 == 0) ? OFERTANTE : CONSUMIDOR), USUARIOS_SUCESSO);
+	}
+	
+	/* Todos os usuários, em ordem de id */
+	EXPECT_EQ(usuarios_consultar_r(contexto, &filtro, &ids),
+		USUARIOS_SUCESSO);
+	ASSERT_EQ(ids.length, 60);
+	for(i=0;i<60;i++) EXPECT_EQ(ids.array[i], i+1);
+	usuarios_freeUint(&ids);
+	
+	filtro.tipo = 7;
+	EXPECT_EQ(usuarios_consultar_r(contexto, &filtro, &ids),
+		USUARIOS_ARGUMENTOINVALIDO);
+	
+	/* Alterações depois da construção, conferidas contra uma busca
+	 * exaustiva */
+	semearAleatorio_r(&estado, 38);
+	for(k=0;k<5;k++) {
+		for(j=0;j<40;j++) {
+			i = 1 + numeroAleatorio_r(&estado, 60);
+			avaliacao = (double)numeroAleatorio_r(&estado, 11)/2;
+			EXPECT_EQ(usuarios_atualizarDados_r(contexto, i,
+				"avaliacao", avaliacao), USUARIOS_SUCESSO);
+			if(j%4 == 0) {
+				situacao = numeroAleatorio_r(&estado, 4);
+				EXPECT_EQ(usuarios_atualizarDados_r(contexto,
+					i, "estado", (int)situacao),
+					USUARIOS_SUCESSO);
+			}
+		}
+		
+		filtro.tipo = OFERTANTE;
+		filtro.estado = ATIVO;
+		filtro.avaliacaoMinima = 2.0 + k/2.0;
+		filtro.avaliacaoMaxima = (k == 4) ? DBL_MAX : 4.5;
+		EXPECT_EQ(usuarios_consultar_r(contexto, &filtro, &ids),
+			USUARIOS_SUCESSO);
+		for(i=1, j=0, esperados=0;i<=60;i++) {
+			usuarios_campoInteiro_r(contexto, i,
+				USUARIOS_CAMPO_TIPO, &tipo);
+			usuarios_campoInteiro_r(contexto, i,
+				USUARIOS_CAMPO_ESTADO, &situacao);
+			usuarios_campoReal_r(contexto, i,
+				USUARIOS_CAMPO_AVALIACAO, &avaliacao);
+			if(
+				tipo != OFERTANTE || situacao != ATIVO ||
+				avaliacao < filtro.avaliacaoMinima ||
+				avaliacao > filtro.avaliacaoMaxima
+			) continue;
+			esperados++;
+			if(j < ids.length) {
+				EXPECT_EQ(ids.array[j++], i);
+			}
+		}
+		EXPECT_EQ(ids.length, esperados);
+		usuarios_freeUint(&ids);
+	}
+	
+	/* Cadastro depois da construção */
+	EXPECT_EQ(Cadastrar("consultanovo", "novo@t.com", "Consulta", "Rua",
+		CONSUMIDOR, PAYPAL), USUARIOS_SUCESSO);
+	filtro.tipo = USUARIOS_QUALQUER;
+	filtro.estado = USUARIOS_QUALQUER;
+	filtro.formaPagamento = PAYPAL;
+	filtro.avaliacaoMinima = 0;
+	filtro.avaliacaoMaxima = 0;
+	EXPECT_EQ(usuarios_consultar_r(contexto, &filtro, &ids),
+		USUARIOS_SUCESSO);
+	ASSERT_EQ(ids.length, 1);
+	EXPECT_EQ(ids.array[0], 61);
+	usuarios_freeUint(&ids);
+}
+
+TEST_F(UsuariosArquivos, Internar){
+	usuarios_uintarray ids;
+	char nome[USUARIOS_LIMITE_NOME], texto[USUARIOS_LIMITE_ENDERECO];
+	unsigned int i, total;
+	
+	ASSERT_NO_FATAL_FAILURE(Preparar("interno", 0));
+	for(i=1;i<=30;i++) {
+		sprintf(nome, "Nome %u", i%3);
+		EXPECT_EQ(CadastrarNumero(i, nome, "Rua Comum"),
+			USUARIOS_SUCESSO);
+	}
+	
+	/* Três nomes e um endereço, compartilhados */
+	EXPECT_EQ(usuarios_textosInternados_r(contexto), 4);
+	EXPECT_STREQ(usuarios_campoTexto_r(contexto, 1, USUARIOS_CAMPO_ENDERECO,
+		texto, sizeof(texto)), "Rua Comum");
+	EXPECT_STREQ(usuarios_campoTexto_r(contexto, 4, USUARIOS_CAMPO_NOME,
+		texto, sizeof(texto)), "Nome 1");
+	
+	/* O último usuário de "Nome 0" muda, o texto é liberado e a entrada
+	 * reaproveitada */
+	for(i=3;i<=30;i+=3) {
+		EXPECT_EQ(usuarios_atualizarDados_r(contexto, i, "nome",
+			"Nome 1"), USUARIOS_SUCESSO);
+	}
+	EXPECT_EQ(usuarios_textosInternados_r(contexto), 3);
+	EXPECT_EQ(usuarios_atualizarDados_r(contexto, 30, "endereco",
+		"Rua Nova"), USUARIOS_SUCESSO);
+	EXPECT_EQ(usuarios_textosInternados_r(contexto), 4);
+	EXPECT_STREQ(usuarios_campoTexto_r(contexto, 30,
+		USUARIOS_CAMPO_ENDERECO, texto, sizeof(texto)), "Rua Nova");
+	EXPECT_STREQ(usuarios_campoTexto_r(contexto, 29,
+		USUARIOS_CAMPO_ENDERECO, texto, sizeof(texto)), "Rua Comum");
+	
+	/* A pesquisa vê o nome novo */
+	EXPECT_EQ(usuarios_pesquisar_r(contexto, "nome 0", 0, 10, &ids, &total),
+		USUARIOS_SUCESSO);
+	EXPECT_EQ(total, 0);
+	usuarios_freeUint(&ids);
+	EXPECT_EQ(usuarios_pesquisar_r(contexto, "nome 1", 0, 10, &ids, &total),
+		USUARIOS_SUCESSO);
+	EXPECT_EQ(total, 20);
+	usuarios_freeUint(&ids);
+	
+	/* O arquivo guarda os textos, não os handles */
+	EXPECT_EQ(usuarios_limpar_r(contexto), USUARIOS_SUCESSO);
+	EXPECT_EQ(usuarios_textosInternados_r(contexto), 0);
+	EXPECT_EQ(usuarios_carregarIndice_r(contexto, USUARIOS_PAGINAS_MINIMO),
+		USUARIOS_SUCESSO);
+	for(i=1;i<=30;i++) {
+		EXPECT_STREQ(usuarios_campoTexto_r(contexto, i,
+			USUARIOS_CAMPO_NOME, texto, sizeof(texto)),
+			(i%3 == 2) ? "Nome 2" : "Nome 1");
+	}
+	EXPECT_STREQ(usuarios_campoTexto_r(contexto, 30,
+		USUARIOS_CAMPO_ENDERECO, texto, sizeof(texto)), "Rua Nova");
+	
+	/* Carregar de novo sem usuarios_limpar descarta o grafo anterior */
+	EXPECT_EQ(usuarios_login_r(contexto, (char *)"interno4",
+		(char *)"123456"), USUARIOS_SUCESSO);
+	EXPECT_EQ(usuarios_carregarArquivo_r(contexto), USUARIOS_SUCESSO);
+	EXPECT_EQ(usuarios_sessaoAberta_r(contexto), 0);
+	EXPECT_EQ(usuarios_max_r(contexto), 30);
+	EXPECT_EQ(usuarios_registrosResidentes_r(contexto), 30);
+	EXPECT_EQ(usuarios_textosInternados_r(contexto), 4);
+	EXPECT_STREQ(usuarios_campoTexto_r(contexto, 30,
+		USUARIOS_CAMPO_ENDERECO, texto, sizeof(texto)), "Rua Nova");
+}
+
+TEST_F(UsuariosArquivos, Disponibilidade){
+	usuarios_estatisticas_disponibilidade estatisticas;
+	
+	ASSERT_NO_FATAL_FAILURE(Preparar("disponivel", 600));
+	
+	/* Todos os dados eram livres: o filtro respondeu ou errou, nunca
+	 * confirmou */
+	usuarios_estatisticasDisponibilidade_r(contexto, &estatisticas);
+	EXPECT_EQ(estatisticas.consultas, 1200);
+	EXPECT_EQ(estatisticas.rejeitadas + estatisticas.falsos_positivos,
+		1200);
+	EXPECT_EQ(estatisticas.confirmadas, 0);
+	/* Com USUARIOS_DISPONIBILIDADE_CONTADORES contadores por texto a taxa
+	 * esperada fica bem abaixo de 1% */
+	EXPECT_LE((double)estatisticas.falsos_positivos/(estatisticas.rejeitadas
+		+ estatisticas.falsos_positivos), 0.01);
+	
+	/* Repetições ainda são achadas */
+	EXPECT_EQ(Cadastrar("disponivel7", "outro@t.com"),
+		USUARIOS_USUARIOEXISTE);
+	EXPECT_EQ(Cadastrar("outro", "disponivel7@t.com"),
+		USUARIOS_USUARIOEXISTE);
+	usuarios_estatisticasDisponibilidade_r(contexto, &estatisticas);
+	EXPECT_EQ(estatisticas.confirmadas, 2);
+	
+	/* Um usuario trocado sai do filtro e o novo entra */
+	EXPECT_EQ(usuarios_atualizarDados_r(contexto, 7, "usuario", "trocado"),
+		USUARIOS_SUCESSO);
+	EXPECT_EQ(Cadastrar("trocado", "trocado@t.com"),
+		USUARIOS_USUARIOEXISTE);
+	EXPECT_EQ(Cadastrar("disponivel7", "trocado@t.com"), USUARIOS_SUCESSO);
+	
+	/* No modo preguiçoso os emails vêm do arquivo */
+	EXPECT_EQ(usuarios_limpar_r(contexto), USUARIOS_SUCESSO);
+	EXPECT_EQ(usuarios_carregarIndice_r(contexto, USUARIOS_PAGINAS_MINIMO),
+		USUARIOS_SUCESSO);
+	EXPECT_EQ(Cadastrar("preguicoso", "disponivel300@t.com"),
+		USUARIOS_USUARIOEXISTE);
+	EXPECT_EQ(Cadastrar("preguicoso", "preguicoso@t.com"),
+		USUARIOS_SUCESSO);
+	EXPECT_EQ(Cadastrar("trocado", "trocado2@t.com"),
+		USUARIOS_USUARIOEXISTE);
+}
+
+TEST(Aleatorio, SementeReprodutivel){
+	aleatorio_estado a, b;
+	char *x, *y;
+	unsigned int i;
+	
+	semearAleatorio_r(&a, 42);
+	semearAleatorio_r(&b, 42);
+	for(i=0;i<1000;i++) {
+		EXPECT_LT(numeroAleatorio_r(&a, 7), 7);
+		numeroAleatorio_r(&b, 7);
+	}
+	x = stringAleatoria_r(&a, 16);
+	y = stringAleatoria_r(&b, 16);
+	EXPECT_STREQ(x, y);
+	EXPECT_EQ(strlen(x), 15);
+	free(x); free(y);
+	
+	/* Sementes diferentes, sequências diferentes */
+	semearAleatorio_r(&b, 43);
+	EXPECT_NE(proximoAleatorio_r(&a), proximoAleatorio_r(&b));
 }
 
 
@@ -212,8 +212,9 @@ errorLevel CreateTransaction(unsigned int user_id1, unsigned int user_id2,
  * @param comment2 Comentário feito pelo segundo usuário acerca do primeiro
  * usuário.
  * @return A função retorna uma instância do tipo errorLevel: Success caso a
- * transação seja finalizada com sucesso; Failure caso as avaliações feitas
- * pelos usuários não sejam lançadas com sucesso; Illegal_argument caso os
+ * transação seja finalizada com sucesso; Failure caso um dos usuários já
+ * tenha avaliado o outro ou caso as avaliações feitas pelos usuários não
+ * sejam lançadas com sucesso; Illegal_argument caso os
  * argumentos passados para a finalização da transação sejam inválidos, caso a
  * transação em si seja inválida ou caso um dos argumentos passados seja um
  * ponteiro nulo.
@@ -231,6 +232,7 @@ errorLevel CreateTransaction(unsigned int user_id1, unsigned int user_id2,
  *  -A transação given_transaction deve ser uma transação válida.
  *  -A transação given_transaction deve ter estado igual a "InProgress".
  *  -Os parâmetros grade1 e grade2 devem ser números entre 0 e 5.
+ *  -Nenhum dos usuários da transação pode ter avaliado o outro antes.
  *
  * Assertivas de saída:
  *  -O estado de given_transaction será "Closed".
@@ -282,6 +284,18 @@ errorLevel FinishTransaction(
     entre os usuários, diz-se que a finalização de transação falhou.
    */
 
+  /*
+    Cada par de usuários avalia um ao outro uma única vez. A verificação das
+    duas direções vem antes de qualquer avaliação, assim uma transação recusada
+    não deixa avaliação pela metade.
+   */
+
+  if(avaliacao_jaAvaliou(given_transaction->user1, given_transaction->user2)
+     != AVALIACAO_NAO_ENCONTRADO
+     || avaliacao_jaAvaliou(given_transaction->user2, given_transaction->user1)
+     != AVALIACAO_NAO_ENCONTRADO)
+    return Failure;
+
   if(avaliacao_avaliar(given_transaction->user1, given_transaction->user2,
                        grade1, comment1) != AVALIACAO_SUCESSO
      || avaliacao_avaliar(given_transaction->user2, given_transaction->user1,
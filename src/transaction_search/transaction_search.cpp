@@ -1090,7 +1090,7 @@ int MatchesRestriction(unsigned int original_user, unsigned int given_user,
    */
 
   if(restriction == NULL || original_user == 0 || given_user == 0
-     || (usuarios_retornaDados(given_user, "avaliacao", &rating)
+     || (usuarios_campoReal(given_user, USUARIOS_CAMPO_AVALIACAO, &rating)
      != USUARIOS_SUCESSO)) {
     return -1;
   }
@@ -1,34 +1,141 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
 #include "../include/aleatorio.h"
 
+/*!
+ * @brief Estado usado pelas funções sem _r, semeado de /dev/urandom no primeiro uso
+*/
+static aleatorio_estado aleatorio_padrao;
+static int aleatorio_semeado = 0;
+static pthread_mutex_t aleatorio_trava = PTHREAD_MUTEX_INITIALIZER;
+
+/*!
+ * @brief Passo do splitmix64, usado para espalhar a semente pelo estado
+*/
+static uint64_t aleatorio_splitmix(uint64_t *x){
+	uint64_t z = (*x += 0x9E3779B97F4A7C15ULL);
+	z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+	z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+	return z ^ (z >> 31);
+}
+
+static uint64_t aleatorio_rotacionar(uint64_t x, int k){
+	return (x << k) | (x >> (64 - k));
+}
+
+/*!
+ * @brief Semeia um gerador; a mesma semente sempre gera a mesma sequência
+*/
+void semearAleatorio_r(aleatorio_estado *estado, uint64_t semente){
+	int i;
+	for(i=0;i<4;i++) estado->s[i] = aleatorio_splitmix(&semente);
+}
+
+/*!
+ * @brief Próximos 64 bits do gerador (xoshiro256**)
+*/
+uint64_t proximoAleatorio_r(aleatorio_estado *estado){
+	uint64_t *s = estado->s;
+	uint64_t resultado = aleatorio_rotacionar(s[1] * 5, 7) * 9;
+	uint64_t t = s[1] << 17;
+
+	s[2] ^= s[0];
+	s[3] ^= s[1];
+	s[1] ^= s[2];
+	s[0] ^= s[3];
+	s[2] ^= t;
+	s[3] = aleatorio_rotacionar(s[3], 45);
+
+	return resultado;
+}
+
+/*!
+ * @brief Gera um número aleatório em [0, limite), ou qualquer unsigned int se limite for 0
+*/
+unsigned int numeroAleatorio_r(aleatorio_estado *estado, unsigned int limite){
+	uint32_t x = (uint32_t)(proximoAleatorio_r(estado) >> 32);
+	/* Multiplicação no lugar do resto: mais rápida e sem preferir os menores valores */
+	return limite ? (unsigned int)(((uint64_t)x * limite) >> 32) : x;
+}
+
+/*!
+ * @brief Gera um real uniforme em [0, 1)
+*/
+double realAleatorio_r(aleatorio_estado *estado){
+	return (proximoAleatorio_r(estado) >> 11) * (1.0 / 9007199254740992.0);
+}
+
 /*!
  * @brief Gera uma string aleatória composta por letras minúsculas
- * 
- * Recebe o tamanho e retorna a string alocada dinamicamente
- * 
+ *
+ * Recebe o tamanho, incluindo o '\0', e retorna a string alocada dinamicamente
+ *
  * Deve-se fazer free após uso
 */
-char *stringAleatoria(unsigned int size){
+char *stringAleatoria_r(aleatorio_estado *estado, unsigned int size){
 	if(size == 0) return NULL;
 	char *string = (char *)malloc(size);
 	unsigned int i=0;
 	if(string == NULL) return NULL;
-	FILE *random = fopen("/dev/urandom", "r");
 	for(;i<size-1;i++)
-		string[i] = 97 + fgetc(random)%26;
+		string[i] = 97 + numeroAleatorio_r(estado, 26);
 	string[i] = '\0';
-	fclose(random);
-	return string;	
+	return string;
+}
+
+/*!
+ * @brief Garante que o estado padrão foi semeado; chamada com aleatorio_trava
+*/
+static void aleatorio_iniciarPadrao(){
+	uint64_t semente;
+	FILE *random;
+
+	if(aleatorio_semeado) return;
+	random = fopen("/dev/urandom", "r");
+	if(random == NULL || fread(&semente, sizeof(semente), 1, random) != 1)
+		semente = (uint64_t)time(NULL) ^ ((uint64_t)getpid() << 32);
+	if(random != NULL) fclose(random);
+	semearAleatorio_r(&aleatorio_padrao, semente);
+	aleatorio_semeado = 1;
+}
+
+/*!
+ * @brief Semeia o gerador padrão, tornando stringAleatoria e numeroAleatorio reprodutíveis
+*/
+void semearAleatorio(uint64_t semente){
+	pthread_mutex_lock(&aleatorio_trava);
+	semearAleatorio_r(&aleatorio_padrao, semente);
+	aleatorio_semeado = 1;
+	pthread_mutex_unlock(&aleatorio_trava);
+}
+
+/*!
+ * @brief Gera uma string aleatória composta por letras minúsculas
+ *
+ * Recebe o tamanho e retorna a string alocada dinamicamente
+ *
+ * Deve-se fazer free após uso
+*/
+char *stringAleatoria(unsigned int size){
+	char *string;
+	pthread_mutex_lock(&aleatorio_trava);
+	aleatorio_iniciarPadrao();
+	string = stringAleatoria_r(&aleatorio_padrao, size);
+	pthread_mutex_unlock(&aleatorio_trava);
+	return string;
 }
 
 /*!
  * @brief Gera um número aleatório dado o limite
 */
 unsigned int numeroAleatorio(unsigned int limite){
-	FILE *random = fopen("/dev/urandom", "r");
 	unsigned int retorno;
-	fread(&retorno, sizeof(unsigned int), 1, random);
-	fclose(random);
-	return limite?(retorno%limite):retorno;
+	pthread_mutex_lock(&aleatorio_trava);
+	aleatorio_iniciarPadrao();
+	retorno = numeroAleatorio_r(&aleatorio_padrao, limite);
+	pthread_mutex_unlock(&aleatorio_trava);
+	return retorno;
 }
@@ -5,52 +5,526 @@
  * @brief Implementação do módulo de usuários
  */
 
+#include <stddef.h>
+#include <limits.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include "usuarios.h"
 
 /*!
- * @brief Grafo de usuários
+ * @brief Descritores dos campos de tpUsuario, indexados por usuarios_campo
 */
-static grafo *usuarios_grafo = NULL; 
+static const usuarios_descritor_campo usuarios_campos[] = {
+  {"identificador", USUARIOS_TIPO_INTEIRO, offsetof(tpUsuario, identificador), offsetof(usuarios_quente, identificador), sizeof(unsigned int), 0},
+  {"usuario", USUARIOS_TIPO_TEXTO, offsetof(tpUsuario, usuario), 0, USUARIOS_LIMITE_USUARIO, 0},
+  {"nome", USUARIOS_TIPO_TEXTO, offsetof(tpUsuario, nome), 0, USUARIOS_LIMITE_NOME, 1},
+  {"email", USUARIOS_TIPO_TEXTO, offsetof(tpUsuario, email), 0, USUARIOS_LIMITE_EMAIL, 0},
+  {"senha", USUARIOS_TIPO_TEXTO, offsetof(tpUsuario, senha), 0, USUARIOS_LIMITE_SENHA, 0},
+  {"endereco", USUARIOS_TIPO_TEXTO, offsetof(tpUsuario, endereco), 0, USUARIOS_LIMITE_ENDERECO, 1},
+  {"formaPagamento", USUARIOS_TIPO_INTEIRO, offsetof(tpUsuario, formaPagamento), offsetof(usuarios_quente, formaPagamento), sizeof(usuarios_forma_de_pagamento), 0},
+  {"tipo", USUARIOS_TIPO_INTEIRO, offsetof(tpUsuario, tipo), offsetof(usuarios_quente, tipo), sizeof(usuarios_tipo_usuario), 0},
+  {"estado", USUARIOS_TIPO_INTEIRO, offsetof(tpUsuario, estado), offsetof(usuarios_quente, estado), sizeof(usuarios_estado_de_usuario), 0},
+  {"avaliacao", USUARIOS_TIPO_REAL, offsetof(tpUsuario, avaliacao), offsetof(usuarios_quente, avaliacao), sizeof(double), 0},
+  {"n_avaliacao", USUARIOS_TIPO_INTEIRO, offsetof(tpUsuario, n_avaliacao), offsetof(usuarios_quente, n_avaliacao), sizeof(unsigned int), 0},
+  {"n_reclamacoes", USUARIOS_TIPO_INTEIRO, offsetof(tpUsuario, n_reclamacoes), offsetof(usuarios_quente, n_reclamacoes), sizeof(unsigned int), 0}
+};
+
+static_assert(sizeof(usuarios_campos)/sizeof(usuarios_campos[0]) == USUARIOS_CAMPO_INVALIDO,
+              "usuarios_campos deve ter um descritor para cada usuarios_campo");
+
+/*!
+ * @brief Contexto usado pelas funções sem o sufixo _r, com os arquivos padrão do banco de dados
+*/
+static usuarios_contexto usuarios_padrao = {
+  .grafo_usuarios = NULL,
+  .contador = 0,
+  .contador_amizades = 0,
+  .sessao = NULL, /* Inicialmente NULL significa que não há usuário logado */
+  .nos = NULL,
+  .nos_capacidade = 0,
+  .quentes = NULL,
+  .log = {
+    .log = NULL,
+    .buffer = {0},
+    .pendentes = 0,
+    .registradas = 0,
+    .ativo = 0,
+    .trabalhador = 0,
+    .trava = PTHREAD_MUTEX_INITIALIZER,
+    .sinal = PTHREAD_COND_INITIALIZER
+  },
+  .sessoes = {
+    .entradas = NULL,
+    .capacidade = 0,
+    .livre = 0,
+    .abertas = 0,
+    .semente = 0,
+    .trava = PTHREAD_MUTEX_INITIALIZER
+  },
+  .trava = PTHREAD_RWLOCK_INITIALIZER,
+  .contagem = NULL,
+  .tocados = NULL,
+  .contagem_capacidade = 0,
+  .recomendacoes = NULL,
+  .recomendacoes_capacidade = 0,
+  .visitas = {},
+  .pesquisa = {},
+  .indices = {},
+  .internos = {},
+  .disponibilidade = {},
+  .paginacao = {},
+  .threads_carga = 0,
+  .db = USUARIOS_DB,
+  .db_amigos = USUARIOS_DB_AMIGOS,
+  .db_wal = USUARIOS_DB_WAL
+};
+
+
+static void usuarios_walParar(usuarios_contexto *contexto);
+static void usuarios_sessoesLimpar(usuarios_contexto *contexto);
+static void usuarios_recomendacoesLimpar(usuarios_contexto *contexto);
+static void usuarios_visitasLimpar(usuarios_contexto *contexto);
+static void usuarios_pesquisaLimpar(usuarios_contexto *contexto);
+static void usuarios_indicesLimpar(usuarios_contexto *contexto);
+static void usuarios_disponibilidadeLimpar(usuarios_contexto *contexto);
+static void usuarios_indicesInserir(usuarios_contexto *contexto, unsigned int identificador);
+static void usuarios_indicesAlterar(usuarios_contexto *contexto, unsigned int identificador, const usuarios_quente *antigo);
+static void usuarios_pesquisaInserir(usuarios_contexto *contexto, tpUsuario *usuario);
+static void usuarios_pesquisaRemover(usuarios_contexto *contexto, tpUsuario *usuario);
+static tpUsuario *usuarios_paginaFalta(usuarios_contexto *contexto, unsigned int identificador);
+static void usuarios_paginaTocar(usuarios_paginacao *paginacao, unsigned int pagina);
+static void usuarios_paginasLimpar(usuarios_contexto *contexto);
+static usuarios_condRet usuarios_paginasNome(usuarios_contexto *contexto, unsigned int identificador, const char *usuario);
+static unsigned int usuarios_paginasUsuario(usuarios_contexto *contexto, const char *usuario);
+static usuarios_condRet usuarios_paginasEmail(usuarios_contexto *contexto, const char *email);
+static int usuarios_lerRegistro(FILE *arquivo, usuarios_linha *linha);
+static int usuarios_temArco(grafo_no *origem, grafo_no *destino);
+static void usuarios_recomendacoesInvalidar(usuarios_contexto *contexto, unsigned int identificador_A, unsigned int identificador_B);
+
+/*!
+ * @fn static usuarios_condRet usuarios_indexarNo(usuarios_contexto *contexto, unsigned int identificador, grafo_no *nodo)
+ * @brief Registra o nó de um usuário no índice nos do contexto
+ * @param contexto Contexto cujo índice recebe o nó
+ * @param identificador Identificador do usuário, maior que 0
+ * @param nodo Nó do grafo que contém o usuário
+ * @return Uma instância usuarios_condRet que assume:
+ *  - USUARIOS_FALHA_ALOCAR se não conseguir aumentar o índice;
+ *  - USUARIOS_SUCESSO caso contrário.
+ *
+ * O índice dobra de tamanho quando fica cheio, portanto a inserção
+ * tem custo amortizado constante. O vetor de campos quentes cresce junto.
+ *
+ * Requisitos:
+ *  - stdlib.h, string.h
+ */
+
+static usuarios_condRet usuarios_indexarNo(usuarios_contexto *contexto, unsigned int identificador, grafo_no *nodo){
+  grafo_no **novo;
+  usuarios_quente *quentes;
+  unsigned int capacidade = contexto->nos_capacidade ? contexto->nos_capacidade : 64;
+  
+  if(identificador >= contexto->nos_capacidade) {
+    while(capacidade <= identificador) capacidade *= 2;
+    novo = (grafo_no **)realloc(contexto->nos, capacidade*sizeof(grafo_no *));
+    if(novo == NULL) return USUARIOS_FALHA_ALOCAR;
+    contexto->nos = novo;
+    quentes = (usuarios_quente *)realloc(contexto->quentes, capacidade*sizeof(usuarios_quente));
+    if(quentes == NULL) return USUARIOS_FALHA_ALOCAR;
+    contexto->quentes = quentes;
+    memset(novo + contexto->nos_capacidade, 0, (capacidade - contexto->nos_capacidade)*sizeof(grafo_no *));
+    memset(quentes + contexto->nos_capacidade, 0, (capacidade - contexto->nos_capacidade)*sizeof(usuarios_quente));
+    contexto->nos_capacidade = capacidade;
+  }
+  
+  contexto->nos[identificador] = nodo;
+  return USUARIOS_SUCESSO;
+}
+
+/*!
+ * @fn static tpUsuario *usuarios_registro(usuarios_contexto *contexto, unsigned int identificador)
+ * @brief Retorna o registro de um usuário sem percorrer o grafo
+ * @param identificador Identificador do usuário, se for 0 usa a sessão
+ * @return Ponteiro para os dados do usuário no grafo ou NULL se não existir
+ *
+ * No modo preguiçoso de usuarios_carregarIndice lê o registro se ele
+ * não estiver na memória e o marca como usado.
+ */
+
+static tpUsuario *usuarios_registro(usuarios_contexto *contexto, unsigned int identificador){
+  grafo_no *nodo;
+  
+  if(identificador == 0) return contexto->sessao;
+  if(identificador >= contexto->nos_capacidade || contexto->nos[identificador] == NULL) return NULL;
+  nodo = contexto->nos[identificador];
+  if(contexto->paginacao.limite == 0) return (tpUsuario *)nodo->dados;
+  
+  /* Modo preguiçoso: lemos o registro se não estiver na memória */
+  if(nodo->dados == NULL) return usuarios_paginaFalta(contexto, identificador);
+  usuarios_paginaTocar(&contexto->paginacao, (unsigned int)((usuarios_pagina *)nodo->dados - contexto->paginacao.paginas));
+  return (tpUsuario *)nodo->dados;
+}
+
+/*!
+ * @fn static void usuarios_quentePreencher(usuarios_quente *quente, const tpUsuario *usuario)
+ * @brief Copia os campos que não são texto de usuario para quente
+ */
+
+static void usuarios_quentePreencher(usuarios_quente *quente, const tpUsuario *usuario){
+  quente->identificador = usuario->identificador;
+  quente->formaPagamento = usuario->formaPagamento;
+  quente->tipo = usuario->tipo;
+  quente->estado = usuario->estado;
+  quente->n_avaliacao = usuario->n_avaliacao;
+  quente->n_reclamacoes = usuario->n_reclamacoes;
+  quente->avaliacao = usuario->avaliacao;
+}
+
+/*!
+ * @fn static void usuarios_quenteCopiar(usuarios_contexto *contexto, unsigned int identificador, const tpUsuario *usuario)
+ * @brief Copia os campos quentes de usuario para a posição identificador do vetor denso
+ *
+ * Deve ser chamada sempre que um registro entra no grafo ou é alterado,
+ * pois o registro é a fonte e o vetor só uma cópia (ver usuarios_quente).
+ *
+ * Assertivas de entrada:
+ *  - identificador já foi indexado com usuarios_indexarNo
+ */
+
+static void usuarios_quenteCopiar(usuarios_contexto *contexto, unsigned int identificador, const tpUsuario *usuario){
+  usuarios_quentePreencher(&contexto->quentes[identificador], usuario);
+}
+
+/*!
+ * @fn static const usuarios_quente *usuarios_atributos(usuarios_contexto *contexto, unsigned int identificador)
+ * @brief Retorna os campos quentes de um usuário sem tocar no registro
+ * @param identificador Identificador do usuário, se for 0 usa a sessão
+ * @return Ponteiro para o vetor denso ou NULL se o usuário não existir
+ *
+ * Ao contrário de usuarios_registro, nunca lê o arquivo no modo preguiçoso.
+ */
+
+static const usuarios_quente *usuarios_atributos(usuarios_contexto *contexto, unsigned int identificador){
+  if(identificador == 0) {
+    if(contexto->sessao == NULL) return NULL;
+    identificador = contexto->sessao->identificador;
+  }
+  if(identificador >= contexto->nos_capacidade || contexto->nos[identificador] == NULL) return NULL;
+  return &contexto->quentes[identificador];
+}
+
+/*!
+ * @fn static uint32_t usuarios_internoDispersao(const char *texto)
+ * @brief Valor de dispersão FNV-1a de um texto
+*/
+
+static uint32_t usuarios_internoDispersao(const char *texto){
+  uint32_t valor = 2166136261u;
+  for(;*texto;texto++) valor = (valor ^ (unsigned char)*texto) * 16777619u;
+  return valor;
+}
+
+/*!
+ * @fn static const char *usuarios_internoTexto(usuarios_contexto *contexto, uint32_t handle)
+ * @brief Texto de um handle de usuarios_internos
+ * @return O texto, válido enquanto algum registro usar o handle; "" para o handle 0
+*/
+
+static const char *usuarios_internoTexto(usuarios_contexto *contexto, uint32_t handle){
+  if(handle == 0 || handle > contexto->internos.n || contexto->internos.entradas[handle-1].texto == NULL) return "";
+  return contexto->internos.entradas[handle-1].texto;
+}
+
+/*!
+ * @fn static uint32_t *usuarios_internoPosicao(usuarios_internos *internos, const char *texto, uint32_t dispersao)
+ * @brief Posição da tabela com o handle de texto, ou a posição vazia onde ele entraria
+ *
+ * Assertivas de entrada:
+ *  - A tabela tem pelo menos uma posição vazia
+*/
+
+static uint32_t *usuarios_internoPosicao(usuarios_internos *internos, const char *texto, uint32_t dispersao){
+  unsigned int mascara = internos->capacidade_tabela - 1, i = dispersao & mascara;
+  uint32_t *removida = NULL, handle;
+  
+  for(;;i=(i+1) & mascara) {
+    handle = internos->tabela[i];
+    if(handle == 0) return removida ? removida : &internos->tabela[i];
+    if(handle == UINT32_MAX) {
+      if(removida == NULL) removida = &internos->tabela[i];
+    }
+    else if(internos->entradas[handle-1].dispersao == dispersao && !strcmp(internos->entradas[handle-1].texto, texto))
+      return &internos->tabela[i];
+  }
+}
+
+/*!
+ * @fn static usuarios_condRet usuarios_internoRedispersar(usuarios_internos *internos)
+ * @brief Reconstrói a tabela de dispersão sem as posições removidas, dobrando-a se estiver cheia de textos
+ * @return USUARIOS_FALHA_ALOCAR se faltar memória, quando a tabela fica como estava
+*/
+
+static usuarios_condRet usuarios_internoRedispersar(usuarios_internos *internos){
+  unsigned int vivas = internos->n - internos->n_livres, capacidade = 64, i;
+  uint32_t *tabela, *antiga = internos->tabela;
+  
+  while(capacidade < 2*(vivas+1)) capacidade *= 2;
+  tabela = (uint32_t *)calloc(capacidade, sizeof(uint32_t));
+  if(tabela == NULL) return USUARIOS_FALHA_ALOCAR;
+  
+  internos->tabela = tabela;
+  internos->capacidade_tabela = capacidade;
+  internos->ocupadas = vivas;
+  for(i=0;i<internos->n;i++)
+    if(internos->entradas[i].texto != NULL) *usuarios_internoPosicao(internos, internos->entradas[i].texto, internos->entradas[i].dispersao) = i+1;
+  free(antiga);
+  return USUARIOS_SUCESSO;
+}
 
 /*!
- * @brief Contador do número de usuários no grafo
+ * @fn static usuarios_condRet usuarios_internar(usuarios_contexto *contexto, const char *texto, uint32_t *handle)
+ * @brief Retorna em handle o texto internado, criando-o se for o primeiro uso, e conta mais uma referência
+ * @return USUARIOS_FALHA_ALOCAR se faltar memória, USUARIOS_SUCESSO caso contrário
+ *
+ * Cada handle obtido deve ser devolvido com usuarios_internoLiberar.
 */
-static unsigned int usuarios_contador = 0;
+
+static usuarios_condRet usuarios_internar(usuarios_contexto *contexto, const char *texto, uint32_t *handle){
+  usuarios_internos *internos = &contexto->internos;
+  usuarios_interno *entradas;
+  uint32_t dispersao, *posicao, novo, *livres;
+  unsigned int capacidade;
+  int livre;
+  
+  *handle = 0;
+  if(*texto == '\0') return USUARIOS_SUCESSO;
+  
+  if((internos->ocupadas+1)*4 > internos->capacidade_tabela*3 && usuarios_internoRedispersar(internos) != USUARIOS_SUCESSO)
+    return USUARIOS_FALHA_ALOCAR;
+  
+  dispersao = usuarios_internoDispersao(texto);
+  posicao = usuarios_internoPosicao(internos, texto, dispersao);
+  if(*posicao != 0 && *posicao != UINT32_MAX) {
+    internos->entradas[*posicao-1].referencias++;
+    *handle = *posicao;
+    return USUARIOS_SUCESSO;
+  }
+  
+  /* Texto novo: reaproveitamos uma entrada livre ou criamos uma */
+  livre = internos->n_livres > 0;
+  if(livre) novo = internos->livres[--internos->n_livres];
+  else {
+    if(internos->n == internos->capacidade) {
+      /* livres cresce junto, assim liberar uma entrada nunca aloca */
+      capacidade = internos->capacidade ? 2*internos->capacidade : 64;
+      livres = (uint32_t *)realloc(internos->livres, capacidade*sizeof(uint32_t));
+      if(livres == NULL) return USUARIOS_FALHA_ALOCAR;
+      internos->livres = livres;
+      entradas = (usuarios_interno *)realloc(internos->entradas, capacidade*sizeof(usuarios_interno));
+      if(entradas == NULL) return USUARIOS_FALHA_ALOCAR;
+      internos->entradas = entradas;
+      internos->capacidade = capacidade;
+    }
+    novo = ++internos->n;
+  }
+  internos->entradas[novo-1].texto = strdup(texto);
+  if(internos->entradas[novo-1].texto == NULL) {
+    /* Devolvemos a entrada de onde ela veio */
+    if(livre) internos->n_livres++;
+    else internos->n--;
+    return USUARIOS_FALHA_ALOCAR;
+  }
+  internos->entradas[novo-1].referencias = 1;
+  internos->entradas[novo-1].dispersao = dispersao;
+  if(*posicao == 0) internos->ocupadas++;
+  *posicao = novo;
+  *handle = novo;
+  return USUARIOS_SUCESSO;
+}
 
 /*!
- * @brief Contador do número de relações entre os nodos
+ * @fn static void usuarios_internoLiberar(usuarios_contexto *contexto, uint32_t handle)
+ * @brief Devolve uma referência a um handle; o texto é liberado quando não houver mais nenhuma
 */
-static int usuarios_contador_amizades = 0;
+
+static void usuarios_internoLiberar(usuarios_contexto *contexto, uint32_t handle){
+  usuarios_internos *internos = &contexto->internos;
+  usuarios_interno *entrada;
+  
+  if(handle == 0 || handle > internos->n) return;
+  entrada = &internos->entradas[handle-1];
+  if(entrada->texto == NULL || --entrada->referencias > 0) return;
+  
+  *usuarios_internoPosicao(internos, entrada->texto, entrada->dispersao) = UINT32_MAX;
+  free(entrada->texto);
+  entrada->texto = NULL;
+  internos->livres[internos->n_livres++] = handle;
+}
 
 /*!
- * @brief Sessão aberta
+ * @fn static void usuarios_internosLimpar(usuarios_contexto *contexto)
+ * @brief Libera todos os textos internados; os handles dos registros deixam de valer
 */
-static tpUsuario *usuarios_sessao = NULL; /* Inicialmente NULL significa que não há usuário logado */
+
+static void usuarios_internosLimpar(usuarios_contexto *contexto){
+  usuarios_internos *internos = &contexto->internos;
+  unsigned int i;
+  
+  for(i=0;i<internos->n;i++) free(internos->entradas[i].texto);
+  free(internos->entradas);
+  free(internos->livres);
+  free(internos->tabela);
+  memset(internos, 0, sizeof(usuarios_internos));
+}
 
 /*!
- * @brief Estrutura de usuário temporário para uso do usuarios_args nas funções
+ * @fn static usuarios_condRet usuarios_linhaInternar(usuarios_contexto *contexto, const usuarios_linha *linha, tpUsuario *destino)
+ * @brief Copia o registro de linha para destino, internando nome e endereco
+ * @return USUARIOS_FALHA_ALOCAR se faltar memória, quando destino não tem referências; USUARIOS_SUCESSO caso contrário
 */
-static tpUsuario usuarios_dadosTemp;
+
+static usuarios_condRet usuarios_linhaInternar(usuarios_contexto *contexto, const usuarios_linha *linha, tpUsuario *destino){
+  memcpy(destino, &linha->dados, sizeof(tpUsuario));
+  if(usuarios_internar(contexto, linha->nome, &destino->nome) != USUARIOS_SUCESSO) return USUARIOS_FALHA_ALOCAR;
+  if(usuarios_internar(contexto, linha->endereco, &destino->endereco) != USUARIOS_SUCESSO) {
+    usuarios_internoLiberar(contexto, destino->nome);
+    return USUARIOS_FALHA_ALOCAR;
+  }
+  return USUARIOS_SUCESSO;
+}
 
 /*!
- * @brief Argumentos padrão aceitáveis pelas funções ao buscar/alterar/definir dados de usuário
+ * @fn static void usuarios_registroLiberar(usuarios_contexto *contexto, tpUsuario *registro)
+ * @brief Devolve as referências de registro aos textos internados, antes de ele sair da memória
 */
-static unsigned int usuarios_cadastro_argumentos_n = 5;
+
+static void usuarios_registroLiberar(usuarios_contexto *contexto, tpUsuario *registro){
+  usuarios_internoLiberar(contexto, registro->nome);
+  usuarios_internoLiberar(contexto, registro->endereco);
+  registro->nome = registro->endereco = 0;
+}
 
 /*!
- * @brief Usado para detecção de argumentos válidos
+ * @fn static char *usuarios_linhaCampo(usuarios_linha *linha, usuarios_campo campo)
+ * @brief Onde fica o texto de um campo de texto em linha
 */
-static usuarios_cadastro_argumentos usuarios_args[] = {
-  {.validos = "usuario", .tamanho = USUARIOS_LIMITE_USUARIO, .destino = usuarios_dadosTemp.usuario},
-  {.validos = "nome", .tamanho = USUARIOS_LIMITE_NOME, .destino = usuarios_dadosTemp.nome},
-  {.validos = "email", .tamanho = USUARIOS_LIMITE_EMAIL, .destino = usuarios_dadosTemp.email},
-  {.validos = "senha", .tamanho = USUARIOS_LIMITE_SENHA, .destino = usuarios_dadosTemp.senha},
-  {.validos = "endereco", .tamanho = USUARIOS_LIMITE_ENDERECO, .destino = usuarios_dadosTemp.endereco}
-};
 
+static char *usuarios_linhaCampo(usuarios_linha *linha, usuarios_campo campo){
+  if(campo == USUARIOS_CAMPO_NOME) return linha->nome;
+  if(campo == USUARIOS_CAMPO_ENDERECO) return linha->endereco;
+  return (char *)&linha->dados + usuarios_campos[campo].deslocamento;
+}
 
 /*!
- * @fn int usuarios_max()
+ * @fn usuarios_contexto *usuarios_contextoCriar(const char *db, const char *db_amigos, const char *db_wal)
+ * @brief Cria um contexto independente do módulo de usuários
+ * @param db Caminho do arquivo de dados de usuários, no formato de USUARIOS_DB
+ * @param db_amigos Caminho do arquivo de amizades, no formato de USUARIOS_DB_AMIGOS
+ * @param db_wal Caminho do log de escrita antecipada, no formato de USUARIOS_DB_WAL
+ * @return O contexto criado ou NULL se não houver memória ou algum caminho tiver USUARIOS_LIMITE_CAMINHO caracteres ou mais
+ *
+ * Cada contexto tem seu próprio grafo, contadores, sessões, índice, log
+ * e trava, então contextos diferentes (por exemplo partições da base de
+ * usuários) podem ser usados em threads diferentes sem sincronização
+ * entre si. As funções com sufixo _r recebem o contexto como primeiro
+ * argumento, as demais usam o contexto padrão (usuarios_contextoPadrao).
+ *
+ * @code
+ * usuarios_contexto *particao = usuarios_contextoCriar("p1/usuarios.txt", "p1/amigos.txt", "p1/usuarios.wal");
+ * usuarios_carregarArquivo_r(particao);
+ * usuarios_login_r(particao, "jose123", "987654");
+ * usuarios_contextoDestruir(&particao);
+ * @endcode
+ *
+ * Assertivas de saída:
+ *  - O contexto não tem grafo carregado nem sessão aberta
+ *
+ * Requisitos:
+ *  - stdlib.h, string.h, pthread.h
+ *
+ * Hipóteses:
+ *  - O contexto será destruído com usuarios_contextoDestruir antes do fim do programa
+ */
+
+usuarios_contexto *usuarios_contextoCriar(const char *db, const char *db_amigos, const char *db_wal){
+  usuarios_contexto *contexto;
+  
+  if(strlen(db) >= USUARIOS_LIMITE_CAMINHO || strlen(db_amigos) >= USUARIOS_LIMITE_CAMINHO || strlen(db_wal) >= USUARIOS_LIMITE_CAMINHO)
+    return NULL;
+  
+  contexto = (usuarios_contexto *)calloc(1, sizeof(usuarios_contexto));
+  if(contexto == NULL) return NULL;
+  
+  strcpy(contexto->db, db);
+  strcpy(contexto->db_amigos, db_amigos);
+  strcpy(contexto->db_wal, db_wal);
+  
+  pthread_mutex_init(&contexto->log.trava, NULL);
+  pthread_cond_init(&contexto->log.sinal, NULL);
+  pthread_mutex_init(&contexto->sessoes.trava, NULL);
+  pthread_rwlock_init(&contexto->trava, NULL);
+  
+  return contexto;
+}
+
+/*!
+ * @fn usuarios_condRet usuarios_contextoDestruir(usuarios_contexto **contexto)
+ * @brief Aplica o log, libera o grafo e destrói um contexto criado por usuarios_contextoCriar
+ * @param contexto Endereço do contexto, recebe NULL
+ * @return Instância usuarios_condRet que assume:
+ *  - USUARIOS_ARGUMENTOINVALIDO se for o contexto padrão;
+ *  - o retorno de usuarios_limpar_r se houver grafo carregado e a limpeza falhar;
+ *  - USUARIOS_SUCESSO caso contrário.
+ */
+
+usuarios_condRet usuarios_contextoDestruir(usuarios_contexto **contexto){
+  usuarios_condRet retorno;
+  usuarios_contexto *alvo = *contexto;
+  
+  if(alvo == NULL) return USUARIOS_SUCESSO;
+  if(alvo == &usuarios_padrao) return USUARIOS_ARGUMENTOINVALIDO;
+  
+  if(alvo->grafo_usuarios != NULL) {
+    retorno = usuarios_limpar_r(alvo);
+    if(retorno != USUARIOS_SUCESSO) return retorno;
+  }
+  else {
+    usuarios_walParar(alvo);
+    usuarios_sessoesLimpar(alvo);
+    usuarios_recomendacoesLimpar(alvo);
+    usuarios_visitasLimpar(alvo);
+    usuarios_pesquisaLimpar(alvo);
+    usuarios_indicesLimpar(alvo);
+    usuarios_disponibilidadeLimpar(alvo);
+    usuarios_paginasLimpar(alvo);
+    usuarios_internosLimpar(alvo);
+  }
+  
+  pthread_mutex_destroy(&alvo->log.trava);
+  pthread_cond_destroy(&alvo->log.sinal);
+  pthread_mutex_destroy(&alvo->sessoes.trava);
+  pthread_rwlock_destroy(&alvo->trava);
+  free(alvo->nos);
+  free(alvo->quentes);
+  free(alvo);
+  *contexto = NULL;
+  
+  return USUARIOS_SUCESSO;
+}
+
+/*!
+ * @fn usuarios_contexto *usuarios_contextoPadrao()
+ * @brief Retorna o contexto usado pelas funções sem sufixo _r, com os arquivos USUARIOS_DB, USUARIOS_DB_AMIGOS e USUARIOS_DB_WAL
+*/
+
+usuarios_contexto *usuarios_contextoPadrao(){
+  return &usuarios_padrao;
+}
+
+/*!
+ * @fn int usuarios_max_r(usuarios_contexto *contexto)
  * @brief Função que retorna o identificador máximo de usuário do programa. Serve para mostrar os usuários do programa pois o identificador é único e ordenado de 1,2,3,...,max
  *
  * @return Retorna o identificador máximo do usuário
@@ -75,12 +549,232 @@ static usuarios_cadastro_argumentos usuarios_args[] = {
  *
  */
 
-int usuarios_max(){
-  return usuarios_contador;
+int usuarios_max_r(usuarios_contexto *contexto){
+  return contexto->contador;
+}
+
+/*!
+ * @fn static void usuarios_disponibilidadeDispersao(usuarios_campo campo, const char *texto, uint32_t *inicio, uint32_t *passo)
+ * @brief Posição inicial e passo dos contadores de um texto de campo no filtro de disponibilidade
+ *
+ * Usa FNV-1a de 64 bits misturado pelo final do splitmix64; as
+ * USUARIOS_DISPONIBILIDADE_FUNCOES posições são inicio + i*passo
+ * (dispersão dupla). O campo entra na dispersão, assim um usuario igual
+ * a um email não colide com ele.
+*/
+
+static void usuarios_disponibilidadeDispersao(usuarios_campo campo, const char *texto, uint32_t *inicio, uint32_t *passo){
+  uint64_t valor = 14695981039346656037ULL ^ (uint64_t)campo;
+  
+  for(;*texto;texto++) valor = (valor ^ (unsigned char)*texto) * 1099511628211ULL;
+  valor = (valor ^ (valor >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  valor = (valor ^ (valor >> 27)) * 0x94D049BB133111EBULL;
+  valor ^= valor >> 31;
+  *inicio = (uint32_t)valor;
+  *passo = (uint32_t)(valor >> 32) | 1; /* Ímpar, percorre todas as posições da potência de 2 */
+}
+
+/*!
+ * @fn static void usuarios_disponibilidadeMarcar(usuarios_disponibilidade *filtro, usuarios_campo campo, const char *texto, int incremento)
+ * @brief Incrementa (incremento não nulo) ou decrementa os contadores de um texto
+*/
+
+static void usuarios_disponibilidadeMarcar(usuarios_disponibilidade *filtro, usuarios_campo campo, const char *texto, int incremento){
+  uint32_t posicao, passo;
+  unsigned int i, deslocamento, contador;
+  
+  usuarios_disponibilidadeDispersao(campo, texto, &posicao, &passo);
+  for(i=0;i<USUARIOS_DISPONIBILIDADE_FUNCOES;i++, posicao += passo) {
+    posicao &= filtro->capacidade - 1;
+    deslocamento = (posicao & 1) * 4;
+    contador = (filtro->contadores[posicao >> 1] >> deslocamento) & 15;
+    /* Um contador saturado não sabe mais quantos textos tem, fica em 15 */
+    if(contador == 15 || (!incremento && contador == 0)) continue;
+    contador = incremento ? contador+1 : contador-1;
+    filtro->contadores[posicao >> 1] = (uint8_t)((filtro->contadores[posicao >> 1] & ~(15 << deslocamento)) | (contador << deslocamento));
+  }
+}
+
+/*!
+ * @fn static int usuarios_disponibilidadeContem(usuarios_disponibilidade *filtro, usuarios_campo campo, const char *texto)
+ * @brief Não nulo se o texto pode estar em uso; nulo garante que não está
+*/
+
+static int usuarios_disponibilidadeContem(usuarios_disponibilidade *filtro, usuarios_campo campo, const char *texto){
+  uint32_t posicao, passo;
+  unsigned int i;
+  
+  usuarios_disponibilidadeDispersao(campo, texto, &posicao, &passo);
+  for(i=0;i<USUARIOS_DISPONIBILIDADE_FUNCOES;i++, posicao += passo) {
+    posicao &= filtro->capacidade - 1;
+    if(((filtro->contadores[posicao >> 1] >> ((posicao & 1) * 4)) & 15) == 0) return 0;
+  }
+  return 1;
+}
+
+/*!
+ * @fn static void usuarios_disponibilidadeLimpar(usuarios_contexto *contexto)
+ * @brief Libera o filtro de disponibilidade, mantendo as estatísticas; será reconstruído na próxima verificação
+*/
+
+static void usuarios_disponibilidadeLimpar(usuarios_contexto *contexto){
+  usuarios_disponibilidade *filtro = &contexto->disponibilidade;
+  
+  free(filtro->contadores);
+  filtro->contadores = NULL;
+  filtro->capacidade = 0;
+  filtro->n = 0;
+  filtro->construido = 0;
+}
+
+/*!
+ * @fn static void usuarios_disponibilidadeInserir(usuarios_contexto *contexto, usuarios_campo campo, const char *texto)
+ * @brief Inclui um usuario ou email novo no filtro, se ele estiver construído
+ *
+ * Quando o filtro passa de USUARIOS_DISPONIBILIDADE_CONTADORES contadores
+ * por texto ele é descartado e reconstruído maior na próxima verificação,
+ * para que a taxa de falsos positivos não cresça.
+*/
+
+static void usuarios_disponibilidadeInserir(usuarios_contexto *contexto, usuarios_campo campo, const char *texto){
+  usuarios_disponibilidade *filtro = &contexto->disponibilidade;
+  
+  if(!filtro->construido) return;
+  if((filtro->n+1) * USUARIOS_DISPONIBILIDADE_CONTADORES > filtro->capacidade) {
+    usuarios_disponibilidadeLimpar(contexto);
+    return;
+  }
+  usuarios_disponibilidadeMarcar(filtro, campo, texto, 1);
+  filtro->n++;
+}
+
+/*!
+ * @fn static void usuarios_disponibilidadeTrocar(usuarios_contexto *contexto, usuarios_campo campo, const char *antigo, const char *novo)
+ * @brief Troca no filtro o valor antigo de usuario ou email pelo novo
+*/
+
+static void usuarios_disponibilidadeTrocar(usuarios_contexto *contexto, usuarios_campo campo, const char *antigo, const char *novo){
+  usuarios_disponibilidade *filtro = &contexto->disponibilidade;
+  
+  if(!filtro->construido) return;
+  usuarios_disponibilidadeMarcar(filtro, campo, antigo, 0);
+  filtro->n--;
+  usuarios_disponibilidadeInserir(contexto, campo, novo);
+}
+
+/*!
+ * @fn static usuarios_condRet usuarios_disponibilidadeConstruir(usuarios_contexto *contexto)
+ * @brief Constrói o filtro de disponibilidade com os usuario e email de todos os usuários
+ * @return Instância usuarios_condRet que assume:
+ *  - USUARIOS_FALHA_ALOCAR se faltar memória;
+ *  - USUARIOS_GRAFO_CORROMPIDO se um nó não tiver registro fora do modo preguiçoso;
+ *  - USUARIOS_FALHA_WAL se, no modo preguiçoso, não conseguir aplicar o log;
+ *  - USUARIOS_SUCESSO caso contrário.
+ *
+ * No modo preguiçoso os nomes de usuário estão na memória e os emails
+ * vêm de uma leitura de USUARIOS_DB, o custo de uma verificação exata.
+*/
+
+static usuarios_condRet usuarios_disponibilidadeConstruir(usuarios_contexto *contexto){
+  usuarios_disponibilidade *filtro = &contexto->disponibilidade;
+  usuarios_paginacao *paginacao = &contexto->paginacao;
+  unsigned int capacidade = 8192, i;
+  usuarios_linha lido;
+  tpUsuario *usuario;
+  FILE *db_usuarios;
+  
+  usuarios_disponibilidadeLimpar(contexto);
+  /* Folga para o dobro dos usuários antes de reconstruir */
+  while(capacidade < 4 * (contexto->contador+1) * USUARIOS_DISPONIBILIDADE_CONTADORES) capacidade *= 2;
+  filtro->contadores = (uint8_t *)calloc(capacidade/2, 1);
+  if(filtro->contadores == NULL) return USUARIOS_FALHA_ALOCAR;
+  filtro->capacidade = capacidade;
+  
+  if(paginacao->limite) {
+    for(i=1;i<=contexto->contador && i<paginacao->deslocamentos_capacidade;i++)
+      usuarios_disponibilidadeMarcar(filtro, USUARIOS_CAMPO_USUARIO, paginacao->nomes + paginacao->deslocamentos[i], 1);
+    if(usuarios_sincronizar_r(contexto) != USUARIOS_SUCESSO) {
+      usuarios_disponibilidadeLimpar(contexto);
+      return USUARIOS_FALHA_WAL;
+    }
+    db_usuarios = fopen(contexto->db, "r");
+    if(db_usuarios != NULL) {
+      while(!feof(db_usuarios) && usuarios_lerRegistro(db_usuarios, &lido))
+        usuarios_disponibilidadeMarcar(filtro, USUARIOS_CAMPO_EMAIL, lido.dados.email, 1);
+      fclose(db_usuarios);
+    }
+  }
+  else {
+    for(i=1;i<contexto->nos_capacidade;i++) {
+      if(contexto->nos[i] == NULL) continue;
+      usuario = (tpUsuario *)contexto->nos[i]->dados;
+      if(usuario == NULL) {
+        usuarios_disponibilidadeLimpar(contexto);
+        return USUARIOS_GRAFO_CORROMPIDO;
+      }
+      usuarios_disponibilidadeMarcar(filtro, USUARIOS_CAMPO_USUARIO, usuario->usuario, 1);
+      usuarios_disponibilidadeMarcar(filtro, USUARIOS_CAMPO_EMAIL, usuario->email, 1);
+    }
+  }
+  
+  filtro->n = 2*contexto->contador;
+  filtro->construido = 1;
+  return USUARIOS_SUCESSO;
+}
+
+/*!
+ * @fn static usuarios_condRet usuarios_repeticaoExata(usuarios_contexto *contexto, const char *argumento, char *dado)
+ * @brief Verificação exata de usuarios_verificaRepeticao, percorrendo o grafo ou, no modo preguiçoso, os nomes e o arquivo
+*/
+
+static usuarios_condRet usuarios_repeticaoExata(usuarios_contexto *contexto, const char *argumento, char *dado){
+  grafo_no *nodo;
+  
+  /* No modo preguiçoso os nós não têm os registros */
+  if(contexto->paginacao.limite) {
+    if(!strcmp(argumento, "usuario")) return usuarios_paginasUsuario(contexto, dado) ? USUARIOS_DADOS_REPETICAO : USUARIOS_DADOS_OK;
+    if(!strcmp(argumento, "email")) return usuarios_paginasEmail(contexto, dado);
+    return USUARIOS_ARGUMENTOINVALIDO;
+  }
+  
+  /* Selecionamos o argumento passado */
+  if(!strcmp(argumento, "usuario")) {
+  
+    /* Primeiro usuário */
+    nodo = (grafo_no *)grafo_busca_no(contexto->grafo_usuarios, 1, 0);
+    
+    /* Percorremos o grafo */
+    for(; nodo != NULL ; nodo = (grafo_no *)nodo->prox_no) {
+    
+      if(nodo->dados == NULL) return USUARIOS_GRAFO_CORROMPIDO; /* Asertiva */
+              
+      /* São iguais */ 
+      if(!strcmp(((tpUsuario *)nodo->dados)->usuario, dado)) return USUARIOS_DADOS_REPETICAO;
+    }
+    
+    return USUARIOS_DADOS_OK;
+  }
+  else if(!strcmp(argumento, "email")) {
+  
+    /* Primeiro usuário */
+    nodo = (grafo_no *)grafo_busca_no(contexto->grafo_usuarios, 1, 0);
+    
+    /* Percorremos o grafo */
+    for(; nodo != NULL ; nodo = (grafo_no *)nodo->prox_no) {
+      if(nodo->dados == NULL) return USUARIOS_GRAFO_CORROMPIDO; /* Asertiva */
+              
+      /* São iguais */ 
+      if(!strcmp(((tpUsuario *)nodo->dados)->email, dado)) return USUARIOS_DADOS_REPETICAO;
+    }
+    
+    return USUARIOS_DADOS_OK;
+  }
+  
+  return USUARIOS_ARGUMENTOINVALIDO;
 }
 
 /*!
- * @fn static usuarios_condRet usuarios_verificaRepeticao(const char *argumento, char *dado)
+ * @fn static usuarios_condRet usuarios_verificaRepeticao(usuarios_contexto *contexto, const char *argumento, char *dado)
  * @brief Função que verifica se há repetição nos dados
  * @param argumento Define o tipo de dado a ser verificado no grafo de usuários
  * @param dado O dado a verificar repetição no grafo de usuários
@@ -92,7 +786,10 @@ int usuarios_max(){
  *  - USUARIOS_ARGUMENTOINVALIDO se o tipo de argumento passado não for válido
  * 
  * A função busca no grafo de usuários se já há algum usuário com o dado
- * igual ao do argumento passado
+ * igual ao do argumento passado. Antes, um filtro de Bloom com contadores
+ * (usuarios_disponibilidade), construído na primeira verificação, responde
+ * sozinho pelos dados livres; só os positivos do filtro passam pela
+ * verificação exata. Os contadores estão em usuarios_estatisticasDisponibilidade.
  * 
  * @code
  * usuarios_verificaRepeticao("nome", "João Antônio");
@@ -122,45 +819,31 @@ int usuarios_max(){
  * 
  */
 
-static usuarios_condRet usuarios_verificaRepeticao(const char *argumento, char *dado){
-  grafo_no *nodo;
+static usuarios_condRet usuarios_verificaRepeticao(usuarios_contexto *contexto, const char *argumento, char *dado){
+  usuarios_disponibilidade *filtro = &contexto->disponibilidade;
+  usuarios_condRet retorno;
+  usuarios_campo campo;
   
-  if(usuarios_grafo == NULL) return USUARIOS_FALHA_GRAFONULL;
+  if(contexto->grafo_usuarios == NULL) return USUARIOS_FALHA_GRAFONULL;
   
-  /* Selecionamos o argumento passado */
-  if(!strcmp(argumento, "usuario")) {
+  if(!strcmp(argumento, "usuario")) campo = USUARIOS_CAMPO_USUARIO;
+  else if(!strcmp(argumento, "email")) campo = USUARIOS_CAMPO_EMAIL;
+  else return USUARIOS_ARGUMENTOINVALIDO;
   
-    /* Primeiro usuário */
-    nodo = (grafo_no *)grafo_busca_no(usuarios_grafo, 1, 0);
-    
-    /* Percorremos o grafo */
-    for(; nodo != NULL ; nodo = (grafo_no *)nodo->prox_no) {
-    
-      if(nodo->dados == NULL) return USUARIOS_GRAFO_CORROMPIDO; /* Asertiva */
-              
-      /* São iguais */ 
-      if(!strcmp(((tpUsuario *)nodo->dados)->usuario, dado)) return USUARIOS_DADOS_REPETICAO;
-    }
-    
-    return USUARIOS_DADOS_OK;
-  }
-  else if(!strcmp(argumento, "email")) {
+  /* Sem o filtro fazemos só a verificação exata */
+  filtro->estatisticas.consultas++;
+  if(!filtro->construido && usuarios_disponibilidadeConstruir(contexto) != USUARIOS_SUCESSO) return usuarios_repeticaoExata(contexto, argumento, dado);
   
-    /* Primeiro usuário */
-    nodo = (grafo_no *)grafo_busca_no(usuarios_grafo, 1, 0);
-    
-    /* Percorremos o grafo */
-    for(; nodo != NULL ; nodo = (grafo_no *)nodo->prox_no) {
-      if(nodo->dados == NULL) return USUARIOS_GRAFO_CORROMPIDO; /* Asertiva */
-              
-      /* São iguais */ 
-      if(!strcmp(((tpUsuario *)nodo->dados)->email, dado)) return USUARIOS_DADOS_REPETICAO;
-    }
-    
+  /* A maior parte dos dados pedidos está livre e o filtro responde sem percorrer o grafo nem o arquivo */
+  if(!usuarios_disponibilidadeContem(filtro, campo, dado)) {
+    filtro->estatisticas.rejeitadas++;
     return USUARIOS_DADOS_OK;
   }
   
-  return USUARIOS_ARGUMENTOINVALIDO;
+  retorno = usuarios_repeticaoExata(contexto, argumento, dado);
+  if(retorno == USUARIOS_DADOS_OK) filtro->estatisticas.falsos_positivos++;
+  else if(retorno == USUARIOS_DADOS_REPETICAO) filtro->estatisticas.confirmadas++;
+  return retorno;
 }
 
 /*!
@@ -197,7 +880,7 @@ static int usuarios_condParada_login(tpUsuario *corrente, va_list argumentos){
 }
 
 /*!
- * @fn static usuarios_condRet usuarios_busca(int condParada(tpUsuario *, va_list), tpUsuario **retorno, unsigned int *indice, ...)
+ * @fn static usuarios_condRet usuarios_busca(usuarios_contexto *contexto, int condParada(tpUsuario *, va_list), tpUsuario **retorno, unsigned int *indice, ...)
  * @brief Função de busca no grafo de usuários dada uma condição de parada condParada
  * @param condParada uma função que retorne um inteiro e receba como argumentos um ponteiro para tpUsuario e um va_list, deve ser a condição de parada de busca no grafo retornando verdade caso chege-se a um nodo que satisfaz a condição
  * @param retorno um endereço de um ponteiro para tpUsuario
@@ -242,19 +925,19 @@ static int usuarios_condParada_login(tpUsuario *corrente, va_list argumentos){
  *
  */
 
-static usuarios_condRet usuarios_busca(int condParada(tpUsuario *, va_list), tpUsuario **retorno, unsigned int *indice, ...){
+static usuarios_condRet usuarios_busca(usuarios_contexto *contexto, int condParada(tpUsuario *, va_list), tpUsuario **retorno, unsigned int *indice, ...){
   unsigned int i = 0;
   tpUsuario *corrente;
   grafo_no *nodo;
   
   va_list argumentos, passado;
   
-  if(usuarios_grafo == NULL) return USUARIOS_FALHA_GRAFONULL;
+  if(contexto->grafo_usuarios == NULL) return USUARIOS_FALHA_GRAFONULL;
   
   va_start(argumentos, indice);
   
   /* Primeiro usuário */
-  nodo = (grafo_no *)grafo_busca_no(usuarios_grafo, 1, 0);
+  nodo = (grafo_no *)grafo_busca_no(contexto->grafo_usuarios, 1, 0);
   
   /* Percorremos o grafo */
   for(; nodo != NULL ; nodo = (grafo_no *)nodo->prox_no) {
@@ -278,6 +961,31 @@ static usuarios_condRet usuarios_busca(int condParada(tpUsuario *, va_list), tpU
   return USUARIOS_FALHA_DADOSINCORRETOS;
 }
 
+/*!
+ * @fn static usuarios_condRet usuarios_buscaLogin(usuarios_contexto *contexto, const char *usuario, const char *senha, tpUsuario **retorno)
+ * @brief Procura o usuário de usuario e senha passados, com os retornos de usuarios_busca
+ *
+ * No modo preguiçoso procura o nome entre os nomes na memória e só lê o
+ * registro desse usuário.
+ */
+
+static usuarios_condRet usuarios_buscaLogin(usuarios_contexto *contexto, const char *usuario, const char *senha, tpUsuario **retorno){
+  unsigned int identificador;
+  tpUsuario *corrente;
+  
+  if(contexto->paginacao.limite == 0) return usuarios_busca(contexto, usuarios_condParada_login, retorno, NULL, usuario, senha);
+  if(contexto->grafo_usuarios == NULL) return USUARIOS_FALHA_GRAFONULL;
+  
+  identificador = usuarios_paginasUsuario(contexto, usuario);
+  if(identificador == 0) return USUARIOS_FALHA_DADOSINCORRETOS;
+  corrente = usuarios_registro(contexto, identificador);
+  if(corrente == NULL) return USUARIOS_GRAFO_CORROMPIDO;
+  if(strcmp(corrente->senha, senha)) return USUARIOS_FALHA_DADOSINCORRETOS;
+  
+  *retorno = corrente;
+  return USUARIOS_SUCESSO;
+}
+
 /*!
  * @fn static void usuarios_lerString(FILE *arquivo, char *dstStr, unsigned int limite)
  * @brief Função leitora de string em um arquivo de dados
@@ -332,495 +1040,1737 @@ static void usuarios_lerString(FILE *arquivo, char *dstStr, unsigned int limite)
 }
 
 /*!
- * @fn usuarios_condRet usuarios_carregarArquivo()
- * @brief Função carregadora do arquivo de usuários e suas relações
- * @return Uma instância usuarios_condRet que assume: 
- *  - USUARIOS_SUCESSO se conseguir carregar com sucesso o grafo de usuários a partir do arquivo; 
- *  - USUARIOS_FALHA_ADICIONAR_GRAFO se falhar em criar um vértice no grafo; 
- *  - USUARIOS_FALHA_INSERIR_DADOS se falhar em definir os dados tirados do arquivo no vértice que acabou de ser criado; 
- *  - USUARIOS_DB_CORROMPIDO se ao ler o arquivo de amizades encontrar uma aresta que já existe no grafo; 
- *  - USUARIOS_FALHA_CRIARAMIZADE se não conseguir criar e definir uma aresta entre dois nós do grafo para representar uma amizade;
- *  - USUARIOS_FALHA_ALOCAR se não conseguir alocar memória para um nó do grafo.
+ * @fn static usuarios_condRet usuarios_walCommit(usuarios_contexto *contexto)
+ * @brief Grava em USUARIOS_DB_WAL as entradas pendentes no buffer do log (group commit)
+ * @return Uma instância usuarios_condRet que assume:
+ *  - USUARIOS_FALHA_WAL se não conseguir abrir, gravar ou sincronizar o arquivo de log;
+ *  - USUARIOS_SUCESSO se o lote estiver no disco ou se não houver entradas pendentes.
  *
- * A relação de um usuário com o outro é a relação de amizade, 
- * o grafo é direcionado, assim a relação entre A e B 
- * de fato existe se e só se existir uma aresta
- * indo de A a B e outra indo de B a A.
- * Se isso não ocorrer temos a pendencia de uma relação, na qual
- * aguarda-se a confirmação da parte solicitada para criá-la.
- * 
- * Retorna USUARIOS_SUCESSO caso tenha carregado o arquivo corretamente e gerado o grafo de usuário. Deve ser a primeira função a ser carregada para que o módulo funcione.
+ * Um único fwrite e um único fsync são feitos para o lote inteiro, que
+ * é a barreira de durabilidade das alterações. Se falharem o log volta
+ * ao tamanho anterior e o lote continua no buffer, para ser gravado
+ * inteiro na próxima tentativa sem desalinhar os registros.
  *
  * Assertivas de entrada:
- *  - O arquivo indicado por USUARIOS_DB existe e é legível pelo programa, se não existir a função criará um arquivo e fechará com um grafo não nulo mas sem nós.
- *  - O arquivo indicado por USUARIOS_DB_AMIGOS existe e é legível pelo programa, se não existir mas houverem usuários a função criará um arquivo e fechará com um grafo sem arestas.
+ *  - log.trava do contexto está adquirida pela thread chamadora
  *
  * Assertivas de saída:
- *  - O grafo de usuários é carregado junto as relações entre os nós
- *  - Haverão arquivos USUARIOS_DB e USUARIOS_DB_AMIGOS
- *  - Os contadores globais do módulo de usuários usuarios_contador e usuarios_contador_amizades conterão os maiores identificadores de vértices no grafo e arestas no grafo respectivamente.
+ *  - log.pendentes do contexto é 0 se retornar USUARIOS_SUCESSO
  *
- * Assertivas de contrato:
- *  - O arquivo deve ter a estrutura indicada por USUARIOS_DB_ESTRUTURA
- * 
  * Requisitos:
- *  - stdio.h, stdlib.h, grafo.h
+ *  - stdio.h, unistd.h
  *
  * Hipóteses:
  *  - Nenhuma
- *
  */
 
-usuarios_condRet usuarios_carregarArquivo(){
-  FILE *db_usuarios = fopen(USUARIOS_DB, "r");
-  FILE *db_amigos;
-    
-  /* Cria-se o grafo de usuários */
-  usuarios_grafo = cria_grafo("Usuários");
+static usuarios_condRet usuarios_walCommit(usuarios_contexto *contexto){
+  size_t tamanho = contexto->log.pendentes*USUARIOS_DB_REGISTRO_TAMANHO;
+  long inicio;
   
-  /* Verificamos se o arquivo existe */
-  if(db_usuarios == NULL){
-    db_usuarios = fopen(USUARIOS_DB, "w");
-    fclose(db_usuarios);
-    return USUARIOS_SUCESSO;
-  }
+  if(contexto->log.pendentes == 0) return USUARIOS_SUCESSO;
   
-  /* Índice dos usuários carregados (para acesso via funções de grafo) */
-  int i = 1;
+  if(contexto->log.log == NULL) {
+    contexto->log.log = fopen(contexto->db_wal, "a");
+    if(contexto->log.log == NULL) return USUARIOS_FALHA_WAL;
+  }
   
-  /* Identificadores para os amigos */
-  unsigned int identificador_A, identificador_B;
-  int valorAresta;
+  fseek(contexto->log.log, 0, SEEK_END);
+  inicio = ftell(contexto->log.log);
+  if(
+    fwrite(contexto->log.buffer, 1, tamanho, contexto->log.log) != tamanho ||
+    fflush(contexto->log.log) != 0 ||
+    fsync(fileno(contexto->log.log)) != 0
+  ) {
+    fclose(contexto->log.log);
+    contexto->log.log = NULL;
+    if(inicio >= 0) truncate(contexto->db_wal, inicio);
+    return USUARIOS_FALHA_WAL;
+  }
   
-  usuarios_condRet busca;
+  contexto->log.registradas += contexto->log.pendentes;
+  contexto->log.pendentes = 0;
+  return USUARIOS_SUCESSO;
+}
+
+/*!
+ * @fn static usuarios_condRet usuarios_walCheckpoint(usuarios_contexto *contexto)
+ * @brief Aplica em USUARIOS_DB todas as entradas do log e o esvazia
+ * @return Uma instância usuarios_condRet que assume:
+ *  - USUARIOS_FALHA_WAL se não conseguir gravar as entradas pendentes no log;
+ *  - USUARIOS_FALHA_LERDB se houver log e não conseguir abrir USUARIOS_DB como "r+";
+ *  - USUARIOS_FALHA_INSERIR_DADOS se não conseguir gravar ou sincronizar as entradas em USUARIOS_DB;
+ *  - USUARIOS_FALHA_WAL se as entradas foram aplicadas mas o log não pôde ser esvaziado;
+ *  - USUARIOS_SUCESSO se o log foi aplicado ou se não havia log.
+ *
+ * As entradas são copiadas na ordem do log para a posição do registro
+ * em USUARIOS_DB, portanto a última alteração de um usuário prevalece.
+ * Uma entrada incompleta no fim do log (escrita interrompida) é ignorada,
+ * assim como entradas que apontem para além do fim de USUARIOS_DB. Se
+ * USUARIOS_DB não existir o log é descartado.
+ * Também é o procedimento de recuperação: replica o log deixado por uma
+ * execução interrompida. O log só é esvaziado depois que USUARIOS_DB
+ * foi gravado e sincronizado; se algo falhar antes ele é mantido e
+ * aplicado de novo no próximo checkpoint.
+ *
+ * Assertivas de entrada:
+ *  - log.trava do contexto está adquirida pela thread chamadora
+ *
+ * Assertivas de saída:
+ *  - USUARIOS_DB contém todas as alterações registradas e USUARIOS_DB_WAL está vazio se retornar USUARIOS_SUCESSO
+ *
+ * Requisitos:
+ *  - stdio.h, unistd.h
+ *
+ * Hipóteses:
+ *  - Nenhuma
+ */
 
+static usuarios_condRet usuarios_walCheckpoint(usuarios_contexto *contexto){
+  char registro[USUARIOS_DB_REGISTRO_TAMANHO+1];
+  unsigned int identificador;
+  long tamanhoDB;
+  int falha = 0;
+  FILE *wal, *db_usuarios;
   
-  while(!feof(db_usuarios)){
-    /* Dados do usuário corrente */
-    tpUsuario *corrente = (tpUsuario *)malloc(sizeof(tpUsuario));
-    if(corrente == NULL) {
-      fclose(db_usuarios);
-      return USUARIOS_FALHA_ALOCAR;
-    }
-    
-    /* Lemos do arquivo */
-    fscanf(db_usuarios, "%u%*[^\t]\t", &(corrente->identificador));
-    if(corrente->identificador == 0) break;
-    
-    usuarios_lerString(db_usuarios, corrente->usuario, USUARIOS_LIMITE_USUARIO);
-    usuarios_lerString(db_usuarios, corrente->nome, USUARIOS_LIMITE_NOME);
-    usuarios_lerString(db_usuarios, corrente->email, USUARIOS_LIMITE_EMAIL);
-    usuarios_lerString(db_usuarios, corrente->senha, USUARIOS_LIMITE_SENHA);
-    usuarios_lerString(db_usuarios, corrente->endereco, USUARIOS_LIMITE_ENDERECO);
-    
-    fscanf(db_usuarios, "%d%*[^\t]\t%d%*[^\t]\t%d%*[^\t]\t%lf%*[^\t]\t%u%*[^\t]\t%u%*[^\n]\n", 
-      (int *)&(corrente->formaPagamento),
-      (int *)&(corrente->tipo),
-      (int *)&(corrente->estado),
-      &(corrente->avaliacao),
-      &(corrente->n_avaliacao),
-      &(corrente->n_reclamacoes)
-    );
-    
-    /* Adicionamos ao grafo */
-    if(adiciona_vertice(usuarios_grafo, i) != SUCESSO) {
+  if(usuarios_walCommit(contexto) != USUARIOS_SUCESSO) return USUARIOS_FALHA_WAL;
+  if(contexto->log.log != NULL) {
+    fclose(contexto->log.log);
+    contexto->log.log = NULL;
+  }
+  
+  wal = fopen(contexto->db_wal, "r");
+  if(wal == NULL) return USUARIOS_SUCESSO; /* Não há log */
+  
+  db_usuarios = fopen(contexto->db, "r+");
+  if(db_usuarios == NULL) {
+    fclose(wal);
+    /* Sem arquivo de dados o log não se refere a nada, descartamos */
+    db_usuarios = fopen(contexto->db, "r");
+    if(db_usuarios != NULL) {
       fclose(db_usuarios);
-      free(corrente);
-      return USUARIOS_FALHA_ADICIONAR_GRAFO;
+      return USUARIOS_FALHA_LERDB;
     }
+    remove(contexto->db_wal);
+    contexto->log.registradas = 0;
+    return USUARIOS_SUCESSO;
+  }
+  fseek(db_usuarios, 0, SEEK_END);
+  tamanhoDB = ftell(db_usuarios);
+  
+  registro[USUARIOS_DB_REGISTRO_TAMANHO] = '\0';
+  while(fread(registro, 1, USUARIOS_DB_REGISTRO_TAMANHO, wal) == USUARIOS_DB_REGISTRO_TAMANHO) {
+    /* Assertiva: todo registro termina com '\n' */
+    if(registro[USUARIOS_DB_REGISTRO_TAMANHO-1] != '\n') break;
+    if(sscanf(registro, "%u", &identificador) != 1 || identificador == 0) continue;
+    if((long)(identificador-1)*USUARIOS_DB_REGISTRO_TAMANHO >= tamanhoDB) continue;
     
-    /* Definimos o valores correntes no vértice */
-    if(muda_valor_vertice(usuarios_grafo, i, (void *)corrente) != SUCESSO) {
-      fclose(db_usuarios);
-      free(corrente);
-      return USUARIOS_FALHA_INSERIR_DADOS;
+    if(
+      fseek(db_usuarios, (long)(identificador-1)*USUARIOS_DB_REGISTRO_TAMANHO, SEEK_SET) != 0 ||
+      fwrite(registro, 1, USUARIOS_DB_REGISTRO_TAMANHO, db_usuarios) != USUARIOS_DB_REGISTRO_TAMANHO
+    ) {
+      falha = 1;
+      break;
     }
-    
-    i++;
-    
   }
   
-  fclose(db_usuarios);
+  if(!falha) falha = fflush(db_usuarios) != 0 || fsync(fileno(db_usuarios)) != 0;
+  if(fclose(db_usuarios) != 0) falha = 1;
+  fclose(wal);
+  if(falha) return USUARIOS_FALHA_INSERIR_DADOS; /* O log fica para o próximo checkpoint */
   
-  usuarios_contador = i-1; /* Número de usuários carregados */
+  /* Esvaziamos o log */
+  wal = fopen(contexto->db_wal, "w");
+  if(wal == NULL) return USUARIOS_FALHA_WAL;
+  falha = fsync(fileno(wal)) != 0;
+  if(fclose(wal) != 0 || falha) return USUARIOS_FALHA_WAL;
+  contexto->log.registradas = 0;
   
-  /* Análogo para amigos */
-  db_amigos = fopen(USUARIOS_DB_AMIGOS, "r");
-  if(db_amigos == NULL){
-    db_amigos = fopen(USUARIOS_DB_AMIGOS, "w");
-    fclose(db_amigos);
-    return USUARIOS_SUCESSO;
-  }
+  return USUARIOS_SUCESSO;
+}
+
+/*!
+ * @fn static void *usuarios_walTrabalhador(void *argumento)
+ * @brief Thread de segundo plano do log de usuários
+ * @param argumento Contexto (usuarios_contexto *) dono do log
+ * @return Sempre NULL
+ *
+ * A cada USUARIOS_WAL_INTERVALO_MS milissegundos grava as entradas
+ * pendentes (gatilho de tempo do group commit) e, se o log tiver
+ * USUARIOS_WAL_CHECKPOINT entradas ou mais, faz o checkpoint em
+ * arquivo de dados do contexto. Termina quando log.ativo for nulo.
+ *
+ * Requisitos:
+ *  - pthread.h, time.h
+ */
+
+static void *usuarios_walTrabalhador(void *argumento){
+  usuarios_contexto *contexto = (usuarios_contexto *)argumento;
+  struct timespec limite;
   
+  pthread_mutex_lock(&contexto->log.trava);
+  while(contexto->log.ativo) {
+    clock_gettime(CLOCK_REALTIME, &limite);
+    limite.tv_nsec += (long)USUARIOS_WAL_INTERVALO_MS*1000000;
+    limite.tv_sec += limite.tv_nsec/1000000000;
+    limite.tv_nsec %= 1000000000;
+    pthread_cond_timedwait(&contexto->log.sinal, &contexto->log.trava, &limite);
+    
+    usuarios_walCommit(contexto);
+    if(contexto->log.registradas >= USUARIOS_WAL_CHECKPOINT) usuarios_walCheckpoint(contexto);
+  }
+  pthread_mutex_unlock(&contexto->log.trava);
+  return NULL;
+}
 
-  /* Agora carregamos os amigos */
-  while(!feof(db_amigos)){
-    /* Lemos do arquivo */
-    fscanf(db_amigos, "%4d%4u%*[^\t]\t%4u%*[^\n]\n", &valorAresta, &identificador_A, &identificador_B);
-    /* Pulamos relações mortas */
-    if(valorAresta){
-      /* Vemos se já há um arco entre eles nesta direção, uma assertiva */
-      if(grafo_busca_arco(usuarios_grafo, identificador_A, identificador_B) != NULL){
-        fclose(db_amigos);
-         destroi_grafo(&usuarios_grafo);
-        return USUARIOS_DB_CORROMPIDO;
-      }
-      
-      /* Colocamos e definimos o id da aresta */
-      if(
-         adiciona_aresta(usuarios_grafo, identificador_A, identificador_B) != SUCESSO ||
-         muda_valor_aresta(usuarios_grafo, identificador_A, identificador_B, valorAresta) != SUCESSO
-      ){
-        fclose(db_amigos);
-        destroi_grafo(&usuarios_grafo);
-        return USUARIOS_FALHA_CRIARAMIZADE;
-      }
-      
-      /* Atualizamos o contador */
-      usuarios_contador_amizades++;
-    }
+/*!
+ * @fn static void usuarios_walParar(usuarios_contexto *contexto)
+ * @brief Encerra a thread de segundo plano do log, se estiver rodando
+ *
+ * Assertivas de saída:
+ *  - log.ativo do contexto é nulo e a thread terminou
+ */
+
+static void usuarios_walParar(usuarios_contexto *contexto){
+  pthread_mutex_lock(&contexto->log.trava);
+  if(!contexto->log.ativo) {
+    pthread_mutex_unlock(&contexto->log.trava);
+    return;
+  }
+  contexto->log.ativo = 0;
+  pthread_cond_signal(&contexto->log.sinal);
+  pthread_mutex_unlock(&contexto->log.trava);
+  pthread_join(contexto->log.trabalhador, NULL);
+}
+
+/*!
+ * @fn static void usuarios_walEncerrar()
+ * @brief Registrada com atexit, garante que o log do contexto padrão é aplicado ao fim do programa
+ *
+ * Contextos criados com usuarios_contextoCriar são aplicados por usuarios_contextoDestruir.
+*/
+
+static void usuarios_walEncerrar(){
+  usuarios_walParar(&usuarios_padrao);
+  usuarios_sincronizar_r(&usuarios_padrao);
+}
+
+/*!
+ * @fn static void usuarios_walIniciar(usuarios_contexto *contexto)
+ * @brief Inicia a thread de segundo plano do log, se ainda não estiver rodando
+ *
+ * Na primeira chamada com o contexto padrão registra usuarios_walEncerrar com atexit.
+ *
+ * Requisitos:
+ *  - pthread.h, stdlib.h
+ */
+
+static void usuarios_walIniciar(usuarios_contexto *contexto){
+  static int registrado = 0;
+  
+  if(!registrado && contexto == &usuarios_padrao) {
+    atexit(usuarios_walEncerrar);
+    registrado = 1;
   }
   
-  fclose(db_amigos);
+  pthread_mutex_lock(&contexto->log.trava);
+  if(!contexto->log.ativo) {
+    contexto->log.ativo = 1;
+    if(pthread_create(&contexto->log.trabalhador, NULL, usuarios_walTrabalhador, contexto) != 0)
+      contexto->log.ativo = 0; /* Sem thread, o gatilho de tamanho e usuarios_sincronizar ainda gravam */
+  }
+  pthread_mutex_unlock(&contexto->log.trava);
+}
 
+/*!
+ * @fn static usuarios_condRet usuarios_walRegistrar(usuarios_contexto *contexto, tpUsuario *dados)
+ * @brief Acrescenta ao log uma entrada com o registro completo do usuário
+ * @param dados Usuário alterado, não nulo
+ * @return Uma instância usuarios_condRet que assume:
+ *  - USUARIOS_FALHA_WAL se o buffer está cheio e não foi possível gravá-lo no log, a entrada não é acrescentada;
+ *  - USUARIOS_SUCESSO caso contrário.
+ *
+ * A entrada fica no buffer até o próximo group commit: quando o buffer
+ * chegar a USUARIOS_WAL_LOTE entradas (nesta chamada) ou na próxima
+ * execução da thread de segundo plano. Um lote que não pôde ser gravado
+ * continua no buffer e é gravado antes da próxima entrada.
+ *
+ * Requisitos:
+ *  - stdio.h, string.h, pthread.h
+ */
+
+static usuarios_condRet usuarios_walRegistrar(usuarios_contexto *contexto, tpUsuario *dados){
+  char registro[USUARIOS_DB_REGISTRO_TAMANHO+1];
+  
+  snprintf(registro, sizeof(registro), USUARIOS_DB_ESTRUTURA, 
+    dados->identificador,
+    dados->usuario,
+    usuarios_internoTexto(contexto, dados->nome),
+    dados->email,
+    dados->senha,
+    usuarios_internoTexto(contexto, dados->endereco),
+    (int)dados->formaPagamento,
+    (int)dados->tipo,
+    (int)dados->estado,
+    dados->avaliacao,
+    dados->n_avaliacao,
+    dados->n_reclamacoes
+  );
+  
+  /* No modo preguiçoso a página do registro passa a depender do log, ver usuarios_paginaVitima */
+  if(
+    contexto->paginacao.paginas != NULL &&
+    (usuarios_pagina *)dados >= contexto->paginacao.paginas &&
+    (usuarios_pagina *)dados < contexto->paginacao.paginas + contexto->paginacao.n
+  ) ((usuarios_pagina *)dados)->sujo = 1;
+  
+  pthread_mutex_lock(&contexto->log.trava);
+  if(contexto->log.pendentes >= USUARIOS_WAL_LOTE && usuarios_walCommit(contexto) != USUARIOS_SUCESSO) {
+    pthread_mutex_unlock(&contexto->log.trava);
+    return USUARIOS_FALHA_WAL;
+  }
+  memcpy(contexto->log.buffer + contexto->log.pendentes*USUARIOS_DB_REGISTRO_TAMANHO, registro, USUARIOS_DB_REGISTRO_TAMANHO);
+  if(++contexto->log.pendentes >= USUARIOS_WAL_LOTE) usuarios_walCommit(contexto); /* Se falhar o lote fica para a próxima entrada */
+  pthread_mutex_unlock(&contexto->log.trava);
+  
   return USUARIOS_SUCESSO;
 }
 
 /*!
- * @fn usuarios_condRet usuarios_cadastro(int n, ...)
- * @brief Função de cadastro de usuários
- * @param n=8 como parâmetro (necessário para uso da elipse)
- * @param (...) Deverá conter 8 pares de argumentos seguindo essa ordem: const char *tipo, dado com dado podendo assumir os tipos char *, usuarios_forma_de_pagamento, usuarios_tipo_usuario
- * @return Retorna uma instância usuarios_condRet que assume: 
- *  - USUARIOS_FALHA_GRAFONULL se o grafo de usuários for NULL; 
- *  - USUARIOS_FALHA_ARGUMENTOSINVALIDOS se n não for 8; 
- *  - USUARIOS_FALHA_CARACTERESILEGAIS se houver algum caracter inválido nos argumentos passados como '\\t' e '\\n'; 
- *  - USUARIOS_FALHA_EMAIL_INVALIDO se o email não for válido; 
- *  - USUARIOS_FALHA_SENHAS_INVALIDAS se as senhas não coincidem; 
- *  - USUARIOS_USUARIOEXISTE se houver repetição de dados; 
- *  - USUARIOS_FALHA_ADICIONAR_GRAFO se não conseguir criar um vértice no grafo; 
- *  - USUARIOS_FALHA_INSERIR_DADOS se não conseguir atribuir valores ao vértice no grafo; 
- *  - USUARIOS_SUCESSO se tiver criado um vértice com sucesso no grafo e atualizado o arquivo de dados com ele
- * 
- * Recebe como parâmetros nome, endereço, email, senha repetida duas vezes, forma de pagamento, tipo de usuário da seguinte maneira:
- * 
- * @code 
- * usuarios_cadastro(8, "usuario", "jose123", "nome", "José Antônio", "email", "joao@antonio.com", "endereco", "Rua Foo Casa Bar", "senha", "123456", "senha_confirmacao", "123456", "formaPagamento", BOLETO, "tipo", CONSUMIDOR);
- * @endcode
+ * @fn usuarios_condRet usuarios_sincronizar_r(usuarios_contexto *contexto)
+ * @brief Grava o log de alterações pendente e o aplica em USUARIOS_DB
+ * @return Uma instância usuarios_condRet que assume:
+ *  - USUARIOS_FALHA_WAL se não conseguir gravar o log;
+ *  - USUARIOS_FALHA_LERDB se não conseguir abrir USUARIOS_DB como "r+";
+ *  - USUARIOS_SUCESSO se USUARIOS_DB estiver atualizado com todas as alterações.
  *
- * Assertivas de entrada: 
- *  - o arquivo USUARIOS_DB já existe, isto é a função usuarios_carregarArquivo já foi executada. 
- *  - Deve ser passado o número correto de argumentos
- *  - Todos os argumentos devem ser passados: usuario, nome, email, endereco, senha, senha_confirmacao, formaPagamento e tipo.
+ * Deve ser chamada antes de encerrar o programa ou de ler USUARIOS_DB
+ * por fora do módulo. usuarios_limpar já a chama.
+ *
+ * Assertivas de entrada:
+ *  - Nenhuma
  *
  * Assertivas de saída:
- *  - O arquivo de dados de usuário é atualizado com o novo usuário
- *  - O grafo passa a ter o novo vértice para o usuário
- *  - Nenhum outro vértice ou aresta do grafo é afetado
- *  - O usuário é ATIVO imediatamente depois do cadastro
- *  - O usuário tem um identificador maior que todos os outros no grafo
- *  - A variável global do módulo usuarios_contador é acrescida de 1
+ *  - USUARIOS_DB_WAL está vazio e USUARIOS_DB reflete o grafo
  *
  * Assertivas estruturais:
- *  - O grafo é consistente e não nulo
- *  - Todas as strings passadas na elipse são terminadas com '\0'
+ *  - Nenhuma
  *
  * Assertivas de contrato:
- *  - A função cria um nó para o usuário no cadastro se atender aos requisitos de validação no cadastro e houver memória para o arquivo de dados e na RAM
+ *  - Nenhuma
  *
  * Requisitos:
- *  - stdarg.h, stdio.h, stdlib.h, grafo.h
- * 
+ *  - pthread.h
+ *
  * Hipóteses:
- *  - Nenhuma.
+ *  - Nenhuma
+ */
+
+usuarios_condRet usuarios_sincronizar_r(usuarios_contexto *contexto){
+  usuarios_condRet retorno;
+  pthread_mutex_lock(&contexto->log.trava);
+  retorno = usuarios_walCheckpoint(contexto);
+  pthread_mutex_unlock(&contexto->log.trava);
+  return retorno;
+}
+
+/*!
+ * @fn static int usuarios_lerRegistro(FILE *arquivo, usuarios_linha *linha)
+ * @brief Lê o registro de usuário na posição corrente de um arquivo no formato de USUARIOS_DB
+ * @param corrente Recebe os dados lidos
+ * @return Nulo se não houver registro (fim do arquivo ou identificador 0)
+ *
+ * Deixa o arquivo no início do próximo registro.
  *
+ * Requisitos:
+ *  - stdio.h
  */
 
-usuarios_condRet usuarios_cadastro(int n, ...){
-  FILE *db_usuarios;
+static int usuarios_lerRegistro(FILE *arquivo, usuarios_linha *linha){
+  tpUsuario *corrente = &linha->dados;
   
-  /* Verificamos se o grafo de usuários foi iniciado */
-  if(usuarios_grafo == NULL) return USUARIOS_FALHA_GRAFONULL;
+  corrente->identificador = 0;
+  fscanf(arquivo, "%u%*[^\t]\t", &(corrente->identificador));
+  if(corrente->identificador == 0) return 0;
   
-  /* Retorna USUARIOS_FALHA_ARGUMENTOSINVALIDOS se n for diferente de 8 */
-  if(n!=8) return USUARIOS_FALHA_ARGUMENTOSINVALIDOS;
+  usuarios_lerString(arquivo, corrente->usuario, USUARIOS_LIMITE_USUARIO);
+  usuarios_lerString(arquivo, linha->nome, USUARIOS_LIMITE_NOME);
+  usuarios_lerString(arquivo, corrente->email, USUARIOS_LIMITE_EMAIL);
+  usuarios_lerString(arquivo, corrente->senha, USUARIOS_LIMITE_SENHA);
+  usuarios_lerString(arquivo, linha->endereco, USUARIOS_LIMITE_ENDERECO);
   
-  /* Dados a armazenar */
-  tpUsuario *novo;
-  char senha_confirmacao[USUARIOS_LIMITE_SENHA];
+  fscanf(arquivo, "%d%*[^\t]\t%d%*[^\t]\t%d%*[^\t]\t%lf%*[^\t]\t%u%*[^\t]\t%u%*[^\n]\n", 
+    (int *)&(corrente->formaPagamento),
+    (int *)&(corrente->tipo),
+    (int *)&(corrente->estado),
+    &(corrente->avaliacao),
+    &(corrente->n_avaliacao),
+    &(corrente->n_reclamacoes)
+  );
   
-  /* Argumentos */  
-  va_list argumentos;
-  va_start(argumentos, n);
-  unsigned int i = 0, j;
+  return 1;
+}
+
+/*!
+ * @fn static void usuarios_paginaDesligar(usuarios_paginacao *paginacao, unsigned int pagina)
+ * @brief Retira uma página da lista de uso recente
+*/
+
+static void usuarios_paginaDesligar(usuarios_paginacao *paginacao, unsigned int pagina){
+  usuarios_pagina *atual = &paginacao->paginas[pagina];
   
+  if(atual->anterior != UINT_MAX) paginacao->paginas[atual->anterior].proxima = atual->proxima;
+  else paginacao->cabeca = atual->proxima;
+  if(atual->proxima != UINT_MAX) paginacao->paginas[atual->proxima].anterior = atual->anterior;
+  else paginacao->cauda = atual->anterior;
+}
+
+/*!
+ * @fn static void usuarios_paginaLigar(usuarios_paginacao *paginacao, unsigned int pagina, int recente)
+ * @brief Coloca uma página fora da lista na cabeça, se recente for não nulo, ou na cauda
+*/
+
+static void usuarios_paginaLigar(usuarios_paginacao *paginacao, unsigned int pagina, int recente){
+  usuarios_pagina *atual = &paginacao->paginas[pagina];
   
+  if(recente) {
+    atual->anterior = UINT_MAX;
+    atual->proxima = paginacao->cabeca;
+    if(paginacao->cabeca != UINT_MAX) paginacao->paginas[paginacao->cabeca].anterior = pagina;
+    else paginacao->cauda = pagina;
+    paginacao->cabeca = pagina;
+  }
+  else {
+    atual->proxima = UINT_MAX;
+    atual->anterior = paginacao->cauda;
+    if(paginacao->cauda != UINT_MAX) paginacao->paginas[paginacao->cauda].proxima = pagina;
+    else paginacao->cabeca = pagina;
+    paginacao->cauda = pagina;
+  }
+}
+
+/*!
+ * @fn static void usuarios_paginaTocar(usuarios_paginacao *paginacao, unsigned int pagina)
+ * @brief Marca a página como a usada mais recentemente
+*/
+
+static void usuarios_paginaTocar(usuarios_paginacao *paginacao, unsigned int pagina){
+  if(paginacao->cabeca == pagina) return;
+  usuarios_paginaDesligar(paginacao, pagina);
+  usuarios_paginaLigar(paginacao, pagina, 1);
+}
+
+/*!
+ * @fn static unsigned int usuarios_paginaVitima(usuarios_contexto *contexto)
+ * @brief Libera a página usada há mais tempo, que não seja a da sessão, e a retorna fora da lista
+ * @return A página liberada ou UINT_MAX se não conseguir aplicar o log
+ *
+ * Se o registro foi alterado desde que foi lido o log é aplicado antes,
+ * para que USUARIOS_DB esteja atualizado quando ele voltar a ser lido.
+ * Páginas só lidas saem sem checkpoint.
+*/
+
+static unsigned int usuarios_paginaVitima(usuarios_contexto *contexto){
+  usuarios_paginacao *paginacao = &contexto->paginacao;
+  unsigned int pagina = paginacao->cauda, identificador;
+  usuarios_condRet retorno = USUARIOS_SUCESSO;
   
-  /* Percorremos os argumentos, armazenamos os dados em usuarios_dadosTemp */
-  for(;i<n;i++){
-    char *argumento = va_arg(argumentos, char *);
-    for(j=0;j<usuarios_cadastro_argumentos_n;j++)
-      if(!strcmp(argumento, usuarios_args[j].validos)) {
-      	strncpy(usuarios_args[j].destino, va_arg(argumentos, char *), usuarios_args[j].tamanho-1);
-        usuarios_args[j].destino[usuarios_args[j].tamanho-1] = '\0';
-      }
-      
-    /* Casos especiais diferentes de char * */
-    if(!strcmp(argumento, "senha_confirmacao")) 
-      strncpy(senha_confirmacao, va_arg(argumentos, char *), USUARIOS_LIMITE_SENHA-1);
-    if(!strcmp(argumento, "formaPagamento")) 
-      usuarios_dadosTemp.formaPagamento = (usuarios_forma_de_pagamento)va_arg(argumentos, int);
-    if(!strcmp(argumento, "tipo")) 
-      usuarios_dadosTemp.tipo = (usuarios_tipo_usuario)va_arg(argumentos, int);
+  /* A sessão guarda um ponteiro para o registro, ele não pode sair */
+  if(&paginacao->paginas[pagina].dados == contexto->sessao) {
+    usuarios_paginaTocar(paginacao, pagina);
+    pagina = paginacao->cauda;
   }
   
-  usuarios_dadosTemp.estado = ATIVO;
-  usuarios_dadosTemp.avaliacao = 0;
-  usuarios_dadosTemp.n_avaliacao = 0;
-  usuarios_dadosTemp.n_reclamacoes = 0;
+  if(paginacao->paginas[pagina].sujo) {
+    pthread_mutex_lock(&contexto->log.trava);
+    if(contexto->log.pendentes || contexto->log.registradas) retorno = usuarios_walCheckpoint(contexto);
+    pthread_mutex_unlock(&contexto->log.trava);
+    if(retorno != USUARIOS_SUCESSO) return UINT_MAX;
+  }
   
-  va_end(argumentos);
+  usuarios_paginaDesligar(paginacao, pagina);
+  identificador = paginacao->paginas[pagina].dados.identificador;
+  if(identificador != 0 && identificador < contexto->nos_capacidade && contexto->nos[identificador] != NULL)
+    contexto->nos[identificador]->dados = NULL;
+  if(identificador != 0) usuarios_registroLiberar(contexto, &paginacao->paginas[pagina].dados);
+  paginacao->paginas[pagina].dados.identificador = 0;
   
+  return pagina;
+}
+
+/*!
+ * @fn static tpUsuario *usuarios_paginaFalta(usuarios_contexto *contexto, unsigned int identificador)
+ * @brief Lê de USUARIOS_DB o registro de um usuário que não está na memória
+ * @return O registro, agora o usado mais recentemente, ou NULL se não conseguir lê-lo
+*/
+
+static tpUsuario *usuarios_paginaFalta(usuarios_contexto *contexto, unsigned int identificador){
+  usuarios_paginacao *paginacao = &contexto->paginacao;
+  usuarios_linha lido;
+  unsigned int pagina;
   
-  /* Procuramos por caracteres ilegais, '\n' e '\t' pois são separadores */
-  for(j=0;j<usuarios_cadastro_argumentos_n;j++)
-    if(strstr(usuarios_args[j].destino, "\t") != NULL || strstr(usuarios_args[j].destino, "\n") != NULL)
-      return USUARIOS_FALHA_CARACTERESILEGAIS;
+  if(paginacao->paginas == NULL) {
+    paginacao->paginas = (usuarios_pagina *)malloc(paginacao->limite*sizeof(usuarios_pagina));
+    if(paginacao->paginas == NULL) return NULL;
+    paginacao->n = 0;
+    paginacao->cabeca = paginacao->cauda = UINT_MAX;
+  }
+  if(paginacao->leitura == NULL) {
+    paginacao->leitura = fopen(contexto->db, "r");
+    if(paginacao->leitura == NULL) return NULL;
+  }
   
-  /* Verificamos se o email é válido */
-  if(strstr(usuarios_dadosTemp.email, "@") == NULL || strstr(usuarios_dadosTemp.email, ".") == NULL) return USUARIOS_FALHA_EMAIL_INVALIDO;
+  if(paginacao->n < paginacao->limite) pagina = paginacao->n++;
+  else if((pagina = usuarios_paginaVitima(contexto)) == UINT_MAX) return NULL;
   
-  /* Verificamos se as senhas coincidem */
-  if(strcmp(usuarios_dadosTemp.senha, senha_confirmacao)) return USUARIOS_FALHA_SENHAS_INVALIDAS;
+  /* Os registros têm tamanho fixo, o de id k está na posição k-1 */
+  paginacao->paginas[pagina].sujo = 0;
+  fseek(paginacao->leitura, (long)(identificador-1)*USUARIOS_DB_REGISTRO_TAMANHO, SEEK_SET);
+  if(
+    !usuarios_lerRegistro(paginacao->leitura, &lido) || lido.dados.identificador != identificador ||
+    usuarios_linhaInternar(contexto, &lido, &paginacao->paginas[pagina].dados) != USUARIOS_SUCESSO
+  ) {
+    /* A página volta vazia para a cauda, para ser a próxima reaproveitada */
+    paginacao->paginas[pagina].dados.identificador = 0;
+    usuarios_paginaLigar(paginacao, pagina, 0);
+    return NULL;
+  }
   
-  /* Verificamos se já há um usuário desse */
-  if(usuarios_verificaRepeticao("usuario", usuarios_dadosTemp.usuario) != USUARIOS_DADOS_OK) return USUARIOS_USUARIOEXISTE;
-    
-  /* Verificamos se já há um email desse */
-  if(usuarios_verificaRepeticao("email", usuarios_dadosTemp.email) != USUARIOS_DADOS_OK) return USUARIOS_USUARIOEXISTE;
+  usuarios_paginaLigar(paginacao, pagina, 1);
+  contexto->nos[identificador]->dados = &paginacao->paginas[pagina].dados;
+  return &paginacao->paginas[pagina].dados;
+}
+
+/*!
+ * @fn static void usuarios_paginasLimpar(usuarios_contexto *contexto)
+ * @brief Tira dos nós os registros das páginas e libera as páginas e os nomes, mantendo o limite
+ *
+ * Deve ser chamada antes de destruir o grafo, que liberaria os dados dos nós.
+*/
+
+static void usuarios_paginasLimpar(usuarios_contexto *contexto){
+  usuarios_paginacao *paginacao = &contexto->paginacao;
+  unsigned int i, identificador, limite = paginacao->limite;
   
-  /* Define-se o identificador */
-  usuarios_dadosTemp.identificador = ++usuarios_contador;
+  for(i=0;i<paginacao->n;i++) {
+    identificador = paginacao->paginas[i].dados.identificador;
+    if(identificador != 0 && identificador < contexto->nos_capacidade && contexto->nos[identificador] != NULL &&
+       contexto->nos[identificador]->dados == &paginacao->paginas[i].dados)
+      contexto->nos[identificador]->dados = NULL;
+    if(identificador != 0) usuarios_registroLiberar(contexto, &paginacao->paginas[i].dados);
+  }
   
-  /* Copiamos o valor temporário para o alocado */
-  novo = (tpUsuario *)malloc(sizeof(tpUsuario));
-  memcpy(novo, &usuarios_dadosTemp, sizeof(tpUsuario));
+  if(paginacao->leitura != NULL) fclose(paginacao->leitura);
+  free(paginacao->paginas);
+  free(paginacao->nomes);
+  free(paginacao->deslocamentos);
+  memset(paginacao, 0, sizeof(usuarios_paginacao));
+  paginacao->limite = limite;
+}
+
+/*!
+ * @fn static usuarios_condRet usuarios_paginasNome(usuarios_contexto *contexto, unsigned int identificador, const char *usuario)
+ * @brief Guarda o nome de usuário de um id no modo preguiçoso
+ * @return USUARIOS_FALHA_ALOCAR se não houver memória, USUARIOS_SUCESSO caso contrário
+ *
+ * Um nome trocado continua ocupando seu espaço até o próximo carregamento.
+*/
+
+static usuarios_condRet usuarios_paginasNome(usuarios_contexto *contexto, unsigned int identificador, const char *usuario){
+  usuarios_paginacao *paginacao = &contexto->paginacao;
+  size_t tamanho = strlen(usuario)+1, bytes;
+  unsigned int capacidade;
+  size_t *deslocamentos;
+  char *nomes;
   
+  if(identificador >= paginacao->deslocamentos_capacidade) {
+    capacidade = paginacao->deslocamentos_capacidade ? paginacao->deslocamentos_capacidade : 64;
+    while(capacidade <= identificador) capacidade *= 2;
+    deslocamentos = (size_t *)realloc(paginacao->deslocamentos, capacidade*sizeof(size_t));
+    if(deslocamentos == NULL) return USUARIOS_FALHA_ALOCAR;
+    paginacao->deslocamentos = deslocamentos;
+    paginacao->deslocamentos_capacidade = capacidade;
+  }
   
-  /* Devemos percorrer o grafo usuarios_grafo e salvar no arquivo */
-  db_usuarios = fopen(USUARIOS_DB, "a+");
+  if(paginacao->nomes_tamanho + tamanho > paginacao->nomes_capacidade) {
+    bytes = paginacao->nomes_capacidade ? paginacao->nomes_capacidade : 4096;
+    while(bytes < paginacao->nomes_tamanho + tamanho) bytes *= 2;
+    nomes = (char *)realloc(paginacao->nomes, bytes);
+    if(nomes == NULL) return USUARIOS_FALHA_ALOCAR;
+    paginacao->nomes = nomes;
+    paginacao->nomes_capacidade = bytes;
+  }
   
-  /* Gravamos no arquivo */
-  fprintf(db_usuarios, USUARIOS_DB_ESTRUTURA, 
-    novo->identificador,
-    novo->usuario,
-    novo->nome,
-    novo->email,
-    novo->senha,
-    novo->endereco,
-    (int)novo->formaPagamento,
-    (int)novo->tipo,
-    (int)novo->estado,
-    novo->avaliacao,
-    novo->n_avaliacao,
-    novo->n_reclamacoes
-  );
+  memcpy(paginacao->nomes + paginacao->nomes_tamanho, usuario, tamanho);
+  paginacao->deslocamentos[identificador] = paginacao->nomes_tamanho;
+  paginacao->nomes_tamanho += tamanho;
   
-  /* Adicionamos ao grafo */
+  return USUARIOS_SUCESSO;
+}
+
+/*!
+ * @fn static unsigned int usuarios_paginasUsuario(usuarios_contexto *contexto, const char *usuario)
+ * @brief Procura um nome de usuário entre os nomes do modo preguiçoso
+ * @return O id do usuário ou 0 se não existir
+*/
+
+static unsigned int usuarios_paginasUsuario(usuarios_contexto *contexto, const char *usuario){
+  usuarios_paginacao *paginacao = &contexto->paginacao;
+  unsigned int i;
   
-  if(adiciona_vertice(usuarios_grafo, novo->identificador) != SUCESSO) {
-    fclose(db_usuarios);
-    free(novo);
-    return USUARIOS_FALHA_ADICIONAR_GRAFO;
-  }
+  for(i=1;i<=contexto->contador && i<paginacao->deslocamentos_capacidade;i++)
+    if(!strcmp(paginacao->nomes + paginacao->deslocamentos[i], usuario)) return i;
+  return 0;
+}
+
+/*!
+ * @fn static usuarios_condRet usuarios_paginasEmail(usuarios_contexto *contexto, const char *email)
+ * @brief Verifica no arquivo de dados se um email já está em uso, para o modo preguiçoso
+ * @return USUARIOS_DADOS_REPETICAO se estiver, USUARIOS_FALHA_WAL se não conseguir aplicar o log, USUARIOS_DADOS_OK caso contrário
+*/
+
+static usuarios_condRet usuarios_paginasEmail(usuarios_contexto *contexto, const char *email){
+  usuarios_condRet retorno = USUARIOS_DADOS_OK;
+  usuarios_linha lido;
+  FILE *db_usuarios;
   
-  /* Definimos o valores correntes no vértice */
-  if(muda_valor_vertice(usuarios_grafo, novo->identificador, (void *)novo) != SUCESSO) {
-    fclose(db_usuarios);
-    free(novo);
-    return USUARIOS_FALHA_INSERIR_DADOS;
+  /* O arquivo precisa ter as alterações que ainda estão no log */
+  if(usuarios_sincronizar_r(contexto) != USUARIOS_SUCESSO) return USUARIOS_FALHA_WAL;
+  
+  db_usuarios = fopen(contexto->db, "r");
+  if(db_usuarios == NULL) return USUARIOS_DADOS_OK;
+  while(!feof(db_usuarios) && usuarios_lerRegistro(db_usuarios, &lido)) {
+    if(!strcmp(lido.dados.email, email)) {
+      retorno = USUARIOS_DADOS_REPETICAO;
+      break;
+    }
   }
-      
   fclose(db_usuarios);
   
-  return USUARIOS_SUCESSO;
+  return retorno;
 }
 
 /*!
- * @fn int usuarios_sessaoAberta()
- * @brief Função que verifica se há uma sessão aberta
- * @return Retorna 0 se não tiver e 1 se tiver
- * 
- * Assertivas de entrada:
- *  - Nenhuma.
- * 
- * Assertivas de saída:
- *  - O retorno será 1 ou 0
- *
- * Assertivas estruturais:
- *  - Nenhuma
- *
- * Assertivas de contrato:
- *  - A função garante que usuarios_sessao é não nulo, indicativo suficiente de que haja sessão ou não. Mas se usuarios_sessao não for consistente com o grafo, esta função não detectará
- *
- * Requisitos:
- *  - Nenhum
- * 
- * Hipóteses:
- *  - usuarios_sessao é consistente com o grafo
+ * @fn static const char *usuarios_textoMemoria(const char *p, const char *fim, char *destino, unsigned int limite)
+ * @brief Copia um campo de texto de um registro na memória, como usuarios_lerString
+ * @param limite Tamanho de destino, incluindo o '\0'
+ * @return Início do próximo campo
  *
- */
+ * O campo termina em '\t', '\n' ou fim; espaços de preenchimento no
+ * final são descartados.
+*/
 
-int usuarios_sessaoAberta(){
-  if(usuarios_sessao == NULL) return 0;
-  return 1;
+static const char *usuarios_textoMemoria(const char *p, const char *fim, char *destino, unsigned int limite){
+  unsigned int i = 0, tamanho = 0;
+  
+  for(; p < fim && *p != '\t' && *p != '\n'; p++) {
+    if(i+1 < limite) {
+      destino[i++] = *p;
+      if(*p != ' ') tamanho = i;
+    }
+  }
+  destino[tamanho] = '\0';
+  
+  return (p < fim && *p == '\t') ? p+1 : p;
 }
 
 /*!
- * @fn usuarios_condRet usuarios_login(char *usuario, char *senha)
- * @brief Buscamos a conta correspondente ao login e senha passados
- * @param usuario string finalizada com '\0' indicando o usuário a ser buscado no grafo
- * @param senha string finalizada com '\0' indicando a senha a ser buscada no grafo
- * @return Instância usuarios_condRet que assume: 
- *  - USUARIOS_FALHA_SESSAOABERTA se já houver uma sessão aberta; 
- *  - USUARIOS_GRAFO_CORROMPIDO se não encontrar o usuário; 
- *  - USUARIOS_FALHA_INATIVO se o usuário for INATIVO; 
- *  - USUARIOS_SUCESSO se encontrar e iniciar a sessão com sucesso.
- * 
- * Recebe as strings usuário e senha, se ambos coincidirem para um nó, esse nó passa ser o nó da sessão
- *
- * Assertivas de entrada:
- *  - O grafo foi carregado e é consistente
- * 
- * Assertivas de saída:
- *  - O grafo não será alterado
- *  - Haverá sessão se e só se os dados coincidirem
- *
- * Assertivas estruturais:
- *  - Usuario e senha terminam com '\0' e não excedem o limite de cada um definido em usuarios.h
- *
- * Assertivas de contrato:
- *  - Nenhuma.
- *
- * Requisitos:
- *  - grafo.h
- *
- * Hipóteses:
- *  - Nenhuma
- *
- */
+ * @fn static const char *usuarios_numeroMemoria(const char *p, const char *fim, double *valor)
+ * @brief Lê um campo numérico de um registro na memória
+ * @return Início do próximo campo
+*/
 
-usuarios_condRet usuarios_login(char *usuario, char *senha){
-  tpUsuario *corrente;
-  usuarios_condRet busca;
-  unsigned int posicao;
-  if(usuarios_sessaoAberta()) return USUARIOS_FALHA_SESSAOABERTA;
+static const char *usuarios_numeroMemoria(const char *p, const char *fim, double *valor){
+  char numero[32];
+  p = usuarios_textoMemoria(p, fim, numero, sizeof(numero));
+  *valor = strtod(numero, NULL);
+  return p;
+}
+
+/*!
+ * @fn static int usuarios_registroMemoria(const char *p, const char *fim, usuarios_linha *linha)
+ * @brief Lê um registro no formato de USUARIOS_DB que está na memória, como usuarios_lerRegistro
+ * @param p Início da linha do registro
+ * @param fim Fim da linha, o '\n' ou o fim do trecho
+ * @return Nulo se o identificador for 0 ou ilegível
+*/
+
+static int usuarios_registroMemoria(const char *p, const char *fim, usuarios_linha *linha){
+  tpUsuario *corrente = &linha->dados;
+  double valor;
   
-  busca = usuarios_busca(usuarios_condParada_login, &corrente, &posicao, usuario, senha);
-  if(busca != USUARIOS_SUCESSO) return busca;
+  p = usuarios_numeroMemoria(p, fim, &valor);
+  corrente->identificador = (unsigned int)valor;
+  if(corrente->identificador == 0) return 0;
   
-  if(corrente == NULL) return USUARIOS_GRAFO_CORROMPIDO;
+  p = usuarios_textoMemoria(p, fim, corrente->usuario, USUARIOS_LIMITE_USUARIO);
+  p = usuarios_textoMemoria(p, fim, linha->nome, USUARIOS_LIMITE_NOME);
+  p = usuarios_textoMemoria(p, fim, corrente->email, USUARIOS_LIMITE_EMAIL);
+  p = usuarios_textoMemoria(p, fim, corrente->senha, USUARIOS_LIMITE_SENHA);
+  p = usuarios_textoMemoria(p, fim, linha->endereco, USUARIOS_LIMITE_ENDERECO);
+  p = usuarios_numeroMemoria(p, fim, &valor);
+  corrente->formaPagamento = (usuarios_forma_de_pagamento)(int)valor;
+  p = usuarios_numeroMemoria(p, fim, &valor);
+  corrente->tipo = (usuarios_tipo_usuario)(int)valor;
+  p = usuarios_numeroMemoria(p, fim, &valor);
+  corrente->estado = (usuarios_estado_de_usuario)(int)valor;
+  p = usuarios_numeroMemoria(p, fim, &corrente->avaliacao);
+  p = usuarios_numeroMemoria(p, fim, &valor);
+  corrente->n_avaliacao = (unsigned int)valor;
+  usuarios_numeroMemoria(p, fim, &valor);
+  corrente->n_reclamacoes = (unsigned int)valor;
   
-  /* Vemos se o usuário está ativo */
-  if(corrente->estado == ATIVO) {
-    usuarios_sessao = corrente;
-    return USUARIOS_SUCESSO;
+  return 1;
+}
+
+/*!
+ * @fn static int usuarios_parteCrescer(void **vetor, unsigned int capacidade, size_t tamanho)
+ * @brief Realoca um vetor da parte para capacidade itens de tamanho bytes
+ * @return Nulo se faltar memória, quando o vetor fica como estava
+*/
+
+static int usuarios_parteCrescer(void **vetor, unsigned int capacidade, size_t tamanho){
+  void *novo = realloc(*vetor, capacidade*tamanho);
+  if(novo == NULL) return 0;
+  *vetor = novo;
+  return 1;
+}
+
+/*!
+ * @fn static int usuarios_parteReservar(usuarios_parte_carga *parte, int arestas)
+ * @brief Garante espaço para mais um item nos vetores usados pela parte
+ * @param arestas Não nulo para o vetor de arestas, nulo para os de usuários
+ * @return Nulo se faltar memória
+*/
+
+static int usuarios_parteReservar(usuarios_parte_carga *parte, int arestas){
+  unsigned int capacidade;
+  
+  if(parte->n < parte->capacidade) return 1;
+  capacidade = parte->capacidade ? 2*parte->capacidade : 1024;
+  if(arestas) {
+    if(!usuarios_parteCrescer((void **)&parte->arestas, capacidade, sizeof(parte->arestas[0]))) return 0;
   }
-  else return USUARIOS_FALHA_INATIVO;
+  else if(parte->preguicoso) {
+    if(!usuarios_parteCrescer((void **)&parte->nomes, capacidade, sizeof(parte->nomes[0]))) return 0;
+    if(!usuarios_parteCrescer((void **)&parte->quentes, capacidade, sizeof(parte->quentes[0]))) return 0;
+  }
+  else if(!usuarios_parteCrescer((void **)&parte->registros, capacidade, sizeof(parte->registros[0]))) return 0;
+  parte->capacidade = capacidade;
+  return 1;
 }
 
 /*!
- * @fn usuarios_condRet usuarios_logout()
- * @brief Função de logout
- * @retorno Sempre retorna USUARIOS_SUCESSO
- * 
- * Finaliza a sessão aberta
- *
- * Assertivas de entrada:
- *  - Nenhuma
- * 
- * Assertivas de saída:
- *  - o global do módulo usuarios_sessao é NULL
- *
- * Assertivas de contrato:
- *  - Nenhuma
- *
- * Assertivas estruturais:
- *  - Nenhuma
- * 
- * Requisitos:
- *  - Nenhum
- * 
- * Hipóteses:
- *  - Nenhuma
+ * @fn static int usuarios_parteTexto(usuarios_parte_carga *parte, const char *texto, uint32_t *posicao)
+ * @brief Acrescenta texto aos textos da parte e retorna em posicao onde ele ficou
+ * @return Nulo se faltar memória ou se a posição não couber em 32 bits
  *
- */
+ * A thread não pode internar, o conjunto de textos é do contexto; o
+ * texto fica na parte até a montagem.
+*/
 
-usuarios_condRet usuarios_logout(){
-  usuarios_sessao = NULL;
-  return USUARIOS_SUCESSO;
+static int usuarios_parteTexto(usuarios_parte_carga *parte, const char *texto, uint32_t *posicao){
+  size_t tamanho = strlen(texto)+1, capacidade;
+  char *textos;
+  
+  if(parte->textos_tamanho > UINT32_MAX) return 0;
+  if(parte->textos_tamanho + tamanho > parte->textos_capacidade) {
+    capacidade = parte->textos_capacidade ? 2*parte->textos_capacidade : 65536;
+    textos = (char *)realloc(parte->textos, capacidade);
+    if(textos == NULL) return 0;
+    parte->textos = textos;
+    parte->textos_capacidade = capacidade;
+  }
+  
+  memcpy(parte->textos + parte->textos_tamanho, texto, tamanho);
+  *posicao = (uint32_t)parte->textos_tamanho;
+  parte->textos_tamanho += tamanho;
+  return 1;
 }
 
 /*!
- * @fn usuarios_relacao usuarios_verificarAmizade(unsigned int identificador)
- * @brief Função verifica um usuário é amigo do usuário na sessão
- * @param identificador Um inteiro positivo que represete o id de um usuário no grafo.
- * @return Retorna usuarios_relacao, podendo ser ERRO, AMIGOS, NENHUMA, ACONFIRMAR ou AGUARDANDOCONFIRMACAO. 
- *  - ERRO, caso algum erro ocorra, como a assertiva de entrada não ser respeitada; AMIGOS, se forem amigos; 
- *  - NENHUMA, se não existir relação direta entre eles; 
- *  - ACONFIRMAR, se o usuário pesquisado não tiver confirmado a amizade; 
- *  - AGUARDANDOCONFIRMACAO, se o usuário da sessão estiver por aceitar a amizade ou não.
- *
- * Recebe o identificador do usuário a ser verificada a relação de amizade com o usuário da sessão
- * 
- * Assertivas de entrada:
- *  - Há uma sessão aberta
- *  - o identificador refere-se a um nó no grafo
- * 
- * Assertivas de saída:
- *  - O grafo não é alterado
+ * @fn static void *usuarios_cargaUsuarios(void *argumento)
+ * @brief Thread da carga: lê os registros de usuários de uma parte (usuarios_parte_carga *)
+ * @return Sempre NULL
  *
- * Assertivas estruturais:
- *  - Nenhuma
- *
- * Assertivas de contrato:
- *  - Nenhuma
- * 
- * Requisitos:
- *  - grafo.h
- *
- * Hipóteses:
- *  - O usuário é ATIVO
- * 
- */
+ * Para no primeiro registro de identificador 0, como a carga serial.
+*/
 
-usuarios_relacao usuarios_verificarAmizade(unsigned int identificador){
-  grafo_arco *A, *B;
+static void *usuarios_cargaUsuarios(void *argumento){
+  usuarios_parte_carga *parte = (usuarios_parte_carga *)argumento;
+  const char *p = parte->inicio, *linha;
+  usuarios_linha lido;
+  tpUsuario *corrente;
   
-  if(usuarios_grafo == NULL) return ERRO;
+  while(p < parte->fim) {
+    linha = (const char *)memchr(p, '\n', parte->fim - p);
+    if(linha == NULL) linha = parte->fim;
+    
+    if(parte->preguicoso) {
+      if(!usuarios_registroMemoria(p, linha, &lido)) {
+        parte->terminado = 1;
+        break;
+      }
+      if(!usuarios_parteReservar(parte, 0)) {
+        parte->falha = 1;
+        break;
+      }
+      memcpy(parte->nomes[parte->n], lido.dados.usuario, USUARIOS_LIMITE_USUARIO);
+      usuarios_quentePreencher(&parte->quentes[parte->n], &lido.dados);
+      parte->n++;
+    }
+    else {
+      if(!usuarios_registroMemoria(p, linha, &lido)) {
+        parte->terminado = 1;
+        break;
+      }
+      /* Os textos só são internados na montagem, que é serial */
+      corrente = (tpUsuario *)malloc(sizeof(tpUsuario));
+      if(
+        corrente == NULL || !usuarios_parteReservar(parte, 0) ||
+        !usuarios_parteTexto(parte, lido.nome, &lido.dados.nome) || !usuarios_parteTexto(parte, lido.endereco, &lido.dados.endereco)
+      ) {
+        free(corrente);
+        parte->falha = 1;
+        break;
+      }
+      memcpy(corrente, &lido.dados, sizeof(tpUsuario));
+      parte->registros[parte->n++] = corrente;
+    }
+    
+    p = linha+1;
+  }
   
-  /* Verificamos se há sessão */
-  if(!usuarios_sessaoAberta()) return ERRO;
+  return NULL;
+}
+
+/*!
+ * @fn static void *usuarios_cargaAmizades(void *argumento)
+ * @brief Thread da carga: lê os registros de amizades, vivos e mortos, de uma parte (usuarios_parte_carga *)
+ * @return Sempre NULL
+*/
+
+static void *usuarios_cargaAmizades(void *argumento){
+  usuarios_parte_carga *parte = (usuarios_parte_carga *)argumento;
+  const char *p = parte->inicio, *linha;
+  char *resto;
+  int i;
+  long valor;
   
-  /* Verificamos se não quer observar uma amizade consigo mesmo */  
-  if(identificador == usuarios_sessao->identificador) return ERRO;
+  while(p < parte->fim) {
+    linha = (const char *)memchr(p, '\n', parte->fim - p);
+    if(linha == NULL) linha = parte->fim;
     
-  A = grafo_busca_arco(usuarios_grafo, usuarios_sessao->identificador, identificador);
-  B = grafo_busca_arco(usuarios_grafo, identificador, usuarios_sessao->identificador);
-  
-  if(A != NULL && B != NULL) return AMIGOS;
-  if(A == NULL && B == NULL) return NENHUMA;
-  if(A == NULL && B != NULL) return ACONFIRMAR;
-  if(A != NULL && B == NULL) return AGUARDANDOCONFIRMACAO;
+    if(!usuarios_parteReservar(parte, 1)) {
+      parte->falha = 1;
+      break;
+    }
+    /* Três inteiros separados por espaços, registros mortos são alinhados à direita */
+    for(i=0;i<3;i++) {
+      valor = strtol(p, &resto, 10);
+      if(resto == p || resto > linha) break;
+      parte->arestas[parte->n][i] = (int)valor;
+      p = resto;
+    }
+    if(i < 3) {
+      parte->terminado = 1;
+      break;
+    }
+    parte->n++;
+    
+    p = linha+1;
+  }
   
+  return NULL;
 }
 
-
 /*!
- * @fn usuarios_condRet usuarios_criarAmizade(unsigned int identificador)
- * @brief Função que cria parte de uma relação de amizade na sesão iniciada para algum outro cliente
- * @param identificador Um inteiro positivo que represete o id de um usuário no grafo.
- * @return Retorna uma instância usuarios_condRet que assume:
+ * @fn static unsigned int usuarios_cargaParalela(usuarios_contexto *contexto, const char *conteudo, size_t tamanho, void *leitor(void *), usuarios_parte_carga *partes)
+ * @brief Divide conteudo em partes alinhadas a registros e as lê em paralelo com leitor
+ * @param partes Vetor com USUARIOS_CARGA_THREADS_MAX posições zeradas
+ * @return Número de partes usadas
+ *
+ * Cada parte termina logo depois de um '\n', então nenhum registro é
+ * dividido. Uma thread que não puder ser criada tem sua parte lida pela
+ * thread chamadora.
+*/
+
+static unsigned int usuarios_cargaParalela(usuarios_contexto *contexto, const char *conteudo, size_t tamanho, void *leitor(void *), usuarios_parte_carga *partes){
+  pthread_t threads[USUARIOS_CARGA_THREADS_MAX];
+  int criada[USUARIOS_CARGA_THREADS_MAX];
+  unsigned int n = contexto->threads_carga, i;
+  const char *p = conteudo, *fim = conteudo + tamanho, *corte;
+  long processadores;
+  
+  if(n == 0) {
+    processadores = sysconf(_SC_NPROCESSORS_ONLN);
+    n = (processadores > 0) ? (unsigned int)processadores : 1;
+  }
+  if(n > USUARIOS_CARGA_THREADS_MAX) n = USUARIOS_CARGA_THREADS_MAX;
+  /* Não vale criar threads para trechos pequenos */
+  if(tamanho/n < 64*1024) n = (unsigned int)(tamanho/(64*1024)) + 1;
+  
+  for(i=0;i<n;i++) {
+    partes[i].inicio = p;
+    if(i == n-1) corte = fim;
+    else {
+      corte = conteudo + (tamanho/n)*(i+1);
+      if(corte < p) corte = p;
+      corte = (const char *)memchr(corte, '\n', fim - corte);
+      corte = (corte == NULL) ? fim : corte+1;
+    }
+    partes[i].fim = corte;
+    partes[i].preguicoso = contexto->paginacao.limite != 0;
+    p = corte;
+  }
+  
+  for(i=1;i<n;i++) criada[i] = pthread_create(&threads[i], NULL, leitor, &partes[i]) == 0;
+  leitor(&partes[0]);
+  for(i=1;i<n;i++) {
+    if(criada[i]) pthread_join(threads[i], NULL);
+    else leitor(&partes[i]);
+  }
+  
+  return n;
+}
+
+/*!
+ * @fn static char *usuarios_mapear(const char *caminho, size_t *tamanho)
+ * @brief Mapeia um arquivo inteiro na memória para leitura
+ * @return O conteúdo, a ser liberado com munmap, ou NULL se o arquivo estiver vazio ou não puder ser mapeado
+*/
+
+static char *usuarios_mapear(const char *caminho, size_t *tamanho){
+  struct stat estado;
+  void *conteudo;
+  int arquivo;
+  
+  *tamanho = 0;
+  arquivo = open(caminho, O_RDONLY);
+  if(arquivo < 0) return NULL;
+  if(fstat(arquivo, &estado) != 0 || estado.st_size == 0) {
+    close(arquivo);
+    return NULL;
+  }
+  conteudo = mmap(NULL, estado.st_size, PROT_READ, MAP_PRIVATE, arquivo, 0);
+  close(arquivo);
+  if(conteudo == MAP_FAILED) return NULL;
+  
+  *tamanho = estado.st_size;
+  return (char *)conteudo;
+}
+
+/*!
+ * @fn static void usuarios_partesLimpar(usuarios_parte_carga *partes, unsigned int n)
+ * @brief Libera os vetores das partes e os registros que não foram para o grafo
+*/
+
+static void usuarios_partesLimpar(usuarios_parte_carga *partes, unsigned int n){
+  unsigned int i, j;
+  
+  for(i=0;i<n;i++) {
+    for(j=0;j<partes[i].n && partes[i].registros != NULL;j++) free(partes[i].registros[j]);
+    free(partes[i].registros);
+    free(partes[i].textos);
+    free(partes[i].nomes);
+    free(partes[i].quentes);
+    free(partes[i].arestas);
+  }
+  memset(partes, 0, n*sizeof(usuarios_parte_carga));
+}
+
+/*!
+ * @fn static int usuarios_cargaArquivo(usuarios_contexto *contexto, const char *caminho, void *leitor(void *), usuarios_parte_carga *partes, unsigned int *n)
+ * @brief Mapeia um arquivo de dados e o lê em partes com leitor (usuarios_cargaParalela)
+ * @param partes Vetor com USUARIOS_CARGA_THREADS_MAX posições zeradas
+ * @param n Recebe o número de partes usadas
+ * @return 0 se o arquivo não existia e foi criado vazio, não nulo caso contrário
+*/
+
+static int usuarios_cargaArquivo(usuarios_contexto *contexto, const char *caminho, void *leitor(void *), usuarios_parte_carga *partes, unsigned int *n){
+  FILE *db;
+  char *conteudo;
+  size_t tamanho;
+  
+  *n = 0;
+  db = fopen(caminho, "r");
+  if(db == NULL){
+    db = fopen(caminho, "w");
+    fclose(db);
+    return 0;
+  }
+  fclose(db);
+  
+  conteudo = usuarios_mapear(caminho, &tamanho);
+  if(conteudo == NULL) return 1;
+  *n = usuarios_cargaParalela(contexto, conteudo, tamanho, leitor, partes);
+  munmap(conteudo, tamanho);
+  return 1;
+}
+
+/*!
+ * @fn static usuarios_condRet usuarios_cargaRegistro(usuarios_contexto *contexto, usuarios_parte_carga *parte, unsigned int j, unsigned int identificador, grafo_no *nodo)
+ * @brief Passa o j-ésimo registro lido em parte para nodo, o nó do usuário identificador, internando nome e endereco
+*/
+
+static usuarios_condRet usuarios_cargaRegistro(usuarios_contexto *contexto, usuarios_parte_carga *parte, unsigned int j, unsigned int identificador, grafo_no *nodo){
+  tpUsuario *registro = parte->registros[j];
+  uint32_t nome = registro->nome, endereco = registro->endereco;
+  
+  /* Trocamos as posições em textos pelos handles */
+  if(usuarios_internar(contexto, parte->textos + nome, &registro->nome) != USUARIOS_SUCESSO) return USUARIOS_FALHA_ALOCAR;
+  if(usuarios_internar(contexto, parte->textos + endereco, &registro->endereco) != USUARIOS_SUCESSO) {
+    usuarios_internoLiberar(contexto, registro->nome);
+    return USUARIOS_FALHA_ALOCAR;
+  }
+  
+  nodo->dados = (void *)registro;
+  parte->registros[j] = NULL; /* Agora é do grafo */
+  usuarios_quenteCopiar(contexto, identificador, registro);
+  return USUARIOS_SUCESSO;
+}
+
+/*!
+ * @fn static usuarios_condRet usuarios_cargaPreguicoso(usuarios_contexto *contexto, usuarios_parte_carga *parte, unsigned int j, unsigned int identificador)
+ * @brief No modo preguiçoso guarda só o nome de usuário e os campos quentes do j-ésimo registro de parte; o nó fica sem dados
+*/
+
+static usuarios_condRet usuarios_cargaPreguicoso(usuarios_contexto *contexto, usuarios_parte_carga *parte, unsigned int j, unsigned int identificador){
+  if(usuarios_paginasNome(contexto, identificador, parte->nomes[j]) != USUARIOS_SUCESSO) return USUARIOS_FALHA_ALOCAR;
+  contexto->quentes[identificador] = parte->quentes[j];
+  return USUARIOS_SUCESSO;
+}
+
+/*!
+ * @fn static usuarios_condRet usuarios_cargaNos(usuarios_contexto *contexto, usuarios_parte_carga *partes, unsigned int n)
+ * @brief Monta os nós na ordem do arquivo, até o primeiro registro que encerra a leitura, e define contexto->contador
+*/
+
+static usuarios_condRet usuarios_cargaNos(usuarios_contexto *contexto, usuarios_parte_carga *partes, unsigned int n){
+  usuarios_condRet retorno = USUARIOS_SUCESSO;
+  unsigned int i, j, indice = 1;
+  grafo_no *nodo;
+  int fim = 0;
+  
+  for(i=0;i<n && !fim && retorno == USUARIOS_SUCESSO;i++) {
+    if(partes[i].falha) retorno = USUARIOS_FALHA_ALOCAR;
+    for(j=0;j<partes[i].n && retorno == USUARIOS_SUCESSO;j++, indice++) {
+      nodo = grafo_anexa_vertice(contexto->grafo_usuarios, indice);
+      if(nodo == NULL) retorno = USUARIOS_FALHA_ADICIONAR_GRAFO;
+      else if(usuarios_indexarNo(contexto, indice, nodo) != USUARIOS_SUCESSO) retorno = USUARIOS_FALHA_ALOCAR;
+      else if(partes[i].preguicoso) retorno = usuarios_cargaPreguicoso(contexto, &partes[i], j, indice);
+      else retorno = usuarios_cargaRegistro(contexto, &partes[i], j, indice, nodo);
+    }
+    fim = partes[i].terminado;
+  }
+  
+  if(retorno == USUARIOS_SUCESSO) contexto->contador = indice-1; /* Número de usuários carregados */
+  return retorno;
+}
+
+/*!
+ * @fn static usuarios_condRet usuarios_cargaArestas(usuarios_contexto *contexto, usuarios_parte_carga *partes, unsigned int n)
+ * @brief Cria os arcos das amizades lidas, até o primeiro registro que encerra a leitura, e define contexto->contador_amizades
+*/
+
+static usuarios_condRet usuarios_cargaArestas(usuarios_contexto *contexto, usuarios_parte_carga *partes, unsigned int n){
+  usuarios_condRet retorno = USUARIOS_SUCESSO;
+  unsigned int i, j, identificador_A, identificador_B;
+  int fim = 0, valorAresta;
+  
+  for(i=0;i<n && !fim && retorno == USUARIOS_SUCESSO;i++) {
+    if(partes[i].falha) retorno = USUARIOS_FALHA_ALOCAR;
+    for(j=0;j<partes[i].n && retorno == USUARIOS_SUCESSO;j++) {
+      valorAresta = partes[i].arestas[j][0];
+      identificador_A = (unsigned int)partes[i].arestas[j][1];
+      identificador_B = (unsigned int)partes[i].arestas[j][2];
+      
+      /* O id de uma aresta é a posição do seu registro, então contamos também os mortos */
+      contexto->contador_amizades++;
+      /* Pulamos relações mortas */
+      if(!valorAresta) continue;
+      
+      if(
+        identificador_A >= contexto->nos_capacidade || contexto->nos[identificador_A] == NULL ||
+        identificador_B >= contexto->nos_capacidade || contexto->nos[identificador_B] == NULL
+      ) retorno = USUARIOS_FALHA_CRIARAMIZADE;
+      /* Vemos se já há um arco entre eles nesta direção, uma assertiva */
+      else if(usuarios_temArco(contexto->nos[identificador_A], contexto->nos[identificador_B])) retorno = USUARIOS_DB_CORROMPIDO;
+      /* Colocamos e definimos o id da aresta */
+      else if(grafo_anexa_aresta(contexto->nos[identificador_A], contexto->nos[identificador_B], valorAresta) != SUCESSO)
+        retorno = USUARIOS_FALHA_CRIARAMIZADE;
+    }
+    fim = partes[i].terminado;
+  }
+  
+  return retorno;
+}
+
+/*!
+ * @fn static void usuarios_cargaIniciar(usuarios_contexto *contexto)
+ * @brief Descarta as estruturas derivadas de um grafo anterior e cria um grafo vazio
+*/
+
+static void usuarios_cargaIniciar(usuarios_contexto *contexto){
+  /* Recomendações, o índice de pesquisa e as páginas de um grafo anterior não valem mais */
+  usuarios_recomendacoesLimpar(contexto);
+  usuarios_pesquisaLimpar(contexto);
+  usuarios_indicesLimpar(contexto);
+  usuarios_disponibilidadeLimpar(contexto);
+  usuarios_paginasLimpar(contexto);
+  usuarios_internosLimpar(contexto);
+  
+  /* Cria-se o grafo de usuários */
+  contexto->grafo_usuarios = cria_grafo("Usuários");
+  contexto->contador_amizades = 0;
+  contexto->contador = 0;
+}
+
+/*!
+ * @fn static void usuarios_cargaDesfazer(usuarios_contexto *contexto)
+ * @brief Apaga o grafo e os índices de uma carga que falhou
+*/
+
+static void usuarios_cargaDesfazer(usuarios_contexto *contexto){
+  usuarios_paginasLimpar(contexto);
+  destroi_grafo(&contexto->grafo_usuarios);
+  free(contexto->nos);
+  free(contexto->quentes);
+  contexto->nos = NULL;
+  contexto->quentes = NULL;
+  contexto->nos_capacidade = 0;
+  usuarios_internosLimpar(contexto);
+}
+
+/*!
+ * @fn static usuarios_condRet usuarios_carregar(usuarios_contexto *contexto)
+ * @brief Implementação de usuarios_carregarArquivo_r e usuarios_carregarIndice_r, que diferem em paginacao.limite
+ *
+ * Os arquivos são mapeados na memória, divididos em partes alinhadas a
+ * registros e lidos em paralelo (usuarios_cargaArquivo); o grafo é
+ * montado depois por uma única thread, percorrendo as partes em ordem
+ * (usuarios_cargaNos e usuarios_cargaArestas).
+ */
+
+static usuarios_condRet usuarios_carregar(usuarios_contexto *contexto){
+  usuarios_parte_carga partes[USUARIOS_CARGA_THREADS_MAX];
+  usuarios_condRet retorno;
+  unsigned int n;
+  
+  /* Recuperação: replicamos no arquivo de dados o log deixado por uma execução interrompida */
+  if(usuarios_sincronizar_r(contexto) == USUARIOS_FALHA_WAL) return USUARIOS_FALHA_WAL;
+  usuarios_walIniciar(contexto);
+  usuarios_cargaIniciar(contexto);
+  
+  memset(partes, 0, sizeof(partes));
+  if(!usuarios_cargaArquivo(contexto, contexto->db, usuarios_cargaUsuarios, partes, &n)) return USUARIOS_SUCESSO;
+  retorno = usuarios_cargaNos(contexto, partes, n);
+  usuarios_partesLimpar(partes, n);
+  if(retorno != USUARIOS_SUCESSO) {
+    usuarios_cargaDesfazer(contexto);
+    return retorno;
+  }
+  
+  /* Análogo para amigos */
+  if(!usuarios_cargaArquivo(contexto, contexto->db_amigos, usuarios_cargaAmizades, partes, &n)) return USUARIOS_SUCESSO;
+  retorno = usuarios_cargaArestas(contexto, partes, n);
+  usuarios_partesLimpar(partes, n);
+  
+  if(retorno != USUARIOS_SUCESSO) usuarios_cargaDesfazer(contexto);
+  return retorno;
+}
+
+/*!
+ * @fn usuarios_condRet usuarios_carregarArquivo_r(usuarios_contexto *contexto)
+ * @brief Função carregadora do arquivo de usuários e suas relações
+ * @return Uma instância usuarios_condRet que assume: 
+ *  - USUARIOS_SUCESSO se conseguir carregar com sucesso o grafo de usuários a partir do arquivo; 
+ *  - USUARIOS_FALHA_ADICIONAR_GRAFO se falhar em criar um vértice no grafo; 
+ *  - USUARIOS_FALHA_INSERIR_DADOS se falhar em definir os dados tirados do arquivo no vértice que acabou de ser criado; 
+ *  - USUARIOS_DB_CORROMPIDO se ao ler o arquivo de amizades encontrar uma aresta que já existe no grafo; 
+ *  - USUARIOS_FALHA_CRIARAMIZADE se não conseguir criar e definir uma aresta entre dois nós do grafo para representar uma amizade;
+ *  - USUARIOS_FALHA_ALOCAR se não conseguir alocar memória para um nó do grafo;
+ *  - USUARIOS_FALHA_WAL se não conseguir ler o log de alterações;
+ *  - USUARIOS_FALHA_LIMPAR se já houver um grafo carregado e não conseguir descartá-lo.
+ *
+ * Antes da leitura, entradas que tenham ficado em USUARIOS_DB_WAL são
+ * aplicadas em USUARIOS_DB (recuperação) e a thread de segundo plano do
+ * log é iniciada. Um grafo carregado antes é descartado com
+ * usuarios_limpar, que também fecha as sessões.
+ *
+ * A relação de um usuário com o outro é a relação de amizade, 
+ * o grafo é direcionado, assim a relação entre A e B 
+ * de fato existe se e só se existir uma aresta
+ * indo de A a B e outra indo de B a A.
+ * Se isso não ocorrer temos a pendencia de uma relação, na qual
+ * aguarda-se a confirmação da parte solicitada para criá-la.
+ * 
+ * Retorna USUARIOS_SUCESSO caso tenha carregado o arquivo corretamente e gerado o grafo de usuário. Deve ser a primeira função a ser carregada para que o módulo funcione.
+ *
+ * Assertivas de entrada:
+ *  - O arquivo indicado por USUARIOS_DB existe e é legível pelo programa, se não existir a função criará um arquivo e fechará com um grafo não nulo mas sem nós.
+ *  - O arquivo indicado por USUARIOS_DB_AMIGOS existe e é legível pelo programa, se não existir mas houverem usuários a função criará um arquivo e fechará com um grafo sem arestas.
+ *
+ * Assertivas de saída:
+ *  - O grafo de usuários é carregado junto as relações entre os nós
+ *  - Haverão arquivos USUARIOS_DB e USUARIOS_DB_AMIGOS
+ *  - O contador do contexto conterá o maior identificador de vértice no grafo e contador_amizades o número de registros, vivos e mortos, de USUARIOS_DB_AMIGOS, que é o maior id de aresta possível.
+ *
+ * Assertivas de contrato:
+ *  - O arquivo deve ter a estrutura indicada por USUARIOS_DB_ESTRUTURA
+ * 
+ * Requisitos:
+ *  - stdio.h, stdlib.h, grafo.h
+ *
+ * Hipóteses:
+ *  - Nenhuma
+ *
+ */
+
+usuarios_condRet usuarios_carregarArquivo_r(usuarios_contexto *contexto){
+  if(contexto->grafo_usuarios != NULL && usuarios_limpar_r(contexto) != USUARIOS_SUCESSO) return USUARIOS_FALHA_LIMPAR;
+  usuarios_paginasLimpar(contexto);
+  contexto->paginacao.limite = 0;
+  return usuarios_carregar(contexto);
+}
+
+/*!
+ * @fn usuarios_condRet usuarios_carregarIndice_r(usuarios_contexto *contexto, unsigned int limite)
+ * @brief Carrega o grafo de usuários e amizades sem carregar os registros completos dos usuários
+ * @param limite Número máximo de registros completos na memória, pelo menos USUARIOS_PAGINAS_MINIMO
+ * @return Os mesmos retornos de usuarios_carregarArquivo_r
+ *
+ * Na inicialização só os ids, os nomes de usuário e as amizades vão para
+ * a memória. O registro completo de um usuário é lido de USUARIOS_DB na
+ * primeira vez que alguma função precisar dele e fica em uma cache de
+ * limite registros; quando ela enche, o registro usado há mais tempo sai.
+ * Antes de sair um registro alterado, o log de alterações é aplicado em
+ * USUARIOS_DB, de modo que a próxima leitura veja a versão atual. O
+ * registro da sessão aberta por usuarios_login nunca sai.
+ *
+ * O tempo de inicialização e a memória passam a depender dos usuários
+ * de fato usados. O login procura o nome de usuário entre os nomes na
+ * memória, e a verificação de email repetido no cadastro lê USUARIOS_DB.
+ *
+ * @code
+ * usuarios_carregarIndice(4096);
+ * @endcode
+ *
+ * Assertivas de saída:
+ *  - O grafo e as amizades são os mesmos de usuarios_carregarArquivo
+ *  - Nenhum registro completo está na memória
+ *
+ * Requisitos:
+ *  - stdio.h, stdlib.h, grafo.h
+ *
+ * Hipóteses:
+ *  - Fora das funções de sessão por token, que travam o grafo com exclusividade neste modo, o contexto é usado por uma thread de cada vez: uma falta pode tirar da memória o registro que outra thread lê
+ */
+
+usuarios_condRet usuarios_carregarIndice_r(usuarios_contexto *contexto, unsigned int limite){
+  if(contexto->grafo_usuarios != NULL && usuarios_limpar_r(contexto) != USUARIOS_SUCESSO) return USUARIOS_FALHA_LIMPAR;
+  usuarios_paginasLimpar(contexto);
+  contexto->paginacao.limite = (limite < USUARIOS_PAGINAS_MINIMO) ? USUARIOS_PAGINAS_MINIMO : limite;
+  return usuarios_carregar(contexto);
+}
+
+/*!
+ * @fn unsigned int usuarios_registrosResidentes_r(usuarios_contexto *contexto)
+ * @brief Número de registros completos de usuários na memória
+ *
+ * Fora do modo preguiçoso de usuarios_carregarIndice todos os usuários
+ * carregados estão na memória.
+ */
+
+unsigned int usuarios_registrosResidentes_r(usuarios_contexto *contexto){
+  if(contexto->grafo_usuarios == NULL) return 0;
+  if(contexto->paginacao.limite == 0) return contexto->contador;
+  return contexto->paginacao.n;
+}
+
+/*!
+ * @fn unsigned int usuarios_textosInternados_r(usuarios_contexto *contexto)
+ * @brief Número de textos distintos de nome e endereco guardados pelos registros na memória
+ *
+ * Usuários com o mesmo nome ou endereço compartilham uma única cópia do
+ * texto; ela é liberada quando o último registro que a usa muda ou sai
+ * da memória.
+ */
+
+unsigned int usuarios_textosInternados_r(usuarios_contexto *contexto){
+  return contexto->internos.n - contexto->internos.n_livres;
+}
+
+/*!
+ * @fn void usuarios_estatisticasDisponibilidade_r(usuarios_contexto *contexto, usuarios_estatisticas_disponibilidade *estatisticas)
+ * @brief Copia em estatisticas os contadores do filtro de disponibilidade desde a criação do contexto
+ *
+ * Conta as verificações de repetição de usuario e email feitas por
+ * usuarios_cadastro, quantas o filtro respondeu sozinho e quantos dos
+ * seus positivos eram falsos.
+ */
+
+void usuarios_estatisticasDisponibilidade_r(usuarios_contexto *contexto, usuarios_estatisticas_disponibilidade *estatisticas){
+  *estatisticas = contexto->disponibilidade.estatisticas;
+}
+
+/*!
+ * @fn void usuarios_threadsCarga_r(usuarios_contexto *contexto, unsigned int threads)
+ * @brief Define quantas threads usuarios_carregarArquivo e usuarios_carregarIndice usam para ler os arquivos
+ * @param threads Número de threads, até USUARIOS_CARGA_THREADS_MAX; 0 usa uma por processador, o padrão
+ *
+ * Arquivos pequenos são lidos com menos threads, cada uma com pelo menos
+ * 64 KiB. O grafo resultante não depende do número de threads.
+ */
+
+void usuarios_threadsCarga_r(usuarios_contexto *contexto, unsigned int threads){
+  contexto->threads_carga = threads;
+}
+
+/*!
+ * @fn static usuarios_condRet usuarios_cadastroLista(usuarios_contexto *contexto, int n, va_list argumentos)
+ * @brief Implementação de usuarios_cadastro_r e usuarios_cadastro, recebe a elipse já iniciada
+ *
+ * Os dados são montados em uma variável local, e não em um rascunho do
+ * módulo, para que cadastros em contextos diferentes possam ocorrer ao
+ * mesmo tempo.
+ */
+
+static usuarios_condRet usuarios_cadastroLista(usuarios_contexto *contexto, int n, va_list argumentos){
+  FILE *db_usuarios;
+  
+  /* Verificamos se o grafo de usuários foi iniciado */
+  if(contexto->grafo_usuarios == NULL) return USUARIOS_FALHA_GRAFONULL;
+  
+  /* Retorna USUARIOS_FALHA_ARGUMENTOSINVALIDOS se n for diferente de 8 */
+  if(n!=8) return USUARIOS_FALHA_ARGUMENTOSINVALIDOS;
+  
+  /* Dados a armazenar, com os textos ainda não internados */
+  usuarios_linha linha;
+  tpUsuario *novo, &dados = linha.dados;
+  char senha_confirmacao[USUARIOS_LIMITE_SENHA] = {0};
+  char *destino;
+  usuarios_campo campo;
+  unsigned int i = 0, j;
+  
+  memset(&linha, 0, sizeof(usuarios_linha));
+  
+  /* Percorremos os argumentos, armazenamos os dados em dados */
+  for(;i<n;i++){
+    char *argumento = va_arg(argumentos, char *);
+    
+    /* Campos de texto */
+    campo = usuarios_campoPorNome(argumento);
+    if(campo != USUARIOS_CAMPO_INVALIDO && usuarios_campos[campo].tipo == USUARIOS_TIPO_TEXTO) {
+      destino = usuarios_linhaCampo(&linha, campo);
+      strncpy(destino, va_arg(argumentos, char *), usuarios_campos[campo].tamanho-1);
+      destino[usuarios_campos[campo].tamanho-1] = '\0';
+    }
+      
+    /* Casos especiais diferentes de char * */
+    if(!strcmp(argumento, "senha_confirmacao")) 
+      strncpy(senha_confirmacao, va_arg(argumentos, char *), USUARIOS_LIMITE_SENHA-1);
+    if(!strcmp(argumento, "formaPagamento")) 
+      dados.formaPagamento = (usuarios_forma_de_pagamento)va_arg(argumentos, int);
+    if(!strcmp(argumento, "tipo")) 
+      dados.tipo = (usuarios_tipo_usuario)va_arg(argumentos, int);
+  }
+  
+  dados.estado = ATIVO;
+  dados.avaliacao = 0;
+  dados.n_avaliacao = 0;
+  dados.n_reclamacoes = 0;
+  
+  /* Procuramos por caracteres ilegais, '\n' e '\t' pois são separadores */
+  for(j=0;j<USUARIOS_CAMPO_INVALIDO;j++) {
+    if(usuarios_campos[j].tipo != USUARIOS_TIPO_TEXTO) continue;
+    destino = usuarios_linhaCampo(&linha, (usuarios_campo)j);
+    if(strstr(destino, "\t") != NULL || strstr(destino, "\n") != NULL)
+      return USUARIOS_FALHA_CARACTERESILEGAIS;
+  }
+  
+  /* Verificamos se o email é válido */
+  if(strstr(dados.email, "@") == NULL || strstr(dados.email, ".") == NULL) return USUARIOS_FALHA_EMAIL_INVALIDO;
+  
+  /* Verificamos se as senhas coincidem */
+  if(strcmp(dados.senha, senha_confirmacao)) return USUARIOS_FALHA_SENHAS_INVALIDAS;
+  
+  /* Verificamos se já há um usuário desse */
+  if(usuarios_verificaRepeticao(contexto, "usuario", dados.usuario) != USUARIOS_DADOS_OK) return USUARIOS_USUARIOEXISTE;
+    
+  /* Verificamos se já há um email desse */
+  if(usuarios_verificaRepeticao(contexto, "email", dados.email) != USUARIOS_DADOS_OK) return USUARIOS_USUARIOEXISTE;
+  
+  /* Define-se o identificador */
+  dados.identificador = ++contexto->contador;
+  
+  /* Copiamos o valor local para o alocado, internando nome e endereco */
+  novo = (tpUsuario *)malloc(sizeof(tpUsuario));
+  if(novo == NULL || usuarios_linhaInternar(contexto, &linha, novo) != USUARIOS_SUCESSO) {
+    free(novo);
+    return USUARIOS_FALHA_ALOCAR;
+  }
+  
+  /* Devemos percorrer o grafo de usuários e salvar no arquivo */
+  pthread_mutex_lock(&contexto->log.trava); /* O checkpoint também escreve no arquivo de dados */
+  db_usuarios = fopen(contexto->db, "a+");
+  if(db_usuarios == NULL) {
+    pthread_mutex_unlock(&contexto->log.trava);
+    usuarios_registroLiberar(contexto, novo);
+    free(novo);
+    return USUARIOS_FALHA_LERDB;
+  }
+  
+  /* Gravamos no arquivo */
+  fprintf(db_usuarios, USUARIOS_DB_ESTRUTURA, 
+    novo->identificador,
+    novo->usuario,
+    linha.nome,
+    novo->email,
+    novo->senha,
+    linha.endereco,
+    (int)novo->formaPagamento,
+    (int)novo->tipo,
+    (int)novo->estado,
+    novo->avaliacao,
+    novo->n_avaliacao,
+    novo->n_reclamacoes
+  );
+  fclose(db_usuarios);
+  pthread_mutex_unlock(&contexto->log.trava);
+  
+  /* Adicionamos ao grafo */
+  
+  if(adiciona_vertice(contexto->grafo_usuarios, novo->identificador) != SUCESSO) {
+    usuarios_registroLiberar(contexto, novo);
+    free(novo);
+    return USUARIOS_FALHA_ADICIONAR_GRAFO;
+  }
+  if(usuarios_indexarNo(contexto, novo->identificador, (grafo_no *)contexto->grafo_usuarios->ultimo) != USUARIOS_SUCESSO) {
+    usuarios_registroLiberar(contexto, novo);
+    free(novo);
+    return USUARIOS_FALHA_ALOCAR;
+  }
+  
+  /* Definimos o valores correntes no vértice */
+  if(muda_valor_vertice(contexto->grafo_usuarios, novo->identificador, (void *)novo) != SUCESSO) {
+    usuarios_registroLiberar(contexto, novo);
+    free(novo);
+    return USUARIOS_FALHA_INSERIR_DADOS;
+  }
+  
+  usuarios_quenteCopiar(contexto, novo->identificador, novo);
+  usuarios_indicesInserir(contexto, novo->identificador);
+  usuarios_pesquisaInserir(contexto, novo);
+  usuarios_disponibilidadeInserir(contexto, USUARIOS_CAMPO_USUARIO, novo->usuario);
+  usuarios_disponibilidadeInserir(contexto, USUARIOS_CAMPO_EMAIL, novo->email);
+  
+  /* No modo preguiçoso o registro já está no arquivo e será lido quando pedido */
+  if(contexto->paginacao.limite) {
+    contexto->nos[novo->identificador]->dados = NULL;
+    usuarios_registroLiberar(contexto, novo);
+    free(novo);
+    if(usuarios_paginasNome(contexto, dados.identificador, dados.usuario) != USUARIOS_SUCESSO) return USUARIOS_FALHA_ALOCAR;
+  }
+  
+  return USUARIOS_SUCESSO;
+}
+
+/*!
+ * @fn usuarios_condRet usuarios_cadastro_r(usuarios_contexto *contexto, int n, ...)
+ * @brief Função de cadastro de usuários
+ * @param n=8 como parâmetro (necessário para uso da elipse)
+ * @param (...) Deverá conter 8 pares de argumentos seguindo essa ordem: const char *tipo, dado com dado podendo assumir os tipos char *, usuarios_forma_de_pagamento, usuarios_tipo_usuario
+ * @return Retorna uma instância usuarios_condRet que assume: 
+ *  - USUARIOS_FALHA_GRAFONULL se o grafo de usuários for NULL; 
+ *  - USUARIOS_FALHA_ARGUMENTOSINVALIDOS se n não for 8; 
+ *  - USUARIOS_FALHA_CARACTERESILEGAIS se houver algum caracter inválido nos argumentos passados como '\\t' e '\\n'; 
+ *  - USUARIOS_FALHA_EMAIL_INVALIDO se o email não for válido; 
+ *  - USUARIOS_FALHA_SENHAS_INVALIDAS se as senhas não coincidem; 
+ *  - USUARIOS_USUARIOEXISTE se houver repetição de dados; 
+ *  - USUARIOS_FALHA_ADICIONAR_GRAFO se não conseguir criar um vértice no grafo; 
+ *  - USUARIOS_FALHA_INSERIR_DADOS se não conseguir atribuir valores ao vértice no grafo; 
+ *  - USUARIOS_FALHA_LERDB se não conseguir abrir USUARIOS_DB como "a+";
+ *  - USUARIOS_SUCESSO se tiver criado um vértice com sucesso no grafo e atualizado o arquivo de dados com ele
+ * 
+ * Recebe como parâmetros nome, endereço, email, senha repetida duas vezes, forma de pagamento, tipo de usuário da seguinte maneira:
+ * 
+ * @code 
+ * usuarios_cadastro(8, "usuario", "jose123", "nome", "José Antônio", "email", "joao@antonio.com", "endereco", "Rua Foo Casa Bar", "senha", "123456", "senha_confirmacao", "123456", "formaPagamento", BOLETO, "tipo", CONSUMIDOR);
+ * @endcode
+ *
+ * Assertivas de entrada: 
+ *  - o arquivo USUARIOS_DB já existe, isto é a função usuarios_carregarArquivo já foi executada. 
+ *  - Deve ser passado o número correto de argumentos
+ *  - Todos os argumentos devem ser passados: usuario, nome, email, endereco, senha, senha_confirmacao, formaPagamento e tipo.
+ *
+ * Assertivas de saída:
+ *  - O arquivo de dados de usuário é atualizado com o novo usuário
+ *  - O grafo passa a ter o novo vértice para o usuário
+ *  - Nenhum outro vértice ou aresta do grafo é afetado
+ *  - O usuário é ATIVO imediatamente depois do cadastro
+ *  - O usuário tem um identificador maior que todos os outros no grafo
+ *  - O contador do contexto é acrescido de 1
+ *
+ * Assertivas estruturais:
+ *  - O grafo é consistente e não nulo
+ *  - Todas as strings passadas na elipse são terminadas com '\0'
+ *
+ * Assertivas de contrato:
+ *  - A função cria um nó para o usuário no cadastro se atender aos requisitos de validação no cadastro e houver memória para o arquivo de dados e na RAM
+ *
+ * Requisitos:
+ *  - stdarg.h, stdio.h, stdlib.h, grafo.h
+ * 
+ * Hipóteses:
+ *  - Nenhuma.
+ *
+ */
+
+usuarios_condRet usuarios_cadastro_r(usuarios_contexto *contexto, int n, ...){
+  usuarios_condRet retorno;
+  va_list argumentos;
+  
+  va_start(argumentos, n);
+  retorno = usuarios_cadastroLista(contexto, n, argumentos);
+  va_end(argumentos);
+  
+  return retorno;
+}
+
+/*!
+ * @fn int usuarios_sessaoAberta_r(usuarios_contexto *contexto)
+ * @brief Função que verifica se há uma sessão aberta
+ * @return Retorna 0 se não tiver e 1 se tiver
+ * 
+ * Assertivas de entrada:
+ *  - Nenhuma.
+ * 
+ * Assertivas de saída:
+ *  - O retorno será 1 ou 0
+ *
+ * Assertivas estruturais:
+ *  - Nenhuma
+ *
+ * Assertivas de contrato:
+ *  - A função garante que a sessão do contexto é não nula, indicativo suficiente de que haja sessão ou não. Mas se a sessão não for consistente com o grafo, esta função não detectará
+ *
+ * Requisitos:
+ *  - Nenhum
+ * 
+ * Hipóteses:
+ *  - A sessão do contexto é consistente com o grafo
+ *
+ */
+
+int usuarios_sessaoAberta_r(usuarios_contexto *contexto){
+  if(contexto->sessao == NULL) return 0;
+  return 1;
+}
+
+/*!
+ * @fn usuarios_condRet usuarios_login_r(usuarios_contexto *contexto, char *usuario, char *senha)
+ * @brief Buscamos a conta correspondente ao login e senha passados
+ * @param usuario string finalizada com '\0' indicando o usuário a ser buscado no grafo
+ * @param senha string finalizada com '\0' indicando a senha a ser buscada no grafo
+ * @return Instância usuarios_condRet que assume: 
+ *  - USUARIOS_FALHA_SESSAOABERTA se já houver uma sessão aberta; 
+ *  - USUARIOS_GRAFO_CORROMPIDO se não encontrar o usuário; 
+ *  - USUARIOS_FALHA_INATIVO se o usuário for INATIVO; 
+ *  - USUARIOS_SUCESSO se encontrar e iniciar a sessão com sucesso.
+ * 
+ * Recebe as strings usuário e senha, se ambos coincidirem para um nó, esse nó passa ser o nó da sessão
+ *
+ * Assertivas de entrada:
+ *  - O grafo foi carregado e é consistente
+ * 
+ * Assertivas de saída:
+ *  - O grafo não será alterado
+ *  - Haverá sessão se e só se os dados coincidirem
+ *
+ * Assertivas estruturais:
+ *  - Usuario e senha terminam com '\0' e não excedem o limite de cada um definido em usuarios.h
+ *
+ * Assertivas de contrato:
+ *  - Nenhuma.
+ *
+ * Requisitos:
+ *  - grafo.h
+ *
+ * Hipóteses:
+ *  - Nenhuma
+ *
+ */
+
+usuarios_condRet usuarios_login_r(usuarios_contexto *contexto, char *usuario, char *senha){
+  tpUsuario *corrente;
+  usuarios_condRet busca;
+  if(usuarios_sessaoAberta_r(contexto)) return USUARIOS_FALHA_SESSAOABERTA;
+  
+  busca = usuarios_buscaLogin(contexto, usuario, senha, &corrente);
+  if(busca != USUARIOS_SUCESSO) return busca;
+  
+  if(corrente == NULL) return USUARIOS_GRAFO_CORROMPIDO;
+  
+  /* Vemos se o usuário está ativo */
+  if(corrente->estado == ATIVO) {
+    contexto->sessao = corrente;
+    return USUARIOS_SUCESSO;
+  }
+  else return USUARIOS_FALHA_INATIVO;
+}
+
+/*!
+ * @fn usuarios_condRet usuarios_logout_r(usuarios_contexto *contexto)
+ * @brief Função de logout
+ * @retorno Sempre retorna USUARIOS_SUCESSO
+ * 
+ * Finaliza a sessão aberta
+ *
+ * Assertivas de entrada:
+ *  - Nenhuma
+ * 
+ * Assertivas de saída:
+ *  - A sessão do contexto é NULL
+ *
+ * Assertivas de contrato:
+ *  - Nenhuma
+ *
+ * Assertivas estruturais:
+ *  - Nenhuma
+ * 
+ * Requisitos:
+ *  - Nenhum
+ * 
+ * Hipóteses:
+ *  - Nenhuma
+ *
+ */
+
+usuarios_condRet usuarios_logout_r(usuarios_contexto *contexto){
+  contexto->sessao = NULL;
+  return USUARIOS_SUCESSO;
+}
+
+/*!
+ * @fn static usuarios_relacao usuarios_relacaoEntre(usuarios_contexto *contexto, unsigned int origem, unsigned int identificador)
+ * @brief Verifica a relação de amizade de origem com identificador
+ * @param origem Id do usuário do ponto de vista do qual a relação é dada
+ * @param identificador Id do outro usuário
+ * @return usuarios_relacao com o mesmo significado de usuarios_verificarAmizade, tomando origem no lugar da sessão
+ *
+ * Requisitos:
+ *  - grafo.h
+ */
+
+static usuarios_relacao usuarios_relacaoEntre(usuarios_contexto *contexto, unsigned int origem, unsigned int identificador){
+  grafo_arco *A, *B;
+  
+  if(contexto->grafo_usuarios == NULL) return ERRO;
+  
+  /* Verificamos se não quer observar uma amizade consigo mesmo */  
+  if(identificador == origem) return ERRO;
+    
+  A = grafo_busca_arco(contexto->grafo_usuarios, origem, identificador);
+  B = grafo_busca_arco(contexto->grafo_usuarios, identificador, origem);
+  
+  if(A != NULL && B != NULL) return AMIGOS;
+  if(A == NULL && B == NULL) return NENHUMA;
+  if(A == NULL && B != NULL) return ACONFIRMAR;
+  return AGUARDANDOCONFIRMACAO;
+}
+
+/*!
+ * @fn usuarios_relacao usuarios_verificarAmizade_r(usuarios_contexto *contexto, unsigned int identificador)
+ * @brief Função verifica um usuário é amigo do usuário na sessão
+ * @param identificador Um inteiro positivo que represete o id de um usuário no grafo.
+ * @return Retorna usuarios_relacao, podendo ser ERRO, AMIGOS, NENHUMA, ACONFIRMAR ou AGUARDANDOCONFIRMACAO. 
+ *  - ERRO, caso algum erro ocorra, como a assertiva de entrada não ser respeitada; AMIGOS, se forem amigos; 
+ *  - NENHUMA, se não existir relação direta entre eles; 
+ *  - ACONFIRMAR, se o usuário pesquisado não tiver confirmado a amizade; 
+ *  - AGUARDANDOCONFIRMACAO, se o usuário da sessão estiver por aceitar a amizade ou não.
+ *
+ * Recebe o identificador do usuário a ser verificada a relação de amizade com o usuário da sessão
+ * 
+ * Assertivas de entrada:
+ *  - Há uma sessão aberta
+ *  - o identificador refere-se a um nó no grafo
+ * 
+ * Assertivas de saída:
+ *  - O grafo não é alterado
+ *
+ * Assertivas estruturais:
+ *  - Nenhuma
+ *
+ * Assertivas de contrato:
+ *  - Nenhuma
+ * 
+ * Requisitos:
+ *  - grafo.h
+ *
+ * Hipóteses:
+ *  - O usuário é ATIVO
+ * 
+ */
+
+usuarios_relacao usuarios_verificarAmizade_r(usuarios_contexto *contexto, unsigned int identificador){
+  if(contexto->grafo_usuarios == NULL) return ERRO;
+  
+  /* Verificamos se há sessão */
+  if(!usuarios_sessaoAberta_r(contexto)) return ERRO;
+  
+  return usuarios_relacaoEntre(contexto, contexto->sessao->identificador, identificador);
+}
+
+
+/*!
+ * @fn static usuarios_condRet usuarios_criarAmizadeEntre(usuarios_contexto *contexto, unsigned int origem, unsigned int identificador)
+ * @brief Cria a aresta de origem para identificador e a grava em USUARIOS_DB_AMIGOS
+ * @param origem Id do usuário que pede a amizade
+ * @param identificador Id do amigo pretendido
+ * @return usuarios_condRet com o mesmo significado de usuarios_criarAmizade, tomando origem no lugar da sessão
+ *
+ * Requisitos:
+ *  - grafo.h, stdio.h
+ */
+
+static usuarios_condRet usuarios_criarAmizadeEntre(usuarios_contexto *contexto, unsigned int origem, unsigned int identificador){
+  FILE *db_amigos;
+  
+  if(contexto->grafo_usuarios == NULL) return USUARIOS_FALHA_GRAFONULL;
+  
+  /* Verificamos se não é o próprio usuário querendo criar uma amizade consigo mesmo */
+  if(identificador == origem) return USUARIOS_AMIZADEINVALIDA;
+  
+  /* O identificador 0 é reservado para a sessão */
+  if(identificador == 0 || usuarios_atributos(contexto, identificador) == NULL) return USUARIOS_FALHAUSUARIONAOEXISTE;
+  
+  /* Criamos uma aresta entre eles se não existir uma */
+  if(grafo_busca_arco(contexto->grafo_usuarios, origem, identificador) != NULL)
+    return USUARIOS_AMIZADEJASOLICITADA;
+  
+  if(adiciona_aresta(contexto->grafo_usuarios, origem, identificador) != SUCESSO) return USUARIOS_FALHACRIARAMIZADE;
+  
+  /* Definimos um valor para a aresta */
+  contexto->contador_amizades++;
+  if(muda_valor_aresta(contexto->grafo_usuarios, origem, identificador, contexto->contador_amizades) != SUCESSO)
+    return USUARIOS_FALHA_CRIARAMIZADE;
+  usuarios_recomendacoesInvalidar(contexto, origem, identificador);
+  
+  db_amigos = fopen(contexto->db_amigos, "a+");
+  if(db_amigos == NULL) return USUARIOS_FALHACRIARAMIZADE;
+  
+  /* Gravamos no arquivo */
+  fprintf(db_amigos, "%*d\t%*u\t%*u\n", -USUARIOS_LIMITE_INT, contexto->contador_amizades, -USUARIOS_LIMITE_INT, origem, -USUARIOS_LIMITE_INT, identificador);
+  fclose(db_amigos);
+  return USUARIOS_SUCESSO;
+}
+
+/*!
+ * @fn usuarios_condRet usuarios_criarAmizade_r(usuarios_contexto *contexto, unsigned int identificador)
+ * @brief Função que cria parte de uma relação de amizade na sesão iniciada para algum outro cliente
+ * @param identificador Um inteiro positivo que represete o id de um usuário no grafo.
+ * @return Retorna uma instância usuarios_condRet que assume:
  * - USUARIOS_FALHA_GRAFONULL se o grafo de usuários for NULL
  * - USUARIOS_FALHA_SESSAONULA se não houver sessão
  * - USUARIOS_AMIZADEINVALIDA se o identificador passado for o mesmo da sessão
@@ -830,656 +2780,2480 @@ usuarios_relacao usuarios_verificarAmizade(unsigned int identificador){
  * - USUARIOS_FALHAUSUARIONAOEXISTE se o usuário passado inexiste
  * - USUARIOS_SUCESSO se gravou no arquivo e salvou no grafo uma aresta que vai da SESSAO para identificador representando um lado da relação.
  *
- * Deve receber o identificador do amigo pretendido
+ * Deve receber o identificador do amigo pretendido
+ * 
+ * Assertivas de entrada:
+ *  - O identificador representa um nó do grafo
+ *  - O identificador não é igual ao identificador da sessão
+ *  - Há uma sessão aberta
+ *  - O programa tem permissão de a+ sobre o arquivo de amizades definido em USUARIOS_DB_AMIGOS
+ *
+ * Assertivas de saída:
+ *  - Haverá uma aresta entre o nó da sessão e o nó identificado pelo identificador
+ *  - Nenhum dado de usuário é alterado
+ *  - O arquivo de amizades USUARIOS_DB_AMIGOS terá a relação entre os nós
+ * 
+ * Assertivas estruturais:
+ *  - O grafo é consistente
+ *
+ * Assertivas de contrato:
+ *  - Nenhuma
+ *
+ * Requisitos:
+ *  - grafo.h
+ *
+ * Hipóteses:
+ *  - identificador se refere a um usuário ATIVO
+ *
+ */
+
+usuarios_condRet usuarios_criarAmizade_r(usuarios_contexto *contexto, unsigned int identificador){
+  if(contexto->grafo_usuarios == NULL) return USUARIOS_FALHA_GRAFONULL;
+  
+  /* Verificamos se há sessão */
+  if(!usuarios_sessaoAberta_r(contexto)) return USUARIOS_FALHA_SESSAONULA;
+  
+  return usuarios_criarAmizadeEntre(contexto, contexto->sessao->identificador, identificador);
+}
+
+/*!
+ * @fn void usuarios_travarLeitura_r(usuarios_contexto *contexto)
+ * @brief Adquire a trava do grafo de usuários para leitura
+ *
+ * As funções de sessão por token já adquirem a trava. Outros módulos
+ * que combinam várias chamadas ao módulo de usuários a partir de threads
+ * diferentes (ver avaliacao_avaliarSessao) devem envolvê-las com
+ * usuarios_travarLeitura ou usuarios_travarEscrita e usuarios_destravar.
+ *
+ * Com a carga sob demanda (usuarios_carregarIndice) uma leitura pode
+ * trazer uma página do arquivo, descartar outra, fazer o checkpoint do
+ * log e mudar as referências do pool de textos, então a trava é
+ * adquirida com exclusividade, como em usuarios_travarEscrita.
+ *
+ * Requisitos:
+ *  - pthread.h
+ */
+
+void usuarios_travarLeitura_r(usuarios_contexto *contexto){
+  if(contexto->paginacao.limite != 0) pthread_rwlock_wrlock(&contexto->trava);
+  else pthread_rwlock_rdlock(&contexto->trava);
+}
+
+/*!
+ * @fn void usuarios_travarEscrita_r(usuarios_contexto *contexto)
+ * @brief Adquire a trava do grafo de usuários com exclusividade, ver usuarios_travarLeitura
+*/
+
+void usuarios_travarEscrita_r(usuarios_contexto *contexto){
+  pthread_rwlock_wrlock(&contexto->trava);
+}
+
+/*!
+ * @fn void usuarios_destravar_r(usuarios_contexto *contexto)
+ * @brief Libera a trava adquirida com usuarios_travarLeitura ou usuarios_travarEscrita
+*/
+
+void usuarios_destravar_r(usuarios_contexto *contexto){
+  pthread_rwlock_unlock(&contexto->trava);
+}
+
+/*!
+ * @fn static unsigned int usuarios_sessoesSegredo(usuarios_contexto *contexto)
+ * @brief Sorteia a parte aleatória de um novo token
+ * @return Um inteiro não nulo
+ *
+ * Usa xorshift64* semeado uma única vez com /dev/urandom e o relógio.
+ *
+ * Assertivas de entrada:
+ *  - sessoes.trava do contexto está adquirida pela thread chamadora
+ *
+ * Requisitos:
+ *  - stdio.h, time.h
+ */
+
+static unsigned int usuarios_sessoesSegredo(usuarios_contexto *contexto){
+  unsigned long long x;
+  unsigned int segredo;
+  FILE *aleatorio;
+  
+  if(contexto->sessoes.semente == 0) {
+    aleatorio = fopen("/dev/urandom", "r");
+    if(aleatorio != NULL) {
+      if(fread(&contexto->sessoes.semente, sizeof(contexto->sessoes.semente), 1, aleatorio) != 1)
+        contexto->sessoes.semente = 0;
+      fclose(aleatorio);
+    }
+    contexto->sessoes.semente ^= (unsigned long long)time(NULL) * 0x9E3779B97F4A7C15ULL;
+    if(contexto->sessoes.semente == 0) contexto->sessoes.semente = 0x2545F4914F6CDD1DULL;
+  }
+  
+  do {
+    x = contexto->sessoes.semente;
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    contexto->sessoes.semente = x;
+    segredo = (unsigned int)((x * 0x2545F4914F6CDD1DULL) >> 32);
+  } while(segredo == 0);
+  
+  return segredo;
+}
+
+/*!
+ * @fn static usuarios_condRet usuarios_sessoesCrescer(usuarios_contexto *contexto)
+ * @brief Dobra a tabela de sessões e encadeia as novas posições na lista de livres
+ * @return USUARIOS_FALHA_ALOCAR se não houver memória, USUARIOS_SUCESSO caso contrário
+ *
+ * Assertivas de entrada:
+ *  - sessoes.trava do contexto está adquirida e não há posição livre
+ */
+
+static usuarios_condRet usuarios_sessoesCrescer(usuarios_contexto *contexto){
+  unsigned int i, capacidade;
+  usuarios_sessao_entrada *novo;
+  
+  capacidade = contexto->sessoes.capacidade ? 2*contexto->sessoes.capacidade : USUARIOS_SESSOES_INICIAL;
+  novo = (usuarios_sessao_entrada *)realloc(contexto->sessoes.entradas, capacidade*sizeof(usuarios_sessao_entrada));
+  if(novo == NULL) return USUARIOS_FALHA_ALOCAR;
+  
+  for(i=contexto->sessoes.capacidade;i<capacidade;++i) {
+    novo[i].identificador = 0;
+    novo[i].segredo = 0;
+    novo[i].proxima_livre = i+1;
+  }
+  
+  contexto->sessoes.livre = contexto->sessoes.capacidade;
+  contexto->sessoes.entradas = novo;
+  contexto->sessoes.capacidade = capacidade;
+  return USUARIOS_SUCESSO;
+}
+
+/*!
+ * @fn static usuarios_sessao_entrada *usuarios_sessoesEntrada(usuarios_contexto *contexto, usuarios_token token)
+ * @brief Encontra a posição da tabela referente a um token
+ * @param token Token a validar
+ * @return A posição da sessão ou NULL se o token não corresponder a uma sessão aberta
+ *
+ * Assertivas de entrada:
+ *  - sessoes.trava do contexto está adquirida pela thread chamadora
+ */
+
+static usuarios_sessao_entrada *usuarios_sessoesEntrada(usuarios_contexto *contexto, usuarios_token token){
+  unsigned int posicao = (unsigned int)(token & 0xFFFFFFFFULL);
+  unsigned int segredo = (unsigned int)(token >> 32);
+  
+  if(segredo == 0 || posicao >= contexto->sessoes.capacidade) return NULL;
+  if(contexto->sessoes.entradas[posicao].segredo != segredo) return NULL;
+  return &contexto->sessoes.entradas[posicao];
+}
+
+/*!
+ * @fn static void usuarios_sessoesLimpar(usuarios_contexto *contexto)
+ * @brief Encerra todas as sessões por token e libera a tabela
+*/
+
+static void usuarios_sessoesLimpar(usuarios_contexto *contexto){
+  pthread_mutex_lock(&contexto->sessoes.trava);
+  free(contexto->sessoes.entradas);
+  contexto->sessoes.entradas = NULL;
+  contexto->sessoes.capacidade = 0;
+  contexto->sessoes.livre = 0;
+  contexto->sessoes.abertas = 0;
+  pthread_mutex_unlock(&contexto->sessoes.trava);
+}
+
+/*!
+ * @fn usuarios_condRet usuarios_loginSessao_r(usuarios_contexto *contexto, const char *usuario, const char *senha, usuarios_token *token)
+ * @brief Abre uma nova sessão na tabela de sessões e retorna seu token
+ * @param usuario string finalizada com '\0' com o usuário
+ * @param senha string finalizada com '\0' com a senha
+ * @param token Recebe o token da sessão aberta
+ * @return Instância usuarios_condRet que assume:
+ *  - USUARIOS_FALHA_GRAFONULL se o grafo não foi carregado;
+ *  - USUARIOS_FALHA_DADOSINCORRETOS se usuário e senha não coincidirem;
+ *  - USUARIOS_FALHA_INATIVO se o usuário for INATIVO;
+ *  - USUARIOS_FALHA_ALOCAR se não conseguir aumentar a tabela;
+ *  - USUARIOS_SUCESSO se a sessão foi aberta.
+ *
+ * Ao contrário de usuarios_login, várias sessões podem estar abertas ao
+ * mesmo tempo, inclusive do mesmo usuário, e não alteram a sessão de
+ * usuarios_login. Pode ser chamada de várias threads.
+ *
+ * @code
+ * usuarios_token token;
+ * usuarios_loginSessao("jose123", "987654", &token);
+ * usuarios_criarAmizadeSessao(token, 2);
+ * usuarios_logoutSessao(token);
+ * @endcode
+ *
+ * Assertivas de entrada:
+ *  - O grafo foi carregado e token não é NULL
+ *
+ * Assertivas de saída:
+ *  - O grafo não é alterado
+ *  - token só é escrito se retornar USUARIOS_SUCESSO
+ *
+ * Requisitos:
+ *  - pthread.h
+ *
+ * Hipóteses:
+ *  - Nenhuma
+ */
+
+usuarios_condRet usuarios_loginSessao_r(usuarios_contexto *contexto, const char *usuario, const char *senha, usuarios_token *token){
+  tpUsuario *corrente = NULL;
+  usuarios_condRet busca;
+  unsigned int posicao, identificador;
+  usuarios_sessao_entrada *entrada;
+  
+  usuarios_travarLeitura_r(contexto);
+  busca = usuarios_buscaLogin(contexto, usuario, senha, &corrente);
+  if(busca == USUARIOS_SUCESSO && corrente->estado != ATIVO) busca = USUARIOS_FALHA_INATIVO;
+  if(busca == USUARIOS_SUCESSO) identificador = corrente->identificador;
+  usuarios_destravar_r(contexto);
+  if(busca != USUARIOS_SUCESSO) return busca;
+  
+  pthread_mutex_lock(&contexto->sessoes.trava);
+  if(contexto->sessoes.livre >= contexto->sessoes.capacidade && usuarios_sessoesCrescer(contexto) != USUARIOS_SUCESSO) {
+    pthread_mutex_unlock(&contexto->sessoes.trava);
+    return USUARIOS_FALHA_ALOCAR;
+  }
+  
+  posicao = contexto->sessoes.livre;
+  entrada = &contexto->sessoes.entradas[posicao];
+  contexto->sessoes.livre = entrada->proxima_livre;
+  entrada->identificador = identificador;
+  entrada->segredo = usuarios_sessoesSegredo(contexto);
+  contexto->sessoes.abertas++;
+  *token = ((usuarios_token)entrada->segredo << 32) | posicao;
+  pthread_mutex_unlock(&contexto->sessoes.trava);
+  
+  return USUARIOS_SUCESSO;
+}
+
+/*!
+ * @fn usuarios_condRet usuarios_logoutSessao_r(usuarios_contexto *contexto, usuarios_token token)
+ * @brief Encerra a sessão do token
+ * @param token Token retornado por usuarios_loginSessao
+ * @return USUARIOS_FALHA_TOKEN se o token não for de uma sessão aberta, USUARIOS_SUCESSO caso contrário
+ *
+ * A posição volta para a lista de livres e o token deixa de ser aceito.
+ */
+
+usuarios_condRet usuarios_logoutSessao_r(usuarios_contexto *contexto, usuarios_token token){
+  usuarios_sessao_entrada *entrada;
+  
+  pthread_mutex_lock(&contexto->sessoes.trava);
+  entrada = usuarios_sessoesEntrada(contexto, token);
+  if(entrada == NULL) {
+    pthread_mutex_unlock(&contexto->sessoes.trava);
+    return USUARIOS_FALHA_TOKEN;
+  }
+  
+  entrada->identificador = 0;
+  entrada->segredo = 0;
+  entrada->proxima_livre = contexto->sessoes.livre;
+  contexto->sessoes.livre = (unsigned int)(token & 0xFFFFFFFFULL);
+  contexto->sessoes.abertas--;
+  pthread_mutex_unlock(&contexto->sessoes.trava);
+  
+  return USUARIOS_SUCESSO;
+}
+
+/*!
+ * @fn usuarios_condRet usuarios_sessaoIdentificador_r(usuarios_contexto *contexto, usuarios_token token, unsigned int *identificador)
+ * @brief Retorna o identificador do usuário de uma sessão por token, em O(1)
+ * @param token Token retornado por usuarios_loginSessao
+ * @param identificador Recebe o id do usuário da sessão
+ * @return USUARIOS_FALHA_TOKEN se o token não for de uma sessão aberta, USUARIOS_SUCESSO caso contrário
+ */
+
+usuarios_condRet usuarios_sessaoIdentificador_r(usuarios_contexto *contexto, usuarios_token token, unsigned int *identificador){
+  usuarios_sessao_entrada *entrada;
+  
+  pthread_mutex_lock(&contexto->sessoes.trava);
+  entrada = usuarios_sessoesEntrada(contexto, token);
+  if(entrada != NULL) *identificador = entrada->identificador;
+  pthread_mutex_unlock(&contexto->sessoes.trava);
+  
+  return entrada != NULL ? USUARIOS_SUCESSO : USUARIOS_FALHA_TOKEN;
+}
+
+/*!
+ * @fn usuarios_condRet usuarios_retornaDadosSessao_r(usuarios_contexto *contexto, usuarios_token token, const char *nomeDado, void *retorno)
+ * @brief Versão de usuarios_retornaDados para o usuário de uma sessão por token
+ * @return USUARIOS_FALHA_TOKEN se o token não for de uma sessão aberta, ou o retorno de usuarios_retornaDados
+ */
+
+usuarios_condRet usuarios_retornaDadosSessao_r(usuarios_contexto *contexto, usuarios_token token, const char *nomeDado, void *retorno){
+  unsigned int identificador;
+  usuarios_condRet resultado;
+  
+  if(usuarios_sessaoIdentificador_r(contexto, token, &identificador) != USUARIOS_SUCESSO) return USUARIOS_FALHA_TOKEN;
+  
+  usuarios_travarLeitura_r(contexto);
+  resultado = usuarios_retornaDados_r(contexto, identificador, nomeDado, retorno);
+  usuarios_destravar_r(contexto);
+  return resultado;
+}
+
+/*!
+ * @fn usuarios_condRet usuarios_criarAmizadeSessao_r(usuarios_contexto *contexto, usuarios_token token, unsigned int identificador)
+ * @brief Versão de usuarios_criarAmizade para o usuário de uma sessão por token
+ * @return USUARIOS_FALHA_TOKEN se o token não for de uma sessão aberta, ou o retorno de usuarios_criarAmizade
+ */
+
+usuarios_condRet usuarios_criarAmizadeSessao_r(usuarios_contexto *contexto, usuarios_token token, unsigned int identificador){
+  unsigned int origem;
+  usuarios_condRet resultado;
+  
+  if(usuarios_sessaoIdentificador_r(contexto, token, &origem) != USUARIOS_SUCESSO) return USUARIOS_FALHA_TOKEN;
+  
+  usuarios_travarEscrita_r(contexto);
+  resultado = usuarios_criarAmizadeEntre(contexto, origem, identificador);
+  usuarios_destravar_r(contexto);
+  return resultado;
+}
+
+/*!
+ * @fn usuarios_relacao usuarios_verificarAmizadeSessao_r(usuarios_contexto *contexto, usuarios_token token, unsigned int identificador)
+ * @brief Versão de usuarios_verificarAmizade para o usuário de uma sessão por token
+ * @return ERRO se o token não for de uma sessão aberta, ou o retorno de usuarios_verificarAmizade
+ */
+
+usuarios_relacao usuarios_verificarAmizadeSessao_r(usuarios_contexto *contexto, usuarios_token token, unsigned int identificador){
+  unsigned int origem;
+  usuarios_relacao resultado;
+  
+  if(usuarios_sessaoIdentificador_r(contexto, token, &origem) != USUARIOS_SUCESSO) return ERRO;
+  
+  usuarios_travarLeitura_r(contexto);
+  resultado = usuarios_relacaoEntre(contexto, origem, identificador);
+  usuarios_destravar_r(contexto);
+  return resultado;
+}
+
+/*!
+ * @fn unsigned int usuarios_sessoesAbertas_r(usuarios_contexto *contexto)
+ * @brief Retorna o número de sessões por token abertas
+*/
+
+unsigned int usuarios_sessoesAbertas_r(usuarios_contexto *contexto){
+  unsigned int abertas;
+  pthread_mutex_lock(&contexto->sessoes.trava);
+  abertas = contexto->sessoes.abertas;
+  pthread_mutex_unlock(&contexto->sessoes.trava);
+  return abertas;
+}
+
+/*!
+ * @fn usuarios_condRet usuarios_removerAmizade_r(usuarios_contexto *contexto, unsigned int identificador_A, unsigned int identificador_B)
+ * @brief Função que remove uma relação de amizade
+ * @param identificador_A id de um nó no grafo, se for 0 do nó da sessão
+ * @param identificador_B id de um outro nó no grafo
+ * @return Retorna uma instância usuarios_condRet que assume:
+ *  - USUARIOS_FALHA_GRAFONULL se o grafo for NULL;
+ *  - USUARIOS_FALHA_SESSAONULA se passou 0 em identificador_A e não há sessão aberta;
+ *  - USUARIOS_FALHA_DADOSINCORRETOS se não consegue carregar o usuário da sessão;
+ *  - USUARIOS_FALHA_LERDB se falha ao ler com permissão de atualização USUARIOS_DB_AMIGOS ("r+")
+ *  - USUARIOS_FALHA_REMOVER_AMIZADE se não conseguir remover as arestas no grafo
+ *  - USUARIOS_SUCESSO se tiver atualizado o arquivo de amizades e deletado as arestas do grafo
+ *
+ * Recebe os identificadores dos usuários A e B, se A for 0 assume que é da sessão
+ *
+ * Assertivas de entrada:
+ *  - os identificadores passados são nós diferentes no grafo
+ *  - o grafo foi carregado
+ *  - se identificador_A é 0, há sessão aberta
+ *  - o arquivo USUARIOS_DB_AMIGOS existe e o programa pode usá-lo com permissão "r+"
+ * 
+ * Assertivas de saída:
+ *  - Não haverá arcos indo na direção de A até B nem de B até A
+ *  - No arquivo USUARIOS_DB_AMIGOS os registros referentes aos arcos serão sobrescritos com 0.
+ *
+ * Assertivas estruturais:
+ *  - O grafo é consistente
+ *
+ * Assertivas de contrato:
+ *  - Nenhuma
+ *
+ * Requisitos:
+ *  - grafo.h, stdio.h
+ *
+ * Hipóteses:
+ *  - Nenhuma
+ *
+ */
+
+usuarios_condRet usuarios_removerAmizade_r(usuarios_contexto *contexto, unsigned int identificador_A, unsigned int identificador_B){
+  int valorAresta;
+  FILE *db_amigos;
+  /* Verificamos se o grafo existe */
+  if(contexto->grafo_usuarios == NULL) return USUARIOS_FALHA_GRAFONULL;
+  
+  /* Pegamos o identificador da sessão */
+  if(identificador_A == 0) {
+    if(!usuarios_sessaoAberta_r(contexto)) return USUARIOS_FALHA_SESSAONULA;
+    if(usuarios_retornaDados_r(contexto, 0, "identificador", &identificador_A) != USUARIOS_SUCESSO)
+      return USUARIOS_FALHA_DADOSINCORRETOS;
+  }
+  
+  /* Removemos do arquivo */
+  db_amigos = fopen(contexto->db_amigos, "r+");
+  if(db_amigos == NULL) return USUARIOS_FALHA_LERDB;
+  
+  /* Recomendações dependem dos arcos que ainda existem */
+  usuarios_recomendacoesInvalidar(contexto, identificador_A, identificador_B);
+  
+  /* Removemos de A para B, se tiver */
+  valorAresta = retorna_valor_aresta(contexto->grafo_usuarios, identificador_A, identificador_B);
+  if(valorAresta){
+    fseek(db_amigos, USUARIOS_DB_AMIGOS_REGISTRO_TAMANHO*(valorAresta-1), SEEK_SET);
+    fprintf(db_amigos, "%4d\t%4u\t%4u\n", 0, (unsigned int)0, (unsigned int)0);
+    
+    if(remove_aresta(contexto->grafo_usuarios, identificador_A, identificador_B) != SUCESSO){
+      fclose(db_amigos);
+      return USUARIOS_FALHA_REMOVER_AMIZADE;
+    }
+  }
+  
+  /* Removemos de B para A, se tiver */
+  valorAresta = retorna_valor_aresta(contexto->grafo_usuarios, identificador_B, identificador_A);
+  if(valorAresta){
+    fseek(db_amigos, USUARIOS_DB_AMIGOS_REGISTRO_TAMANHO*(valorAresta-1), SEEK_SET);
+    fprintf(db_amigos, "%4d\t%4u\t%4u\n", 0, (unsigned int)0, (unsigned int)0);
+    
+    /* Removemos no grafo */
+    if(remove_aresta(contexto->grafo_usuarios, identificador_B, identificador_A) != SUCESSO){
+      fclose(db_amigos);
+      return USUARIOS_FALHA_REMOVER_AMIZADE;
+    }
+  }
+  
+  fclose(db_amigos);
+  return USUARIOS_SUCESSO;
+  
+  
+}
+
+/*!
+ * @fn static int usuarios_arcoComparar(const void *a, const void *b)
+ * @brief Ordem de usuarios_arco_origem pelo id da aresta, para qsort
+*/
+
+static int usuarios_arcoComparar(const void *a, const void *b){
+  const grafo_arco *x = ((const usuarios_arco_origem *)a)->arco;
+  const grafo_arco *y = ((const usuarios_arco_origem *)b)->arco;
+  return (x->valor > y->valor) - (x->valor < y->valor);
+}
+
+/*!
+ * @fn usuarios_condRet usuarios_compactarAmizades_r(usuarios_contexto *contexto, unsigned int *removidos)
+ * @brief Reescreve o arquivo de amizades sem os registros mortos deixados por usuarios_removerAmizade
+ * @param removidos Se não for NULL, recebe o número de registros mortos descartados
+ * @return Instância usuarios_condRet que assume:
+ *  - USUARIOS_FALHA_GRAFONULL se o grafo não foi carregado;
+ *  - USUARIOS_FALHA_ALOCAR se faltar memória;
+ *  - USUARIOS_FALHA_COMPACTAR se não conseguir escrever ou substituir o arquivo, caso em que o arquivo e o grafo ficam como estavam;
+ *  - USUARIOS_SUCESSO caso contrário.
+ *
+ * Os arcos do grafo são exatamente os registros vivos. Eles são gravados
+ * em um arquivo temporário ao lado de USUARIOS_DB_AMIGOS, na ordem dos ids
+ * antigos e com ids renumerados de 1 em diante, e o temporário substitui
+ * o original com rename, que é atômico: quem abrir o arquivo vê a versão
+ * antiga ou a nova inteira. Só então os ids dos arcos no grafo e
+ * contador_amizades passam a valer os novos, mantendo a correspondência
+ * entre id e posição do registro usada por usuarios_removerAmizade.
+ *
+ * Assertivas de entrada:
+ *  - Nenhuma outra thread altera amizades do contexto durante a chamada, ver usuarios_travarEscrita
+ *
+ * Assertivas de saída:
+ *  - O arquivo de amizades tem um registro vivo por arco do grafo e nenhum morto
+ *  - O arco de id k corresponde ao k-ésimo registro do arquivo
+ *
+ * Requisitos:
+ *  - stdio.h, stdlib.h, unistd.h, grafo.h
+ *
+ * Hipóteses:
+ *  - O sistema de arquivos implementa rename atomicamente
+ */
+
+usuarios_condRet usuarios_compactarAmizades_r(usuarios_contexto *contexto, unsigned int *removidos){
+  char temporario[USUARIOS_LIMITE_CAMINHO + 4];
+  usuarios_arco_origem *arcos, *novo;
+  grafo_arco *arco;
+  FILE *db_amigos;
+  unsigned int n = 0, capacidade = 64, i;
+  long registros = 0;
+  int falha;
+  
+  if(removidos != NULL) *removidos = 0;
+  if(contexto->grafo_usuarios == NULL) return USUARIOS_FALHA_GRAFONULL;
+  
+  /* Registros no arquivo atual, vivos e mortos */
+  db_amigos = fopen(contexto->db_amigos, "r");
+  if(db_amigos != NULL) {
+    fseek(db_amigos, 0, SEEK_END);
+    registros = ftell(db_amigos)/USUARIOS_DB_AMIGOS_REGISTRO_TAMANHO;
+    fclose(db_amigos);
+  }
+  
+  /* Juntamos os arcos vivos em ordem de id */
+  arcos = (usuarios_arco_origem *)malloc(capacidade*sizeof(usuarios_arco_origem));
+  if(arcos == NULL) return USUARIOS_FALHA_ALOCAR;
+  for(i=1;i<contexto->nos_capacidade;i++) {
+    if(contexto->nos[i] == NULL) continue;
+    for(arco = (grafo_arco *)contexto->nos[i]->acesso_arco; arco != NULL; arco = (grafo_arco *)arco->prox_arco) {
+      if(n == capacidade) {
+        novo = (usuarios_arco_origem *)realloc(arcos, 2*capacidade*sizeof(usuarios_arco_origem));
+        if(novo == NULL) {
+          free(arcos);
+          return USUARIOS_FALHA_ALOCAR;
+        }
+        arcos = novo;
+        capacidade *= 2;
+      }
+      arcos[n].arco = arco;
+      arcos[n].origem = i;
+      n++;
+    }
+  }
+  qsort(arcos, n, sizeof(usuarios_arco_origem), usuarios_arcoComparar);
+  
+  /* Gravamos o temporário e só substituímos se tudo chegou ao disco */
+  sprintf(temporario, "%s.tmp", contexto->db_amigos);
+  db_amigos = fopen(temporario, "w");
+  if(db_amigos == NULL) {
+    free(arcos);
+    return USUARIOS_FALHA_COMPACTAR;
+  }
+  falha = 0;
+  for(i=0;i<n && !falha;i++)
+    if(fprintf(db_amigos, "%*d\t%*u\t%*u\n", -USUARIOS_LIMITE_INT, (int)(i+1), -USUARIOS_LIMITE_INT, arcos[i].origem, -USUARIOS_LIMITE_INT, (unsigned int)((grafo_no *)arcos[i].arco->acesso_adjacente)->valor) < 0)
+      falha = 1;
+  if(fflush(db_amigos) != 0 || fsync(fileno(db_amigos)) != 0) falha = 1;
+  if(fclose(db_amigos) != 0) falha = 1;
+  if(falha || rename(temporario, contexto->db_amigos) != 0) {
+    remove(temporario);
+    free(arcos);
+    return USUARIOS_FALHA_COMPACTAR;
+  }
+  
+  /* O arquivo novo está no lugar, renumeramos o grafo */
+  for(i=0;i<n;i++) arcos[i].arco->valor = i+1;
+  contexto->contador_amizades = n;
+  if(removidos != NULL) *removidos = (registros > (long)n) ? registros - n : 0;
+  
+  free(arcos);
+  return USUARIOS_SUCESSO;
+}
+
+/*!
+ * @fn usuarios_condRet usuarios_retornaDados_r(usuarios_contexto *contexto, unsigned int identificador, const char *nomeDado, void *retorno)
+ * @brief Retorna os dados do usuário do identificador passado
+ * @param identificador Identificador do nó a buscar o dado, se for 0 usa-se o nó da sessão
+ * @param nomeDado o dado a ser buscado. Valores válidos: "identificador", "usuario", "nome", "senha", "email", "endereco", 
+ * "formaPagamento", "tipo", "estado", "avaliacao", "n_avaliacao", "n_reclamacoes"
+ * @param retorno Retorno por referência do dado pretendido, deve ser feito casting para void *
+ * @return Instância usuarios_condRet que assume:
+ *  - USUARIOS_FALHA_GRAFONULL se o grafo for NULL;
+ *  - USUARIOS_GRAFO_CORROMPIDO se o nó relativo ao id for NULL;
+ *  - USUARIOS_SUCESSO se conseguir passar por referência o dado pretendido ou se o argumento passado for inválido;
+ *
+ * Se identificador for zero, retornamos os dados da sessão
+ * 
+ * Retorna o dado por referência, recebe uma string com o dado a ser buscado.
+ * É um invólucro de usuarios_retornaCampo, laços devem resolver o nome com
+ * usuarios_campoPorNome uma vez ou usar as funções de acesso tipado.
+ * 
+ * @code
+ * char string_nome[USUARIOS_LIMITE_NOME];
+ * usuarios_retornaDados(0, "nome", (void *)string_nome);
+ * @endcode
+ * 
+ * @code
+ * usuarios_estado_de_usuario estado;
+ * usuarios_retornaDados(0, "estado", (void *)&estado);
+ * @endcode
+ * 
+ * Assertivas de entrada:
+ *  - O grafo é consistente e não nulo
+ *  - O identificador refere-se a um nó do grafo ou, se for 0, há uma sessão aberta
+ *  - nomeDado é uma string válida
+ *  - retorno é um ponteiro para void 
+ *  - Se retorno for um ponteiro para string, essa string já está alocada como limite associado a ela corretamente.
+ * 
+ * Assertivas de saída:
+ *  - O grafo não é alterado
+ *  - Se o retorno for string, essa string será uma cópia dos dados no grafo, não um ponteiro para eles
+ *
+ * Assertivas estruturais:
+ *  - nomeDado termina com '\0'
+ *
+ * Assertivas de contrato:
+ *  - Nenhuma.
+ *
+ * Requisitos:
+ *  - stdlib.h, string.h
+ *
+ * Hipóteses:
+ *  - Nenhuma
+ */
+ 
+usuarios_condRet usuarios_retornaDados_r(usuarios_contexto *contexto, unsigned int identificador, const char *nomeDado, void *retorno) {
+  usuarios_campo campo;
+  
+  if(contexto->grafo_usuarios == NULL) return USUARIOS_FALHA_GRAFONULL;
+  
+  campo = usuarios_campoPorNome(nomeDado);
+  /* Argumento inválido não altera retorno */
+  if(campo == USUARIOS_CAMPO_INVALIDO) {
+    if(usuarios_atributos(contexto, identificador) == NULL) return USUARIOS_GRAFO_CORROMPIDO; /* Assertiva */
+    return USUARIOS_SUCESSO;
+  }
+  
+  return usuarios_retornaCampo_r(contexto, identificador, campo, retorno);
+}
+
+/*!
+ * @fn usuarios_campo usuarios_campoPorNome(const char *nomeDado)
+ * @brief Converte o nome de um campo no seu valor de usuarios_campo
+ * @param nomeDado Nome do campo como aceito por usuarios_retornaDados
+ * @return O campo correspondente ou USUARIOS_CAMPO_INVALIDO se nomeDado não for um campo
+ *
+ * Serve para resolver o nome uma única vez fora de laços, que então
+ * passam a usar as funções de acesso tipado.
+ *
+ * @code
+ * usuarios_campo campo = usuarios_campoPorNome("avaliacao");
+ * @endcode
+ *
+ * Assertivas de entrada:
+ *  - nomeDado não é NULL e termina com '\0'
+ *
+ * Requisitos:
+ *  - string.h
+ */
+
+usuarios_campo usuarios_campoPorNome(const char *nomeDado) {
+  int i;
+  for(i=0;i<USUARIOS_CAMPO_INVALIDO;++i)
+    if(!strcmp(nomeDado, usuarios_campos[i].nome)) return (usuarios_campo)i;
+  return USUARIOS_CAMPO_INVALIDO;
+}
+
+/*!
+ * @fn usuarios_condRet usuarios_retornaCampo_r(usuarios_contexto *contexto, unsigned int identificador, usuarios_campo campo, void *retorno)
+ * @brief Copia um campo do usuário para retorno usando a tabela de descritores
+ * @param identificador Identificador do usuário, se for 0 usa-se o da sessão
+ * @param campo Campo a copiar
+ * @param retorno Destino da cópia, com o tamanho e o tipo do campo
+ * @return Instância usuarios_condRet que assume:
+ *  - USUARIOS_FALHA_GRAFONULL se o grafo for NULL;
+ *  - USUARIOS_ARGUMENTOINVALIDO se campo não for válido;
+ *  - USUARIOS_GRAFO_CORROMPIDO se não houver usuário com esse identificador;
+ *  - USUARIOS_SUCESSO se copiou o campo.
+ *
+ * Strings são copiadas com strncpy até o limite do campo, os demais
+ * tipos com memcpy do tamanho do campo.
+ *
+ * @code
+ * usuarios_estado_de_usuario estado;
+ * usuarios_retornaCampo(0, USUARIOS_CAMPO_ESTADO, (void *)&estado);
+ * @endcode
+ *
+ * Assertivas de entrada:
+ *  - retorno tem pelo menos o tamanho do campo
+ *
+ * Assertivas de saída:
+ *  - O grafo não é alterado
+ *
+ * Requisitos:
+ *  - string.h
+ */
+
+usuarios_condRet usuarios_retornaCampo_r(usuarios_contexto *contexto, unsigned int identificador, usuarios_campo campo, void *retorno) {
+  const usuarios_descritor_campo *descritor;
+  const char *dados;
+  
+  if(contexto->grafo_usuarios == NULL) return USUARIOS_FALHA_GRAFONULL;
+  if(campo < 0 || campo >= USUARIOS_CAMPO_INVALIDO) return USUARIOS_ARGUMENTOINVALIDO;
+  
+  descritor = &usuarios_campos[campo];
+  if(descritor->tipo == USUARIOS_TIPO_TEXTO) {
+    dados = (const char *)usuarios_registro(contexto, identificador);
+    if(dados == NULL) return USUARIOS_GRAFO_CORROMPIDO; /* Assertiva */
+    if(descritor->internado) strncpy((char *)retorno, usuarios_internoTexto(contexto, *(const uint32_t *)(dados + descritor->deslocamento)), descritor->tamanho);
+    else strncpy((char *)retorno, dados + descritor->deslocamento, descritor->tamanho);
+  }
+  else {
+    /* Os demais campos vêm do vetor denso */
+    dados = (const char *)usuarios_atributos(contexto, identificador);
+    if(dados == NULL) return USUARIOS_GRAFO_CORROMPIDO; /* Assertiva */
+    memcpy(retorno, dados + descritor->deslocamento_quente, descritor->tamanho);
+  }
+  
+  return USUARIOS_SUCESSO;
+}
+
+/*!
+ * @fn const char *usuarios_campoTexto_r(usuarios_contexto *contexto, unsigned int identificador, usuarios_campo campo, char *destino, size_t tamanho)
+ * @brief Copia um campo de texto do usuário para destino e o retorna
+ * @param identificador Identificador do usuário, se for 0 usa-se o da sessão
+ * @param campo USUARIOS_CAMPO_USUARIO, USUARIOS_CAMPO_NOME, USUARIOS_CAMPO_EMAIL, USUARIOS_CAMPO_SENHA ou USUARIOS_CAMPO_ENDERECO
+ * @param destino Recebe o texto terminado com '\0', cortado em tamanho-1 bytes
+ * @param tamanho Bytes de destino, maior que 0
+ * @return destino, ou NULL se o usuário não existir ou o campo não for de texto
+ *
+ * O texto é copiado porque nenhum ponteiro para ele sobrevive com
+ * segurança à chamada: nome e endereco ficam no pool de textos
+ * internados, que libera um texto quando o último usuário deixa de
+ * usá-lo, e com usuarios_carregarIndice qualquer chamada pode tirar o
+ * registro da memória. Um destino com o USUARIOS_LIMITE_ do campo
+ * recebe o texto inteiro.
+ *
+ * @code
+ * char nome[USUARIOS_LIMITE_NOME];
+ * printf("%s\n", usuarios_campoTexto(2, USUARIOS_CAMPO_NOME, nome, sizeof(nome)));
+ * @endcode
+ *
+ * Requisitos:
+ *  - stdio.h
+ */
+
+const char *usuarios_campoTexto_r(usuarios_contexto *contexto, unsigned int identificador, usuarios_campo campo, char *destino, size_t tamanho) {
+  const char *dados, *texto;
+  
+  if(campo < 0 || campo >= USUARIOS_CAMPO_INVALIDO || usuarios_campos[campo].tipo != USUARIOS_TIPO_TEXTO) return NULL;
+  
+  dados = (const char *)usuarios_registro(contexto, identificador);
+  if(dados == NULL) return NULL;
+  /* Nome e endereco apontam para o texto internado, compartilhado com outros usuários */
+  if(usuarios_campos[campo].internado) texto = usuarios_internoTexto(contexto, *(const uint32_t *)(dados + usuarios_campos[campo].deslocamento));
+  else texto = dados + usuarios_campos[campo].deslocamento;
+  snprintf(destino, tamanho, "%s", texto);
+  return destino;
+}
+
+/*!
+ * @fn usuarios_condRet usuarios_campoInteiro_r(usuarios_contexto *contexto, unsigned int identificador, usuarios_campo campo, unsigned int *retorno)
+ * @brief Retorna por valor um campo inteiro ou enumeração do usuário
+ * @param identificador Identificador do usuário, se for 0 usa-se o da sessão
+ * @param campo Um campo do tipo USUARIOS_TIPO_INTEIRO
+ * @param retorno Recebe o valor do campo
+ * @return Instância usuarios_condRet que assume:
+ *  - USUARIOS_ARGUMENTOINVALIDO se o campo não for inteiro;
+ *  - USUARIOS_GRAFO_CORROMPIDO se não houver usuário com esse identificador;
+ *  - USUARIOS_SUCESSO caso contrário.
+ *
+ * @code
+ * unsigned int n;
+ * usuarios_campoInteiro(4, USUARIOS_CAMPO_N_AVALIACAO, &n);
+ * @endcode
+ */
+
+usuarios_condRet usuarios_campoInteiro_r(usuarios_contexto *contexto, unsigned int identificador, usuarios_campo campo, unsigned int *retorno) {
+  const char *dados;
+  
+  if(campo < 0 || campo >= USUARIOS_CAMPO_INVALIDO || usuarios_campos[campo].tipo != USUARIOS_TIPO_INTEIRO) return USUARIOS_ARGUMENTOINVALIDO;
+  
+  dados = (const char *)usuarios_atributos(contexto, identificador);
+  if(dados == NULL) return USUARIOS_GRAFO_CORROMPIDO;
+  
+  /* Enumerações e unsigned int têm o mesmo tamanho */
+  *retorno = *(const unsigned int *)(dados + usuarios_campos[campo].deslocamento_quente);
+  return USUARIOS_SUCESSO;
+}
+
+/*!
+ * @fn usuarios_condRet usuarios_campoReal_r(usuarios_contexto *contexto, unsigned int identificador, usuarios_campo campo, double *retorno)
+ * @brief Retorna por valor um campo de ponto flutuante do usuário
+ * @param identificador Identificador do usuário, se for 0 usa-se o da sessão
+ * @param campo Um campo do tipo USUARIOS_TIPO_REAL (USUARIOS_CAMPO_AVALIACAO)
+ * @param retorno Recebe o valor do campo
+ * @return Instância usuarios_condRet que assume:
+ *  - USUARIOS_ARGUMENTOINVALIDO se o campo não for real;
+ *  - USUARIOS_GRAFO_CORROMPIDO se não houver usuário com esse identificador;
+ *  - USUARIOS_SUCESSO caso contrário.
+ */
+
+usuarios_condRet usuarios_campoReal_r(usuarios_contexto *contexto, unsigned int identificador, usuarios_campo campo, double *retorno) {
+  const char *dados;
+  
+  if(campo < 0 || campo >= USUARIOS_CAMPO_INVALIDO || usuarios_campos[campo].tipo != USUARIOS_TIPO_REAL) return USUARIOS_ARGUMENTOINVALIDO;
+  
+  dados = (const char *)usuarios_atributos(contexto, identificador);
+  if(dados == NULL) return USUARIOS_GRAFO_CORROMPIDO;
+  
+  *retorno = *(const double *)(dados + usuarios_campos[campo].deslocamento_quente);
+  return USUARIOS_SUCESSO;
+}
+
+/*!
+ * @fn static usuarios_condRet usuarios_atualizarLista(usuarios_contexto *contexto, unsigned int identificador, const char *nomeDado, va_list arg)
+ * @brief Implementação de usuarios_atualizarDados_r e usuarios_atualizarDados, recebe a elipse já iniciada
+ */
+
+static usuarios_condRet usuarios_atualizarLista(usuarios_contexto *contexto, unsigned int identificador, const char *nomeDado, va_list arg){
+  usuarios_campo campo;
+  tpUsuario *corrente, dados;
+  usuarios_quente antigo;
+  char texto[(USUARIOS_LIMITE_NOME > USUARIOS_LIMITE_ENDERECO) ? USUARIOS_LIMITE_NOME : USUARIOS_LIMITE_ENDERECO];
+  uint32_t handle_antigo = 0;
+  
+  if(contexto->grafo_usuarios == NULL) return USUARIOS_FALHA_GRAFONULL;
+  
+  /* Pegamos o nodo com o identificador passado */
+  corrente = usuarios_registro(contexto, identificador);
+  
+  if(corrente == NULL) return USUARIOS_GRAFO_CORROMPIDO; /* Assertiva */
+      
+  /* Analizamos os argumentos passados armazenando em dados */
+  memcpy(&dados, corrente, sizeof(tpUsuario));
+  
+  campo = usuarios_campoPorNome(nomeDado);
+  if(campo != USUARIOS_CAMPO_INVALIDO && usuarios_campos[campo].internado) {
+    /* O novo texto é internado antes; o antigo só é devolvido depois de sair do índice de pesquisa */
+    strncpy(texto, va_arg(arg, char *), usuarios_campos[campo].tamanho-1);
+    texto[usuarios_campos[campo].tamanho-1] = '\0';
+    handle_antigo = *(uint32_t *)((char *)&dados + usuarios_campos[campo].deslocamento);
+    if(usuarios_internar(contexto, texto, (uint32_t *)((char *)&dados + usuarios_campos[campo].deslocamento)) != USUARIOS_SUCESSO)
+      return USUARIOS_FALHA_ALOCAR;
+  }
+  else if(campo != USUARIOS_CAMPO_INVALIDO && usuarios_campos[campo].tipo == USUARIOS_TIPO_TEXTO)
+    strncpy((char *)&dados + usuarios_campos[campo].deslocamento, va_arg(arg, char *), usuarios_campos[campo].tamanho);
+  /* Outros casos (não char *) */
+  if(!strcmp(nomeDado, "formaPagamento")) 
+    dados.formaPagamento = (usuarios_forma_de_pagamento)va_arg(arg, int);
+  if(!strcmp(nomeDado, "tipo")) 
+    dados.tipo = (usuarios_tipo_usuario)va_arg(arg, int);
+  if(!strcmp(nomeDado, "estado")) 
+    dados.estado = (usuarios_estado_de_usuario)va_arg(arg, int);
+  if(!strcmp(nomeDado, "avaliacao")) 
+    dados.avaliacao = va_arg(arg, double);
+  if(!strcmp(nomeDado, "n_avaliacao")) 
+    dados.n_avaliacao = va_arg(arg, unsigned int);
+  if(!strcmp(nomeDado, "n_reclamacoes")) 
+    dados.n_reclamacoes = va_arg(arg, unsigned int);
+  
+  if(campo == USUARIOS_CAMPO_USUARIO || campo == USUARIOS_CAMPO_EMAIL)
+    usuarios_disponibilidadeTrocar(contexto, campo, (char *)corrente + usuarios_campos[campo].deslocamento, (char *)&dados + usuarios_campos[campo].deslocamento);
+  
+  /* Copiamos no grafo, atualizando o índice de pesquisa se o texto indexado mudar */
+  if(campo == USUARIOS_CAMPO_USUARIO || campo == USUARIOS_CAMPO_NOME) {
+    usuarios_pesquisaRemover(contexto, corrente);
+    memcpy(corrente, &dados, sizeof(tpUsuario));
+    usuarios_pesquisaInserir(contexto, corrente);
+    if(contexto->paginacao.limite && campo == USUARIOS_CAMPO_USUARIO && usuarios_paginasNome(contexto, corrente->identificador, corrente->usuario) != USUARIOS_SUCESSO)
+      return USUARIOS_FALHA_ALOCAR;
+  }
+  else memcpy(corrente, &dados, sizeof(tpUsuario));
+  usuarios_internoLiberar(contexto, handle_antigo);
+  antigo = contexto->quentes[corrente->identificador];
+  usuarios_quenteCopiar(contexto, corrente->identificador, corrente);
+  usuarios_indicesAlterar(contexto, corrente->identificador, &antigo);
+  
+  /* Registramos no log, o checkpoint atualiza o arquivo de dados */
+  return usuarios_walRegistrar(contexto, corrente);
+}
+
+/*!
+ * @fn usuarios_condRet usuarios_atualizarDados_r(usuarios_contexto *contexto, unsigned int identificador, const char *nomeDado, ...)
+ * @brief Atualiza dados do usuário de identificador passado
+ * @param identificador Id do usuário no grafo a alterar um dado, se for 0 assume-se da sessão
+ * @param nomeDado o dado a ser alterado, pode ser: "identificador", "usuario", "nome", "senha", "email", "endereco", "formaPagamento", "tipo", "estado", "avaliacao", "n_avaliacao", "n_reclamacoes".
+ * @param (...) Um argumento de tipo char *, usuarios_forma_de_pagamento, usuarios_tipo_usuario, usuarios_estado_de_usuario, double ou unsigned int
+ * @return Uma instância do tipo usuarios_condRet que assume:
+ *  - USUARIOS_FALHA_GRAFONULL se o grafo for NULL;
+ *  - USUARIOS_GRAFO_CORROMPIDO se o nodo associado ao id for NULL;
+ *  - USUARIOS_FALHA_WAL se não conseguir gravar o log de alterações;
+ *  - USUARIOS_SUCESSO se atualizar no grafo e registrar no log a alteração pretendida ou se o nomeDado não for válido;
+ *
+ * O arquivo de dados não é aberto a cada chamada: o registro alterado vai
+ * para o log USUARIOS_DB_WAL em lote e é aplicado em USUARIOS_DB pelo
+ * checkpoint em segundo plano (ver usuarios_sincronizar).
+ *  
+ * @code
+ * usuarios_atualizarDados(0, "nome", "João Ninguém");
+ * @endcode
+ *
+ * O último argumento pode ser de qualquer tipo, exemplo:
+ * 
+ * @code
+ * usuarios_atualizarDados(0, "estado", INATIVO_ABUSO);
+ * @endcode
+ * 
+ * Assertivas de entrada:
+ *  - O grafo é consistente e não nulo
+ *  - Se identificador é 0, há sessão
+ *  - É passado exatamente 1 argumento na elípse (...)
+ *  - nomeDado é válido
+ *  - Há permissões para escrever em USUARIOS_DB_WAL e abrir o arquivo USUARIOS_DB como "r+"
+ *
+ * Assertivas de saída:
+ *  - O dado pretendido é atualizado no grafo e no log respeitando os limites do campo
+ *  - Nenhum outro dado é alterado
+ * 
+ *  Assertivas estruturais:
+ *  - String passadas na elipse terminam com '\0' e respeitam o limite dos campos
+ * 
+ * Assertivas de contrato:
+ *  - Os dados no grafo e no arquivo a serem alterados serão alterados usando os dados passados pelos parâmetros
+ *
+ * Requisitos:
+ *  - grafo.h, string.h, stdlib.h, stdio.h 
+ *
+ * Hipóteses:
+ *  - Nenhuma
+ * 
+ */
+ 
+usuarios_condRet usuarios_atualizarDados_r(usuarios_contexto *contexto, unsigned int identificador, const char *nomeDado, ...){
+  usuarios_condRet retorno;
+  va_list arg;
+  
+  va_start(arg, nomeDado);
+  retorno = usuarios_atualizarLista(contexto, identificador, nomeDado, arg);
+  va_end(arg);
+  
+  return retorno;
+}
+
+/*!
+ * @fn usuarios_condRet usuarios_atualizarAvaliacao_r(usuarios_contexto *contexto, unsigned int identificador, double avaliacao, unsigned int n_avaliacao)
+ * @brief Atualiza juntos a avaliação média e o número de avaliações de um usuário
+ * @param identificador Id do usuário no grafo, se for 0 assume-se da sessão
+ * @return Uma instância do tipo usuarios_condRet que assume:
+ *  - USUARIOS_FALHA_GRAFONULL se o grafo for NULL;
+ *  - USUARIOS_GRAFO_CORROMPIDO se o nodo associado ao id for NULL;
+ *  - USUARIOS_FALHA_WAL se não conseguir gravar o log de alterações;
+ *  - USUARIOS_SUCESSO caso contrário.
+ *
+ * Equivale a usuarios_atualizarDados com "avaliacao" e "n_avaliacao",
+ * mas os dois campos vão ao log em uma única entrada, assim uma
+ * interrupção não deixa um atualizado e o outro não.
+ *
+ * Assertivas de entrada:
+ *  - O grafo é consistente e não nulo
+ *
+ * Assertivas de saída:
+ *  - Os dois campos são atualizados no grafo e no log; nenhum outro dado é alterado
+ *
+ * Requisitos:
+ *  - grafo.h
+ *
+ * Hipóteses:
+ *  - Nenhuma
+ */
+
+usuarios_condRet usuarios_atualizarAvaliacao_r(usuarios_contexto *contexto, unsigned int identificador, double avaliacao, unsigned int n_avaliacao){
+  tpUsuario *corrente;
+  usuarios_quente antigo;
+  
+  if(contexto->grafo_usuarios == NULL) return USUARIOS_FALHA_GRAFONULL;
+  corrente = usuarios_registro(contexto, identificador);
+  if(corrente == NULL) return USUARIOS_GRAFO_CORROMPIDO;
+  
+  corrente->avaliacao = avaliacao;
+  corrente->n_avaliacao = n_avaliacao;
+  antigo = contexto->quentes[corrente->identificador];
+  usuarios_quenteCopiar(contexto, corrente->identificador, corrente);
+  usuarios_indicesAlterar(contexto, corrente->identificador, &antigo);
+  
+  return usuarios_walRegistrar(contexto, corrente);
+}
+
+/*!
+ * @fn usuarios_condRet usuarios_limpar_r(usuarios_contexto *contexto)
+ * @brief Apaga o grafo de usuários da memória e faz logout na sessão aberta e nas sessões por token
+ * @return Retorna uma instância do tipo usuarios_condRet que assume:
+ *  - USUARIOS_FALHA_FECHARSESSAO se não conseguir fazer logout na sessão se houver sessão aberta;
+ *  - USUARIOS_FALHA_LIMPAR se não conseguir destruir o grafo da memória ou aplicar o log de alterações em USUARIOS_DB.
+ *  - Retorna USUARIOS_SUCESSO se não ocorrerem erros.
+ *
+ * Assertivas de entrada:
+ *  - Nenhuma
+ *
+ * Assertivas de saída:
+ *  - Não haverá mais grafo nem sessão
+ *  - USUARIOS_DB contém todas as alterações feitas
+ *
+ * Assertivas estruturais:
+ *  - O grafo é consistente
+ * 
+ * Assertivas de contrato:
+ *  - Nenhuma
+ * 
+ * Requisitos:
+ *  - grafo.h
+ *
+ * Hipóteses:
+ *  - Nenhuma
+ * 
+ */
+ 
+usuarios_condRet usuarios_limpar_r(usuarios_contexto *contexto){
+  /* Aplicamos as alterações pendentes e paramos a thread do log */
+  usuarios_walParar(contexto);
+  if(usuarios_sincronizar_r(contexto) != USUARIOS_SUCESSO) return USUARIOS_FALHA_LIMPAR;
+  /* Fechamos qualquer sessão aberta */
+  if(usuarios_logout_r(contexto) != USUARIOS_SUCESSO) return USUARIOS_FALHA_FECHARSESSAO;
+  usuarios_sessoesLimpar(contexto);
+  /* Limpamos o grafo */
+  /* As páginas não foram alocadas pelo grafo, tiramos dos nós antes de destruí-lo */
+  usuarios_paginasLimpar(contexto);
+  contexto->paginacao.limite = 0;
+  if(destroi_grafo(&contexto->grafo_usuarios) != SUCESSO) return USUARIOS_FALHA_LIMPAR;
+  usuarios_recomendacoesLimpar(contexto);
+  usuarios_visitasLimpar(contexto);
+  usuarios_pesquisaLimpar(contexto);
+  usuarios_indicesLimpar(contexto);
+  usuarios_disponibilidadeLimpar(contexto);
+  usuarios_internosLimpar(contexto);
+  free(contexto->nos);
+  free(contexto->quentes);
+  contexto->nos = NULL;
+  contexto->quentes = NULL;
+  contexto->nos_capacidade = 0;
+  
+  return USUARIOS_SUCESSO;
+}
+
+/*!
+ * @fn usuarios_condRet usuarios_listarAmigos_r(usuarios_contexto *contexto, unsigned int identificador, usuarios_uintarray *retorno)
+ * @brief Função que retorna uma lista de identificadores dos amigos do usuário passado pretendido, se o identificador for 0, usa a sessão
+ * @param identificador Id do usuário a buscar amigos, se for 0 usa a sessão
+ * @param retorno Lista de amigos a ser passada por referência e alocada na função. A cabeça do array deve ser alocada estaticamente:
+ * 
+ * @code
+ * usuarios_uintarray array;
+ * usuarios_listarAmigos(0, &array);
+ * @endcode
+ * 
+ * Vai compor o array com os identificadores dos amigos.
+ *
+ * Deve-se liberar o array quando não mais usado usando usuarios_freeUint.
+ *
+ * @return A função retorna uma instância que assume:
+ *  - USUARIOS_FALHA_ACESSORESTRITO se o usuário do identificador for NULL;
+ *  - USUARIOS_SUCESSO se gerar o array com sucesso.
+ *
+ * Assertivas de entrada:
+ *  - identificador é um nó do grafo
+ *  - o grafo já foi carregado e é consistente
+ *  - a cabeça array já foi alocada estaticamente
+ *
+ * Assertivas de saída:
+ *  - O array conterá o número de amigos e os identificadores dos amigos do usuário passado no parâmetro
+ *  - O grafo não é afetado
+ * 
+ * Assertivas estruturais:
+ *  - o retorno é o endereço da cabeça de um usuarios_uintarray já alocado anteriormente
+ *
+ * Assertivas de contrato:
+ *  - Nenhuma
+ *
+ * Requisitos:
+ *  - grafo.h, stdlib.h
+ *
+ * Hipóteses:
+ *  - Nenhuma
+ * 
+ */
+
+usuarios_condRet usuarios_listarAmigos_r(usuarios_contexto *contexto, unsigned int identificador, usuarios_uintarray *retorno) {
+  const usuarios_quente *usuario;
+  grafo_lista_no *listaVizinhos, *tmp;
+  
+  /* Pegamos o nodo com o identificador passado */
+  usuario = usuarios_atributos(contexto, identificador);
+  
+  if(usuario == NULL) return USUARIOS_FALHA_ACESSORESTRITO; /* Assertiva */
+ 
+  /* Geramos o vetor */
+  //*retorno = (usuarios_uintarray *)malloc(sizeof(usuarios_uintarray));
+  retorno->length = 0;
+  retorno->array = NULL;
+  
+  /* Buscamos os nós vizinhos */
+  listaVizinhos = vizinhos(contexto->grafo_usuarios, usuario->identificador);
+  for(tmp=listaVizinhos;tmp != NULL;tmp=(grafo_lista_no *)tmp->prox_no){
+    
+    /* Verificamos se há um arco vindo no sentido contrário */
+    if(adjacente(contexto->grafo_usuarios, tmp->valor, usuario->identificador) == ADJACENTES)  {
+      retorno->array = (unsigned int *)realloc(retorno->array, (++retorno->length)*sizeof(unsigned int));
+      retorno->array[retorno->length-1] = tmp->valor;
+    }
+  }
+  
+  grafo_lista_no_limpar(&listaVizinhos);
+  return USUARIOS_SUCESSO;
+  
+}
+
+/*!
+ * @fn usuarios_condRet usuarios_listarAmigosPendentes_r(usuarios_contexto *contexto, unsigned int identificador, usuarios_uintarray *retorno)
+ * @brief Função que retorna uma lista de identificadores dos amigos pendentes do usuário passado pretendido, se o identificador for 0, usa a sessão
+ * @param identificador Id do usuário a buscar amigos pendentes, se for 0 usa a sessão
+ * @param retorno Lista de amigos pendentes a ser passada por referência e alocada na função. A cabeça do array deve ser alocada estaticamente:
+ * 
+ * @code
+ * usuarios_uintarray array;
+ * usuarios_listarAmigosPendentes(0, &array);
+ * @endcode
  * 
+ * Vai compor o array com os identificadores dos amigos pendentes.
+ *
+ * Deve-se liberar o array quando não mais usado usando usuarios_freeUint.
+ *
+ * @return A função retorna uma instância que assume:
+ *  - USUARIOS_FALHA_ACESSORESTRITO se o usuário do identificador for NULL;
+ *  - USUARIOS_SUCESSO se gerar o array com sucesso.
+ *
  * Assertivas de entrada:
- *  - O identificador representa um nó do grafo
- *  - O identificador não é igual ao identificador da sessão
- *  - Há uma sessão aberta
- *  - O programa tem permissão de a+ sobre o arquivo de amizades definido em USUARIOS_DB_AMIGOS
+ *  - identificador é um nó do grafo
+ *  - o grafo já foi carregado e é consistente
+ *  - a cabeça array já foi alocada estaticamente
  *
  * Assertivas de saída:
- *  - Haverá uma aresta entre o nó da sessão e o nó identificado pelo identificador
- *  - Nenhum dado de usuário é alterado
- *  - O arquivo de amizades USUARIOS_DB_AMIGOS terá a relação entre os nós
+ *  - O array conterá o número de amigos pendentes e os identificadores dos amigos pendentes do usuário passado no parâmetro
+ *  - O grafo não é afetado
  * 
  * Assertivas estruturais:
- *  - O grafo é consistente
+ *  - o retorno é o endereço da cabeça de um usuarios_uintarray já alocado anteriormente
  *
  * Assertivas de contrato:
  *  - Nenhuma
  *
  * Requisitos:
- *  - grafo.h
+ *  - grafo.h, stdlib.h
  *
  * Hipóteses:
- *  - identificador se refere a um usuário ATIVO
- *
+ *  - Nenhuma
+ * 
  */
 
-usuarios_condRet usuarios_criarAmizade(unsigned int identificador){
-  FILE *db_amigos;
-  grafo_no *nodo;
+usuarios_condRet usuarios_listarAmigosPendentes_r(usuarios_contexto *contexto, unsigned int identificador, usuarios_uintarray *retorno) {
+  const usuarios_quente *corrente;
+  unsigned int i;
   
-  if(usuarios_grafo == NULL) return USUARIOS_FALHA_GRAFONULL;
+  /* Pegamos o nodo com o identificador passado */
+  corrente = usuarios_atributos(contexto, identificador);
   
-  /* Verificamos se há sessão */
-  if(!usuarios_sessaoAberta()) return USUARIOS_FALHA_SESSAONULA;
+  if(corrente == NULL) return USUARIOS_FALHA_ACESSORESTRITO; /* Assertiva */
   
-  /* Verificamos se não é o próprio usuário querendo criar uma amizade consigo mesmo */
-  if(identificador == usuarios_sessao->identificador) return USUARIOS_AMIZADEINVALIDA;
+  /* Geramos o vetor */
+  //*retorno = (usuarios_uintarray *)malloc(sizeof(usuarios_uintarray));
+  retorno->length = 0;
+  retorno->array = NULL;
   
-  /* Buscamos no grafo o identificador */
-  nodo = (grafo_no *)grafo_busca_no(usuarios_grafo, 1, 0); /* Primeiro usuário */
-  for(; nodo != NULL; nodo = (grafo_no *)nodo->prox_no ){
-    
-    tpUsuario *corrente = (tpUsuario *)nodo->dados;
-    if(corrente == NULL) return USUARIOS_GRAFO_CORROMPIDO; /* Assertiva */
-    
-    if(corrente->identificador == identificador){
-    
-      /* Criamos uma aresta entre eles se não existir uma */
-      if(grafo_busca_arco(usuarios_grafo, usuarios_sessao->identificador, corrente->identificador) != NULL)
-        return USUARIOS_AMIZADEJASOLICITADA;
-      
-      if(adiciona_aresta(usuarios_grafo, usuarios_sessao->identificador, corrente->identificador) == SUCESSO){
-        /* Definimos um valor para a aresta */
-        usuarios_contador_amizades++;
-        if(muda_valor_aresta(usuarios_grafo, usuarios_sessao->identificador, corrente->identificador, usuarios_contador_amizades) != SUCESSO)
-          return USUARIOS_FALHA_CRIARAMIZADE;
-        
-        db_amigos = fopen(USUARIOS_DB_AMIGOS, "a+");
-        if(db_amigos == NULL) return USUARIOS_FALHACRIARAMIZADE;
-        
-        /* Gravamos no arquivo */
-        fprintf(db_amigos, "%*d\t%*u\t%*u\n", -USUARIOS_LIMITE_INT, usuarios_contador_amizades, -USUARIOS_LIMITE_INT, usuarios_sessao->identificador, -USUARIOS_LIMITE_INT, identificador);
-        fclose(db_amigos);
-        return USUARIOS_SUCESSO;
-        
+  /* Buscamos em todo o grafo */
+  for(i=0;i<contexto->contador;i++){
+    /* Vemos se há um arco do usuário i ao usuário identificador e que não há um no sentido contrário */
+    if(grafo_busca_arco(contexto->grafo_usuarios, i, identificador) != NULL &&
+       grafo_busca_arco(contexto->grafo_usuarios, identificador, i) == NULL){
+      /* Adicionamos ao array */
+      retorno->length++;
+      retorno->array = (unsigned int*)realloc(retorno->array, retorno->length*sizeof(unsigned int));
+      if(retorno->array == NULL) {
+        retorno->length = 0;
+        return USUARIOS_FALHA_INSERIR_DADOS;
       }
-      else return USUARIOS_FALHACRIARAMIZADE;
+      retorno->array[retorno->length-1] = i;
     }
   }
-  return USUARIOS_FALHAUSUARIONAOEXISTE;
+  
+  return USUARIOS_SUCESSO;
+  
 }
 
 /*!
- * @fn usuarios_condRet usuarios_removerAmizade(unsigned int identificador_A, unsigned int identificador_B)
- * @brief Função que remove uma relação de amizade
- * @param identificador_A id de um nó no grafo, se for 0 do nó da sessão
- * @param identificador_B id de um outro nó no grafo
- * @return Retorna uma instância usuarios_condRet que assume:
- *  - USUARIOS_FALHA_GRAFONULL se o grafo for NULL;
- *  - USUARIOS_FALHA_SESSAONULA se passou 0 em identificador_A e não há sessão aberta;
- *  - USUARIOS_FALHA_DADOSINCORRETOS se não consegue carregar o usuário da sessão;
- *  - USUARIOS_FALHA_LERDB se falha ao ler com permissão de atualização USUARIOS_DB_AMIGOS ("r+")
- *  - USUARIOS_FALHA_REMOVER_AMIZADE se não conseguir remover as arestas no grafo
- *  - USUARIOS_SUCESSO se tiver atualizado o arquivo de amizades e deletado as arestas do grafo
+ * @fn usuarios_condRet usuarios_listarAmigosdeAmigos_r(usuarios_contexto *contexto, unsigned int identificador, usuarios_uintarray *retorno)
+ * @brief Função que lista os amigos de amigos (excluíndo amigos)
+ * @param identificador Id do usuário a buscar amigos de amigos, se for 0 usa a sessão
+ * @param retorno Lista de amigos pendentes a ser passada por referência e alocada na função. A cabeça do array deve ser alocada estaticamente:
+ * 
+ * @code
+ * usuarios_uintarray array;
+ * usuarios_listarAmigosdeAmigos(0, &array);
+ * @endcode
+ * 
+ * Vai compor o array com os identificadores dos amigos de amigos.
  *
- * Recebe os identificadores dos usuários A e B, se A for 0 assume que é da sessão
+ * Deve-se liberar o array quando não mais usado usando usuarios_freeUint.
+ *
+ * @return A função retorna uma instância que assume:
+ *  - USUARIOS_FALHA_ACESSORESTRITO se o usuário do identificador for NULL;
+ *  - USUARIOS_SUCESSO se gerar o array com sucesso.
  *
  * Assertivas de entrada:
- *  - os identificadores passados são nós diferentes no grafo
- *  - o grafo foi carregado
- *  - se identificador_A é 0, há sessão aberta
- *  - o arquivo USUARIOS_DB_AMIGOS existe e o programa pode usá-lo com permissão "r+"
- * 
- * Assertivas de saída:
- *  - Não haverá arcos indo na direção de A até B nem de B até A
- *  - No arquivo USUARIOS_DB_AMIGOS os registros referentes aos arcos serão sobrescritos com 0.
+ *  - identificador é um nó do grafo
+ *  - o grafo já foi carregado e é consistente
+ *  - a cabeça array já foi alocada estaticamente
  *
+ * Assertivas de saída:
+ *  - O array conterá o número de amigos de amigos e os identificadores dos amigos de amigos do usuário passado no parâmetro
+ *  - O grafo não é afetado
+ * 
  * Assertivas estruturais:
- *  - O grafo é consistente
+ *  - o retorno é o endereço da cabeça de um usuarios_uintarray já alocado anteriormente
  *
  * Assertivas de contrato:
  *  - Nenhuma
  *
  * Requisitos:
- *  - grafo.h, stdio.h
+ *  - grafo.h, stdlib.h
  *
  * Hipóteses:
  *  - Nenhuma
- *
+ * 
  */
 
-usuarios_condRet usuarios_removerAmizade(unsigned int identificador_A, unsigned int identificador_B){
-  int valorAresta;
-  FILE *db_amigos;
-  /* Verificamos se o grafo existe */
-  if(usuarios_grafo == NULL) return USUARIOS_FALHA_GRAFONULL;
+usuarios_condRet usuarios_listarAmigosdeAmigos_r(usuarios_contexto *contexto, unsigned int identificador, usuarios_uintarray *retorno){
+  usuarios_uintarray amigos, amigosdeamigos;
+  unsigned int i,j,k;
   
-  /* Pegamos o identificador da sessão */
-  if(identificador_A == 0) {
-    if(!usuarios_sessaoAberta()) return USUARIOS_FALHA_SESSAONULA;
-    if(usuarios_retornaDados(0, "identificador", &identificador_A) != USUARIOS_SUCESSO)
-      return USUARIOS_FALHA_DADOSINCORRETOS;
-  }
+  /* Listamos os amigos do usuário */
+  if(usuarios_listarAmigos_r(contexto, identificador, &amigos) != USUARIOS_SUCESSO) 
+    return USUARIOS_FALHA_LISTARAMIGOS;
   
-  /* Removemos do arquivo */
-  db_amigos = fopen(USUARIOS_DB_AMIGOS, "r+");
-  if(db_amigos == NULL) return USUARIOS_FALHA_LERDB;
+  retorno->length = 0;
+  retorno->array = NULL;
   
-  /* Removemos de A para B, se tiver */
-  valorAresta = retorna_valor_aresta(usuarios_grafo, identificador_A, identificador_B);
-  if(valorAresta){
-    fseek(db_amigos, USUARIOS_DB_AMIGOS_REGISTRO_TAMANHO*(valorAresta-1), SEEK_SET);
-    fprintf(db_amigos, "%4d\t%4u\t%4u\n", 0, (unsigned int)0, (unsigned int)0);
-    
-    if(remove_aresta(usuarios_grafo, identificador_A, identificador_B) != SUCESSO){
-      fclose(db_amigos);
-      return USUARIOS_FALHA_REMOVER_AMIZADE;
+  /* Para cada amigo buscamos os amigos */
+  for(i=0;i<amigos.length;i++){
+    if(usuarios_listarAmigos_r(contexto, amigos.array[i], &amigosdeamigos) != USUARIOS_SUCESSO) 
+      return USUARIOS_FALHA_LISTARAMIGOS;
+      
+    /* Inserimos um a um de temporário no retorno, se ainda não estiver */
+    for(j=0;j<amigosdeamigos.length;j++){
+      /* Impedimos autoinclusão */
+      if(amigosdeamigos.array[j] != identificador) {
+        /* Para cada temporário buscamos no retorno se já existe e não esteja em amigos */
+        for(k=0;k<retorno->length;k++){
+          if(retorno->array[k] == amigosdeamigos.array[j]) break;
+        }
+        /* Adicionamos ao retorno */
+        if(k == retorno->length) {
+          retorno->length++;
+          retorno->array = (unsigned int *)realloc(retorno->array, retorno->length*sizeof(unsigned int));
+          retorno->array[retorno->length-1] = amigosdeamigos.array[j];
+        }
+      }
     }
+    usuarios_freeUint(&amigosdeamigos);
   }
   
-  /* Removemos de B para A, se tiver */
-  valorAresta = retorna_valor_aresta(usuarios_grafo, identificador_B, identificador_A);
-  if(valorAresta){
-    fseek(db_amigos, USUARIOS_DB_AMIGOS_REGISTRO_TAMANHO*(valorAresta-1), SEEK_SET);
-    fprintf(db_amigos, "%4d\t%4u\t%4u\n", 0, (unsigned int)0, (unsigned int)0);
-    
-    /* Removemos no grafo */
-    if(remove_aresta(usuarios_grafo, identificador_B, identificador_A) != SUCESSO){
-      fclose(db_amigos);
-      return USUARIOS_FALHA_REMOVER_AMIZADE;
+  usuarios_freeUint(&amigos);
+  return USUARIOS_SUCESSO;  
+}
+
+/*!
+ * @fn static int usuarios_temArco(grafo_no *origem, grafo_no *destino)
+ * @brief Verifica se há um arco de origem para destino percorrendo apenas os arcos de origem
+ * @return Não nulo se houver o arco
+ *
+ * Custa O(grau de origem), ao contrário de grafo_busca_arco que também percorre a lista de nós.
+ */
+
+static int usuarios_temArco(grafo_no *origem, grafo_no *destino){
+  grafo_arco *arco;
+  for(arco = (grafo_arco *)origem->acesso_arco; arco != NULL; arco = (grafo_arco *)arco->prox_arco)
+    if(arco->acesso_adjacente == destino) return 1;
+  return 0;
+}
+
+/*!
+ * @fn static void usuarios_recomendacoesLimpar(usuarios_contexto *contexto)
+ * @brief Libera o contador denso e o cache de recomendações do contexto
+*/
+
+static void usuarios_recomendacoesLimpar(usuarios_contexto *contexto){
+  unsigned int i;
+  
+  for(i=0;i<contexto->recomendacoes_capacidade;i++) free(contexto->recomendacoes[i].itens);
+  free(contexto->recomendacoes);
+  free(contexto->contagem);
+  free(contexto->tocados);
+  contexto->recomendacoes = NULL;
+  contexto->recomendacoes_capacidade = 0;
+  contexto->contagem = NULL;
+  contexto->tocados = NULL;
+  contexto->contagem_capacidade = 0;
+}
+
+/*!
+ * @fn static void usuarios_recomendacoesInvalidar(usuarios_contexto *contexto, unsigned int identificador_A, unsigned int identificador_B)
+ * @brief Invalida as recomendações afetadas por uma mudança no arco entre A e B
+ *
+ * Uma solicitação ou amizade entre A e B muda os excluídos de A e de B e
+ * os amigos em comum que A e B oferecem aos seus amigos confirmados, então
+ * invalida A, B e os amigos confirmados de ambos. Deve ser chamada com o
+ * arco presente: depois de criá-lo ou antes de removê-lo.
+ */
+
+static void usuarios_recomendacoesInvalidar(usuarios_contexto *contexto, unsigned int identificador_A, unsigned int identificador_B){
+  unsigned int ids[2] = {identificador_A, identificador_B}, i;
+  grafo_no *nodo, *vizinho;
+  grafo_arco *arco;
+  
+  if(contexto->recomendacoes == NULL) return;
+  
+  for(i=0;i<2;i++) {
+    if(ids[i] >= contexto->recomendacoes_capacidade || ids[i] >= contexto->nos_capacidade) continue;
+    contexto->recomendacoes[ids[i]].valido = 0;
+    nodo = contexto->nos[ids[i]];
+    if(nodo == NULL) continue;
+    for(arco = (grafo_arco *)nodo->acesso_arco; arco != NULL; arco = (grafo_arco *)arco->prox_arco) {
+      vizinho = (grafo_no *)arco->acesso_adjacente;
+      if((unsigned int)vizinho->valor < contexto->recomendacoes_capacidade && usuarios_temArco(vizinho, nodo))
+        contexto->recomendacoes[vizinho->valor].valido = 0;
     }
   }
+}
+
+/*!
+ * @fn static int usuarios_recomendacaoMelhor(const usuarios_recomendacao *a, const usuarios_recomendacao *b)
+ * @brief Ordem das recomendações: maior pontuação primeiro e, no empate, menor identificador
+*/
+
+static int usuarios_recomendacaoMelhor(const usuarios_recomendacao *a, const usuarios_recomendacao *b){
+  if(a->pontuacao != b->pontuacao) return a->pontuacao > b->pontuacao;
+  return a->identificador < b->identificador;
+}
+
+static int usuarios_recomendacaoComparar(const void *a, const void *b){
+  if(usuarios_recomendacaoMelhor((const usuarios_recomendacao *)a, (const usuarios_recomendacao *)b)) return -1;
+  if(usuarios_recomendacaoMelhor((const usuarios_recomendacao *)b, (const usuarios_recomendacao *)a)) return 1;
+  return 0;
+}
+
+/*!
+ * @fn static void usuarios_heapDescer(usuarios_recomendacao *heap, unsigned int tamanho, unsigned int i)
+ * @brief Restaura o heap de mínimo (pior recomendação na raiz) a partir da posição i
+*/
+
+static void usuarios_heapDescer(usuarios_recomendacao *heap, unsigned int tamanho, unsigned int i){
+  unsigned int pior, filho;
+  usuarios_recomendacao troca;
   
-  fclose(db_amigos);
-  return USUARIOS_SUCESSO;
+  for(;;) {
+    pior = i;
+    filho = 2*i+1;
+    if(filho < tamanho && usuarios_recomendacaoMelhor(&heap[pior], &heap[filho])) pior = filho;
+    filho++;
+    if(filho < tamanho && usuarios_recomendacaoMelhor(&heap[pior], &heap[filho])) pior = filho;
+    if(pior == i) return;
+    troca = heap[i];
+    heap[i] = heap[pior];
+    heap[pior] = troca;
+    i = pior;
+  }
+}
+
+/*!
+ * @fn static void usuarios_heapSubir(usuarios_recomendacao *heap, unsigned int i)
+ * @brief Sobe o elemento da posição i no heap de mínimo
+*/
+
+static void usuarios_heapSubir(usuarios_recomendacao *heap, unsigned int i){
+  usuarios_recomendacao troca;
+  
+  while(i > 0 && usuarios_recomendacaoMelhor(&heap[(i-1)/2], &heap[i])) {
+    troca = heap[i];
+    heap[i] = heap[(i-1)/2];
+    heap[(i-1)/2] = troca;
+    i = (i-1)/2;
+  }
+}
+
+/*!
+ * @fn static usuarios_condRet usuarios_recomendacoesReservar(usuarios_contexto *contexto)
+ * @brief Garante contador denso e cache com uma posição para cada identificador do índice
+ * @return USUARIOS_FALHA_ALOCAR se não houver memória, USUARIOS_SUCESSO caso contrário
+*/
+
+static usuarios_condRet usuarios_recomendacoesReservar(usuarios_contexto *contexto){
+  unsigned int capacidade = contexto->nos_capacidade, *contagem, *tocados;
+  usuarios_cache_recomendacao *cache;
+  
+  if(contexto->contagem_capacidade < capacidade) {
+    contagem = (unsigned int *)realloc(contexto->contagem, capacidade*sizeof(unsigned int));
+    if(contagem == NULL) return USUARIOS_FALHA_ALOCAR;
+    contexto->contagem = contagem;
+    tocados = (unsigned int *)realloc(contexto->tocados, capacidade*sizeof(unsigned int));
+    if(tocados == NULL) return USUARIOS_FALHA_ALOCAR;
+    contexto->tocados = tocados;
+    memset(contagem + contexto->contagem_capacidade, 0, (capacidade - contexto->contagem_capacidade)*sizeof(unsigned int));
+    contexto->contagem_capacidade = capacidade;
+  }
   
+  if(contexto->recomendacoes_capacidade < capacidade) {
+    cache = (usuarios_cache_recomendacao *)realloc(contexto->recomendacoes, capacidade*sizeof(usuarios_cache_recomendacao));
+    if(cache == NULL) return USUARIOS_FALHA_ALOCAR;
+    memset(cache + contexto->recomendacoes_capacidade, 0, (capacidade - contexto->recomendacoes_capacidade)*sizeof(usuarios_cache_recomendacao));
+    contexto->recomendacoes = cache;
+    contexto->recomendacoes_capacidade = capacidade;
+  }
   
+  return USUARIOS_SUCESSO;
 }
 
 /*!
- * @fn usuarios_condRet usuarios_retornaDados(unsigned int identificador, const char *nomeDado, void *retorno)
- * @brief Retorna os dados do usuário do identificador passado
- * @param identificador Identificador do nó a buscar o dado, se for 0 usa-se o nó da sessão
- * @param nomeDado o dado a ser buscado. Valores válidos: "identificador", "usuario", "nome", "senha", "email", "endereco", 
- * "formaPagamento", "tipo", "estado", "avaliacao", "n_avaliacao", "n_reclamacoes"
- * @param retorno Retorno por referência do dado pretendido, deve ser feito casting para void *
- * @return Instância usuarios_condRet que assume:
- *  - USUARIOS_FALHA_GRAFONULL se o grafo for NULL;
- *  - USUARIOS_GRAFO_CORROMPIDO se o nó relativo ao id for NULL;
- *  - USUARIOS_SUCESSO se conseguir passar por referência o dado pretendido ou se o argumento passado for inválido;
- *
- * Se identificador for zero, retornamos os dados da sessão
- * 
- * Retorna o dado por referência, recebe uma string com o dado a ser buscado
- * 
- * @code
- * char string_nome[USUARIOS_LIMITE_NOME];
- * usuarios_retornaDados(0, "nome", (void *)string_nome);
- * @endcode
- * 
+ * @fn usuarios_condRet usuarios_recomendarAmigos_r(usuarios_contexto *contexto, unsigned int identificador, unsigned int k, usuarios_recomendacao *retorno, unsigned int *n)
+ * @brief Lista até k usuários que o usuário talvez conheça, por amigos em comum ponderados pela avaliação
+ * @param identificador Id do usuário, se for 0 usa a sessão
+ * @param k Número máximo de recomendações
+ * @param retorno Vetor com pelo menos k posições, recebe as recomendações da melhor para a pior
+ * @param n Recebe o número de recomendações escritas em retorno
+ * @return Instância usuarios_condRet que assume:
+ *  - USUARIOS_FALHA_GRAFONULL se o grafo não foi carregado;
+ *  - USUARIOS_FALHAUSUARIONAOEXISTE se o usuário não existir ou, com identificador 0, não houver sessão;
+ *  - USUARIOS_FALHA_ALOCAR se faltar memória;
+ *  - USUARIOS_SUCESSO caso contrário.
+ *
+ * Os candidatos são amigos confirmados de amigos confirmados, contados em
+ * um vetor denso indexado por id (só as posições tocadas são zeradas ao
+ * fim). Ficam de fora o próprio usuário, seus amigos e quem tem
+ * solicitação pendente com ele em qualquer sentido. A pontuação é
+ * mutuos*(1 + avaliacao/5) e os k melhores são mantidos em um heap, então
+ * o custo é O(soma dos graus dos amigos + c log k) para c candidatos.
+ *
+ * O resultado fica em cache por usuário e é invalidado quando uma
+ * amizade ou solicitação envolvendo o usuário ou um amigo dele muda.
+ * Alterações de avaliação só aparecem no próximo recálculo.
+ *
  * @code
- * usuarios_estado_de_usuario estado;
- * usuarios_retornaDados(0, "estado", (void *)&estado);
+ * usuarios_recomendacao sugestoes[10];
+ * unsigned int n;
+ * usuarios_recomendarAmigos(0, 10, sugestoes, &n);
  * @endcode
- * 
- * Assertivas de entrada:
- *  - O grafo é consistente e não nulo
- *  - O identificador refere-se a um nó do grafo ou, se for 0, há uma sessão aberta
- *  - nomeDado é uma string válida
- *  - retorno é um ponteiro para void 
- *  - Se retorno for um ponteiro para string, essa string já está alocada como limite associado a ela corretamente.
- * 
+ *
  * Assertivas de saída:
  *  - O grafo não é alterado
- *  - Se o retorno for string, essa string será uma cópia dos dados no grafo, não um ponteiro para eles
- *
- * Assertivas estruturais:
- *  - nomeDado termina com '\0'
- *
- * Assertivas de contrato:
- *  - Nenhuma.
+ *  - retorno[0..n-1] está em ordem decrescente de pontuação, com o menor id primeiro no empate
  *
  * Requisitos:
- *  - stdlib.h, string.h
+ *  - stdlib.h, string.h, grafo.h
  *
  * Hipóteses:
  *  - Nenhuma
  */
- 
-usuarios_condRet usuarios_retornaDados(unsigned int identificador, const char *nomeDado, void *retorno) {
-  unsigned int i = 0;
-  tpUsuario *dados;
-    
-  if(usuarios_grafo == NULL) return USUARIOS_FALHA_GRAFONULL;
+
+usuarios_condRet usuarios_recomendarAmigos_r(usuarios_contexto *contexto, unsigned int identificador, unsigned int k, usuarios_recomendacao *retorno, unsigned int *n){
+  const usuarios_quente *usuario, *candidato;
+  grafo_no *nodo, *amigo, *vizinho;
+  grafo_arco *arco, *arcoAmigo;
+  usuarios_cache_recomendacao *cache;
+  usuarios_recomendacao *heap, item;
+  unsigned int tamanho = 0, ntocados = 0, i, id;
   
-  /* Pegamos o nodo com o identificador passado */
-  if(identificador) dados = (tpUsuario *)retorna_valor_vertice(usuarios_grafo, identificador);
-  /* Se foi passado 0, então pega-se o da sessão */
-  else dados = usuarios_sessao;
+  *n = 0;
+  if(contexto->grafo_usuarios == NULL) return USUARIOS_FALHA_GRAFONULL;
+  
+  usuario = usuarios_atributos(contexto, identificador);
+  if(usuario == NULL) return USUARIOS_FALHAUSUARIONAOEXISTE;
+  identificador = usuario->identificador;
+  if(k == 0) return USUARIOS_SUCESSO;
+  
+  /* Resultado em cache serve se tiver pelo menos k itens ou for a lista completa */
+  if(identificador < contexto->recomendacoes_capacidade) {
+    cache = &contexto->recomendacoes[identificador];
+    if(cache->valido && (cache->k >= k || cache->n < cache->k)) {
+      *n = cache->n < k ? cache->n : k;
+      memcpy(retorno, cache->itens, (*n)*sizeof(usuarios_recomendacao));
+      return USUARIOS_SUCESSO;
+    }
+  }
+  
+  if(usuarios_recomendacoesReservar(contexto) != USUARIOS_SUCESSO) return USUARIOS_FALHA_ALOCAR;
+  nodo = contexto->nos[identificador];
   
-  if(dados == NULL) return USUARIOS_GRAFO_CORROMPIDO; /* Assertiva */
+  /* Contamos os amigos em comum de cada candidato a dois passos */
+  for(arco = (grafo_arco *)nodo->acesso_arco; arco != NULL; arco = (grafo_arco *)arco->prox_arco) {
+    amigo = (grafo_no *)arco->acesso_adjacente;
+    if(!usuarios_temArco(amigo, nodo)) continue; /* Solicitação, não amizade */
+    
+    for(arcoAmigo = (grafo_arco *)amigo->acesso_arco; arcoAmigo != NULL; arcoAmigo = (grafo_arco *)arcoAmigo->prox_arco) {
+      vizinho = (grafo_no *)arcoAmigo->acesso_adjacente;
+      if(vizinho == nodo || !usuarios_temArco(vizinho, amigo)) continue;
+      if(contexto->contagem[vizinho->valor]++ == 0) contexto->tocados[ntocados++] = vizinho->valor;
+    }
+  }
   
-  /* Copiamos os dados para usuarios_dadosTemp */
-  memcpy(&usuarios_dadosTemp, dados, sizeof(tpUsuario));
+  heap = (usuarios_recomendacao *)malloc(k*sizeof(usuarios_recomendacao));
+  if(heap == NULL) {
+    for(i=0;i<ntocados;i++) contexto->contagem[contexto->tocados[i]] = 0;
+    return USUARIOS_FALHA_ALOCAR;
+  }
   
-  /* Dados possíveis */
-  for(;i<usuarios_cadastro_argumentos_n;i++)
-    if(!strcmp(nomeDado, usuarios_args[i].validos)) {
-      strncpy((char *)retorno, usuarios_args[i].destino, usuarios_args[i].tamanho);
+  /* Selecionamos os k melhores, excluindo amigos e solicitações pendentes */
+  for(i=0;i<ntocados;i++) {
+    id = contexto->tocados[i];
+    vizinho = contexto->nos[id];
+    item.identificador = id;
+    item.mutuos = contexto->contagem[id];
+    contexto->contagem[id] = 0;
+    
+    if(usuarios_temArco(nodo, vizinho) || usuarios_temArco(vizinho, nodo)) continue;
+    
+    candidato = usuarios_atributos(contexto, id);
+    item.pontuacao = item.mutuos*(1.0 + ((candidato != NULL) ? candidato->avaliacao : 0)/5.0);
+    
+    if(tamanho < k) {
+      heap[tamanho] = item;
+      usuarios_heapSubir(heap, tamanho++);
     }
-  /* Outros casos (não char *) */
-  if(!strcmp(nomeDado, "identificador")) 
-    *((int *)retorno) = usuarios_dadosTemp.identificador;
-  if(!strcmp(nomeDado, "formaPagamento")) 
-    *((usuarios_forma_de_pagamento *)retorno) = usuarios_dadosTemp.formaPagamento;
-  if(!strcmp(nomeDado, "tipo")) 
-    *((usuarios_tipo_usuario *)retorno) = usuarios_dadosTemp.tipo;
-  if(!strcmp(nomeDado, "estado")) 
-    *((usuarios_estado_de_usuario *)retorno) = usuarios_dadosTemp.estado;
-  if(!strcmp(nomeDado, "avaliacao")) 
-    *((double *)retorno) = usuarios_dadosTemp.avaliacao;
-  if(!strcmp(nomeDado, "n_avaliacao")) 
-    *((unsigned int *)retorno) = usuarios_dadosTemp.n_avaliacao;
-  if(!strcmp(nomeDado, "n_reclamacoes")) 
-    *((unsigned int *)retorno) = usuarios_dadosTemp.n_reclamacoes;
+    else if(usuarios_recomendacaoMelhor(&item, &heap[0])) {
+      heap[0] = item;
+      usuarios_heapDescer(heap, tamanho, 0);
+    }
+  }
+  
+  qsort(heap, tamanho, sizeof(usuarios_recomendacao), usuarios_recomendacaoComparar);
+  
+  /* Guardamos no cache, o vetor do heap passa a ser do cache */
+  cache = &contexto->recomendacoes[identificador];
+  free(cache->itens);
+  cache->itens = heap;
+  cache->k = k;
+  cache->n = tamanho;
+  cache->valido = 1;
   
+  memcpy(retorno, heap, tamanho*sizeof(usuarios_recomendacao));
+  *n = tamanho;
   return USUARIOS_SUCESSO;
+}
+
+/*!
+ * @fn static void usuarios_visitasLimpar(usuarios_contexto *contexto)
+ * @brief Libera os vetores da busca de grau de separação do contexto
+*/
+
+static void usuarios_visitasLimpar(usuarios_contexto *contexto){
+  free(contexto->visitas.marca);
+  free(contexto->visitas.pai);
+  free(contexto->visitas.distancia);
+  free(contexto->visitas.fila);
+  memset(&contexto->visitas, 0, sizeof(usuarios_visitas));
+}
+
+/*!
+ * @fn static usuarios_condRet usuarios_visitasReservar(usuarios_contexto *contexto)
+ * @brief Garante vetores de visita com uma posição por identificador do índice e inicia uma nova geração
+ * @return USUARIOS_FALHA_ALOCAR se não houver memória, USUARIOS_SUCESSO caso contrário
+*/
+
+static usuarios_condRet usuarios_visitasReservar(usuarios_contexto *contexto){
+  usuarios_visitas *v = &contexto->visitas;
+  unsigned int capacidade = contexto->nos_capacidade;
+  
+  if(v->capacidade < capacidade) {
+    usuarios_visitasLimpar(contexto);
+    v->marca = (unsigned int *)calloc(2*capacidade, sizeof(unsigned int));
+    v->pai = (unsigned int *)malloc(2*capacidade*sizeof(unsigned int));
+    v->distancia = (unsigned int *)malloc(2*capacidade*sizeof(unsigned int));
+    v->fila = (unsigned int *)malloc(2*capacidade*sizeof(unsigned int));
+    if(v->marca == NULL || v->pai == NULL || v->distancia == NULL || v->fila == NULL) {
+      usuarios_visitasLimpar(contexto);
+      return USUARIOS_FALHA_ALOCAR;
+    }
+    v->capacidade = capacidade;
+  }
+  
+  /* Ao dar a volta no contador as marcas antigas poderiam coincidir */
+  if(++v->geracao == 0) {
+    memset(v->marca, 0, 2*v->capacidade*sizeof(unsigned int));
+    v->geracao = 1;
+  }
   
+  return USUARIOS_SUCESSO;
 }
 
 /*!
- * @fn usuarios_condRet usuarios_atualizarDados(unsigned int identificador, const char *nomeDado, ...)
- * @brief Atualiza dados do usuário de identificador passado
- * @param identificador Id do usuário no grafo a alterar um dado, se for 0 assume-se da sessão
- * @param nomeDado o dado a ser alterado, pode ser: "identificador", "usuario", "nome", "senha", "email", "endereco", "formaPagamento", "tipo", "estado", "avaliacao", "n_avaliacao", "n_reclamacoes".
- * @param (...) Um argumento de tipo char *, usuarios_forma_de_pagamento, usuarios_tipo_usuario, usuarios_estado_de_usuario, double ou unsigned int
- * @return Uma instância do tipo usuarios_condRet que assume:
- *  - USUARIOS_FALHA_GRAFONULL se o grafo for NULL;
- *  - USUARIOS_GRAFO_CORROMPIDO se o nodo associado ao id for NULL;
- *  - USUARIOS_FALHA_LERDB se não consegue abrir o banco de dados de usuários USUARIOS_DB como "r+";
- *  - USUARIOS_SUCESSO se atualizar no grafo e no arquivo a alteração pretendida ou se o nomeDado não for válido;
- *  
- * @code
- * usuarios_atualizarDados(0, "nome", "João Ninguém");
- * @endcode
+ * @fn usuarios_condRet usuarios_grauSeparacao_r(usuarios_contexto *contexto, unsigned int origem, unsigned int destino, unsigned int profundidadeMax, unsigned int *distancia, usuarios_uintarray *caminho)
+ * @brief Calcula a menor distância em amizades confirmadas entre dois usuários
+ * @param origem Id do primeiro usuário, se for 0 usa a sessão
+ * @param destino Id do segundo usuário
+ * @param profundidadeMax Maior distância procurada
+ * @param distancia Recebe o número de passos entre origem e destino
+ * @param caminho Se não for NULL, recebe os ids de um caminho mínimo de origem a destino, inclusive, e deve ser liberado com usuarios_freeUint
+ * @return Instância usuarios_condRet que assume:
+ *  - USUARIOS_FALHA_GRAFONULL se o grafo não foi carregado;
+ *  - USUARIOS_FALHAUSUARIONAOEXISTE se algum dos usuários não existir;
+ *  - USUARIOS_FALHA_ALOCAR se faltar memória;
+ *  - USUARIOS_FALHA_SEMCAMINHO se não houver caminho com até profundidadeMax passos;
+ *  - USUARIOS_SUCESSO caso contrário.
+ *
+ * Faz uma busca em largura a partir de cada ponta, sempre expandindo um
+ * nível inteiro da fronteira menor, e para no primeiro nível em que as
+ * buscas se encontram. Com grau médio d e distância D visita cerca de
+ * 2*d^(D/2) usuários em vez de d^D. Os vetores de visita ficam no
+ * contexto e são marcados por geração, então não são alocados nem
+ * zerados a cada consulta.
  *
- * O último argumento pode ser de qualquer tipo, exemplo:
- * 
  * @code
- * usuarios_atualizarDados(0, "estado", INATIVO_ABUSO);
+ * unsigned int passos;
+ * if(usuarios_grauSeparacao(0, vendedor, 6, &passos, NULL) == USUARIOS_SUCESSO)
+ *   printf("Você está a %u passos deste vendedor\n", passos);
  * @endcode
- * 
- * Assertivas de entrada:
- *  - O grafo é consistente e não nulo
- *  - Se identificador é 0, há sessão
- *  - É passado exatamente 1 argumento na elípse (...)
- *  - nomeDado é válido
- *  - Há permissões para abrir o arquivo USUARIOS_DB como "r+"
  *
  * Assertivas de saída:
- *  - O dado pretendido é atualizado no grafo e no arquivo respeitando os limites do campo
- *  - Nenhum outro dado é alterado
- * 
- *  Assertivas estruturais:
- *  - String passadas na elipse terminam com '\0' e respeitam o limite dos campos
- * 
- * Assertivas de contrato:
- *  - Os dados no grafo e no arquivo a serem alterados serão alterados usando os dados passados pelos parâmetros
+ *  - O grafo não é alterado
+ *  - Se retornar USUARIOS_SUCESSO, caminho tem distancia+1 ids, começa em origem e termina em destino
  *
  * Requisitos:
- *  - grafo.h, string.h, stdlib.h, stdio.h 
+ *  - stdlib.h, string.h, limits.h, grafo.h
  *
  * Hipóteses:
  *  - Nenhuma
- * 
  */
- 
-usuarios_condRet usuarios_atualizarDados(unsigned int identificador, const char *nomeDado, ...){
-  unsigned int i;
-  tpUsuario *corrente;
-  FILE *db_usuarios;
-  va_list arg;
+
+usuarios_condRet usuarios_grauSeparacao_r(usuarios_contexto *contexto, unsigned int origem, unsigned int destino, unsigned int profundidadeMax, unsigned int *distancia, usuarios_uintarray *caminho){
+  usuarios_visitas *v = &contexto->visitas;
+  const usuarios_quente *usuario;
+  grafo_no *nx, *ny;
+  grafo_arco *arco;
+  unsigned int inicio[2], fim[2], nivel[2], pontas[2], lado, outro, limite, x, y, i, cap;
+  unsigned int melhor = UINT_MAX, encontro = 0;
   
-  if(usuarios_grafo == NULL) return USUARIOS_FALHA_GRAFONULL;
+  if(caminho != NULL) {
+    caminho->length = 0;
+    caminho->array = NULL;
+  }
+  if(contexto->grafo_usuarios == NULL) return USUARIOS_FALHA_GRAFONULL;
   
-  /* Pegamos o nodo com o identificador passado */
-  if(identificador) corrente = (tpUsuario *)retorna_valor_vertice(usuarios_grafo, identificador);
-  /* Se foi passado 0, então pega-se o da sessão */
-  else corrente = usuarios_sessao;
+  usuario = usuarios_atributos(contexto, origem);
+  if(usuario == NULL || destino == 0 || usuarios_atributos(contexto, destino) == NULL) return USUARIOS_FALHAUSUARIONAOEXISTE;
+  origem = usuario->identificador;
   
-  if(corrente == NULL) return USUARIOS_GRAFO_CORROMPIDO; /* Assertiva */
-      
-  va_start(arg, nomeDado);
+  if(origem == destino) {
+    *distancia = 0;
+    if(caminho != NULL) {
+      caminho->array = (unsigned int *)malloc(sizeof(unsigned int));
+      if(caminho->array == NULL) return USUARIOS_FALHA_ALOCAR;
+      caminho->array[0] = origem;
+      caminho->length = 1;
+    }
+    return USUARIOS_SUCESSO;
+  }
+  
+  if(usuarios_visitasReservar(contexto) != USUARIOS_SUCESSO) return USUARIOS_FALHA_ALOCAR;
+  cap = v->capacidade;
   
-  /* Analizamos os argumentos passados armazenando em usuarios_dadosTemp */
-  memcpy(&usuarios_dadosTemp, corrente, sizeof(tpUsuario));
+  /* Lado 0 parte da origem e lado 1 do destino */
+  pontas[0] = origem;
+  pontas[1] = destino;
+  for(lado=0;lado<2;lado++) {
+    v->marca[lado*cap + pontas[lado]] = v->geracao;
+    v->pai[lado*cap + pontas[lado]] = pontas[lado];
+    v->distancia[lado*cap + pontas[lado]] = 0;
+    v->fila[lado*cap] = pontas[lado];
+    inicio[lado] = 0;
+    fim[lado] = 1;
+    nivel[lado] = 0;
+  }
   
-  for(i=0;i<usuarios_cadastro_argumentos_n;i++)
-    if(!strcmp(nomeDado, usuarios_args[i].validos)) {
-      strncpy(usuarios_args[i].destino, va_arg(arg, char *), usuarios_args[i].tamanho);
+  while(nivel[0] + nivel[1] < profundidadeMax && inicio[0] < fim[0] && inicio[1] < fim[1]) {
+    /* Expandimos a fronteira menor */
+    lado = (fim[0] - inicio[0] <= fim[1] - inicio[1]) ? 0 : 1;
+    outro = 1 - lado;
+    limite = fim[lado];
+    
+    for(; inicio[lado] < limite; inicio[lado]++) {
+      x = v->fila[lado*cap + inicio[lado]];
+      nx = contexto->nos[x];
+      for(arco = (grafo_arco *)nx->acesso_arco; arco != NULL; arco = (grafo_arco *)arco->prox_arco) {
+        ny = (grafo_no *)arco->acesso_adjacente;
+        y = ny->valor;
+        if(v->marca[lado*cap + y] == v->geracao || !usuarios_temArco(ny, nx)) continue;
+        
+        v->marca[lado*cap + y] = v->geracao;
+        v->pai[lado*cap + y] = x;
+        v->distancia[lado*cap + y] = nivel[lado] + 1;
+        v->fila[lado*cap + fim[lado]++] = y;
+        
+        /* Encontro com a outra busca */
+        if(v->marca[outro*cap + y] == v->geracao && nivel[lado] + 1 + v->distancia[outro*cap + y] < melhor) {
+          melhor = nivel[lado] + 1 + v->distancia[outro*cap + y];
+          encontro = y;
+        }
+      }
     }
-  /* Outros casos (não char *) */
-  if(!strcmp(nomeDado, "formaPagamento")) 
-    usuarios_dadosTemp.formaPagamento = (usuarios_forma_de_pagamento)va_arg(arg, int);
-  if(!strcmp(nomeDado, "tipo")) 
-    usuarios_dadosTemp.tipo = (usuarios_tipo_usuario)va_arg(arg, int);
-  if(!strcmp(nomeDado, "estado")) 
-    usuarios_dadosTemp.estado = (usuarios_estado_de_usuario)va_arg(arg, int);
-  if(!strcmp(nomeDado, "avaliacao")) 
-    usuarios_dadosTemp.avaliacao = va_arg(arg, double);
-  if(!strcmp(nomeDado, "n_avaliacao")) 
-    usuarios_dadosTemp.n_avaliacao = va_arg(arg, unsigned int);
-  if(!strcmp(nomeDado, "n_reclamacoes")) 
-    usuarios_dadosTemp.n_reclamacoes = va_arg(arg, unsigned int);
+    nivel[lado]++;
     
-  va_end(arg);
-  
-  /* Copiamos no grafo */
-  memcpy(corrente, &usuarios_dadosTemp, sizeof(tpUsuario));
-  
-  /* Atualizamos no arquivo de dados */
-  db_usuarios = fopen(USUARIOS_DB, "r+");
-  if(db_usuarios == NULL) return USUARIOS_FALHA_LERDB;
-  
-  fseek(db_usuarios, (corrente->identificador-1)*(
-    USUARIOS_LIMITE_INT + 1 +
-    USUARIOS_LIMITE_USUARIO + 1 +
-    USUARIOS_LIMITE_NOME + 1 +
-    USUARIOS_LIMITE_EMAIL + 1 +
-    USUARIOS_LIMITE_SENHA + 1 +
-    USUARIOS_LIMITE_ENDERECO + 1 +
-    USUARIOS_LIMITE_INT + 1 +
-    USUARIOS_LIMITE_INT + 1 +
-    USUARIOS_LIMITE_INT + 1 +
-    USUARIOS_LIMITE_DOUBLE + 1 +
-    USUARIOS_LIMITE_INT + 1 +
-    USUARIOS_LIMITE_INT + 1
-	), SEEK_SET);
+    if(melhor != UINT_MAX) break;
+  }
   
-  fprintf(db_usuarios, USUARIOS_DB_ESTRUTURA, 
-    corrente->identificador,
-    corrente->usuario,
-    corrente->nome,
-    corrente->email,
-    corrente->senha,
-    corrente->endereco,
-    (int)corrente->formaPagamento,
-    (int)corrente->tipo,
-    (int)corrente->estado,
-    corrente->avaliacao,
-    corrente->n_avaliacao,
-    corrente->n_reclamacoes
-  );
+  if(melhor == UINT_MAX) return USUARIOS_FALHA_SEMCAMINHO;
+  *distancia = melhor;
   
-  fclose(db_usuarios);
+  if(caminho != NULL) {
+    caminho->array = (unsigned int *)malloc((melhor+1)*sizeof(unsigned int));
+    if(caminho->array == NULL) return USUARIOS_FALHA_ALOCAR;
+    caminho->length = melhor+1;
+    
+    /* Do encontro até a origem pelos pais do lado 0, depois até o destino pelos pais do lado 1 */
+    i = v->distancia[encontro];
+    for(x = encontro;; x = v->pai[x]) {
+      caminho->array[i] = x;
+      if(i-- == 0) break;
+    }
+    i = v->distancia[encontro];
+    for(x = encontro; x != destino;) {
+      x = v->pai[cap + x];
+      caminho->array[++i] = x;
+    }
+  }
   
   return USUARIOS_SUCESSO;
+}
+
+/*!
+ * @fn static void usuarios_minusculas(char *destino, const char *origem, size_t limite)
+ * @brief Copia origem para destino trocando as letras ASCII por minúsculas
+ * @param limite Tamanho de destino, incluindo o '\0'
+ *
+ * Bytes fora do ASCII, como os de letras acentuadas em UTF-8, são copiados
+ * sem alteração.
+*/
+
+static void usuarios_minusculas(char *destino, const char *origem, size_t limite){
+  size_t i;
   
+  for(i=0;i+1<limite && origem[i] != '\0';i++)
+    destino[i] = (origem[i] >= 'A' && origem[i] <= 'Z') ? origem[i] - 'A' + 'a' : origem[i];
+  destino[i] = '\0';
+}
+
+/*!
+ * @fn static unsigned int usuarios_trigramaCodigo(const char *texto)
+ * @brief Código do trigrama que começa em texto, que deve ter ao menos três caracteres
+*/
+
+static unsigned int usuarios_trigramaCodigo(const char *texto){
+  return ((unsigned int)(unsigned char)texto[0] << 16) | ((unsigned int)(unsigned char)texto[1] << 8) | (unsigned char)texto[2];
+}
+
+/*!
+ * @fn static usuarios_trigrama *usuarios_trigramaPosicao(usuarios_pesquisa *pesquisa, unsigned int codigo)
+ * @brief Posição do trigrama na tabela, ou a posição livre onde ele seria inserido
+*/
+
+static usuarios_trigrama *usuarios_trigramaPosicao(usuarios_pesquisa *pesquisa, unsigned int codigo){
+  unsigned int mascara = pesquisa->capacidade_trigramas - 1;
+  unsigned int i = (codigo * 2654435761u) & mascara;
   
+  while(pesquisa->trigramas[i].codigo != 0 && pesquisa->trigramas[i].codigo != codigo) i = (i+1) & mascara;
+  return &pesquisa->trigramas[i];
 }
 
 /*!
- * @fn usuarios_condRet usuarios_limpar()
- * @brief Apaga o grafo de usuários da memória e faz logout na sessão aberta
- * @return Retorna uma instância do tipo usuarios_condRet que assume:
- *  - USUARIOS_FALHA_FECHARSESSAO se não conseguir fazer logout na sessão se houver sessão aberta;
- *  - USUARIOS_FALHA_LIMPAR se não conseguir destruir o grafo da memória.
- *  - Retorna USUARIOS_SUCESSO se não ocorrerem erros.
+ * @fn static usuarios_condRet usuarios_trigramaAdicionar(usuarios_pesquisa *pesquisa, unsigned int codigo, unsigned int identificador)
+ * @brief Inclui identificador na lista do trigrama, mantendo a ordem e sem repetir
+ * @return USUARIOS_FALHA_ALOCAR se não houver memória, USUARIOS_SUCESSO caso contrário
  *
- * Assertivas de entrada:
- *  - Nenhuma
+ * A tabela dobra quando passa de 70% de ocupação.
+*/
+
+static usuarios_condRet usuarios_trigramaAdicionar(usuarios_pesquisa *pesquisa, unsigned int codigo, unsigned int identificador){
+  usuarios_trigrama *trigrama, *antiga;
+  unsigned int *ids, capacidade, i, inicio, fim, meio;
+  
+  if(10*(pesquisa->n_trigramas+1) > 7*pesquisa->capacidade_trigramas) {
+    antiga = pesquisa->trigramas;
+    capacidade = pesquisa->capacidade_trigramas;
+    pesquisa->capacidade_trigramas = capacidade ? 2*capacidade : 1024;
+    pesquisa->trigramas = (usuarios_trigrama *)calloc(pesquisa->capacidade_trigramas, sizeof(usuarios_trigrama));
+    if(pesquisa->trigramas == NULL) {
+      pesquisa->trigramas = antiga;
+      pesquisa->capacidade_trigramas = capacidade;
+      return USUARIOS_FALHA_ALOCAR;
+    }
+    for(i=0;i<capacidade;i++)
+      if(antiga[i].codigo != 0) *usuarios_trigramaPosicao(pesquisa, antiga[i].codigo) = antiga[i];
+    free(antiga);
+  }
+  
+  trigrama = usuarios_trigramaPosicao(pesquisa, codigo);
+  if(trigrama->codigo == 0) {
+    trigrama->codigo = codigo;
+    pesquisa->n_trigramas++;
+  }
+  
+  /* Ids costumam chegar em ordem crescente, então testamos o fim antes da busca binária */
+  inicio = trigrama->n;
+  if(trigrama->n > 0 && trigrama->ids[trigrama->n-1] >= identificador) {
+    inicio = 0;
+    fim = trigrama->n;
+    while(inicio < fim) {
+      meio = (inicio + fim)/2;
+      if(trigrama->ids[meio] < identificador) inicio = meio+1;
+      else fim = meio;
+    }
+    if(trigrama->ids[inicio] == identificador) return USUARIOS_SUCESSO;
+  }
+  
+  if(trigrama->n == trigrama->capacidade) {
+    capacidade = trigrama->capacidade ? 2*trigrama->capacidade : 4;
+    ids = (unsigned int *)realloc(trigrama->ids, capacidade*sizeof(unsigned int));
+    if(ids == NULL) return USUARIOS_FALHA_ALOCAR;
+    trigrama->ids = ids;
+    trigrama->capacidade = capacidade;
+  }
+  
+  memmove(trigrama->ids + inicio + 1, trigrama->ids + inicio, (trigrama->n - inicio)*sizeof(unsigned int));
+  trigrama->ids[inicio] = identificador;
+  trigrama->n++;
+  
+  return USUARIOS_SUCESSO;
+}
+
+/*!
+ * @fn static int usuarios_trigramaContem(const usuarios_trigrama *trigrama, unsigned int identificador, unsigned int *posicao)
+ * @brief Busca binária de identificador na lista do trigrama
+ * @param posicao Recebe a posição do identificador, se encontrado
+ * @return Não nulo se o identificador estiver na lista
+*/
+
+static int usuarios_trigramaContem(const usuarios_trigrama *trigrama, unsigned int identificador, unsigned int *posicao){
+  unsigned int inicio = 0, fim = trigrama->n, meio;
+  
+  while(inicio < fim) {
+    meio = (inicio + fim)/2;
+    if(trigrama->ids[meio] < identificador) inicio = meio+1;
+    else fim = meio;
+  }
+  *posicao = inicio;
+  return inicio < trigrama->n && trigrama->ids[inicio] == identificador;
+}
+
+/*!
+ * @fn static int usuarios_chaveComparar(const void *a, const void *b)
+ * @brief Ordem de usuarios_chave_pesquisa por texto e depois por identificador, para qsort
+*/
+
+static int usuarios_chaveComparar(const void *a, const void *b){
+  const usuarios_chave_pesquisa *x = (const usuarios_chave_pesquisa *)a;
+  const usuarios_chave_pesquisa *y = (const usuarios_chave_pesquisa *)b;
+  int ordem = strcmp(x->texto, y->texto);
+  
+  if(ordem != 0) return ordem;
+  return (x->identificador > y->identificador) - (x->identificador < y->identificador);
+}
+
+/*!
+ * @fn static unsigned int usuarios_chaveLimiteInferior(usuarios_pesquisa *pesquisa, const usuarios_chave_pesquisa *chave)
+ * @brief Primeira posição de chaves que não vem antes de chave
+*/
+
+static unsigned int usuarios_chaveLimiteInferior(usuarios_pesquisa *pesquisa, const usuarios_chave_pesquisa *chave){
+  unsigned int inicio = 0, fim = pesquisa->n_chaves, meio;
+  
+  while(inicio < fim) {
+    meio = (inicio + fim)/2;
+    if(usuarios_chaveComparar(&pesquisa->chaves[meio], chave) < 0) inicio = meio+1;
+    else fim = meio;
+  }
+  return inicio;
+}
+
+/*!
+ * @fn static void usuarios_pesquisaLimpar(usuarios_contexto *contexto)
+ * @brief Libera o índice de pesquisa, que volta a ser construído na próxima pesquisa
+*/
+
+static void usuarios_pesquisaLimpar(usuarios_contexto *contexto){
+  usuarios_pesquisa *pesquisa = &contexto->pesquisa;
+  unsigned int i;
+  
+  for(i=0;i<pesquisa->n_chaves;i++) free(pesquisa->chaves[i].texto);
+  for(i=0;i<pesquisa->capacidade_trigramas;i++) free(pesquisa->trigramas[i].ids);
+  free(pesquisa->chaves);
+  free(pesquisa->trigramas);
+  memset(pesquisa, 0, sizeof(usuarios_pesquisa));
+}
+
+/*!
+ * @fn static usuarios_condRet usuarios_pesquisaTrigramas(usuarios_contexto *contexto, tpUsuario *usuario)
+ * @brief Inclui os trigramas de usuario e nome do usuário no índice
+*/
+
+static usuarios_condRet usuarios_pesquisaTrigramas(usuarios_contexto *contexto, tpUsuario *usuario){
+  char texto[USUARIOS_LIMITE_NOME];
+  const char *campos[2] = {usuario->usuario, usuarios_internoTexto(contexto, usuario->nome)};
+  unsigned int i, j;
+  
+  for(i=0;i<2;i++) {
+    usuarios_minusculas(texto, campos[i], sizeof(texto));
+    for(j=0;texto[j] != '\0' && texto[j+1] != '\0' && texto[j+2] != '\0';j++)
+      if(usuarios_trigramaAdicionar(&contexto->pesquisa, usuarios_trigramaCodigo(texto+j), usuario->identificador) != USUARIOS_SUCESSO)
+        return USUARIOS_FALHA_ALOCAR;
+  }
+  return USUARIOS_SUCESSO;
+}
+
+/*!
+ * @fn static usuarios_condRet usuarios_pesquisaChave(usuarios_contexto *contexto, const char *texto, unsigned int identificador, int ordenar)
+ * @brief Inclui uma chave no vetor de prefixos
+ * @param ordenar Se nulo a chave vai para o fim e o vetor deve ser ordenado depois
+*/
+
+static usuarios_condRet usuarios_pesquisaChave(usuarios_contexto *contexto, const char *texto, unsigned int identificador, int ordenar){
+  usuarios_pesquisa *pesquisa = &contexto->pesquisa;
+  usuarios_chave_pesquisa chave, *chaves;
+  unsigned int capacidade, posicao = pesquisa->n_chaves;
+  
+  if(pesquisa->n_chaves == pesquisa->capacidade_chaves) {
+    capacidade = pesquisa->capacidade_chaves ? 2*pesquisa->capacidade_chaves : 64;
+    chaves = (usuarios_chave_pesquisa *)realloc(pesquisa->chaves, capacidade*sizeof(usuarios_chave_pesquisa));
+    if(chaves == NULL) return USUARIOS_FALHA_ALOCAR;
+    pesquisa->chaves = chaves;
+    pesquisa->capacidade_chaves = capacidade;
+  }
+  
+  chave.texto = (char *)malloc(strlen(texto)+1);
+  if(chave.texto == NULL) return USUARIOS_FALHA_ALOCAR;
+  usuarios_minusculas(chave.texto, texto, strlen(texto)+1);
+  chave.identificador = identificador;
+  
+  if(ordenar) {
+    posicao = usuarios_chaveLimiteInferior(pesquisa, &chave);
+    memmove(pesquisa->chaves + posicao + 1, pesquisa->chaves + posicao, (pesquisa->n_chaves - posicao)*sizeof(usuarios_chave_pesquisa));
+  }
+  pesquisa->chaves[posicao] = chave;
+  pesquisa->n_chaves++;
+  
+  return USUARIOS_SUCESSO;
+}
+
+/*!
+ * @fn static void usuarios_pesquisaInserir(usuarios_contexto *contexto, tpUsuario *usuario)
+ * @brief Inclui um usuário no índice de pesquisa, se ele estiver construído
  *
- * Assertivas de saída:
- *  - Não haverá mais grafo nem sessão
+ * Se faltar memória o índice é descartado e reconstruído na próxima
+ * pesquisa, assim ele nunca fica desatualizado.
+*/
+
+static void usuarios_pesquisaInserir(usuarios_contexto *contexto, tpUsuario *usuario){
+  if(!contexto->pesquisa.construido) return;
+  
+  if(
+    usuarios_pesquisaChave(contexto, usuario->usuario, usuario->identificador, 1) != USUARIOS_SUCESSO ||
+    usuarios_pesquisaChave(contexto, usuarios_internoTexto(contexto, usuario->nome), usuario->identificador, 1) != USUARIOS_SUCESSO ||
+    usuarios_pesquisaTrigramas(contexto, usuario) != USUARIOS_SUCESSO
+  ) usuarios_pesquisaLimpar(contexto);
+}
+
+/*!
+ * @fn static void usuarios_pesquisaRemover(usuarios_contexto *contexto, tpUsuario *usuario)
+ * @brief Retira um usuário do índice de pesquisa, se ele estiver construído
  *
- * Assertivas estruturais:
- *  - O grafo é consistente
- * 
- * Assertivas de contrato:
- *  - Nenhuma
- * 
- * Requisitos:
- *  - grafo.h
+ * Deve ser chamada antes de alterar usuario ou nome, com os valores antigos.
+*/
+
+static void usuarios_pesquisaRemover(usuarios_contexto *contexto, tpUsuario *usuario){
+  usuarios_pesquisa *pesquisa = &contexto->pesquisa;
+  usuarios_chave_pesquisa chave;
+  usuarios_trigrama *trigrama;
+  char texto[USUARIOS_LIMITE_NOME];
+  const char *campos[2] = {usuario->usuario, usuarios_internoTexto(contexto, usuario->nome)};
+  unsigned int i, j, posicao;
+  
+  if(!pesquisa->construido) return;
+  
+  for(i=0;i<2;i++) {
+    usuarios_minusculas(texto, campos[i], sizeof(texto));
+    
+    chave.texto = texto;
+    chave.identificador = usuario->identificador;
+    posicao = usuarios_chaveLimiteInferior(pesquisa, &chave);
+    if(posicao < pesquisa->n_chaves && usuarios_chaveComparar(&pesquisa->chaves[posicao], &chave) == 0) {
+      free(pesquisa->chaves[posicao].texto);
+      memmove(pesquisa->chaves + posicao, pesquisa->chaves + posicao + 1, (pesquisa->n_chaves - posicao - 1)*sizeof(usuarios_chave_pesquisa));
+      pesquisa->n_chaves--;
+    }
+    
+    /* Trigramas que não existem mais no texto ficam com a lista vazia */
+    for(j=0;texto[j] != '\0' && texto[j+1] != '\0' && texto[j+2] != '\0';j++) {
+      trigrama = usuarios_trigramaPosicao(pesquisa, usuarios_trigramaCodigo(texto+j));
+      if(trigrama->codigo != 0 && usuarios_trigramaContem(trigrama, usuario->identificador, &posicao)) {
+        memmove(trigrama->ids + posicao, trigrama->ids + posicao + 1, (trigrama->n - posicao - 1)*sizeof(unsigned int));
+        trigrama->n--;
+      }
+    }
+  }
+}
+
+/*!
+ * @fn static usuarios_condRet usuarios_pesquisaConstruir(usuarios_contexto *contexto)
+ * @brief Constrói o índice de pesquisa com todos os usuários do grafo
+ * @return USUARIOS_FALHA_ALOCAR se não houver memória, USUARIOS_SUCESSO caso contrário
  *
- * Hipóteses:
- *  - Nenhuma
- * 
- */
- 
-usuarios_condRet usuarios_limpar(){
-  /* Fechamos qualquer sessão aberta */
-  if(usuarios_logout() != USUARIOS_SUCESSO) return USUARIOS_FALHA_FECHARSESSAO;
-  /* Limpamos o grafo */
-  if(destroi_grafo(&usuarios_grafo) != SUCESSO) return USUARIOS_FALHA_LIMPAR;
+ * As chaves são ordenadas uma única vez no fim e os ids chegam às listas
+ * de trigramas em ordem crescente, então a construção custa O(n log n).
+*/
+
+static usuarios_condRet usuarios_pesquisaConstruir(usuarios_contexto *contexto){
+  tpUsuario *usuario;
+  unsigned int i;
+  
+  usuarios_pesquisaLimpar(contexto);
+  
+  for(i=1;i<contexto->nos_capacidade;i++) {
+    usuario = usuarios_registro(contexto, i);
+    if(usuario == NULL) continue;
+    if(
+      usuarios_pesquisaChave(contexto, usuario->usuario, i, 0) != USUARIOS_SUCESSO ||
+      usuarios_pesquisaChave(contexto, usuarios_internoTexto(contexto, usuario->nome), i, 0) != USUARIOS_SUCESSO ||
+      usuarios_pesquisaTrigramas(contexto, usuario) != USUARIOS_SUCESSO
+    ) {
+      usuarios_pesquisaLimpar(contexto);
+      return USUARIOS_FALHA_ALOCAR;
+    }
+  }
+  
+  qsort(contexto->pesquisa.chaves, contexto->pesquisa.n_chaves, sizeof(usuarios_chave_pesquisa), usuarios_chaveComparar);
+  contexto->pesquisa.construido = 1;
   
   return USUARIOS_SUCESSO;
 }
 
 /*!
- * @fn usuarios_condRet usuarios_listarAmigos(unsigned int identificador, usuarios_uintarray *retorno)
- * @brief Função que retorna uma lista de identificadores dos amigos do usuário passado pretendido, se o identificador for 0, usa a sessão
- * @param identificador Id do usuário a buscar amigos, se for 0 usa a sessão
- * @param retorno Lista de amigos a ser passada por referência e alocada na função. A cabeça do array deve ser alocada estaticamente:
- * 
- * @code
- * usuarios_uintarray array;
- * usuarios_listarAmigos(0, &array);
- * @endcode
- * 
- * Vai compor o array com os identificadores dos amigos.
+ * @fn static int usuarios_resultadoComparar(const void *a, const void *b)
+ * @brief Ordem dos resultados por avaliação decrescente e depois por identificador, para qsort
+*/
+
+static int usuarios_resultadoComparar(const void *a, const void *b){
+  const usuarios_resultado_pesquisa *x = (const usuarios_resultado_pesquisa *)a;
+  const usuarios_resultado_pesquisa *y = (const usuarios_resultado_pesquisa *)b;
+  
+  if(x->avaliacao != y->avaliacao) return x->avaliacao < y->avaliacao ? 1 : -1;
+  return (x->identificador > y->identificador) - (x->identificador < y->identificador);
+}
+
+/*!
+ * @fn usuarios_condRet usuarios_pesquisar_r(usuarios_contexto *contexto, const char *consulta, unsigned int pagina, unsigned int tamanhoPagina, usuarios_uintarray *retorno, unsigned int *total)
+ * @brief Pesquisa usuários por trecho de usuario ou nome, sem diferenciar maiúsculas de minúsculas ASCII
+ * @param consulta Texto procurado, não vazio
+ * @param pagina Página pedida, começando em 0
+ * @param tamanhoPagina Número máximo de ids por página, maior que 0
+ * @param retorno Recebe os ids da página, deve ser liberado com usuarios_freeUint
+ * @param total Se não for NULL, recebe o número de usuários encontrados em todas as páginas
+ * @return Instância usuarios_condRet que assume:
+ *  - USUARIOS_FALHA_GRAFONULL se o grafo não foi carregado;
+ *  - USUARIOS_FALHA_ARGUMENTOSINVALIDOS se consulta for vazia ou tamanhoPagina for 0;
+ *  - USUARIOS_FALHA_ALOCAR se faltar memória;
+ *  - USUARIOS_SUCESSO caso contrário, mesmo que nada seja encontrado.
  *
- * Deve-se liberar o array quando não mais usado usando usuarios_freeUint.
+ * Consultas de um ou dois caracteres encontram os usuários cujo usuario
+ * ou nome começa pela consulta, pela busca binária no vetor de prefixos.
+ * A partir de três caracteres a consulta pode aparecer em qualquer ponto:
+ * intersectamos as listas dos trigramas da consulta a partir da menor e
+ * conferimos o texto dos candidatos. Os resultados são ordenados pela
+ * avaliação, da maior para a menor, e empates pelo identificador.
  *
- * @return A função retorna uma instância que assume:
- *  - USUARIOS_FALHA_ACESSORESTRITO se o usuário do identificador for NULL;
- *  - USUARIOS_SUCESSO se gerar o array com sucesso.
+ * O índice é construído na primeira pesquisa e mantido por
+ * usuarios_cadastro e usuarios_atualizarDados.
  *
- * Assertivas de entrada:
- *  - identificador é um nó do grafo
- *  - o grafo já foi carregado e é consistente
- *  - a cabeça array já foi alocada estaticamente
+ * @code
+ * usuarios_uintarray pagina;
+ * unsigned int total;
+ * usuarios_pesquisar("silv", 0, 20, &pagina, &total);
+ * @endcode
  *
  * Assertivas de saída:
- *  - O array conterá o número de amigos e os identificadores dos amigos do usuário passado no parâmetro
- *  - O grafo não é afetado
- * 
- * Assertivas estruturais:
- *  - o retorno é o endereço da cabeça de um usuarios_uintarray já alocado anteriormente
- *
- * Assertivas de contrato:
- *  - Nenhuma
+ *  - O grafo não é alterado
+ *  - retorno tem no máximo tamanhoPagina ids, sem repetição
  *
  * Requisitos:
- *  - grafo.h, stdlib.h
+ *  - stdlib.h, string.h, grafo.h
  *
  * Hipóteses:
  *  - Nenhuma
- * 
  */
 
-usuarios_condRet usuarios_listarAmigos(unsigned int identificador, usuarios_uintarray *retorno) {
+usuarios_condRet usuarios_pesquisar_r(usuarios_contexto *contexto, const char *consulta, unsigned int pagina, unsigned int tamanhoPagina, usuarios_uintarray *retorno, unsigned int *total){
+  usuarios_pesquisa *pesquisa = &contexto->pesquisa;
+  usuarios_resultado_pesquisa *resultados;
+  usuarios_trigrama **listas, *menor;
+  usuarios_chave_pesquisa chave;
   tpUsuario *usuario;
-  grafo_lista_no *listaVizinhos, *tmp;
+  const usuarios_quente *quente;
+  char texto[USUARIOS_LIMITE_NOME], campo[USUARIOS_LIMITE_NOME];
+  unsigned int tamanho, n = 0, capacidade, n_listas, i, j, k, posicao, inicio;
   
-  /* Pegamos o nodo com o identificador passado */
-  if(identificador) usuario = (tpUsuario *)retorna_valor_vertice(usuarios_grafo, identificador);
-  /* Se foi passado 0, então pega-se o da sessão */
-  else usuario = usuarios_sessao;
-  
-  if(usuario == NULL) return USUARIOS_FALHA_ACESSORESTRITO; /* Assertiva */
- 
-  /* Geramos o vetor */
-  //*retorno = (usuarios_uintarray *)malloc(sizeof(usuarios_uintarray));
   retorno->length = 0;
   retorno->array = NULL;
+  if(total != NULL) *total = 0;
   
-  /* Buscamos os nós vizinhos */
-  listaVizinhos = vizinhos(usuarios_grafo, usuario->identificador);
-  for(tmp=listaVizinhos;tmp != NULL;tmp=(grafo_lista_no *)tmp->prox_no){
+  if(contexto->grafo_usuarios == NULL) return USUARIOS_FALHA_GRAFONULL;
+  if(consulta == NULL || consulta[0] == '\0' || tamanhoPagina == 0) return USUARIOS_FALHA_ARGUMENTOSINVALIDOS;
+  if(!pesquisa->construido && usuarios_pesquisaConstruir(contexto) != USUARIOS_SUCESSO) return USUARIOS_FALHA_ALOCAR;
+  
+  usuarios_minusculas(texto, consulta, sizeof(texto));
+  tamanho = strlen(texto);
+  
+  if(tamanho < 3) {
+    /* Prefixo: as chaves que começam pela consulta são contíguas */
+    chave.texto = texto;
+    chave.identificador = 0;
+    inicio = usuarios_chaveLimiteInferior(pesquisa, &chave);
+    for(i=inicio;i<pesquisa->n_chaves && !strncmp(pesquisa->chaves[i].texto, texto, tamanho);i++);
     
-    /* Verificamos se há um arco vindo no sentido contrário */
-    if(adjacente(usuarios_grafo, tmp->valor, usuario->identificador) == ADJACENTES)  {
-      retorno->array = (unsigned int *)realloc(retorno->array, (++retorno->length)*sizeof(unsigned int));
-      retorno->array[retorno->length-1] = tmp->valor;
+    capacidade = i - inicio;
+    resultados = (usuarios_resultado_pesquisa *)malloc((capacidade ? capacidade : 1)*sizeof(usuarios_resultado_pesquisa));
+    if(resultados == NULL) return USUARIOS_FALHA_ALOCAR;
+    for(i=inicio;i<inicio+capacidade;i++) {
+      resultados[n].identificador = pesquisa->chaves[i].identificador;
+      quente = usuarios_atributos(contexto, resultados[n].identificador);
+      resultados[n].avaliacao = (quente != NULL) ? quente->avaliacao : 0;
+      n++;
+    }
+  }
+  else {
+    /* Trecho: interseção das listas de trigramas */
+    n_listas = tamanho - 2;
+    listas = (usuarios_trigrama **)malloc(n_listas*sizeof(usuarios_trigrama *));
+    if(listas == NULL) return USUARIOS_FALHA_ALOCAR;
+    
+    menor = NULL;
+    for(i=0;i<n_listas;i++) {
+      listas[i] = usuarios_trigramaPosicao(pesquisa, usuarios_trigramaCodigo(texto+i));
+      if(listas[i]->codigo == 0) {
+        free(listas);
+        return USUARIOS_SUCESSO;
+      }
+      if(menor == NULL || listas[i]->n < menor->n) menor = listas[i];
+    }
+    
+    resultados = (usuarios_resultado_pesquisa *)malloc((menor->n ? menor->n : 1)*sizeof(usuarios_resultado_pesquisa));
+    if(resultados == NULL) {
+      free(listas);
+      return USUARIOS_FALHA_ALOCAR;
+    }
+    
+    for(i=0;i<menor->n;i++) {
+      for(j=0;j<n_listas;j++)
+        if(listas[j] != menor && !usuarios_trigramaContem(listas[j], menor->ids[i], &posicao)) break;
+      if(j < n_listas) continue;
+      
+      /* Os trigramas podem estar em pontos diferentes do texto, conferimos a ocorrência */
+      usuario = usuarios_registro(contexto, menor->ids[i]);
+      if(usuario == NULL) continue;
+      usuarios_minusculas(campo, usuario->usuario, sizeof(campo));
+      if(strstr(campo, texto) == NULL) {
+        usuarios_minusculas(campo, usuarios_internoTexto(contexto, usuario->nome), sizeof(campo));
+        if(strstr(campo, texto) == NULL) continue;
+      }
+      resultados[n].identificador = usuario->identificador;
+      resultados[n].avaliacao = usuario->avaliacao;
+      n++;
     }
+    free(listas);
   }
   
-  grafo_lista_no_limpar(&listaVizinhos);
+  qsort(resultados, n, sizeof(usuarios_resultado_pesquisa), usuarios_resultadoComparar);
+  
+  /* Um usuário cujo usuario e nome começam pela consulta aparece duas vezes, sempre adjacentes */
+  for(i=0, k=0;i<n;i++)
+    if(k == 0 || resultados[k-1].identificador != resultados[i].identificador) resultados[k++] = resultados[i];
+  n = k;
+  if(total != NULL) *total = n;
+  
+  if((unsigned long long)pagina*tamanhoPagina < n) {
+    inicio = pagina*tamanhoPagina;
+    retorno->length = (n - inicio < tamanhoPagina) ? n - inicio : tamanhoPagina;
+    retorno->array = (unsigned int *)malloc(retorno->length*sizeof(unsigned int));
+    if(retorno->array == NULL) {
+      retorno->length = 0;
+      free(resultados);
+      return USUARIOS_FALHA_ALOCAR;
+    }
+    for(i=0;i<retorno->length;i++) retorno->array[i] = resultados[inicio+i].identificador;
+  }
+  
+  free(resultados);
   return USUARIOS_SUCESSO;
+}
+
+/*!
+ * @fn static void usuarios_indicesLimpar(usuarios_contexto *contexto)
+ * @brief Libera os índices secundários; serão reconstruídos na próxima consulta
+*/
+
+static void usuarios_indicesLimpar(usuarios_contexto *contexto){
+  usuarios_indices *indices = &contexto->indices;
+  int i;
   
+  for(i=0;i<USUARIOS_BITMAPS;i++) free(indices->bitmaps[i]);
+  free(indices->por_avaliacao);
+  memset(indices, 0, sizeof(usuarios_indices));
 }
 
 /*!
- * @fn usuarios_condRet usuarios_listarAmigosPendentes(unsigned int identificador, usuarios_uintarray *retorno)
- * @brief Função que retorna uma lista de identificadores dos amigos pendentes do usuário passado pretendido, se o identificador for 0, usa a sessão
- * @param identificador Id do usuário a buscar amigos pendentes, se for 0 usa a sessão
- * @param retorno Lista de amigos pendentes a ser passada por referência e alocada na função. A cabeça do array deve ser alocada estaticamente:
- * 
- * @code
- * usuarios_uintarray array;
- * usuarios_listarAmigosPendentes(0, &array);
- * @endcode
- * 
- * Vai compor o array com os identificadores dos amigos pendentes.
- *
- * Deve-se liberar o array quando não mais usado usando usuarios_freeUint.
- *
- * @return A função retorna uma instância que assume:
- *  - USUARIOS_FALHA_ACESSORESTRITO se o usuário do identificador for NULL;
- *  - USUARIOS_SUCESSO se gerar o array com sucesso.
- *
- * Assertivas de entrada:
- *  - identificador é um nó do grafo
- *  - o grafo já foi carregado e é consistente
- *  - a cabeça array já foi alocada estaticamente
+ * @fn static void usuarios_indicesMarcar(usuarios_indices *indices, unsigned int identificador, const usuarios_quente *quente, int ligar)
+ * @brief Liga ou desliga os bits do usuário nos mapas dos seus valores de tipo, estado e forma de pagamento
  *
- * Assertivas de saída:
- *  - O array conterá o número de amigos pendentes e os identificadores dos amigos pendentes do usuário passado no parâmetro
- *  - O grafo não é afetado
- * 
- * Assertivas estruturais:
- *  - o retorno é o endereço da cabeça de um usuarios_uintarray já alocado anteriormente
+ * Valores fora das enumerações não entram em nenhum mapa desses campos.
+*/
+
+static void usuarios_indicesMarcar(usuarios_indices *indices, unsigned int identificador, const usuarios_quente *quente, int ligar){
+  int mapas[4], n = 0, i;
+  uint64_t bit = (uint64_t)1 << (identificador % 64);
+  
+  mapas[n++] = USUARIOS_BITMAP_TODOS;
+  if((unsigned int)quente->tipo <= ADMINISTRADOR) mapas[n++] = USUARIOS_BITMAP_TIPO + quente->tipo;
+  if((unsigned int)quente->estado <= ATIVO) mapas[n++] = USUARIOS_BITMAP_ESTADO + quente->estado;
+  if((unsigned int)quente->formaPagamento <= PAYPAL) mapas[n++] = USUARIOS_BITMAP_PAGAMENTO + quente->formaPagamento;
+  
+  for(i=0;i<n;i++) {
+    if(ligar) indices->bitmaps[mapas[i]][identificador / 64] |= bit;
+    else indices->bitmaps[mapas[i]][identificador / 64] &= ~bit;
+  }
+}
+
+/*!
+ * @fn static unsigned int usuarios_indicesPosicao(usuarios_contexto *contexto, unsigned int inicio, unsigned int fim, double avaliacao, unsigned int identificador)
+ * @brief Primeira posição de por_avaliacao em [inicio, fim) cujo par (avaliação, id) não é menor que (avaliacao, identificador)
  *
- * Assertivas de contrato:
- *  - Nenhuma
+ * As avaliações dos ids do vetor vêm de contexto->quentes.
+*/
+
+static unsigned int usuarios_indicesPosicao(usuarios_contexto *contexto, unsigned int inicio, unsigned int fim, double avaliacao, unsigned int identificador){
+  const unsigned int *ids = contexto->indices.por_avaliacao;
+  unsigned int meio;
+  double valor;
+  
+  while(inicio < fim) {
+    meio = inicio + (fim - inicio)/2;
+    valor = contexto->quentes[ids[meio]].avaliacao;
+    if(valor < avaliacao || (valor == avaliacao && ids[meio] < identificador)) inicio = meio+1;
+    else fim = meio;
+  }
+  return inicio;
+}
+
+/*!
+ * @fn static usuarios_condRet usuarios_indicesInserirId(usuarios_contexto *contexto, unsigned int identificador)
+ * @brief Inclui o usuário nos mapas de bits e em por_avaliacao, com os valores de contexto->quentes
+ * @return USUARIOS_FALHA_ALOCAR se faltar memória, USUARIOS_SUCESSO caso contrário
+*/
+
+static usuarios_condRet usuarios_indicesInserirId(usuarios_contexto *contexto, unsigned int identificador){
+  usuarios_indices *indices = &contexto->indices;
+  unsigned int palavras, capacidade, posicao;
+  uint64_t *mapa;
+  unsigned int *ids;
+  int i;
+  
+  if(identificador/64 >= indices->palavras) {
+    palavras = indices->palavras ? indices->palavras : 16;
+    while(palavras <= identificador/64) palavras *= 2;
+    for(i=0;i<USUARIOS_BITMAPS;i++) {
+      mapa = (uint64_t *)realloc(indices->bitmaps[i], palavras*sizeof(uint64_t));
+      if(mapa == NULL) return USUARIOS_FALHA_ALOCAR;
+      memset(mapa + indices->palavras, 0, (palavras - indices->palavras)*sizeof(uint64_t));
+      indices->bitmaps[i] = mapa;
+    }
+    indices->palavras = palavras;
+  }
+  if(indices->n == indices->capacidade) {
+    capacidade = indices->capacidade ? 2*indices->capacidade : 1024;
+    ids = (unsigned int *)realloc(indices->por_avaliacao, capacidade*sizeof(unsigned int));
+    if(ids == NULL) return USUARIOS_FALHA_ALOCAR;
+    indices->por_avaliacao = ids;
+    indices->capacidade = capacidade;
+  }
+  
+  usuarios_indicesMarcar(indices, identificador, &contexto->quentes[identificador], 1);
+  posicao = usuarios_indicesPosicao(contexto, 0, indices->n, contexto->quentes[identificador].avaliacao, identificador);
+  memmove(indices->por_avaliacao + posicao + 1, indices->por_avaliacao + posicao, (indices->n - posicao)*sizeof(unsigned int));
+  indices->por_avaliacao[posicao] = identificador;
+  indices->n++;
+  return USUARIOS_SUCESSO;
+}
+
+/*!
+ * @fn static void usuarios_indicesInserir(usuarios_contexto *contexto, unsigned int identificador)
+ * @brief Inclui um usuário novo nos índices secundários, se eles estiverem construídos
  *
- * Requisitos:
- *  - grafo.h, stdlib.h
+ * Se faltar memória os índices são descartados e reconstruídos na
+ * próxima consulta, assim eles nunca ficam desatualizados.
+*/
+
+static void usuarios_indicesInserir(usuarios_contexto *contexto, unsigned int identificador){
+  if(!contexto->indices.construido) return;
+  if(usuarios_indicesInserirId(contexto, identificador) != USUARIOS_SUCESSO) usuarios_indicesLimpar(contexto);
+}
+
+/*!
+ * @fn static void usuarios_indicesAlterar(usuarios_contexto *contexto, unsigned int identificador, const usuarios_quente *antigo)
+ * @brief Atualiza os índices secundários depois que os campos quentes do usuário mudaram de antigo para contexto->quentes[identificador]
  *
- * Hipóteses:
- *  - Nenhuma
- * 
- */
+ * Uma nova avaliação só desloca os ids entre a posição antiga e a nova
+ * em por_avaliacao.
+*/
 
-usuarios_condRet usuarios_listarAmigosPendentes(unsigned int identificador, usuarios_uintarray *retorno) {
-  tpUsuario *corrente;
-  unsigned int i;
+static void usuarios_indicesAlterar(usuarios_contexto *contexto, unsigned int identificador, const usuarios_quente *antigo){
+  usuarios_indices *indices = &contexto->indices;
+  const usuarios_quente *novo = &contexto->quentes[identificador];
+  unsigned int *ids = indices->por_avaliacao;
+  unsigned int inicio, fim, meio, antiga, nova;
+  double valor;
   
-  /* Pegamos o nodo com o identificador passado */
-  if(identificador) corrente = (tpUsuario *)retorna_valor_vertice(usuarios_grafo, identificador);
-  /* Se foi passado 0, então pega-se o da sessão */
-  else corrente = usuarios_sessao;
+  if(!indices->construido) return;
   
-  if(corrente == NULL) return USUARIOS_FALHA_ACESSORESTRITO; /* Assertiva */
+  usuarios_indicesMarcar(indices, identificador, antigo, 0);
+  usuarios_indicesMarcar(indices, identificador, novo, 1);
+  if(antigo->avaliacao == novo->avaliacao) return;
   
-  /* Geramos o vetor */
-  //*retorno = (usuarios_uintarray *)malloc(sizeof(usuarios_uintarray));
-  retorno->length = 0;
-  retorno->array = NULL;
+  /* Posição antiga, comparando o próprio usuário pelo valor antigo */
+  inicio = 0;
+  fim = indices->n;
+  while(inicio < fim) {
+    meio = inicio + (fim - inicio)/2;
+    valor = (ids[meio] == identificador) ? antigo->avaliacao : contexto->quentes[ids[meio]].avaliacao;
+    if(valor < antigo->avaliacao || (valor == antigo->avaliacao && ids[meio] < identificador)) inicio = meio+1;
+    else fim = meio;
+  }
+  antiga = inicio;
+  if(antiga >= indices->n || ids[antiga] != identificador) {
+    usuarios_indicesLimpar(contexto); /* Inconsistente, reconstruímos na próxima consulta */
+    return;
+  }
   
-  /* Buscamos em todo o grafo */
-  for(i=0;i<usuarios_contador;i++){
-    /* Vemos se há um arco do usuário i ao usuário identificador e que não há um no sentido contrário */
-    if(grafo_busca_arco(usuarios_grafo, i, identificador) != NULL &&
-       grafo_busca_arco(usuarios_grafo, identificador, i) == NULL){
-      /* Adicionamos ao array */
-      retorno->length++;
-      retorno->array = (unsigned int*)realloc(retorno->array, retorno->length*sizeof(unsigned int));
-      if(retorno->array == NULL) {
-        retorno->length = 0;
-        return USUARIOS_FALHA_INSERIR_DADOS;
-      }
-      retorno->array[retorno->length-1] = i;
-    }
+  if(novo->avaliacao > antigo->avaliacao) {
+    nova = usuarios_indicesPosicao(contexto, antiga+1, indices->n, novo->avaliacao, identificador) - 1;
+    memmove(ids + antiga, ids + antiga + 1, (nova - antiga)*sizeof(unsigned int));
   }
+  else {
+    nova = usuarios_indicesPosicao(contexto, 0, antiga, novo->avaliacao, identificador);
+    memmove(ids + nova + 1, ids + nova, (antiga - nova)*sizeof(unsigned int));
+  }
+  ids[nova] = identificador;
+}
+
+/*!
+ * @fn static usuarios_condRet usuarios_indicesConstruir(usuarios_contexto *contexto)
+ * @brief Constrói os índices secundários a partir de contexto->quentes
+ * @return USUARIOS_FALHA_ALOCAR se faltar memória, USUARIOS_SUCESSO caso contrário
+*/
+
+static usuarios_condRet usuarios_indicesConstruir(usuarios_contexto *contexto){
+  unsigned int i;
   
+  usuarios_indicesLimpar(contexto);
+  /* Inserimos em ordem de id, a maior parte das inserções em por_avaliacao é perto do fim */
+  for(i=1;i<contexto->nos_capacidade;i++) {
+    if(contexto->nos[i] == NULL) continue;
+    if(usuarios_indicesInserirId(contexto, i) != USUARIOS_SUCESSO) {
+      usuarios_indicesLimpar(contexto);
+      return USUARIOS_FALHA_ALOCAR;
+    }
+  }
+  contexto->indices.construido = 1;
   return USUARIOS_SUCESSO;
-  
 }
 
 /*!
- * @fn usuarios_condRet usuarios_listarAmigosdeAmigos(unsigned int identificador, usuarios_uintarray *retorno)
- * @brief Função que lista os amigos de amigos (excluíndo amigos)
- * @param identificador Id do usuário a buscar amigos de amigos, se for 0 usa a sessão
- * @param retorno Lista de amigos pendentes a ser passada por referência e alocada na função. A cabeça do array deve ser alocada estaticamente:
- * 
- * @code
- * usuarios_uintarray array;
- * usuarios_listarAmigosdeAmigos(0, &array);
- * @endcode
- * 
- * Vai compor o array com os identificadores dos amigos de amigos.
+ * @fn usuarios_condRet usuarios_consultar_r(usuarios_contexto *contexto, const usuarios_filtro *filtro, usuarios_uintarray *retorno)
+ * @brief Lista os usuários que atendem a todas as condições de filtro
+ * @param filtro Condições; campos com USUARIOS_QUALQUER e a faixa de USUARIOS_FILTRO_TODOS não restringem
+ * @param retorno Recebe os ids em ordem crescente, deve ser liberado com usuarios_freeUint
+ * @return Instância usuarios_condRet que assume:
+ *  - USUARIOS_FALHA_GRAFONULL se o grafo não foi carregado;
+ *  - USUARIOS_ARGUMENTOINVALIDO se algum campo de filtro não for um valor da sua enumeração nem USUARIOS_QUALQUER;
+ *  - USUARIOS_FALHA_ALOCAR se faltar memória;
+ *  - USUARIOS_SUCESSO caso contrário, mesmo que nada seja encontrado.
  *
- * Deve-se liberar o array quando não mais usado usando usuarios_freeUint.
+ * Tipo, estado e forma de pagamento são mapas de bits por valor,
+ * intersectados palavra a palavra; a faixa de avaliação vem de uma busca
+ * binária no vetor de ids ordenado por avaliação. Nenhum registro é
+ * lido, então a consulta não percorre os nós do grafo.
  *
- * @return A função retorna uma instância que assume:
- *  - USUARIOS_FALHA_ACESSORESTRITO se o usuário do identificador for NULL;
- *  - USUARIOS_SUCESSO se gerar o array com sucesso.
+ * Os índices são construídos na primeira consulta e mantidos por
+ * usuarios_cadastro e usuarios_atualizarDados (e portanto por
+ * avaliacao_fazerAvaliacao, que altera a avaliação por ela).
  *
- * Assertivas de entrada:
- *  - identificador é um nó do grafo
- *  - o grafo já foi carregado e é consistente
- *  - a cabeça array já foi alocada estaticamente
+ * @code
+ * usuarios_filtro filtro = USUARIOS_FILTRO_TODOS;
+ * usuarios_uintarray ids;
+ * filtro.tipo = OFERTANTE;
+ * filtro.estado = ATIVO;
+ * filtro.avaliacaoMinima = 4;
+ * usuarios_consultar(&filtro, &ids);
+ * @endcode
  *
  * Assertivas de saída:
- *  - O array conterá o número de amigos de amigos e os identificadores dos amigos de amigos do usuário passado no parâmetro
- *  - O grafo não é afetado
- * 
- * Assertivas estruturais:
- *  - o retorno é o endereço da cabeça de um usuarios_uintarray já alocado anteriormente
- *
- * Assertivas de contrato:
- *  - Nenhuma
+ *  - O grafo não é alterado
  *
  * Requisitos:
- *  - grafo.h, stdlib.h
+ *  - stdlib.h, string.h, stdint.h, float.h
  *
  * Hipóteses:
  *  - Nenhuma
- * 
  */
 
-usuarios_condRet usuarios_listarAmigosdeAmigos(unsigned int identificador, usuarios_uintarray *retorno){
-  usuarios_uintarray amigos, amigosdeamigos;
-  unsigned int i,j,k;
-  
-  /* Listamos os amigos do usuário */
-  if(usuarios_listarAmigos(identificador, &amigos) != USUARIOS_SUCESSO) 
-    return USUARIOS_FALHA_LISTARAMIGOS;
+usuarios_condRet usuarios_consultar_r(usuarios_contexto *contexto, const usuarios_filtro *filtro, usuarios_uintarray *retorno){
+  usuarios_indices *indices = &contexto->indices;
+  uint64_t *resultado, *faixa, palavra;
+  int mapas[3], n_mapas = 0, i;
+  unsigned int p, inicio, fim, total = 0;
   
   retorno->length = 0;
   retorno->array = NULL;
+  if(contexto->grafo_usuarios == NULL) return USUARIOS_FALHA_GRAFONULL;
+  if(
+    (filtro->tipo != USUARIOS_QUALQUER && (filtro->tipo < 0 || filtro->tipo > ADMINISTRADOR)) ||
+    (filtro->estado != USUARIOS_QUALQUER && (filtro->estado < 0 || filtro->estado > ATIVO)) ||
+    (filtro->formaPagamento != USUARIOS_QUALQUER && (filtro->formaPagamento < 0 || filtro->formaPagamento > PAYPAL))
+  ) return USUARIOS_ARGUMENTOINVALIDO;
   
-  /* Para cada amigo buscamos os amigos */
-  for(i=0;i<amigos.length;i++){
-    if(usuarios_listarAmigos(amigos.array[i], &amigosdeamigos) != USUARIOS_SUCESSO) 
-      return USUARIOS_FALHA_LISTARAMIGOS;
-      
-    /* Inserimos um a um de temporário no retorno, se ainda não estiver */
-    for(j=0;j<amigosdeamigos.length;j++){
-      /* Impedimos autoinclusão */
-      if(amigosdeamigos.array[j] != identificador) {
-        /* Para cada temporário buscamos no retorno se já existe e não esteja em amigos */
-        for(k=0;k<retorno->length;k++){
-          if(retorno->array[k] == amigosdeamigos.array[j]) break;
-        }
-        /* Adicionamos ao retorno */
-        if(k == retorno->length) {
-          retorno->length++;
-          retorno->array = (unsigned int *)realloc(retorno->array, retorno->length*sizeof(unsigned int));
-          retorno->array[retorno->length-1] = amigosdeamigos.array[j];
-        }
-      }
+  if(!indices->construido && usuarios_indicesConstruir(contexto) != USUARIOS_SUCESSO) return USUARIOS_FALHA_ALOCAR;
+  if(indices->palavras == 0 || filtro->avaliacaoMinima > filtro->avaliacaoMaxima) return USUARIOS_SUCESSO;
+  
+  mapas[n_mapas++] = USUARIOS_BITMAP_TODOS;
+  if(filtro->tipo != USUARIOS_QUALQUER) mapas[n_mapas++] = USUARIOS_BITMAP_TIPO + filtro->tipo;
+  if(filtro->estado != USUARIOS_QUALQUER) mapas[n_mapas++] = USUARIOS_BITMAP_ESTADO + filtro->estado;
+  if(filtro->formaPagamento != USUARIOS_QUALQUER) mapas[n_mapas++] = USUARIOS_BITMAP_PAGAMENTO + filtro->formaPagamento;
+  
+  resultado = (uint64_t *)malloc(indices->palavras*sizeof(uint64_t));
+  if(resultado == NULL) return USUARIOS_FALHA_ALOCAR;
+  memcpy(resultado, indices->bitmaps[mapas[0]], indices->palavras*sizeof(uint64_t));
+  for(i=1;i<n_mapas;i++)
+    for(p=0;p<indices->palavras;p++) resultado[p] &= indices->bitmaps[mapas[i]][p];
+  
+  /* A faixa de avaliação vira mais um mapa, montado com os ids entre os limites */
+  if(filtro->avaliacaoMinima > -DBL_MAX || filtro->avaliacaoMaxima < DBL_MAX) {
+    faixa = (uint64_t *)calloc(indices->palavras, sizeof(uint64_t));
+    if(faixa == NULL) {
+      free(resultado);
+      return USUARIOS_FALHA_ALOCAR;
     }
-    usuarios_freeUint(&amigosdeamigos);
+    inicio = usuarios_indicesPosicao(contexto, 0, indices->n, filtro->avaliacaoMinima, 0);
+    /* Nenhum usuário tem o id UINT_MAX, então fim fica depois de todos com avaliacaoMaxima */
+    fim = usuarios_indicesPosicao(contexto, inicio, indices->n, filtro->avaliacaoMaxima, UINT_MAX);
+    for(p=inicio;p<fim;p++) faixa[indices->por_avaliacao[p] / 64] |= (uint64_t)1 << (indices->por_avaliacao[p] % 64);
+    for(p=0;p<indices->palavras;p++) resultado[p] &= faixa[p];
+    free(faixa);
   }
   
-  usuarios_freeUint(&amigos);
-  return USUARIOS_SUCESSO;  
+  for(p=0;p<indices->palavras;p++) total += __builtin_popcountll(resultado[p]);
+  if(total) {
+    retorno->array = (unsigned int *)malloc(total*sizeof(unsigned int));
+    if(retorno->array == NULL) {
+      free(resultado);
+      return USUARIOS_FALHA_ALOCAR;
+    }
+    for(p=0;p<indices->palavras;p++)
+      for(palavra=resultado[p];palavra;palavra &= palavra-1)
+        retorno->array[retorno->length++] = p*64 + __builtin_ctzll(palavra);
+  }
+  
+  free(resultado);
+  return USUARIOS_SUCESSO;
 }
 
 /*!
@@ -1519,3 +5293,394 @@ usuarios_condRet usuarios_freeUint(usuarios_uintarray *vetor){
 }
 
 
+
+/*
+ * Funções no contexto padrão
+ *
+ * Cada função abaixo equivale à versão com sufixo _r chamada com
+ * usuarios_contextoPadrao(), cuja documentação descreve os parâmetros e
+ * retornos. Mantêm a interface anterior aos contextos.
+*/
+
+/*!
+ * @fn int usuarios_max()
+ * @brief Versão de usuarios_max_r no contexto padrão
+*/
+
+int usuarios_max(){
+  return usuarios_max_r(&usuarios_padrao);
+}
+
+/*!
+ * @fn usuarios_condRet usuarios_sincronizar()
+ * @brief Versão de usuarios_sincronizar_r no contexto padrão
+*/
+
+usuarios_condRet usuarios_sincronizar(){
+  return usuarios_sincronizar_r(&usuarios_padrao);
+}
+
+/*!
+ * @fn usuarios_condRet usuarios_carregarArquivo()
+ * @brief Versão de usuarios_carregarArquivo_r no contexto padrão
+*/
+
+usuarios_condRet usuarios_carregarArquivo(){
+  return usuarios_carregarArquivo_r(&usuarios_padrao);
+}
+
+/*!
+ * @fn usuarios_condRet usuarios_cadastro(int n, ...)
+ * @brief Versão de usuarios_cadastro_r no contexto padrão
+*/
+
+usuarios_condRet usuarios_cadastro(int n, ...){
+  usuarios_condRet retorno;
+  va_list argumentos;
+  
+  va_start(argumentos, n);
+  retorno = usuarios_cadastroLista(&usuarios_padrao, n, argumentos);
+  va_end(argumentos);
+  
+  return retorno;
+}
+
+/*!
+ * @fn int usuarios_sessaoAberta()
+ * @brief Versão de usuarios_sessaoAberta_r no contexto padrão
+*/
+
+int usuarios_sessaoAberta(){
+  return usuarios_sessaoAberta_r(&usuarios_padrao);
+}
+
+/*!
+ * @fn usuarios_condRet usuarios_login(char *usuario, char *senha)
+ * @brief Versão de usuarios_login_r no contexto padrão
+*/
+
+usuarios_condRet usuarios_login(char *usuario, char *senha){
+  return usuarios_login_r(&usuarios_padrao, usuario, senha);
+}
+
+/*!
+ * @fn usuarios_condRet usuarios_logout()
+ * @brief Versão de usuarios_logout_r no contexto padrão
+*/
+
+usuarios_condRet usuarios_logout(){
+  return usuarios_logout_r(&usuarios_padrao);
+}
+
+/*!
+ * @fn usuarios_relacao usuarios_verificarAmizade(unsigned int identificador)
+ * @brief Versão de usuarios_verificarAmizade_r no contexto padrão
+*/
+
+usuarios_relacao usuarios_verificarAmizade(unsigned int identificador){
+  return usuarios_verificarAmizade_r(&usuarios_padrao, identificador);
+}
+
+/*!
+ * @fn usuarios_condRet usuarios_criarAmizade(unsigned int identificador)
+ * @brief Versão de usuarios_criarAmizade_r no contexto padrão
+*/
+
+usuarios_condRet usuarios_criarAmizade(unsigned int identificador){
+  return usuarios_criarAmizade_r(&usuarios_padrao, identificador);
+}
+
+/*!
+ * @fn void usuarios_travarLeitura()
+ * @brief Versão de usuarios_travarLeitura_r no contexto padrão
+*/
+
+void usuarios_travarLeitura(){
+  usuarios_travarLeitura_r(&usuarios_padrao);
+}
+
+/*!
+ * @fn void usuarios_travarEscrita()
+ * @brief Versão de usuarios_travarEscrita_r no contexto padrão
+*/
+
+void usuarios_travarEscrita(){
+  usuarios_travarEscrita_r(&usuarios_padrao);
+}
+
+/*!
+ * @fn void usuarios_destravar()
+ * @brief Versão de usuarios_destravar_r no contexto padrão
+*/
+
+void usuarios_destravar(){
+  usuarios_destravar_r(&usuarios_padrao);
+}
+
+/*!
+ * @fn usuarios_condRet usuarios_loginSessao(const char *usuario, const char *senha, usuarios_token *token)
+ * @brief Versão de usuarios_loginSessao_r no contexto padrão
+*/
+
+usuarios_condRet usuarios_loginSessao(const char *usuario, const char *senha, usuarios_token *token){
+  return usuarios_loginSessao_r(&usuarios_padrao, usuario, senha, token);
+}
+
+/*!
+ * @fn usuarios_condRet usuarios_logoutSessao(usuarios_token token)
+ * @brief Versão de usuarios_logoutSessao_r no contexto padrão
+*/
+
+usuarios_condRet usuarios_logoutSessao(usuarios_token token){
+  return usuarios_logoutSessao_r(&usuarios_padrao, token);
+}
+
+/*!
+ * @fn usuarios_condRet usuarios_sessaoIdentificador(usuarios_token token, unsigned int *identificador)
+ * @brief Versão de usuarios_sessaoIdentificador_r no contexto padrão
+*/
+
+usuarios_condRet usuarios_sessaoIdentificador(usuarios_token token, unsigned int *identificador){
+  return usuarios_sessaoIdentificador_r(&usuarios_padrao, token, identificador);
+}
+
+/*!
+ * @fn usuarios_condRet usuarios_retornaDadosSessao(usuarios_token token, const char *nomeDado, void *retorno)
+ * @brief Versão de usuarios_retornaDadosSessao_r no contexto padrão
+*/
+
+usuarios_condRet usuarios_retornaDadosSessao(usuarios_token token, const char *nomeDado, void *retorno){
+  return usuarios_retornaDadosSessao_r(&usuarios_padrao, token, nomeDado, retorno);
+}
+
+/*!
+ * @fn usuarios_condRet usuarios_criarAmizadeSessao(usuarios_token token, unsigned int identificador)
+ * @brief Versão de usuarios_criarAmizadeSessao_r no contexto padrão
+*/
+
+usuarios_condRet usuarios_criarAmizadeSessao(usuarios_token token, unsigned int identificador){
+  return usuarios_criarAmizadeSessao_r(&usuarios_padrao, token, identificador);
+}
+
+/*!
+ * @fn usuarios_relacao usuarios_verificarAmizadeSessao(usuarios_token token, unsigned int identificador)
+ * @brief Versão de usuarios_verificarAmizadeSessao_r no contexto padrão
+*/
+
+usuarios_relacao usuarios_verificarAmizadeSessao(usuarios_token token, unsigned int identificador){
+  return usuarios_verificarAmizadeSessao_r(&usuarios_padrao, token, identificador);
+}
+
+/*!
+ * @fn unsigned int usuarios_sessoesAbertas()
+ * @brief Versão de usuarios_sessoesAbertas_r no contexto padrão
+*/
+
+unsigned int usuarios_sessoesAbertas(){
+  return usuarios_sessoesAbertas_r(&usuarios_padrao);
+}
+
+/*!
+ * @fn usuarios_condRet usuarios_removerAmizade(unsigned int identificador_A, unsigned int identificador_B)
+ * @brief Versão de usuarios_removerAmizade_r no contexto padrão
+*/
+
+usuarios_condRet usuarios_removerAmizade(unsigned int identificador_A, unsigned int identificador_B){
+  return usuarios_removerAmizade_r(&usuarios_padrao, identificador_A, identificador_B);
+}
+
+/*!
+ * @fn usuarios_condRet usuarios_retornaDados(unsigned int identificador, const char *nomeDado, void *retorno)
+ * @brief Versão de usuarios_retornaDados_r no contexto padrão
+*/
+
+usuarios_condRet usuarios_retornaDados(unsigned int identificador, const char *nomeDado, void *retorno){
+  return usuarios_retornaDados_r(&usuarios_padrao, identificador, nomeDado, retorno);
+}
+
+/*!
+ * @fn usuarios_condRet usuarios_retornaCampo(unsigned int identificador, usuarios_campo campo, void *retorno)
+ * @brief Versão de usuarios_retornaCampo_r no contexto padrão
+*/
+
+usuarios_condRet usuarios_retornaCampo(unsigned int identificador, usuarios_campo campo, void *retorno){
+  return usuarios_retornaCampo_r(&usuarios_padrao, identificador, campo, retorno);
+}
+
+/*!
+ * @fn const char *usuarios_campoTexto(unsigned int identificador, usuarios_campo campo, char *destino, size_t tamanho)
+ * @brief Versão de usuarios_campoTexto_r no contexto padrão
+*/
+
+const char *usuarios_campoTexto(unsigned int identificador, usuarios_campo campo, char *destino, size_t tamanho){
+  return usuarios_campoTexto_r(&usuarios_padrao, identificador, campo, destino, tamanho);
+}
+
+/*!
+ * @fn usuarios_condRet usuarios_campoInteiro(unsigned int identificador, usuarios_campo campo, unsigned int *retorno)
+ * @brief Versão de usuarios_campoInteiro_r no contexto padrão
+*/
+
+usuarios_condRet usuarios_campoInteiro(unsigned int identificador, usuarios_campo campo, unsigned int *retorno){
+  return usuarios_campoInteiro_r(&usuarios_padrao, identificador, campo, retorno);
+}
+
+/*!
+ * @fn usuarios_condRet usuarios_campoReal(unsigned int identificador, usuarios_campo campo, double *retorno)
+ * @brief Versão de usuarios_campoReal_r no contexto padrão
+*/
+
+usuarios_condRet usuarios_campoReal(unsigned int identificador, usuarios_campo campo, double *retorno){
+  return usuarios_campoReal_r(&usuarios_padrao, identificador, campo, retorno);
+}
+
+/*!
+ * @fn usuarios_condRet usuarios_atualizarDados(unsigned int identificador, const char *nomeDado, ...)
+ * @brief Versão de usuarios_atualizarDados_r no contexto padrão
+*/
+
+usuarios_condRet usuarios_atualizarDados(unsigned int identificador, const char *nomeDado, ...){
+  usuarios_condRet retorno;
+  va_list arg;
+  
+  va_start(arg, nomeDado);
+  retorno = usuarios_atualizarLista(&usuarios_padrao, identificador, nomeDado, arg);
+  va_end(arg);
+  
+  return retorno;
+}
+
+/*!
+ * @fn usuarios_condRet usuarios_atualizarAvaliacao(unsigned int identificador, double avaliacao, unsigned int n_avaliacao)
+ * @brief Versão de usuarios_atualizarAvaliacao_r no contexto padrão
+*/
+
+usuarios_condRet usuarios_atualizarAvaliacao(unsigned int identificador, double avaliacao, unsigned int n_avaliacao){
+  return usuarios_atualizarAvaliacao_r(&usuarios_padrao, identificador, avaliacao, n_avaliacao);
+}
+
+/*!
+ * @fn usuarios_condRet usuarios_limpar()
+ * @brief Versão de usuarios_limpar_r no contexto padrão
+*/
+
+usuarios_condRet usuarios_limpar(){
+  return usuarios_limpar_r(&usuarios_padrao);
+}
+
+/*!
+ * @fn usuarios_condRet usuarios_listarAmigos(unsigned int identificador, usuarios_uintarray *retorno)
+ * @brief Versão de usuarios_listarAmigos_r no contexto padrão
+*/
+
+usuarios_condRet usuarios_listarAmigos(unsigned int identificador, usuarios_uintarray *retorno){
+  return usuarios_listarAmigos_r(&usuarios_padrao, identificador, retorno);
+}
+
+/*!
+ * @fn usuarios_condRet usuarios_listarAmigosPendentes(unsigned int identificador, usuarios_uintarray *retorno)
+ * @brief Versão de usuarios_listarAmigosPendentes_r no contexto padrão
+*/
+
+usuarios_condRet usuarios_listarAmigosPendentes(unsigned int identificador, usuarios_uintarray *retorno){
+  return usuarios_listarAmigosPendentes_r(&usuarios_padrao, identificador, retorno);
+}
+
+/*!
+ * @fn usuarios_condRet usuarios_listarAmigosdeAmigos(unsigned int identificador, usuarios_uintarray *retorno)
+ * @brief Versão de usuarios_listarAmigosdeAmigos_r no contexto padrão
+*/
+
+usuarios_condRet usuarios_listarAmigosdeAmigos(unsigned int identificador, usuarios_uintarray *retorno){
+  return usuarios_listarAmigosdeAmigos_r(&usuarios_padrao, identificador, retorno);
+}
+
+/*!
+ * @fn usuarios_condRet usuarios_recomendarAmigos(unsigned int identificador, unsigned int k, usuarios_recomendacao *retorno, unsigned int *n)
+ * @brief Versão de usuarios_recomendarAmigos_r no contexto padrão
+*/
+
+usuarios_condRet usuarios_recomendarAmigos(unsigned int identificador, unsigned int k, usuarios_recomendacao *retorno, unsigned int *n){
+  return usuarios_recomendarAmigos_r(&usuarios_padrao, identificador, k, retorno, n);
+}
+
+/*!
+ * @fn usuarios_condRet usuarios_grauSeparacao(unsigned int origem, unsigned int destino, unsigned int profundidadeMax, unsigned int *distancia, usuarios_uintarray *caminho)
+ * @brief Versão de usuarios_grauSeparacao_r no contexto padrão
+*/
+
+usuarios_condRet usuarios_grauSeparacao(unsigned int origem, unsigned int destino, unsigned int profundidadeMax, unsigned int *distancia, usuarios_uintarray *caminho){
+  return usuarios_grauSeparacao_r(&usuarios_padrao, origem, destino, profundidadeMax, distancia, caminho);
+}
+
+/*!
+ * @fn usuarios_condRet usuarios_pesquisar(const char *consulta, unsigned int pagina, unsigned int tamanhoPagina, usuarios_uintarray *retorno, unsigned int *total)
+ * @brief Versão de usuarios_pesquisar_r no contexto padrão
+*/
+
+usuarios_condRet usuarios_pesquisar(const char *consulta, unsigned int pagina, unsigned int tamanhoPagina, usuarios_uintarray *retorno, unsigned int *total){
+  return usuarios_pesquisar_r(&usuarios_padrao, consulta, pagina, tamanhoPagina, retorno, total);
+}
+
+/*!
+ * @fn usuarios_condRet usuarios_compactarAmizades(unsigned int *removidos)
+ * @brief Versão de usuarios_compactarAmizades_r no contexto padrão
+*/
+
+usuarios_condRet usuarios_compactarAmizades(unsigned int *removidos){
+  return usuarios_compactarAmizades_r(&usuarios_padrao, removidos);
+}
+
+/*!
+ * @fn usuarios_condRet usuarios_carregarIndice(unsigned int limite)
+ * @brief Versão de usuarios_carregarIndice_r no contexto padrão
+*/
+
+usuarios_condRet usuarios_carregarIndice(unsigned int limite){
+  return usuarios_carregarIndice_r(&usuarios_padrao, limite);
+}
+
+/*!
+ * @fn unsigned int usuarios_registrosResidentes()
+ * @brief Versão de usuarios_registrosResidentes_r no contexto padrão
+*/
+
+unsigned int usuarios_registrosResidentes(){
+  return usuarios_registrosResidentes_r(&usuarios_padrao);
+}
+
+/*!
+ * @fn unsigned int usuarios_textosInternados()
+ * @brief Versão de usuarios_textosInternados_r no contexto padrão
+*/
+
+unsigned int usuarios_textosInternados(){
+  return usuarios_textosInternados_r(&usuarios_padrao);
+}
+
+/*!
+ * @fn void usuarios_estatisticasDisponibilidade(usuarios_estatisticas_disponibilidade *estatisticas)
+ * @brief Versão de usuarios_estatisticasDisponibilidade_r no contexto padrão
+*/
+
+void usuarios_estatisticasDisponibilidade(usuarios_estatisticas_disponibilidade *estatisticas){
+  usuarios_estatisticasDisponibilidade_r(&usuarios_padrao, estatisticas);
+}
+
+/*!
+ * @fn void usuarios_threadsCarga(unsigned int threads)
+ * @brief Versão de usuarios_threadsCarga_r no contexto padrão
+*/
+
+void usuarios_threadsCarga(unsigned int threads){
+  usuarios_threadsCarga_r(&usuarios_padrao, threads);
+}
+
+/*!
+ * @fn usuarios_condRet usuarios_consultar(const usuarios_filtro *filtro, usuarios_uintarray *retorno)
+ * @brief Versão de usuarios_consultar_r no contexto padrão
+*/
+
+usuarios_condRet usuarios_consultar(const usuarios_filtro *filtro, usuarios_uintarray *retorno){
+  return usuarios_consultar_r(&usuarios_padrao, filtro, retorno);
+}
@@ -24,6 +24,13 @@ int main(int argc, char *argv[])
         exit(1);
     }
 
+    //conferir avaliacao e n_avaliacao dos usuarios com o arquivo de avaliacoes
+    unsigned int corrigidos;
+    if(avaliacao_recalcular(0, &corrigidos) != AVALIACAO_SUCESSO)
+        cout << "Nao foi possivel conferir as avaliacoes" << endl;
+    else if(corrigidos)
+        cout << corrigidos << " usuarios com avaliacao corrigida" << endl;
+
     cout << "teste" << endl;
 
     productList lista;